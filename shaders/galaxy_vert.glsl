@@ -1,24 +1,42 @@
+// xyz: blob position, w: blob brightness
 attribute vec4 in_Position;
+// xy: sprite corner, z: color index, w: number of times the sprite is shrunk
 attribute vec4 in_TexCoord0;
-//attribute float in_ColorIndex;
-//attribute float in_Alpha;
 
 uniform sampler2D colorTex;
+// Transformation of the galactic form, relative to the galaxy
+uniform mat4 galaxyMatrix;
+// Sprite axes facing the viewer
+uniform vec3 spriteRight;
+uniform vec3 spriteUp;
+uniform float size;
+uniform float spriteScaleFactor;
+uniform float alphaScale;
 
 varying vec4 color;
 varying vec2 texCoord;
 
 void main(void)
 {
-    // we pass color index as short int
-    // reusing gl_MultiTexCoord0.z
+    vec3 p = (galaxyMatrix * vec4(in_Position.xyz, 1.0)).xyz;
+    float spriteSize = size * pow(spriteScaleFactor, in_TexCoord0.w);
+
+    // Sprites too large on screen are moved outside of the clip volume
+    float screenFrac = spriteSize / length(p);
+    if (screenFrac >= 0.1)
+    {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        color = vec4(0.0);
+        texCoord = vec2(0.0);
+        return;
+    }
+
     // we use 255 only because we have 256 color indices
     float t = in_TexCoord0.z / 255.0; // [0, 255] -> [0, 1]
-    // we pass alpha values as as short int
-    // reusing gl_MultiTexCoord0.w
-    // we use 65535 for better precision
-    float a = in_TexCoord0.w / 65535.0; // [0, 65535] -> [0, 1]
+    float a = min(1.0, alphaScale * (0.1 - screenFrac) * in_Position.w);
     color = vec4(texture2D(colorTex, vec2(t, 0.0)).rgb, a);
-    texCoord = in_TexCoord0.st;
-    set_vp(in_Position);
+    texCoord = in_TexCoord0.xy;
+
+    vec2 corner = in_TexCoord0.xy * 2.0 - 1.0;
+    set_vp(vec4(p + (spriteRight * corner.x + spriteUp * corner.y) * spriteSize, 1.0));
 }
@@ -0,0 +1,12 @@
+uniform sampler2D starTex;
+uniform int starStyle;
+varying vec4 color;
+
+void main(void)
+{
+    // Point stars are drawn untextured
+    if (starStyle == 1)
+        gl_FragColor = color;
+    else
+        gl_FragColor = texture2D(starTex, gl_PointCoord) * color;
+}
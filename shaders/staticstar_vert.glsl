@@ -0,0 +1,53 @@
+attribute vec3 in_Position;
+attribute vec4 in_Color;
+// x: absolute magnitude, y: extinction per light year
+attribute vec4 in_TexCoord0;
+
+uniform vec3 obsPosHigh;
+uniform vec3 obsPosLow;
+uniform float limitingMag;
+uniform float faintestMag;
+uniform float brightnessScale;
+uniform float brightnessBias;
+uniform float satPoint;
+uniform float discSize;
+uniform float maxScaledDiscSize;
+uniform float minDistance;
+uniform float maxDistance;
+uniform int starStyle;
+
+varying vec4 color;
+
+const float LY_PER_PARSEC = 3.26167;
+const float LOG10_2 = 0.30103;
+
+void main(void)
+{
+    vec3 relPos = (in_Position - obsPosHigh) - obsPosLow;
+    float distance = length(relPos);
+    float appMag = in_TexCoord0.x - 5.0 + 5.0 * LOG10_2 * log2(distance / LY_PER_PARSEC) + in_TexCoord0.y * distance;
+
+    // Stars drawn by the CPU, and stars too faint or too far, are moved
+    // outside of the clip volume
+    if (in_Color.a == 0.0 || appMag >= limitingMag || distance < minDistance || distance > maxDistance)
+    {
+        gl_Position = vec4(2.0, 2.0, 2.0, 1.0);
+        gl_PointSize = 1.0;
+        color = vec4(0.0);
+        return;
+    }
+
+    // Same as Renderer::calculatePointSize()
+    float alpha = max(0.0, (faintestMag - appMag) * brightnessScale + brightnessBias);
+    float size = discSize;
+    if (alpha > 1.0)
+    {
+        if (starStyle == 2)
+            size *= max(1.0, min(maxScaledDiscSize, pow(2.0, 0.3 * (satPoint - appMag))));
+        alpha = 1.0;
+    }
+
+    gl_PointSize = size;
+    color = vec4(in_Color.rgb, alpha);
+    set_vp(vec4(relPos, 1.0));
+}
@@ -996,14 +996,21 @@ void Body::computeLocations()
     if (locationsComputed)
         return;
 
-    locationsComputed = true;
-
     // No work to do if there's no mesh, or if the mesh cannot be loaded
     if (geometry == InvalidResource)
+    {
+        locationsComputed = true;
         return;
+    }
     Geometry* g = GetGeometryManager()->find(geometry);
     if (!g)
+    {
+        // Try again once a mesh loading in the background is ready
+        locationsComputed = GetGeometryManager()->getState(geometry) != ResourceLoading;
         return;
+    }
+
+    locationsComputed = true;
 
     // TODO: Implement separate radius and bounding radius so that this hack is
     // not necessary.
@@ -0,0 +1,101 @@
+// catalogquery.h
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// Filter and ordering of star and deep sky object catalog queries.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include <Eigen/Core>
+
+#include <celcompat/numbers.h>
+
+
+struct CatalogQuery
+{
+    enum class SortKey
+    {
+        None,
+        Distance,
+        ApparentMagnitude,
+        AbsoluteMagnitude,
+    };
+
+    static constexpr std::uint32_t AllSpectralClasses = (UINT32_C(1) << 26) - 1;
+
+    // Observer position in light years
+    Eigen::Vector3d observer{ Eigen::Vector3d::Zero() };
+
+    // Only objects within coneAngle radians of the unit vector coneAxis,
+    // seen from the observer, match. The cone is disabled when the angle
+    // is pi or larger.
+    Eigen::Vector3d coneAxis{ Eigen::Vector3d::UnitZ() };
+    double coneAngle{ celestia::numbers::pi };
+
+    // Distance range from the observer in light years
+    float minDistance{ 0.0f };
+    float maxDistance{ std::numeric_limits<float>::infinity() };
+
+    float minAppMag{ -std::numeric_limits<float>::infinity() };
+    float maxAppMag{ std::numeric_limits<float>::infinity() };
+    float minAbsMag{ -std::numeric_limits<float>::infinity() };
+    float maxAbsMag{ std::numeric_limits<float>::infinity() };
+
+    // Stars only: bit n is set to match stars whose spectral type starts
+    // with the letter 'A' + n, see spectralClassBit().
+    std::uint32_t spectralClassMask{ AllSpectralClasses };
+
+    // Deep sky objects only: Renderer::Show* flags of the object types to
+    // match, as returned by DeepSkyObject::getRenderMask().
+    std::uint64_t dsoTypeMask{ ~UINT64_C(0) };
+
+    SortKey sortKey{ SortKey::None };
+    std::uint32_t maxResults{ std::numeric_limits<std::uint32_t>::max() };
+
+    static std::uint32_t spectralClassBit(char c)
+    {
+        return c >= 'A' && c <= 'Z' ? UINT32_C(1) << (c - 'A') : 0;
+    }
+
+    bool hasCone() const
+    {
+        return coneAngle < celestia::numbers::pi;
+    }
+
+    bool hasAppMagLimits() const
+    {
+        return minAppMag > -std::numeric_limits<float>::infinity() ||
+               maxAppMag < std::numeric_limits<float>::infinity();
+    }
+
+    // Test an object at offset from the observer, distance being the
+    // length of offset
+    bool inCone(const Eigen::Vector3d& offset, double distance) const
+    {
+        return !hasCone() || offset.dot(coneAxis) >= std::cos(coneAngle) * distance;
+    }
+
+    // Whether a sphere at offset from the observer may intersect the cone
+    bool sphereInCone(const Eigen::Vector3d& offset, double radius) const
+    {
+        if (!hasCone())
+            return true;
+
+        double distance = offset.norm();
+        if (distance <= radius)
+            return true;
+
+        double angle = std::acos(std::clamp(offset.dot(coneAxis) / distance, -1.0, 1.0));
+        return angle - std::asin(radius / distance) <= coneAngle;
+    }
+};
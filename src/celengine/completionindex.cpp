@@ -0,0 +1,122 @@
+// completionindex.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// Prefix index used for object name completion.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+
+#include <celutil/utf8.h>
+#include "completionindex.h"
+
+
+void CompletionIndex::build(const std::vector<const std::string*>& names)
+{
+    clear();
+    if (names.empty())
+        return;
+
+    entries.reserve(names.size());
+    for (const std::string* name : names)
+    {
+        auto offset = static_cast<std::uint32_t>(keys.size());
+        keys.append(UTF8FoldCase(*name));
+        entries.push_back({ offset, static_cast<std::uint32_t>(keys.size() - offset), name });
+    }
+
+    std::sort(entries.begin(), entries.end(),
+              [this](const Entry& e0, const Entry& e1) { return key(e0) < key(e1); });
+
+    nodes.push_back({ 0, static_cast<std::uint32_t>(entries.size()), 0, 0, 0, 0 });
+    for (std::size_t i = 0; i < nodes.size(); ++i)
+    {
+        // Since the entries are sorted, the prefix shared by all entries of
+        // the node is the one shared by the first and the last.
+        std::string_view first = key(entries[nodes[i].firstEntry]);
+        std::string_view last = key(entries[nodes[i].lastEntry - 1]);
+        std::uint32_t depth = nodes[i].depth;
+        while (depth < first.size() && depth < last.size() && first[depth] == last[depth])
+            ++depth;
+
+        nodes[i].depth = depth;
+        nodes[i].firstChild = static_cast<std::uint32_t>(nodes.size());
+
+        std::uint32_t entry = nodes[i].firstEntry;
+        std::uint32_t lastEntry = nodes[i].lastEntry;
+        while (entry < lastEntry && key(entries[entry]).size() == depth)
+            ++entry;
+
+        while (entry < lastEntry)
+        {
+            char label = key(entries[entry])[depth];
+            std::uint32_t childEnd = entry + 1;
+            while (childEnd < lastEntry && key(entries[childEnd])[depth] == label)
+                ++childEnd;
+
+            nodes.push_back({ entry, childEnd, depth + 1, 0, 0, static_cast<unsigned char>(label) });
+            entry = childEnd;
+        }
+
+        nodes[i].childCount = static_cast<std::uint32_t>(nodes.size()) - nodes[i].firstChild;
+    }
+}
+
+
+void CompletionIndex::clear()
+{
+    keys.clear();
+    entries.clear();
+    nodes.clear();
+}
+
+
+void CompletionIndex::find(std::string_view prefix,
+                           std::size_t maxCount,
+                           std::vector<std::string>& completion) const
+{
+    if (nodes.empty())
+        return;
+
+    const Node* node = &nodes.front();
+    std::size_t matched = 0;
+    for (;;)
+    {
+        // Check the part of the prefix that lies along the edge to this node
+        std::size_t end = std::min<std::size_t>(node->depth, prefix.size());
+        std::string_view nodeKey = key(entries[node->firstEntry]);
+        if (nodeKey.compare(matched, end - matched, prefix, matched, end - matched) != 0)
+            return;
+
+        if (prefix.size() <= node->depth)
+            break;
+
+        matched = node->depth;
+        node = findChild(*node, static_cast<unsigned char>(prefix[matched]));
+        if (node == nullptr)
+            return;
+    }
+
+    std::uint32_t lastEntry = node->lastEntry;
+    if (lastEntry - node->firstEntry > maxCount)
+        lastEntry = node->firstEntry + static_cast<std::uint32_t>(maxCount);
+    for (std::uint32_t i = node->firstEntry; i < lastEntry; ++i)
+        completion.push_back(*entries[i].name);
+}
+
+
+const CompletionIndex::Node* CompletionIndex::findChild(const Node& node,
+                                                        unsigned char label) const
+{
+    auto first = nodes.begin() + node.firstChild;
+    auto last = first + node.childCount;
+    auto it = std::lower_bound(first, last, label,
+                               [](const Node& child, unsigned char l) { return child.label < l; });
+    if (it == last || it->label != label)
+        return nullptr;
+    return &*it;
+}
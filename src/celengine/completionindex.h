@@ -0,0 +1,75 @@
+// completionindex.h
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// Prefix index used for object name completion.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Radix tree over the case folded forms of a set of names (see
+ * UTF8FoldCase). Every node covers a contiguous range of the names sorted
+ * by folded form, so the names starting with a prefix are found by walking
+ * down the prefix and then reading a range, rather than by comparing the
+ * prefix against every name.
+ *
+ * The index refers to the names it was built from, which must outlive it
+ * and must not change.
+ */
+class CompletionIndex
+{
+ public:
+    void build(const std::vector<const std::string*>& names);
+    void clear();
+    bool empty() const { return entries.empty(); }
+
+    // Append to completion at most maxCount names which start with prefix,
+    // which must already be case folded.
+    void find(std::string_view prefix,
+              std::size_t maxCount,
+              std::vector<std::string>& completion) const;
+
+ private:
+    struct Entry
+    {
+        std::uint32_t keyOffset;
+        std::uint32_t keyLength;
+        const std::string* name;
+    };
+
+    // Nodes are stored breadth first so that the children of a node are
+    // contiguous and ordered by label. All the entries of a node share their
+    // first depth bytes; those whose key is exactly depth bytes long are not
+    // covered by any child.
+    struct Node
+    {
+        std::uint32_t firstEntry;
+        std::uint32_t lastEntry;
+        std::uint32_t depth;
+        std::uint32_t firstChild;
+        std::uint32_t childCount;
+        unsigned char label;
+    };
+
+    std::string_view key(const Entry& entry) const
+    {
+        return std::string_view(keys).substr(entry.keyOffset, entry.keyLength);
+    }
+
+    const Node* findChild(const Node&, unsigned char label) const;
+
+    std::string keys;
+    std::vector<Entry> entries;
+    std::vector<Node> nodes;
+};
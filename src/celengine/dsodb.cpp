@@ -12,10 +12,14 @@
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
 
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
 #include <celutil/tokenizer.h>
+#include "astro.h"
 #include "galaxy.h"
 #include "globular.h"
 #include "parser.h"
@@ -27,6 +31,26 @@
 
 using celestia::util::GetLogger;
 
+namespace
+{
+
+// Keep the deep sky objects within the search radius of an octree query
+class DSOCollector : public DSOHandler
+{
+ public:
+    explicit DSOCollector(std::vector<const DeepSkyObject*>& _dsos) : dsos(_dsos) {}
+
+    void process(DeepSkyObject* const& dso, double /*distance*/, float /*appMag*/) override
+    {
+        dsos.push_back(dso);
+    }
+
+ private:
+    std::vector<const DeepSkyObject*>& dsos;
+};
+
+} // end unnamed namespace
+
 constexpr const float DSO_OCTREE_MAGNITUDE   = 8.0f;
 //constexpr const float DSO_EXTRA_ROOM         = 0.01f; // Reserve 1% capacity for extra DSOs
                                                       // (useful as a complement of binary loaded DSOs)
@@ -135,7 +159,8 @@ void DSODatabase::findVisibleDSOs(DSOHandler& dsoHandler,
                                   float fovY,
                                   float aspectRatio,
                                   float limitingMag,
-                                  OctreeProcStats *stats) const
+                                  OctreeProcStats *stats,
+                                  celestia::util::ThreadPool* threadPool) const
 {
     // Compute the bounding planes of an infinite view frustum
     Eigen::Hyperplane<double, 3> frustumPlanes[5];
@@ -158,6 +183,18 @@ void DSODatabase::findVisibleDSOs(DSOHandler& dsoHandler,
         frustumPlanes[i]   = Eigen::Hyperplane<double, 3>(planeNormals[i], obsPos);
     }
 
+    // Statistics are only gathered by serial traversals
+    if (threadPool != nullptr && threadPool->size() > 1)
+    {
+        octreeRoot->processVisibleObjects(dsoHandler,
+                                          obsPos,
+                                          frustumPlanes,
+                                          limitingMag,
+                                          DSO_OCTREE_ROOT_SIZE,
+                                          *threadPool);
+        return;
+    }
+
     octreeRoot->processVisibleObjects(dsoHandler,
                                       obsPos,
                                       frustumPlanes,
@@ -178,6 +215,75 @@ void DSODatabase::findCloseDSOs(DSOHandler& dsoHandler,
 }
 
 
+void DSODatabase::findDSOs(std::vector<const DeepSkyObject*>& dsos,
+                           const CatalogQuery& query) const
+{
+    // Only the octree nodes within the maximum distance need to be visited
+    std::vector<const DeepSkyObject*> candidates;
+    if (query.maxDistance < std::numeric_limits<float>::infinity())
+    {
+        DSOCollector collector(candidates);
+        findCloseDSOs(collector, query.observer, query.maxDistance);
+    }
+    else
+    {
+        candidates.assign(DSOs, DSOs + nDSOs);
+    }
+
+    std::vector<std::pair<float, const DeepSkyObject*>> matches;
+    for (const DeepSkyObject* dso : candidates)
+    {
+        if ((dso->getRenderMask() & query.dsoTypeMask) == 0)
+            continue;
+
+        float absMag = dso->getAbsoluteMagnitude();
+        if (absMag < query.minAbsMag || absMag > query.maxAbsMag)
+            continue;
+
+        Eigen::Vector3d offset = dso->getPosition() - query.observer;
+        double distance = offset.norm();
+        if (distance < query.minDistance || distance > query.maxDistance ||
+            !query.inCone(offset, distance))
+        {
+            continue;
+        }
+
+        // Same convention as the renderer for objects closer than 10 pc
+        auto appMag = static_cast<float>(distance >= 32.6167 ? astro::absToAppMag(static_cast<double>(absMag), distance) : absMag);
+        if (appMag < query.minAppMag || appMag > query.maxAppMag)
+            continue;
+
+        float key = 0.0f;
+        switch (query.sortKey)
+        {
+        case CatalogQuery::SortKey::ApparentMagnitude:
+            key = appMag;
+            break;
+        case CatalogQuery::SortKey::AbsoluteMagnitude:
+            key = absMag;
+            break;
+        case CatalogQuery::SortKey::Distance:
+            key = static_cast<float>(distance);
+            break;
+        default:
+            break;
+        }
+        matches.emplace_back(key, dso);
+    }
+
+    std::size_t nResults = std::min(matches.size(), static_cast<std::size_t>(query.maxResults));
+    if (query.sortKey != CatalogQuery::SortKey::None)
+    {
+        std::partial_sort(matches.begin(), matches.begin() + nResults, matches.end(),
+                          [](const auto& a, const auto& b) { return a.first < b.first; });
+    }
+
+    dsos.reserve(dsos.size() + nResults);
+    for (std::size_t i = 0; i < nResults; ++i)
+        dsos.push_back(matches[i].second);
+}
+
+
 DSONameDatabase* DSODatabase::getNameDatabase() const
 {
     return namesDB;
@@ -193,6 +299,12 @@ void DSODatabase::setNameDatabase(DSONameDatabase* _namesDB)
 bool DSODatabase::load(std::istream& in, const fs::path& resourcePath)
 {
     Tokenizer tokenizer(&in);
+    return load(tokenizer, resourcePath);
+}
+
+
+bool DSODatabase::load(Tokenizer& tokenizer, const fs::path& resourcePath)
+{
     Parser    parser(&tokenizer);
 
 #ifdef ENABLE_NLS
@@ -335,6 +447,8 @@ void DSODatabase::finish()
     buildOctree();
     buildIndexes();
     calcAvgAbsMag();
+    if (namesDB != nullptr)
+        namesDB->buildCompletionIndex();
     /*
     // Put AbsMag = avgAbsMag for Add-ons without AbsMag entry
     for (int i = 0; i < nDSOs; ++i)
@@ -21,9 +21,11 @@
 #include <Eigen/Geometry>
 
 #include <celcompat/filesystem.h>
+#include <celengine/catalogquery.h>
 #include <celengine/dsooctree.h>
 
 class DSONameDatabase;
+class Tokenizer;
 
 constexpr inline unsigned int MAX_DSO_NAMES = 10;
 
@@ -52,12 +54,19 @@ class DSODatabase
                          float fovY,
                          float aspectRatio,
                          float limitingMag,
-                         OctreeProcStats * = nullptr) const;
+                         OctreeProcStats * = nullptr,
+                         celestia::util::ThreadPool* threadPool = nullptr) const;
 
     void findCloseDSOs(DSOHandler& dsoHandler,
                        const Eigen::Vector3d& obsPosition,
                        float radius) const;
 
+    // Append the deep sky objects matching the query, in the order of its
+    // sort key, up to query.maxResults objects. Distances are measured to
+    // the centers of the objects.
+    void findDSOs(std::vector<const DeepSkyObject*>& dsos,
+                  const CatalogQuery& query) const;
+
     std::string getDSOName    (const DeepSkyObject* const &, bool i18n = false) const;
     std::string getDSONameList(const DeepSkyObject* const &, const unsigned int maxNames = MAX_DSO_NAMES) const;
 
@@ -65,6 +74,7 @@ class DSODatabase
     void setNameDatabase(DSONameDatabase*);
 
     bool load(std::istream&, const fs::path& resourcePath = fs::path());
+    bool load(Tokenizer&, const fs::path& resourcePath = fs::path());
     bool loadBinary(std::istream&);
     void finish();
 
@@ -16,6 +16,7 @@
 #include <celengine/deepskyobj.h>
 #include <celengine/location.h>
 #include <celengine/frame.h>
+#include <celutil/timecache.h>
 
 using namespace Eigen;
 using namespace std;
@@ -25,6 +26,26 @@ using namespace std;
 // are Julian days.
 static const double ANGULAR_VELOCITY_DIFF_DELTA = 1.0 / 1440.0;
 
+namespace
+{
+
+// Recently computed state of a CachingFrame
+struct FrameState
+{
+    Quaterniond orientation;
+    Vector3d angularVelocity;
+};
+
+enum
+{
+    OrientationValid     = 0x1,
+    AngularVelocityValid = 0x2,
+};
+
+using FrameCache = celestia::util::TimeCache<FrameState, 256>;
+
+} // end unnamed namespace
+
 
 /*** ReferenceFrame ***/
 
@@ -167,6 +188,13 @@ ReferenceFrame::nestingDepth(unsigned int maxDepth, FrameType frameType) const
 }
 
 
+void
+ReferenceFrame::getReferencedObjects(std::vector<Selection>& objects) const
+{
+    objects.push_back(centerObject);
+}
+
+
 static unsigned int
 getFrameDepth(const Selection& sel, unsigned int depth, unsigned int maxDepth,
               ReferenceFrame::FrameType frameType)
@@ -336,6 +364,14 @@ BodyFixedFrame::nestingDepth(unsigned int depth,
 }
 
 
+void
+BodyFixedFrame::getReferencedObjects(std::vector<Selection>& objects) const
+{
+    ReferenceFrame::getReferencedObjects(objects);
+    objects.push_back(fixObject);
+}
+
+
 /*** BodyMeanEquatorFrame ***/
 
 BodyMeanEquatorFrame::BodyMeanEquatorFrame(Selection center,
@@ -441,15 +477,26 @@ BodyMeanEquatorFrame::nestingDepth(unsigned int depth,
 }
 
 
+void
+BodyMeanEquatorFrame::getReferencedObjects(std::vector<Selection>& objects) const
+{
+    ReferenceFrame::getReferencedObjects(objects);
+    objects.push_back(equatorObject);
+}
+
+
 /*** CachingFrame ***/
 
 CachingFrame::CachingFrame(Selection _center) :
     ReferenceFrame(_center),
-    lastTime(-1.0e50),
-    lastOrientation(Quaterniond::Identity()),
-    lastAngularVelocity(0.0, 0.0, 0.0),
-    orientationCacheValid(false),
-    angularVelocityCacheValid(false)
+    cacheKey(FrameCache::newKey())
+{
+}
+
+
+CachingFrame::CachingFrame(const CachingFrame& other) :
+    ReferenceFrame(other),
+    cacheKey(FrameCache::newKey())
 {
 }
 
@@ -457,39 +504,31 @@ CachingFrame::CachingFrame(Selection _center) :
 Quaterniond
 CachingFrame::getOrientation(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastOrientation = computeOrientation(tjd);
-        orientationCacheValid = true;
-        angularVelocityCacheValid = false;
-    }
-    else if (!orientationCacheValid)
-    {
-        lastOrientation = computeOrientation(tjd);
-        orientationCacheValid = true;
-    }
+    FrameCache::Entry& entry = FrameCache::entry(cacheKey, tjd);
+    if (entry.has(cacheKey, tjd, OrientationValid))
+        return entry.values.orientation;
+
+    Quaterniond orientation = computeOrientation(tjd);
+    entry.claim(cacheKey, tjd);
+    entry.values.orientation = orientation;
+    entry.valid |= OrientationValid;
 
-    return lastOrientation;
+    return orientation;
 }
 
 
 Vector3d CachingFrame::getAngularVelocity(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        orientationCacheValid = false;
-        angularVelocityCacheValid = true;
-    }
-    else if (!angularVelocityCacheValid)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        angularVelocityCacheValid = true;
-    }
+    FrameCache::Entry& entry = FrameCache::entry(cacheKey, tjd);
+    if (entry.has(cacheKey, tjd, AngularVelocityValid))
+        return entry.values.angularVelocity;
+
+    Vector3d angularVelocity = computeAngularVelocity(tjd);
+    entry.claim(cacheKey, tjd);
+    entry.values.angularVelocity = angularVelocity;
+    entry.valid |= AngularVelocityValid;
 
-    return lastAngularVelocity;
+    return angularVelocity;
 }
 
 
@@ -660,6 +699,15 @@ TwoVectorFrame::nestingDepth(unsigned int depth,
 }
 
 
+void
+TwoVectorFrame::getReferencedObjects(std::vector<Selection>& objects) const
+{
+    ReferenceFrame::getReferencedObjects(objects);
+    primaryVector.getReferencedObjects(objects);
+    secondaryVector.getReferencedObjects(objects);
+}
+
+
 
 // Copy constructor
 FrameVector::FrameVector(const FrameVector& fv) :
@@ -801,3 +849,25 @@ FrameVector::nestingDepth(unsigned int depth,
         return depth;
     }
 }
+
+
+void
+FrameVector::getReferencedObjects(std::vector<Selection>& objects) const
+{
+    switch (vecType)
+    {
+    case RelativePosition:
+    case RelativeVelocity:
+        objects.push_back(observer);
+        objects.push_back(target);
+        break;
+
+    case ConstantVector:
+        if (frame != nullptr)
+            frame->getReferencedObjects(objects);
+        break;
+
+    default:
+        break;
+    }
+}
@@ -11,6 +11,8 @@
 #ifndef _CELENGINE_FRAME_H_
 #define _CELENGINE_FRAME_H_
 
+#include <cstdint>
+#include <vector>
 #include <celengine/astro.h>
 #include <celengine/selection.h>
 #include <Eigen/Core>
@@ -58,13 +60,20 @@ class ReferenceFrame
                                       unsigned int maxDepth,
                                       FrameType frameType) const = 0;
 
+    /*! Append the objects whose positions or orientations are needed to
+     *  evaluate the frame, starting with its center. Objects referenced
+     *  through other frames are included, objects may be repeated.
+     */
+    virtual void getReferencedObjects(std::vector<Selection>& objects) const;
+
  private:
     Selection centerObject;
 };
 
 
 /*! Base class for complex frames where there may be some benefit
- *  to caching the last calculated orientation.
+ *  to caching the last calculated orientations. The cache is kept per
+ *  thread, as for CachingOrbit.
  */
 class CachingFrame : public ReferenceFrame
 {
@@ -72,6 +81,8 @@ class CachingFrame : public ReferenceFrame
     SHARED_TYPES(CachingFrame)
 
     CachingFrame(Selection _center);
+    CachingFrame(const CachingFrame&);
+    CachingFrame& operator=(const CachingFrame&) = delete;
     virtual ~CachingFrame() {};
 
     Eigen::Quaterniond getOrientation(double tjd) const;
@@ -80,11 +91,8 @@ class CachingFrame : public ReferenceFrame
     virtual Eigen::Vector3d computeAngularVelocity(double tjd) const;
 
  private:
-    mutable double lastTime;
-    mutable Eigen::Quaterniond lastOrientation;
-    mutable Eigen::Vector3d lastAngularVelocity;
-    mutable bool orientationCacheValid;
-    mutable bool angularVelocityCacheValid;
+    // Identifies the frame in the cache
+    const std::uint64_t cacheKey;
 };
 
 
@@ -145,6 +153,7 @@ class BodyFixedFrame : public ReferenceFrame
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
                                       FrameType frameType) const;
+    void getReferencedObjects(std::vector<Selection>& objects) const override;
 
  private:
     Selection fixObject;
@@ -165,6 +174,7 @@ class BodyMeanEquatorFrame : public ReferenceFrame
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
                                       FrameType frameType) const;
+    void getReferencedObjects(std::vector<Selection>& objects) const override;
 
  private:
     Selection equatorObject;
@@ -191,6 +201,9 @@ class FrameVector
      */
     unsigned int nestingDepth(unsigned int depth, unsigned int maxDepth) const;
 
+    //! Append the objects the direction depends on
+    void getReferencedObjects(std::vector<Selection>& objects) const;
+
     enum FrameVectorType
     {
         RelativePosition,
@@ -245,6 +258,7 @@ class TwoVectorFrame : public CachingFrame
     virtual unsigned int nestingDepth(unsigned int depth,
                                       unsigned int maxDepth,
                                       FrameType frameType) const;
+    void getReferencedObjects(std::vector<Selection>& objects) const override;
 
     //! The sine of minimum angle between the primary and secondary vectors
     static const double Tolerance;
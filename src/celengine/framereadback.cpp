@@ -0,0 +1,148 @@
+// framereadback.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <cstddef>
+
+#include <celutil/logger.h>
+#include "framereadback.h"
+
+using celestia::PixelFormat;
+using celestia::util::GetLogger;
+
+namespace
+{
+
+int
+bytesPerPixel(PixelFormat format)
+{
+    return format == PixelFormat::RGB
+#ifndef GL_ES
+           || format == PixelFormat::BGR
+#endif
+           ? 3 : 4;
+}
+
+} // end unnamed namespace
+
+FrameReadback::FrameReadback(int _width, int _height, PixelFormat _format, int _nBuffers) :
+    width(_width),
+    height(_height),
+    format(_format),
+    // Rows are aligned on 4 bytes, the default GL_PACK_ALIGNMENT
+    stride((_width * bytesPerPixel(_format) + 3) & ~3),
+    nBuffers(_nBuffers)
+{
+    auto size = static_cast<std::size_t>(stride) * static_cast<std::size_t>(height);
+
+#ifdef GL_ES
+    nBuffers = 1;
+    buffers.emplace_back(size);
+#else
+    pbos.resize(nBuffers);
+    glGenBuffers(nBuffers, pbos.data());
+    for (GLuint pbo : pbos)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+#endif
+}
+
+FrameReadback::~FrameReadback()
+{
+    if (!pbos.empty())
+        glDeleteBuffers(static_cast<GLsizei>(pbos.size()), pbos.data());
+}
+
+void
+FrameReadback::abandon()
+{
+    pbos.clear();
+    buffers.clear();
+    first = 0;
+    count = 0;
+}
+
+bool
+FrameReadback::read(int x, int y)
+{
+    if (full())
+        return false;
+
+    int index = (first + count) % nBuffers;
+    if (pbos.empty())
+    {
+        glReadPixels(x, y, width, height, static_cast<GLenum>(format), GL_UNSIGNED_BYTE, buffers[index].data());
+    }
+    else
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[index]);
+        glReadPixels(x, y, width, height, static_cast<GLenum>(format), GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    if (glGetError() != GL_NO_ERROR)
+    {
+        GetLogger()->error("Failed to read the frame buffer\n");
+        return false;
+    }
+
+    ++count;
+    return true;
+}
+
+const unsigned char*
+FrameReadback::map()
+{
+    if (count == 0)
+        return nullptr;
+
+    if (pbos.empty())
+        return buffers[first].data();
+
+#ifdef GL_ES
+    return nullptr;
+#else
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pbos[first]);
+    auto* pixels = static_cast<const unsigned char*>(glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+    if (pixels == nullptr)
+        GetLogger()->error("Failed to map the frame read\n");
+    return pixels;
+#endif
+}
+
+void
+FrameReadback::unmap()
+{
+    if (count == 0)
+        return;
+
+#ifndef GL_ES
+    if (!pbos.empty())
+    {
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+#endif
+
+    first = (first + 1) % nBuffers;
+    --count;
+}
+
+bool
+FrameReadback::isTopDown() const
+{
+#ifdef GL_ES
+    return false;
+#else
+    // Set by the renderer when the extension is available
+    return celestia::gl::MESA_pack_invert;
+#endif
+}
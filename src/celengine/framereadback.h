@@ -0,0 +1,74 @@
+// framereadback.h
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <vector>
+
+#include <celengine/pixelformat.h>
+#include "glsupport.h"
+
+// Reads regions of the frame buffer through a ring of pixel buffer objects.
+// Reading a frame only queues the copy, which the GPU does when it has
+// finished drawing; the pixels are mapped when all the buffers are in use,
+// so that a frame is mapped nBuffers - 1 frames after it was read and
+// mapping doesn't stall. OpenGL ES 2 has no pixel buffer objects, there
+// frames are read immediately into memory.
+class FrameReadback
+{
+ public:
+    FrameReadback(int _width, int _height, celestia::PixelFormat _format, int nBuffers);
+    ~FrameReadback();
+    FrameReadback() = delete;
+    FrameReadback(const FrameReadback&) = delete;
+    FrameReadback(FrameReadback&&) = delete;
+    FrameReadback& operator=(const FrameReadback&) = delete;
+    FrameReadback& operator=(FrameReadback&&) = delete;
+
+    // Start reading the region with its lower left corner at (x, y).
+    // Fails when all the buffers hold frames which haven't been mapped.
+    bool read(int x, int y);
+
+    // Map the pixels of the oldest frame read, or return nullptr on
+    // failure. unmap() must be called in both cases before reading again.
+    const unsigned char* map();
+    void unmap();
+
+    // Forget the buffers and the frames they hold without any OpenGL call,
+    // for when the context may not be current. The buffers are then freed
+    // with the context.
+    void abandon();
+
+    // Number of frames read but not mapped yet
+    int pending() const { return count; }
+    bool full() const { return count == nBuffers; }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    // Bytes between the starts of consecutive rows
+    int getStride() const { return stride; }
+    // Whether rows are stored from the top of the frame, otherwise they are
+    // stored from the bottom like OpenGL returns them.
+    bool isTopDown() const;
+
+ private:
+    int width;
+    int height;
+    celestia::PixelFormat format;
+    int stride;
+    int nBuffers;
+
+    // Pixel buffer objects, or memory without them
+    std::vector<GLuint> pbos;
+    std::vector<std::vector<unsigned char>> buffers;
+
+    // Index of the oldest frame read
+    int first{ 0 };
+    int count{ 0 };
+};
@@ -12,10 +12,13 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <memory>
 #include "celengine/frametree.h"
 #include "celengine/timeline.h"
 #include "celengine/timelinephase.h"
 #include "celengine/frame.h"
+#include "celengine/frametreeindex.h"
 #include <celengine/body.h>
 #include <celengine/star.h>
 #include <celengine/location.h>
@@ -43,6 +46,15 @@
 
 using namespace std;
 
+namespace
+{
+// Bounds of half the time span of an index, in days
+constexpr double MinIndexHalfSpan = 1.0;
+constexpr double MaxIndexHalfSpan = 100.0;
+// Number of time steps an index should last
+constexpr double IndexTimeSteps = 16.0;
+}
+
 /*! Create a frame tree associated with a star.
  */
 FrameTree::FrameTree(Star* star) :
@@ -68,6 +80,9 @@ FrameTree::FrameTree(Body* body) :
 }
 
 
+FrameTree::~FrameTree() = default;
+
+
 /*! Return the default reference frame for the object a frame tree is associated
  *  with.
  */
@@ -120,6 +135,7 @@ FrameTree::recomputeBoundingSphere()
 {
     if (m_changed)
     {
+        m_index.reset();
         m_boundingSphereRadius = 0.0;
         m_maxChildRadius = 0.0;
         m_containsSecondaryIlluminators = false;
@@ -155,6 +171,7 @@ void
 FrameTree::addChild(const TimelinePhase::SharedConstPtr &phase)
 {
     children.push_back(phase);
+    m_index.reset();
     markChanged();
 }
 
@@ -169,6 +186,7 @@ FrameTree::removeChild(const TimelinePhase::SharedConstPtr &phase)
     if (iter != children.end())
     {
         children.erase(iter);
+        m_index.reset();
         markChanged();
     }
 }
@@ -188,3 +206,29 @@ FrameTree::childCount() const
 {
     return children.size();
 }
+
+
+/*! Return a spatial index of the children valid at the specified time, or
+ *  nullptr if the tree is too small to need one. The index is rebuilt when
+ *  time leaves its span; its span follows the time step between frames,
+ *  so that it isn't rebuilt in every frame when time runs fast.
+ */
+const FrameTreeIndex*
+FrameTree::getIndex(double tdb) const
+{
+    if (children.size() < FrameTreeIndex::MinChildren)
+        return nullptr;
+
+    if (tdb != m_lastIndexTime)
+    {
+        if (m_index != nullptr)
+            m_indexTimeStep = abs(tdb - m_lastIndexTime);
+        m_lastIndexTime = tdb;
+    }
+
+    double halfSpan = clamp(m_indexTimeStep * IndexTimeSteps, MinIndexHalfSpan, MaxIndexHalfSpan);
+    if (m_index == nullptr || !m_index->covers(tdb) || m_index->getHalfSpan() > 4.0 * halfSpan)
+        m_index = make_unique<FrameTreeIndex>(*this, tdb, halfSpan);
+
+    return m_index.get();
+}
@@ -21,13 +21,14 @@
 
 class Star;
 class Body;
+class FrameTreeIndex;
 
 class FrameTree
 {
 public:
     FrameTree(Star*);
     FrameTree(Body*);
-    ~FrameTree() = default;
+    ~FrameTree();
 
     /*! Return the star that this tree is associated with; it will be
      *  nullptr for frame trees associated with solar system bodies.
@@ -89,6 +90,8 @@ public:
         return m_childClassMask;
     }
 
+    const FrameTreeIndex* getIndex(double tdb) const;
+
 private:
     Star* starParent;
     Body* bodyParent;
@@ -101,6 +104,11 @@ private:
     int m_childClassMask{ 0 };
 
     ReferenceFrame::SharedConstPtr defaultFrame;
+
+    // Built as needed when drawing
+    mutable std::unique_ptr<FrameTreeIndex> m_index;
+    mutable double m_lastIndexTime{ 0.0 };
+    mutable double m_indexTimeStep{ 0.0 };
 };
 
 #endif // _CELENGINE_FRAMETREE_H_
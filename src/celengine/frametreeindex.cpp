@@ -0,0 +1,98 @@
+// frametreeindex.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+
+#include <Eigen/Geometry>
+
+#include <celephem/orbit.h>
+#include "body.h"
+#include "frame.h"
+#include "frametree.h"
+#include "timelinephase.h"
+#include "frametreeindex.h"
+
+FrameTreeIndex::FrameTreeIndex(const FrameTree& tree, double tdb, double halfSpan) :
+    startTime(tdb - halfSpan),
+    endTime(tdb + halfSpan)
+{
+    std::vector<Entry> entries;
+    entries.reserve(tree.childCount());
+
+    for (std::uint32_t i = 0; i < tree.childCount(); i++)
+    {
+        const auto& phase = tree.getChild(i);
+        const Body* body = phase->body();
+        const auto& frame = phase->orbitFrame();
+
+        double speed = phase->orbit()->getMaximumSpeed();
+        if (speed < 0.0 ||
+            phase->startTime() > startTime || phase->endTime() <= endTime ||
+            !frame->isInertial() ||
+            body->getFrameTree() != nullptr)
+        {
+            ungrouped.push_back(i);
+            continue;
+        }
+
+        Entry& entry = entries.emplace_back();
+        entry.position = frame->getOrientation(tdb).conjugate() * phase->orbit()->positionAtTime(tdb);
+        entry.bodyRadius = body->getRadius();
+        entry.cullingRadius = body->getCullingRadius();
+        entry.radius = entry.cullingRadius + speed * halfSpan;
+        entry.classification = body->getOrbitClassification();
+        entry.secondaryIlluminator = body->isSecondaryIlluminator();
+        entry.child = i;
+    }
+
+    split(entries.begin(), entries.end());
+}
+
+// Split the entries at the median of the longest side of their bounding
+// box until groups are small enough.
+void
+FrameTreeIndex::split(std::vector<Entry>::iterator begin, std::vector<Entry>::iterator end)
+{
+    if (begin == end)
+        return;
+
+    Eigen::AlignedBox3d box;
+    for (auto iter = begin; iter != end; ++iter)
+        box.extend(iter->position);
+
+    if (static_cast<std::size_t>(end - begin) > MaxGroupSize)
+    {
+        int axis;
+        box.sizes().maxCoeff(&axis);
+        auto middle = begin + (end - begin) / 2;
+        std::nth_element(begin, middle, end,
+                         [axis](const Entry& a, const Entry& b) { return a.position[axis] < b.position[axis]; });
+        split(begin, middle);
+        split(middle, end);
+        return;
+    }
+
+    Group& group = groups.emplace_back();
+    group.center = box.center();
+    group.radius = 0.0;
+    group.maxRadius = 0.0;
+    group.maxCullingRadius = 0.0;
+    group.classMask = 0;
+    group.containsSecondaryIlluminators = false;
+    group.children.reserve(end - begin);
+    for (auto iter = begin; iter != end; ++iter)
+    {
+        group.radius = std::max(group.radius, (iter->position - group.center).norm() + iter->radius);
+        group.maxRadius = std::max(group.maxRadius, iter->bodyRadius);
+        group.maxCullingRadius = std::max(group.maxCullingRadius, iter->cullingRadius);
+        group.classMask |= iter->classification;
+        group.containsSecondaryIlluminators = group.containsSecondaryIlluminators || iter->secondaryIlluminator;
+        group.children.push_back(iter->child);
+    }
+}
@@ -0,0 +1,80 @@
+// frametreeindex.h
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+class FrameTree;
+
+// Spatial index of the children of a frame tree over a span of time, so
+// that the renderer can cull groups of nearby bodies without computing
+// the positions of the bodies, e.g. in catalogs of many asteroids.
+//
+// Bodies are grouped by their positions at the middle of the span. A
+// body moves less than its maximum orbital speed times half the span, so
+// the bounding sphere of a group, grown by that distance and the culling
+// radii of the bodies, holds the bodies over the whole span. Bodies
+// without a speed bound or an inertial orbit frame, bodies with their own
+// frame tree, and phases which don't cover the span, are left out of the
+// groups. Groups holding bodies which illuminate others are flagged so
+// that they aren't culled while they may light visible objects.
+class FrameTreeIndex
+{
+ public:
+    struct Group
+    {
+        // Relative to the center of the frame tree, in the universal frame
+        Eigen::Vector3d center;
+        double radius;
+        double maxRadius;
+        double maxCullingRadius;
+        // Orbit classifications of the bodies
+        int classMask;
+        bool containsSecondaryIlluminators;
+        // Indices of the children in the frame tree
+        std::vector<std::uint32_t> children;
+    };
+
+    // Smallest number of children for which the tree is indexed
+    static constexpr unsigned int MinChildren = 256;
+    static constexpr std::size_t MaxGroupSize = 64;
+
+    FrameTreeIndex(const FrameTree& tree, double tdb, double halfSpan);
+
+    bool covers(double tdb) const { return tdb >= startTime && tdb <= endTime; }
+    double getHalfSpan() const { return (endTime - startTime) * 0.5; }
+    double getCenterTime() const { return (startTime + endTime) * 0.5; }
+
+    const std::vector<Group>& getGroups() const { return groups; }
+    const std::vector<std::uint32_t>& getUngrouped() const { return ungrouped; }
+
+ private:
+    struct Entry
+    {
+        Eigen::Vector3d position;
+        // Culling radius and distance travelled over half the span
+        double radius;
+        double bodyRadius;
+        double cullingRadius;
+        int classification;
+        bool secondaryIlluminator;
+        std::uint32_t child;
+    };
+
+    void split(std::vector<Entry>::iterator begin, std::vector<Entry>::iterator end);
+
+    double startTime;
+    double endTime;
+    std::vector<Group> groups;
+    std::vector<std::uint32_t> ungrouped;
+};
@@ -11,8 +11,10 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstddef>
 #include <iterator>
 #include <map>
+#include <memory>
 #include <optional>
 #include <ostream>
 #include <utility>
@@ -24,6 +26,7 @@
 #include <celmath/intersect.h>
 #include <celmath/randutils.h>
 #include <celmath/ray.h>
+#include <celrender/vertexobject.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
 #include "galaxy.h"
@@ -35,6 +38,7 @@
 #include "vecgl.h"
 
 namespace vecgl = celestia::vecgl;
+using celestia::render::VertexObject;
 
 namespace
 {
@@ -130,26 +134,60 @@ void colorTextureEval(float u, float /*v*/, float /*w*/, std::uint8_t *pixel)
     pixel[2] = static_cast<std::uint8_t>(b * 255.99f);
 }
 
+// The blobs of a form are drawn as sprites from a static vertex buffer, in
+// which each blob is expanded into the two triangles of its sprite. The
+// galaxy shader places the sprites and computes their size and alpha.
 struct GalaxyVertex
 {
+    // xyz: blob position, w: blob brightness
     Eigen::Vector4f position;
-    Eigen::Matrix<GLushort, 4, 1> texCoord; // texCoord.x = x, texCoord.y = y, texCoord.z = color index, texCoord.w = alpha
+    // x, y: sprite corner, z: color index, w: number of times the sprite is
+    // shrunk, which increases at each power of two of the blob index
+    Eigen::Matrix<GLushort, 4, 1> texCoord;
 };
 
-void draw(const GalaxyVertex *v, std::size_t count, const GLushort *indices)
+constexpr unsigned int VerticesPerBlob = 6;
+
+std::unique_ptr<VertexObject> createVertexObject(const GalacticForm& form)
 {
-    glVertexAttribPointer(CelestiaGLProgram::VertexCoordAttributeIndex,
-                          4, GL_FLOAT, GL_FALSE,
-                          sizeof(GalaxyVertex), v[0].position.data());
-    glVertexAttribPointer(CelestiaGLProgram::TextureCoord0AttributeIndex,
-                          4, GL_UNSIGNED_SHORT, GL_FALSE,
-                          sizeof(GalaxyVertex), v[0].texCoord.data());
-    glDrawElements(GL_TRIANGLES, count, GL_UNSIGNED_SHORT, indices);
-}
+    static const GLushort corners[VerticesPerBlob][2] =
+    {
+        { 0, 0 }, { 1, 0 }, { 1, 1 },
+        { 0, 0 }, { 1, 1 }, { 0, 1 },
+    };
 
-GalaxyVertex *g_vertices = nullptr;
-GLushort *g_indices = nullptr;
-constexpr const std::size_t maxPoints = 8192; // 256k buffer
+    std::vector<GalaxyVertex> vertices;
+    vertices.reserve(form.blobs.size() * VerticesPerBlob);
+
+    unsigned int pow2 = 1;
+    GLushort level = 0;
+    for (std::size_t i = 0; i < form.blobs.size(); ++i)
+    {
+        if ((i & pow2) != 0)
+        {
+            pow2 <<= 1;
+            ++level;
+        }
+
+        const Blob& b = form.blobs[i];
+        Eigen::Vector4f position(b.position.x(), b.position.y(), b.position.z(), b.brightness / 255.0f);
+        auto color = static_cast<GLushort>(b.colorIndex);
+        for (const auto& corner : corners)
+            vertices.push_back({ position, { corner[0], corner[1], color, level } });
+    }
+
+    auto vo = std::make_unique<VertexObject>(GL_ARRAY_BUFFER,
+                                             vertices.size() * sizeof(GalaxyVertex),
+                                             GL_STATIC_DRAW);
+    vo->bind();
+    vo->allocate(vertices.data());
+    vo->setVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex,
+                             4, GL_FLOAT, false, sizeof(GalaxyVertex), offsetof(GalaxyVertex, position));
+    vo->setVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex,
+                             4, GL_UNSIGNED_SHORT, false, sizeof(GalaxyVertex), offsetof(GalaxyVertex, texCoord));
+    vo->unbind();
+    return vo;
+}
 
 std::optional<GalacticForm> buildGalacticForm(const fs::path& filename)
 {
@@ -260,12 +298,15 @@ class GalacticFormManager
 
     const GalacticForm* getForm(std::size_t) const;
     std::size_t getCustomForm(const fs::path& path);
+    VertexObject* getVertexObject(std::size_t);
 
  private:
     void initializeStandardForms();
 
     std::vector<std::optional<GalacticForm>> galacticForms{ };
     std::map<fs::path, std::size_t> customForms{ };
+    // Vertex buffers of the forms, created when they are first drawn
+    std::vector<std::unique_ptr<VertexObject>> vertexObjects{ };
 };
 
 const GalacticForm* GalacticFormManager::getForm(std::size_t form) const
@@ -276,6 +317,19 @@ const GalacticForm* GalacticFormManager::getForm(std::size_t form) const
         : nullptr;
 }
 
+VertexObject* GalacticFormManager::getVertexObject(std::size_t form)
+{
+    assert(form < galacticForms.size());
+    if (!galacticForms[form].has_value())
+        return nullptr;
+
+    if (vertexObjects.size() < galacticForms.size())
+        vertexObjects.resize(galacticForms.size());
+    if (vertexObjects[form] == nullptr)
+        vertexObjects[form] = createVertexObject(*galacticForms[form]);
+    return vertexObjects[form].get();
+}
+
 std::size_t GalacticFormManager::getCustomForm(const fs::path& path)
 {
     auto iter = customForms.find(path);
@@ -513,14 +567,6 @@ void Galaxy::render(const Eigen::Vector3f& offset,
     colorTex->bind();
 
     Eigen::Matrix3f viewMat = viewerOrientation.conjugate().toRotationMatrix();
-    Eigen::Vector4f v0(Eigen::Vector4f::Zero());
-    Eigen::Vector4f v1(Eigen::Vector4f::Zero());
-    Eigen::Vector4f v2(Eigen::Vector4f::Zero());
-    Eigen::Vector4f v3(Eigen::Vector4f::Zero());
-    v0.head(3) = viewMat * Eigen::Vector3f(-1, -1, 0) * size;
-    v1.head(3) = viewMat * Eigen::Vector3f( 1, -1, 0) * size;
-    v2.head(3) = viewMat * Eigen::Vector3f( 1,  1, 0) * size;
-    v3.head(3) = viewMat * Eigen::Vector3f(-1,  1, 0) * size;
 
     Eigen::Quaternionf orientation = getOrientation().conjugate();
     Eigen::Matrix3f mScale = galacticForm->scale.asDiagonal() * size;
@@ -530,10 +576,7 @@ void Galaxy::render(const Eigen::Vector3f& offset,
     m.topLeftCorner(3,3) = mLinear;
     m.block<3,1>(0, 3) = offset;
 
-    int pow2 = 1;
-
-    const BlobVector& points = galacticForm->blobs;
-    unsigned int nPoints = static_cast<unsigned int>(points.size() * std::clamp(getDetail(), 0.0f, 1.0f));
+    unsigned int nPoints = static_cast<unsigned int>(galacticForm->blobs.size() * std::clamp(getDetail(), 0.0f, 1.0f));
     // corrections to avoid excessive brightening if viewed e.g. edge-on
 
     float brightness_corr = 1.0f;
@@ -559,20 +602,33 @@ void Galaxy::render(const Eigen::Vector3f& offset,
     const float btot = (type == GalaxyType::Irr || type >= GalaxyType::E0) ? 2.5f : 5.0f;
     const float spriteScaleFactor = 1.0f / 1.55f;
 
-    glEnableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    glEnableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
-
-    if (g_vertices == nullptr)
-        g_vertices = new GalaxyVertex[maxPoints];
-    if (g_indices == nullptr)
-        g_indices = new GLushort[(maxPoints / 4 + 1) * 6];
+    // Sprites shrink at each power of two of the blob index; stop at the
+    // first sprite smaller than a feature.
+    float spriteSize = size;
+    for (unsigned int first = 1; first < nPoints; first <<= 1)
+    {
+        spriteSize *= spriteScaleFactor;
+        if (spriteSize < minimumFeatureSize)
+        {
+            nPoints = first;
+            break;
+        }
+    }
 
-    GLushort j = 0;
+    VertexObject* vo = getGalacticFormManager()->getVertexObject(form);
+    if (vo == nullptr)
+        return;
 
     prog->use();
     prog->setMVPMatrices(*ms.projection, mv);
     prog->samplerParam("galaxyTex") = 0;
     prog->samplerParam("colorTex") = 1;
+    prog->mat4Param("galaxyMatrix") = m;
+    prog->vec3Param("spriteRight") = viewMat * Eigen::Vector3f::UnitX();
+    prog->vec3Param("spriteUp") = viewMat * Eigen::Vector3f::UnitY();
+    prog->floatParam("size") = size;
+    prog->floatParam("spriteScaleFactor") = spriteScaleFactor;
+    prog->floatParam("alphaScale") = (4.0f * lightGain + 1.0f) * btot * brightness_corr * brightness;
 
     Renderer::PipelineState ps;
     ps.blending = true;
@@ -580,59 +636,10 @@ void Galaxy::render(const Eigen::Vector3f& offset,
     ps.smoothLines = true;
     renderer->setPipelineState(ps);
 
-    std::size_t vertex = 0, index = 0;
-    for (unsigned int i = 0; i < nPoints; ++i)
-    {
-        if ((i & pow2) != 0)
-        {
-            pow2 <<= 1;
-            size *= spriteScaleFactor;
-            v0 *= spriteScaleFactor;
-            v1 *= spriteScaleFactor;
-            v2 *= spriteScaleFactor;
-            v3 *= spriteScaleFactor;
-            if (size < minimumFeatureSize)
-                break;
-        }
-
-        const Blob& b = points[i];
-        Eigen::Vector4f p  = m * b.position;
-        float br = b.brightness / 255.0f;
-
-        float screenFrac = size / p.norm();
-        if (screenFrac < 0.1f)
-        {
-            float a = (4.0f * lightGain + 1.0f) * btot * (0.1f - screenFrac) * brightness_corr * brightness * br;
-            GLushort alpha = static_cast<GLushort>(std::min(1.0f, a) * 65535.99f);
-            GLushort color = static_cast<GLushort>(b.colorIndex);
-            g_vertices[vertex++] = { p + v0, { 0, 0, color, alpha } };
-            g_vertices[vertex++] = { p + v1, { 1, 0, color, alpha } };
-            g_vertices[vertex++] = { p + v2, { 1, 1, color, alpha } };
-            g_vertices[vertex++] = { p + v3, { 0, 1, color, alpha } };
-
-            g_indices[index++] = j;
-            g_indices[index++] = j + 1;
-            g_indices[index++] = j + 2;
-            g_indices[index++] = j;
-            g_indices[index++] = j + 2;
-            g_indices[index++] = j + 3;
-            j += 4;
-
-            if (vertex + 4 > maxPoints)
-            {
-                draw(g_vertices, index, g_indices);
-                index = 0;
-                vertex = 0;
-                j = 0;
-            }
-        }
-    }
-
-    if (index > 0)
-        draw(g_vertices, index, g_indices);
+    vo->bind();
+    vo->draw(GL_TRIANGLES, static_cast<GLsizei>(nPoints * VerticesPerBlob));
+    vo->unbind();
 
-    glDisableVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex);
-    glDisableVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex);
     glActiveTexture(GL_TEXTURE0);
 }
 
@@ -9,12 +9,14 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <celengine/glsupport.h>
 #include <celutil/logger.h>
 #include <celutil/filetype.h>
 #include <celutil/gettext.h>
+#include <celutil/threadpool.h>
 #include <celimage/imageformats.h>
 #include "image.h"
 
@@ -227,15 +229,14 @@ Image* Image::computeNormalMap(float scale, bool wrap) const
     uint8_t* nmPixels = normalMap->getPixels();
     int nmPitch = normalMap->getPitch();
 
-    // Compute normals using differences between adjacent texels.
-    for (int i = 0; i < height; i++)
+    // Compute normals using differences between adjacent texels. Rows are
+    // computed in parallel since bump maps can be very large.
+    auto computeRows = [&](std::size_t firstRow, std::size_t lastRow)
     {
-        for (int j = 0; j < width; j++)
+        for (int i = static_cast<int>(firstRow); i < static_cast<int>(lastRow); i++)
         {
             int i0 = i;
-            int j0 = j;
             int i1 = i - 1;
-            int j1 = j - 1;
             if (i1 < 0)
             {
                 if (wrap)
@@ -248,40 +249,55 @@ Image* Image::computeNormalMap(float scale, bool wrap) const
                     i1++;
                 }
             }
-            if (j1 < 0)
+
+            const uint8_t* row0 = pixels.get() + i0 * pitch;
+            const uint8_t* row1 = pixels.get() + i1 * pitch;
+            uint8_t* nmRow = nmPixels + i * nmPitch;
+            for (int j = 0; j < width; j++)
             {
-                if (wrap)
-                {
-                    j1 = width - 1;
-                }
-                else
+                int j0 = j;
+                int j1 = j - 1;
+                if (j1 < 0)
                 {
-                    j0++;
-                    j1++;
+                    if (wrap)
+                    {
+                        j1 = width - 1;
+                    }
+                    else
+                    {
+                        j0++;
+                        j1++;
+                    }
                 }
-            }
 
-            auto h00 = (int) pixels[i0 * pitch + j0 * components];
-            auto h10 = (int) pixels[i0 * pitch + j1 * components];
-            auto h01 = (int) pixels[i1 * pitch + j0 * components];
+                auto h00 = (int) row0[j0 * components];
+                auto h10 = (int) row0[j1 * components];
+                auto h01 = (int) row1[j0 * components];
 
-            float dx = (float) (h10 - h00) * (1.0f / 255.0f) * scale;
-            float dy = (float) (h01 - h00) * (1.0f / 255.0f) * scale;
+                float dx = (float) (h10 - h00) * (1.0f / 255.0f) * scale;
+                float dy = (float) (h01 - h00) * (1.0f / 255.0f) * scale;
 
-            auto mag = (float) sqrt(dx * dx + dy * dy + 1.0f);
-            float rmag = 1.0f / mag;
+                float rmag = 1.0f / std::sqrt(dx * dx + dy * dy + 1.0f);
 
-            int n = i * nmPitch + j * 4;
-            nmPixels[n]     = (uint8_t) (128 + 127 * dx * rmag);
-            nmPixels[n + 1] = (uint8_t) (128 + 127 * dy * rmag);
-            nmPixels[n + 2] = (uint8_t) (128 + 127 * rmag);
-            nmPixels[n + 3] = 255;
+                nmRow[j * 4]     = (uint8_t) (128 + 127 * dx * rmag);
+                nmRow[j * 4 + 1] = (uint8_t) (128 + 127 * dy * rmag);
+                nmRow[j * 4 + 2] = (uint8_t) (128 + 127 * rmag);
+                nmRow[j * 4 + 3] = 255;
+            }
         }
-    }
+    };
+
+    GetImageThreadPool().parallelFor(height, std::max(1, 65536 / std::max(width, 1)), computeRows);
 
     return normalMap;
 }
 
+celestia::util::ThreadPool& GetImageThreadPool()
+{
+    static celestia::util::ThreadPool pool;
+    return pool;
+}
+
 Image* LoadImageFromFile(const fs::path& filename)
 {
     ContentType type = DetermineFileType(filename);
@@ -14,6 +14,11 @@
 #include <celcompat/filesystem.h>
 #include <celengine/pixelformat.h>
 
+namespace celestia::util
+{
+class ThreadPool;
+}
+
 // The image class supports multiple GL formats, including compressed ones.
 // Mipmaps may be stored within an image as well.  The mipmaps are stored in
 // one contiguous block of memory (i.e. there's not an instance of Image per
@@ -67,3 +72,6 @@ class Image
 };
 
 Image* LoadImageFromFile(const fs::path& filename);
+
+// Worker threads shared by the decoding and processing of large images
+celestia::util::ThreadPool& GetImageThreadPool();
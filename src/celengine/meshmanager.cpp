@@ -369,9 +369,18 @@ Convert3DSModel(const M3DScene& scene, const fs::path& texPath)
 
 constexpr const char UniqueSuffixChar = '!';
 
+bool reorderModelMeshes = false;
+
 } // end unnamed namespace
 
 
+void
+GeometryInfo::setReorderMeshes(bool reorder)
+{
+    reorderModelMeshes = reorder;
+}
+
+
 GeometryManager*
 GetGeometryManager()
 {
@@ -442,7 +451,8 @@ GeometryInfo::load(const fs::path& resolvedFilename)
                 [&](const fs::path& name)
                 {
                     return GetTextureManager()->getHandle(TextureInfo(name, path, TextureInfo::WrapTexture));
-                });
+                },
+                reorderModelMeshes);
             if (model != nullptr)
             {
                 if (isNormalized)
@@ -498,3 +508,14 @@ GeometryInfo::load(const fs::path& resolvedFilename)
         return nullptr;
     }
 }
+
+
+std::function<Geometry*()>
+GeometryInfo::loadInBackground(const fs::path& resolvedFilename)
+{
+    auto geometry = std::make_shared<std::unique_ptr<Geometry>>(load(resolvedFilename));
+    if (*geometry == nullptr)
+        return {};
+
+    return [geometry] { return geometry->release(); };
+}
@@ -51,6 +51,15 @@ class GeometryInfo : public ResourceInfo<Geometry>
 
     virtual fs::path resolve(const fs::path&);
     virtual Geometry* load(const fs::path&);
+    // Models are loaded entirely on the worker thread; their OpenGL buffers
+    // are only created when they are first rendered.
+    virtual bool hasBackgroundLoad() const { return true; }
+    virtual std::function<Geometry*()> loadInBackground(const fs::path&);
+
+    // Reorder the triangles of cmod models for the vertex cache as they
+    // are loaded, see cmod::ReorderMesh(). Must be set before any model is
+    // loaded.
+    static void setReorderMeshes(bool reorder);
 };
 
 inline bool operator<(const GeometryInfo& g0, const GeometryInfo& g1)
@@ -20,6 +20,9 @@ void NameDatabase::add(const AstroCatalog::IndexNumber catalogNumber, const std:
         if ((tmp = getCatalogNumberByName(name, false)) != AstroCatalog::InvalidIndex)
             celestia::util::GetLogger()->debug("Duplicated name '{}' on object with catalog numbers: {} and {}\n", name, tmp, catalogNumber);
 #endif
+        nameCompletionIndex.clear();
+        localizedCompletionIndex.clear();
+
         // Add the new name
         //nameIndex.insert(NameIndex::value_type(name, catalogNumber));
         std::string fname = ReplaceGreekLetterAbbr(name);
@@ -101,15 +104,26 @@ NameDatabase::NumberIndex::const_iterator NameDatabase::getFinalNameIter() const
     return numberIndex.end();
 }
 
-std::vector<std::string> NameDatabase::getCompletion(const std::string& name, bool i18n) const
+std::vector<std::string> NameDatabase::getCompletion(const std::string& name, bool i18n, std::size_t maxCount) const
 {
     std::string name2 = ReplaceGreekLetter(name);
 
     std::vector<std::string> completion;
+    if (!nameCompletionIndex.empty())
+    {
+        std::string prefix = UTF8FoldCase(name2);
+        nameCompletionIndex.find(prefix, maxCount, completion);
+        if (i18n && completion.size() < maxCount)
+            localizedCompletionIndex.find(prefix, maxCount - completion.size(), completion);
+        return completion;
+    }
+
     const int name_length = UTF8Length(name2);
 
     for (const auto &[n, _] : nameIndex)
     {
+        if (completion.size() == maxCount)
+            return completion;
         if (!UTF8StringCompare(n, name2, name_length, true))
             completion.push_back(n);
     }
@@ -117,9 +131,25 @@ std::vector<std::string> NameDatabase::getCompletion(const std::string& name, bo
     {
         for (const auto &[n, _] : localizedNameIndex)
         {
+            if (completion.size() == maxCount)
+                return completion;
             if (!UTF8StringCompare(n, name2, name_length, true))
                 completion.push_back(n);
         }
     }
     return completion;
 }
+
+void NameDatabase::buildCompletionIndex()
+{
+    std::vector<const std::string*> names;
+    names.reserve(nameIndex.size());
+    for (const auto &[n, _] : nameIndex)
+        names.push_back(&n);
+    nameCompletionIndex.build(names);
+
+    names.clear();
+    for (const auto &[n, _] : localizedNameIndex)
+        names.push_back(&n);
+    localizedCompletionIndex.build(names);
+}
@@ -12,11 +12,15 @@
 
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <map>
 #include <string>
+#include <vector>
 
 #include <celengine/astroobj.h>
+#include <celengine/completionindex.h>
 #include <celutil/stringutils.h>
 
 // TODO: this can be "detemplatized" by creating e.g. a global-scope enum InvalidCatalogNumber since there
@@ -44,11 +48,20 @@ class NameDatabase
     NumberIndex::const_iterator getFirstNameIter(const AstroCatalog::IndexNumber catalogNumber) const;
     NumberIndex::const_iterator getFinalNameIter() const;
 
-    std::vector<std::string> getCompletion(const std::string& name, bool i18n) const;
+    std::vector<std::string> getCompletion(const std::string& name, bool i18n,
+                                           std::size_t maxCount = std::numeric_limits<std::size_t>::max()) const;
+
+    // Build the prefix indices used by getCompletion once all names have
+    // been added. Adding a name afterwards drops them again, and completion
+    // falls back to a scan of all names until they are rebuilt.
+    void buildCompletionIndex();
 
  protected:
     NameIndex   nameIndex;
     NameIndex   localizedNameIndex;
     NumberIndex numberIndex;
+
+    CompletionIndex nameCompletionIndex;
+    CompletionIndex localizedCompletionIndex;
 };
 
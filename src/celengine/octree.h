@@ -13,9 +13,15 @@
 #ifndef _CELENGINE_OCTREE_H_
 #define _CELENGINE_OCTREE_H_
 
+#include <cstddef>
+#include <future>
+#include <memory>
+#include <utility>
+
 #include <Eigen/Core>
 #include <Eigen/Geometry>
 #include <celengine/observer.h>
+#include <celutil/threadpool.h>
 #include <vector>
 
 // The DynamicOctree and StaticOctree template arguments are:
@@ -39,9 +45,156 @@ template <class OBJ, class PREC> class OctreeProcessor
     virtual ~OctreeProcessor() {};
 
     virtual void process(const OBJ& obj, PREC distance, float appMag) = 0;
+
+    // Process count objects at once; octree traversals that cull objects in
+    // batches call this instead of process().
+    virtual void processBatch(const OBJ* const* objs,
+                              const PREC* distances,
+                              const float* appMags,
+                              std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; ++i)
+            process(*objs[i], distances[i], appMags[i]);
+    }
+};
+
+
+// Processor which keeps the objects passed to it, so that part of an octree
+// can be traversed on a worker thread and the objects handed over later to
+// a processor which isn't thread-safe. The objects must be references into
+// the octree's object array.
+template <class OBJ, class PREC> class OctreeObjectBuffer : public OctreeProcessor<OBJ, PREC>
+{
+ public:
+    void process(const OBJ& obj, PREC distance, float appMag) override
+    {
+        objects.push_back(&obj);
+        distances.push_back(distance);
+        appMags.push_back(appMag);
+    }
+
+    void processBatch(const OBJ* const* objs,
+                      const PREC* _distances,
+                      const float* _appMags,
+                      std::size_t count) override
+    {
+        objects.insert(objects.end(), objs, objs + count);
+        distances.insert(distances.end(), _distances, _distances + count);
+        appMags.insert(appMags.end(), _appMags, _appMags + count);
+    }
+
+    // Pass the buffered objects to processor and empty the buffer
+    void flush(OctreeProcessor<OBJ, PREC>& processor)
+    {
+        if (!objects.empty())
+            processor.processBatch(objects.data(), distances.data(), appMags.data(), objects.size());
+
+        objects.clear();
+        distances.clear();
+        appMags.clear();
+    }
+
+ private:
+    std::vector<const OBJ*> objects;
+    std::vector<PREC>       distances;
+    std::vector<float>      appMags;
 };
 
 
+// Traverse an octree with the threads of a pool. The top levels are visited
+// on the calling thread, one level at a time, until there are enough subtrees
+// left to keep the pool busy; each of these subtrees is then traversed by a
+// task which collects its objects into its own OctreeObjectBuffer. The
+// buffers are passed to the processor on the calling thread and in the order
+// of a serial traversal, so the result is the same and the processor doesn't
+// need to be thread-safe.
+//
+// NODE identifies a node. processNode(node, scale, processor) processes the
+// objects of a single node and returns whether its children need to be
+// visited, processSubtree(node, scale, processor) traverses a whole subtree,
+// and forEachChild(node, f) calls f for each child of a node.
+template <class OBJ, class PREC, class NODE,
+          class ProcessNodeFn, class ProcessSubtreeFn, class ForEachChildFn>
+void processOctreeInParallel(OctreeProcessor<OBJ, PREC>& processor,
+                             NODE                        root,
+                             PREC                        scale,
+                             celestia::util::ThreadPool& pool,
+                             ProcessNodeFn               processNode,
+                             ProcessSubtreeFn            processSubtree,
+                             ForEachChildFn              forEachChild)
+{
+    using Buffer = OctreeObjectBuffer<OBJ, PREC>;
+    struct WorkItem
+    {
+        NODE node;
+        PREC scale;
+        bool visited;
+        std::unique_ptr<Buffer> buffer;
+        std::future<void> done;
+    };
+
+    // Subtree tasks are small enough to balance the load when there are a
+    // few of them for each thread.
+    const std::size_t targetSubtrees = 4 * static_cast<std::size_t>(pool.size());
+    // Bound on the number of levels visited serially, for degenerate trees
+    constexpr int maxSerialLevels = 32;
+
+    std::vector<WorkItem> items;
+    items.push_back({ root, scale, false, nullptr, {} });
+    std::size_t nSubtrees = 1;
+    for (int level = 0; level < maxSerialLevels && nSubtrees > 0 && nSubtrees < targetSubtrees; ++level)
+    {
+        std::vector<WorkItem> nextItems;
+        nextItems.reserve(items.size() * 2);
+        nSubtrees = 0;
+        for (auto& item : items)
+        {
+            if (item.visited)
+            {
+                nextItems.push_back(std::move(item));
+                continue;
+            }
+
+            NODE node = item.node;
+            PREC childScale = item.scale * PREC(0.5);
+            item.buffer = std::make_unique<Buffer>();
+            item.visited = true;
+            bool visitChildren = processNode(node, item.scale, *item.buffer);
+            nextItems.push_back(std::move(item));
+
+            if (visitChildren)
+            {
+                forEachChild(node, [&](NODE child)
+                {
+                    nextItems.push_back({ child, childScale, false, nullptr, {} });
+                    ++nSubtrees;
+                });
+            }
+        }
+        items.swap(nextItems);
+    }
+
+    for (auto& item : items)
+    {
+        if (item.visited)
+            continue;
+
+        item.buffer = std::make_unique<Buffer>();
+        item.done = pool.submit([&processSubtree, &item]
+        {
+            processSubtree(item.node, item.scale, *item.buffer);
+        });
+    }
+
+    for (auto& item : items)
+    {
+        if (item.done.valid())
+            item.done.get();
+        item.buffer->flush(processor);
+    }
+}
+
+
 
 struct OctreeLevelStatistics
 {
@@ -137,6 +290,15 @@ template <class OBJ, class PREC> class StaticOctree
                                PREC                              scale,
                                OctreeProcStats * = nullptr) const;
 
+    // Same as processVisibleObjects, but with the subtrees below the top
+    // levels traversed by the threads of a pool; see processOctreeInParallel.
+    void processVisibleObjects(OctreeProcessor<OBJ, PREC>&       processor,
+                               const PointType&                  obsPosition,
+                               const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                               float                             limitingFactor,
+                               PREC                              scale,
+                               celestia::util::ThreadPool&       pool) const;
+
     void processCloseObjects(OctreeProcessor<OBJ, PREC>&        processor,
                              const PointType&                   obsPosition,
                              PREC                               boundingRadius,
@@ -147,6 +309,37 @@ template <class OBJ, class PREC> class StaticOctree
 
     void computeStatistics(std::vector<OctreeLevelStatistics>& stats, unsigned int level = 0);
 
+    // Flat representation of a node used to store a prebuilt octree in a
+    // catalog file. Nodes are listed in depth-first order, and the objects of
+    // each node are given as a range of indices into the sorted object array.
+    struct FlatNode
+    {
+        PointType    cellCenterPos;
+        float        exclusionFactor;
+        unsigned int firstObject;
+        unsigned int nObjects;
+        bool         hasChildren;
+    };
+
+    void flatten(std::vector<FlatNode>& nodes, const OBJ* objects) const;
+
+    // Rebuild an octree from nodes written by flatten(). Returns nullptr if
+    // the node list ends before the tree is complete.
+    static StaticOctree* unflatten(const FlatNode*& node,
+                                   const FlatNode*  end,
+                                   OBJ*             objects);
+
+ private:
+    // Process the objects of this node only, and return whether any of the
+    // objects in the child nodes may be visible. This is the part of
+    // processVisibleObjects that is specialized for each object type.
+    bool processVisibleNodeObjects(OctreeProcessor<OBJ, PREC>&       processor,
+                                   const PointType&                  obsPosition,
+                                   const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                   float                             limitingFactor,
+                                   PREC                              scale,
+                                   OctreeProcStats*                  stats) const;
+
  private:
     static const PREC SQRT3;
 
@@ -359,6 +552,78 @@ inline StaticOctree<OBJ, PREC>::~StaticOctree()
 }
 
 
+template <class OBJ, class PREC>
+void StaticOctree<OBJ, PREC>::processVisibleObjects(OctreeProcessor<OBJ, PREC>&       processor,
+                                                    const PointType&                  obsPosition,
+                                                    const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                                    float                             limitingFactor,
+                                                    PREC                              scale,
+                                                    OctreeProcStats*                  stats) const
+{
+#ifdef OCTREE_DEBUG
+    size_t h;
+    if (stats != nullptr)
+        h = stats->height + 1;
+#endif
+
+    if (!processVisibleNodeObjects(processor, obsPosition, frustumPlanes, limitingFactor, scale, stats))
+        return;
+
+    // Recurse into the child nodes
+    if (_children != nullptr)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            _children[i]->processVisibleObjects(processor,
+                                                obsPosition,
+                                                frustumPlanes,
+                                                limitingFactor,
+                                                scale * PREC(0.5),
+                                                stats);
+#ifdef OCTREE_DEBUG
+            if (stats != nullptr && stats->height > h)
+                h = stats->height;
+#endif
+        }
+#ifdef OCTREE_DEBUG
+        if (stats != nullptr)
+            stats->height = h;
+#endif
+    }
+}
+
+
+template <class OBJ, class PREC>
+void StaticOctree<OBJ, PREC>::processVisibleObjects(OctreeProcessor<OBJ, PREC>&       processor,
+                                                    const PointType&                  obsPosition,
+                                                    const Eigen::Hyperplane<PREC, 3>* frustumPlanes,
+                                                    float                             limitingFactor,
+                                                    PREC                              scale,
+                                                    celestia::util::ThreadPool&       pool) const
+{
+    using Processor = OctreeProcessor<OBJ, PREC>;
+    processOctreeInParallel(processor, this, scale, pool,
+        [&](const StaticOctree* node, PREC nodeScale, Processor& nodeProcessor)
+        {
+            return node->processVisibleNodeObjects(nodeProcessor, obsPosition, frustumPlanes,
+                                                   limitingFactor, nodeScale, nullptr);
+        },
+        [&](const StaticOctree* node, PREC nodeScale, Processor& nodeProcessor)
+        {
+            node->processVisibleObjects(nodeProcessor, obsPosition, frustumPlanes,
+                                        limitingFactor, nodeScale);
+        },
+        [](const StaticOctree* node, auto&& f)
+        {
+            if (node->_children != nullptr)
+            {
+                for (int i = 0; i < 8; ++i)
+                    f(static_cast<const StaticOctree*>(node->_children[i]));
+            }
+        });
+}
+
+
 template <class OBJ, class PREC>
 inline int StaticOctree<OBJ, PREC>::countChildren() const
 {
@@ -411,4 +676,52 @@ void StaticOctree<OBJ, PREC>::computeStatistics(std::vector<OctreeLevelStatistic
 }
 
 
+template <class OBJ, class PREC>
+void StaticOctree<OBJ, PREC>::flatten(std::vector<FlatNode>& nodes, const OBJ* objects) const
+{
+    nodes.push_back({ cellCenterPos,
+                      exclusionFactor,
+                      static_cast<unsigned int>(_firstObject - objects),
+                      nObjects,
+                      _children != nullptr });
+
+    if (_children != nullptr)
+    {
+        for (int i = 0; i < 8; ++i)
+            _children[i]->flatten(nodes, objects);
+    }
+}
+
+
+template <class OBJ, class PREC>
+StaticOctree<OBJ, PREC>* StaticOctree<OBJ, PREC>::unflatten(const FlatNode*& node,
+                                                          const FlatNode*  end,
+                                                          OBJ*             objects)
+{
+    if (node == end)
+        return nullptr;
+
+    const FlatNode& flat = *node++;
+    auto* staticNode = new StaticOctree<OBJ, PREC>(flat.cellCenterPos,
+                                                   flat.exclusionFactor,
+                                                   objects + flat.firstObject,
+                                                   flat.nObjects);
+    if (flat.hasChildren)
+    {
+        staticNode->_children = new StaticOctree<OBJ, PREC>*[8]();
+        for (int i = 0; i < 8; ++i)
+        {
+            staticNode->_children[i] = unflatten(node, end, objects);
+            if (staticNode->_children[i] == nullptr)
+            {
+                delete staticNode;
+                return nullptr;
+            }
+        }
+    }
+
+    return staticNode;
+}
+
+
 #endif // _OCTREE_H_
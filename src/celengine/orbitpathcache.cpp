@@ -0,0 +1,174 @@
+// orbitpathcache.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <chrono>
+
+#include <celephem/orbit.h>
+#include <celutil/threadpool.h>
+#include "curveplot.h"
+#include "orbitsampler.h"
+#include "orbitpathcache.h"
+
+namespace
+{
+
+bool
+isReady(const std::future<std::unique_ptr<CurvePlot>>& pending)
+{
+    return pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+std::size_t
+plotBytes(const CurvePlot& plot)
+{
+    return sizeof(CurvePlot) + plot.sampleCount() * sizeof(CurvePlotSample);
+}
+
+} // end unnamed namespace
+
+OrbitPathCache::OrbitPathCache(const Renderer& _renderer, unsigned int nThreads, std::size_t _maxBytes) :
+    renderer(_renderer),
+    maxBytes(_maxBytes)
+{
+    if (nThreads > 0)
+        pool = std::make_unique<celestia::util::ThreadPool>(nThreads);
+}
+
+OrbitPathCache::~OrbitPathCache()
+{
+    cancelled = true;
+}
+
+CurvePlot*
+OrbitPathCache::find(const Orbit* orbit, double startTime, std::uint32_t frame)
+{
+    if (frame != lastUpdate)
+    {
+        update(frame);
+        lastUpdate = frame;
+    }
+
+    if (auto iter = entries.find(orbit); iter != entries.end())
+    {
+        Entry& entry = iter->second;
+        entry.lastUsed = frame;
+        if (entry.plot == nullptr)
+        {
+            // Still being sampled
+            if (!isReady(entry.pending))
+                return nullptr;
+            entry.plot = entry.pending.get();
+            --stats.pending;
+            insert(orbit, entry);
+        }
+        else
+        {
+            lru.splice(lru.begin(), lru, entry.lruPosition);
+        }
+
+        ++stats.hits;
+        return entry.plot.get();
+    }
+
+    ++stats.misses;
+
+    Entry& entry = entries[orbit];
+    entry.lastUsed = frame;
+    if (pool == nullptr || !orbit->isThreadSafe())
+    {
+        entry.plot = sample(orbit, startTime);
+        insert(orbit, entry);
+        return entry.plot.get();
+    }
+
+    entry.pending = pool->submit([this, orbit, startTime]
+    {
+        return cancelled ? nullptr : sample(orbit, startTime);
+    });
+    ++stats.pending;
+    return nullptr;
+}
+
+void
+OrbitPathCache::clear()
+{
+    cancelled = true;
+    for (auto& [orbit, entry] : entries)
+    {
+        if (entry.pending.valid())
+            entry.pending.wait();
+    }
+    cancelled = false;
+
+    entries.clear();
+    lru.clear();
+    stats.bytes = 0;
+    stats.paths = 0;
+    stats.pending = 0;
+}
+
+std::unique_ptr<CurvePlot>
+OrbitPathCache::sample(const Orbit* orbit, double startTime) const
+{
+    auto plot = std::make_unique<CurvePlot>(renderer);
+
+    OrbitSampler sampler;
+    orbit->sample(startTime, startTime + orbit->getPeriod(), sampler);
+    sampler.insertForward(plot.get());
+
+    return plot;
+}
+
+void
+OrbitPathCache::insert(const Orbit* orbit, Entry& entry)
+{
+    lru.push_front(orbit);
+    entry.lruPosition = lru.begin();
+    stats.bytes += plotBytes(*entry.plot);
+    stats.paths = lru.size();
+}
+
+// Collect the paths sampled since the last frame, and evict the least
+// recently used paths beyond the memory budget. Paths are extended and
+// trimmed as time goes on, so their sizes are counted again.
+void
+OrbitPathCache::update(std::uint32_t frame)
+{
+    if (stats.pending > 0)
+    {
+        for (auto& [orbit, entry] : entries)
+        {
+            if (entry.plot == nullptr && isReady(entry.pending))
+            {
+                entry.plot = entry.pending.get();
+                --stats.pending;
+                insert(orbit, entry);
+            }
+        }
+    }
+
+    stats.bytes = 0;
+    for (const Orbit* orbit : lru)
+        stats.bytes += plotBytes(*entries[orbit].plot);
+
+    while (stats.bytes > maxBytes && !lru.empty())
+    {
+        auto iter = entries.find(lru.back());
+        // Keep the paths drawn in the last frame, otherwise paths would be
+        // sampled again in every frame when they don't fit in the budget.
+        if (frame - iter->second.lastUsed <= 1)
+            break;
+
+        stats.bytes -= plotBytes(*iter->second.plot);
+        entries.erase(iter);
+        lru.pop_back();
+    }
+
+    stats.paths = lru.size();
+}
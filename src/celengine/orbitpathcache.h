@@ -0,0 +1,94 @@
+// orbitpathcache.h
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+class CurvePlot;
+class Orbit;
+class Renderer;
+
+namespace celestia::util
+{
+class ThreadPool;
+}
+
+// Sampled orbit paths kept for drawing. Missing paths are sampled by worker
+// threads, so that showing the orbits of many bodies at once doesn't stall
+// rendering; a path isn't available until its samples are ready. Without
+// worker threads, and for orbits which can't be evaluated concurrently,
+// paths are sampled immediately.
+//
+// The cache holds about maxBytes of samples. The least recently used paths
+// are evicted beyond that, except the ones drawn in the last frame.
+class OrbitPathCache
+{
+ public:
+    struct Statistics
+    {
+        std::uint64_t hits          { 0 };
+        std::uint64_t misses        { 0 };
+        std::size_t bytes           { 0 };
+        std::size_t paths           { 0 };
+        std::size_t pending         { 0 };
+    };
+
+    OrbitPathCache(const Renderer& _renderer, unsigned int nThreads, std::size_t _maxBytes);
+    ~OrbitPathCache();
+    OrbitPathCache() = delete;
+    OrbitPathCache(const OrbitPathCache&) = delete;
+    OrbitPathCache(OrbitPathCache&&) = delete;
+    OrbitPathCache& operator=(const OrbitPathCache&) = delete;
+    OrbitPathCache& operator=(OrbitPathCache&&) = delete;
+
+    // Return the path of the orbit sampled over one period from startTime,
+    // or nullptr while it is being sampled. The path may cover another time
+    // range when it was sampled in an earlier frame.
+    CurvePlot* find(const Orbit* orbit, double startTime, std::uint32_t frame);
+
+    // Drop all paths, waiting for the pending ones.
+    void clear();
+
+    const Statistics& getStatistics() const { return stats; }
+
+ private:
+    struct Entry
+    {
+        std::unique_ptr<CurvePlot> plot;
+        std::future<std::unique_ptr<CurvePlot>> pending;
+        std::list<const Orbit*>::iterator lruPosition;
+        std::uint32_t lastUsed{ 0 };
+    };
+
+    std::unique_ptr<CurvePlot> sample(const Orbit* orbit, double startTime) const;
+    void insert(const Orbit* orbit, Entry& entry);
+    void update(std::uint32_t frame);
+
+    const Renderer& renderer;
+    std::size_t maxBytes;
+
+    std::unordered_map<const Orbit*, Entry> entries;
+    // Orbits of the sampled paths, most recently used first
+    std::list<const Orbit*> lru;
+
+    Statistics stats;
+    std::uint32_t lastUpdate{ 0 };
+    // Set to drop the samplings which haven't started yet
+    std::atomic<bool> cancelled{ false };
+
+    // Declared last so that the workers are done before the entries go
+    std::unique_ptr<celestia::util::ThreadPool> pool;
+};
@@ -32,6 +32,16 @@ PointStarRenderer::PointStarRenderer() :
 {
 }
 
+void PointStarRenderer::processBatch(const Star* const* stars,
+                                     const float* distances,
+                                     const float* appMags,
+                                     std::size_t count)
+{
+    // Qualified calls avoid a virtual dispatch per star
+    for (std::size_t i = 0; i < count; ++i)
+        PointStarRenderer::process(*stars[i], distances[i], appMags[i]);
+}
+
 void PointStarRenderer::process(const Star& star, float distance, float appMag)
 {
     if (distance > distanceLimit)
@@ -104,7 +114,7 @@ void PointStarRenderer::process(const Star& star, float distance, float appMag)
 
             if (glareSize != 0.0f)
                 glareVertexBuffer->addStar(relPos, Color(starColor, glareAlpha), glareSize);
-            if (pointSize != 0.0f)
+            if (pointSize != 0.0f && (!staticDiscs || hasOrbit))
                 starVertexBuffer->addStar(relPos, Color(starColor, alpha), pointSize);
 
             // Place labels for stars brighter than the specified label threshold brightness
@@ -41,6 +41,10 @@ class PointStarRenderer : public ObjectRenderer<Star, float>
 
     PointStarRenderer();
     void process(const Star &star, float distance, float appMag);
+    void processBatch(const Star* const* stars,
+                      const float* distances,
+                      const float* appMags,
+                      std::size_t count) override;
 
     Eigen::Vector3d obsPos;
     Eigen::Vector3f viewNormal;
@@ -51,4 +55,7 @@ class PointStarRenderer : public ObjectRenderer<Star, float>
     const ColorTemperatureTable* colorTemp      { nullptr };
     float SolarSystemMaxDistance                { 1.0f };
     float cosFOV                                { 1.0f };
+    // Set when the discs of the distant stars without an orbit are drawn
+    // from a StaticStarVertexBuffer; only their glare and label is added.
+    bool staticDiscs                            { false };
 };
@@ -36,6 +36,7 @@
 #include "renderglsl.h"
 #include "axisarrow.h"
 #include "frametree.h"
+#include "frametreeindex.h"
 #include "timelinephase.h"
 #include "skygrid.h"
 #include "modelgeometry.h"
@@ -46,6 +47,7 @@
 #include "planetgrid.h"
 #include "pointstarvertexbuffer.h"
 #include "pointstarrenderer.h"
+#include "staticstarvertexbuffer.h"
 #include "orbitsampler.h"
 #include "asterismrenderer.h"
 #include "boundariesrenderer.h"
@@ -147,11 +149,6 @@ static const int MaxSkyRings = 32;
 static const int MaxSkySlices = 180;
 static const int MinSkySlices = 30;
 
-// Size at which the orbit cache will be flushed of old orbit paths
-static const unsigned int OrbitCacheCullThreshold = 200;
-// Age in frames at which unused orbit paths may be eliminated from the cache
-static const uint32_t OrbitCacheRetireAge = 16;
-
 Color Renderer::StarLabelColor          (0.471f, 0.356f, 0.682f);
 Color Renderer::PlanetLabelColor        (0.407f, 0.333f, 0.964f);
 Color Renderer::DwarfPlanetLabelColor   (0.557f, 0.235f, 0.576f);
@@ -259,7 +256,6 @@ Renderer::Renderer() :
     glareVertexBuffer(nullptr),
     textureResolution(medres),
     frameCount(0),
-    lastOrbitCacheFlush(0),
     minOrbitSize(MinOrbitSizeForLabel),
     distanceLimit(1.0e6f),
     minFeatureSize(MinFeatureSizeForLabel),
@@ -309,7 +305,11 @@ Renderer::DetailOptions::DetailOptions() :
     eclipseTextureSize(128),
     orbitWindowEnd(0.5),
     orbitPeriodsShown(1.0),
-    linearFadeFraction(0.0)
+    linearFadeFraction(0.0),
+    cullingThreads(1),
+    staticStarBuffer(false),
+    orbitSamplingThreads(1),
+    orbitCacheSize(64 * 1024 * 1024)
 {
 }
 
@@ -541,6 +541,16 @@ bool Renderer::init(
 {
     detailOptions = _detailOptions;
 
+    if (detailOptions.cullingThreads != 1)
+        m_cullingPool = std::make_unique<celestia::util::ThreadPool>(detailOptions.cullingThreads);
+
+    if (detailOptions.staticStarBuffer)
+        m_staticStarBuffer = std::make_unique<StaticStarVertexBuffer>(*this);
+
+    m_orbitPathCache = std::make_unique<OrbitPathCache>(*this,
+                                                        detailOptions.orbitSamplingThreads,
+                                                        detailOptions.orbitCacheSize);
+
     // Initialize static meshes and textures common to all instances of Renderer
     if (!commonDataInitialized)
     {
@@ -1023,87 +1033,32 @@ void Renderer::renderOrbit(const OrbitPathListEntry& orbitPath,
     else
         orbit = orbitPath.star->getOrbit();
 
-    CurvePlot* cachedOrbit = nullptr;
-    OrbitCache::iterator cached = orbitCache.find(orbit);
-    if (cached != orbitCache.end())
-    {
-        cachedOrbit = cached->second;
-        cachedOrbit->setLastUsed(frameCount);
-    }
+    // If it's not in the cache already, the orbit is sampled over one
+    // period from this start time.
+    double startTime = t;
 
-    // If it's not in the cache already
-    if (cachedOrbit == nullptr)
+    // Adjust the number of samples used for aperiodic orbits--these aren't
+    // true orbits, but are sampled trajectories, generally of spacecraft.
+    // Better control is really needed--some sort of adaptive sampling would
+    // be ideal.
+    if (!orbit->isPeriodic())
     {
-        double startTime = t;
-#if 0
-        int nSamples = detailOptions.orbitPathSamplePoints;
-#endif
-
-        // Adjust the number of samples used for aperiodic orbits--these aren't
-        // true orbits, but are sampled trajectories, generally of spacecraft.
-        // Better control is really needed--some sort of adaptive sampling would
-        // be ideal.
-        if (!orbit->isPeriodic())
-        {
-            double begin = 0.0, end = 0.0;
-            orbit->getValidRange(begin, end);
-
-            if (begin != end)
-            {
-                startTime = begin;
-#if 0
-                nSamples = (int) (orbit->getPeriod() * 100.0);
-                nSamples = std::clamp(nSamples, 100, 1000);
-#endif
-            }
-#if 0
-            else
-            {
-                // If the orbit is aperiodic and doesn't have a
-                // finite duration, we don't render it. A compromise
-                // would be to pick some time window centered at the
-                // current time, but we'd have to pick some arbitrary
-                // duration.
-                nSamples = 0;
-            }
-#endif
-        }
-        else
-        {
-            startTime = t - orbit->getPeriod();
-        }
-
-        cachedOrbit = new CurvePlot(*this);
-        cachedOrbit->setLastUsed(frameCount);
+        double begin = 0.0, end = 0.0;
+        orbit->getValidRange(begin, end);
 
-        OrbitSampler sampler;
-        orbit->sample(startTime,
-                      startTime + orbit->getPeriod(),
-                      sampler);
-        sampler.insertForward(cachedOrbit);
-
-        // If the orbit cache is full, first try and eliminate some old orbits
-        if (orbitCache.size() > OrbitCacheCullThreshold)
-        {
-            // Check for old orbits at most once per frame
-            if (lastOrbitCacheFlush != frameCount)
-            {
-                for (auto iter = orbitCache.begin(); iter != orbitCache.end();)
-                {
-                    // Tricky code to eliminate a node in the orbit cache without screwing
-                    // up the iterator. Should work in all STL implementations.
-                    if (frameCount - iter->second->lastUsed() > OrbitCacheRetireAge)
-                        orbitCache.erase(iter++);
-                    else
-                        ++iter;
-                }
-                lastOrbitCacheFlush = frameCount;
-            }
-        }
-
-        orbitCache[orbit] = cachedOrbit;
+        if (begin != end)
+            startTime = begin;
+    }
+    else
+    {
+        startTime = t - orbit->getPeriod();
     }
 
+    // Nothing is drawn until the orbit has been sampled
+    CurvePlot* cachedOrbit = m_orbitPathCache->find(orbit, startTime, frameCount);
+    if (cachedOrbit == nullptr)
+        return;
+
     if (cachedOrbit->empty())
         return;
 
@@ -1487,6 +1442,7 @@ void Renderer::draw(const Observer& observer,
     // large enough to have discernible surface detail are also placed in
     // renderList.
     renderList.clear();
+    pointBodyList.clear();
     orbitPathList.clear();
     lightSourceList.clear();
     secondaryIlluminators.clear();
@@ -1750,6 +1706,32 @@ void Renderer::renderObjectAsPoint(const Vector3f& position,
                                    bool useHalos,
                                    bool emissive,
                                    const Matrices &mvp)
+{
+    Renderer::PipelineState ps;
+    ps.blending = true;
+    ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
+    ps.depthTest = true;
+    setPipelineState(ps);
+
+    if (starStyle != PointStars)
+        gaussianDiscTex->bind();
+
+    addObjectPointSprite(position, radius, appMag, discSizeInPixels,
+                         color, useHalos, emissive, mvp);
+}
+
+
+// Append the point sprite (and halo) for an object to the point star and
+// glare vertex buffers. The caller is responsible for setting up the
+// pipeline state and binding the disc texture.
+void Renderer::addObjectPointSprite(const Vector3f& position,
+                                    float radius,
+                                    float appMag,
+                                    float discSizeInPixels,
+                                    const Color &color,
+                                    bool useHalos,
+                                    bool emissive,
+                                    const Matrices &mvp)
 {
     const bool useScaledDiscs = starStyle == ScaledDiscStars;
     float maxDiscSize = useScaledDiscs ? MaxScaledDiscStarSize : 1.0f;
@@ -1778,15 +1760,6 @@ void Renderer::renderObjectAsPoint(const Vector3f& position,
         if (glareSize != 0.0f)
             glareSize = std::max(glareSize, pointSize * discSizeInPixels / scale * 3.0f);
 
-        Renderer::PipelineState ps;
-        ps.blending = true;
-        ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
-        ps.depthTest = true;
-        setPipelineState(ps);
-
-        if (starStyle != PointStars)
-            gaussianDiscTex->bind();
-
         if (pointSize > gl::maxPointSize)
             renderLargePoint(*this, position, {color, alpha}, pointSize, mvp);
         else
@@ -2515,6 +2488,11 @@ void Renderer::renderObject(const Vector3f& pos,
     {
         // This is a model loaded from a file
         geometry = GetGeometryManager()->find(obj.geometry);
+
+        // Draw nothing rather than an ellipsoid while the model is being
+        // loaded in the background
+        if (geometry == nullptr && GetGeometryManager()->getState(obj.geometry) == ResourceLoading)
+            return;
     }
 
     // Get the textures . . .
@@ -3711,21 +3689,33 @@ void Renderer::addRenderListEntries(RenderListEntry& rle,
     {
         rle.renderableType = RenderListEntry::RenderableBody;
         rle.body = &body;
+        rle.radius = body.getRadius();
 
-        if (body.getGeometry() != InvalidResource && rle.discSizeInPixels > 1)
+        // Bodies that are smaller than a pixel even at their nearest point
+        // can only be drawn as point sprites. Keep them out of the render
+        // list so that they're drawn in one batch rather than individually.
+        float altitude = rle.distance - rle.radius;
+        if (altitude > 0.0f && rle.radius < altitude * pixelSize)
         {
-            Geometry* geometry = GetGeometryManager()->find(body.getGeometry());
-            if (geometry == nullptr)
-                rle.isOpaque = true;
-            else
-                rle.isOpaque = geometry->isOpaque();
+            rle.isOpaque = false;
+            pointBodyList.push_back(rle);
         }
         else
         {
-            rle.isOpaque = true;
+            if (body.getGeometry() != InvalidResource && rle.discSizeInPixels > 1)
+            {
+                Geometry* geometry = GetGeometryManager()->find(body.getGeometry());
+                if (geometry == nullptr)
+                    rle.isOpaque = true;
+                else
+                    rle.isOpaque = geometry->isOpaque();
+            }
+            else
+            {
+                rle.isOpaque = true;
+            }
+            renderList.push_back(rle);
         }
-        rle.radius = body.getRadius();
-        renderList.push_back(rle);
     }
 
     if (body.getClassification() == Body::Comet && (renderFlags & ShowCometTails) != 0)
@@ -3773,14 +3763,11 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
     double invCosViewAngle = 1.0 / cosViewConeAngle;
     double sinViewAngle = sqrt(1.0 - square(cosViewConeAngle));
 
-    unsigned int nChildren = tree != nullptr ? tree->childCount() : 0;
-    for (unsigned int i = 0; i < nChildren; i++)
+    auto addChild = [&](const TimelinePhase::SharedConstPtr& phase)
     {
-        auto phase = tree->getChild(i);
-
         // No need to do anything if the phase isn't active now
         if (!phase->includes(now))
-            continue;
+            return;
 
         Body* body = phase->body();
 
@@ -3980,6 +3967,67 @@ void Renderer::buildRenderLists(const Vector3d& astrocentricObserverPos,
                                  now);
             }
         } // end subtree traverse
+    };
+
+    if (tree == nullptr)
+        return;
+
+    const FrameTreeIndex* index = tree->getIndex(now);
+    if (index == nullptr)
+    {
+        for (unsigned int i = 0; i < tree->childCount(); i++)
+            addChild(tree->getChild(i));
+        return;
+    }
+
+    // Large trees are culled by groups of bodies first, with the same tests
+    // as subtrees, so that the orbits of culled bodies aren't evaluated.
+    for (std::uint32_t i : index->getUngrouped())
+        addChild(tree->getChild(i));
+
+    for (const auto& group : index->getGroups())
+    {
+        Vector3d pos_v = frameCenter + group.center - astrocentricObserverPos;
+        auto minPossibleDistance = (float) (pos_v.norm() - group.radius);
+        float brightestPossible = -100.0f;
+        float largestPossible = 100.0f;
+
+        if (minPossibleDistance > 1.0f)
+        {
+            float lum = 0.0f;
+            for (unsigned int li = 0; li < lightSourceList.size(); li++)
+            {
+                // Bodies of the group may be closer to the light source
+                // than the center of the group
+                double sunDistance = max((pos_v - lightSourceList[li].position).norm() - group.radius, 1.0);
+                lum += luminosityAtOpposition(lightSourceList[li].luminosity, (float) sunDistance, (float) group.maxCullingRadius);
+            }
+            brightestPossible = astro::lumToAppMag(lum, astro::kilometersToLightYears(minPossibleDistance));
+            largestPossible = (float) group.maxCullingRadius / minPossibleDistance / pixelSize;
+        }
+
+        // Labeled bodies are added however small and faint they are
+        bool visible = false;
+        if (brightestPossible < faintestPlanetMag || largestPossible > 1.0f || (group.classMask & labelClassMask) != 0)
+            visible = viewFrustum.testSphere(pos_v.cast<float>(), (float) group.radius) != Frustum::Outside;
+
+        if (!visible && group.containsSecondaryIlluminators && largestPossible > PLANETSHINE_PIXEL_SIZE_LIMIT)
+        {
+            auto influenceRadius = (float) (group.radius + group.maxRadius * PLANETSHINE_DISTANCE_LIMIT_FACTOR);
+            double dist_vn = viewPlaneNormal.dot(pos_v);
+            if (dist_vn > -influenceRadius)
+            {
+                double maxPerpDist = (influenceRadius + dist_vn * sinViewAngle) * invCosViewAngle;
+                double perpDistSq = (pos_v - dist_vn * viewPlaneNormal).squaredNorm();
+                visible = perpDistSq < maxPerpDist * maxPerpDist;
+            }
+        }
+
+        if (!visible)
+            continue;
+
+        for (std::uint32_t i : group.children)
+            addChild(tree->getChild(i));
     }
 }
 
@@ -4121,24 +4169,24 @@ void Renderer::buildLabelLists(const Frustum& viewFrustum,
     Body* lastPrimary = nullptr;
     Sphered primarySphere;
 
-    for (auto &ri : renderList)
+    auto addLabel = [&](const RenderListEntry& ri)
     {
         if (ri.renderableType != RenderListEntry::RenderableBody)
-            continue;
+            return;
 
         if ((ri.body->getOrbitClassification() & labelClassMask) == 0)
-            continue;
+            return;
 
         if (viewFrustum.testSphere(ri.position, ri.radius) == Frustum::Outside)
-            continue;
+            return;
 
         const Body* body = ri.body;
         auto boundingRadiusSize = (float) (body->getOrbit(now)->getBoundingRadius() / ri.distance) / pixelSize;
         if (boundingRadiusSize <= minOrbitSize)
-            continue;
+            return;
 
         if (body->getName().empty())
-            continue;
+            return;
 
         auto phase = body->getTimeline()->findPhase(now);
         Body* primary = phase->orbitFrame()->getCenter().body();
@@ -4224,7 +4272,12 @@ void Renderer::buildLabelLists(const Frustum& viewFrustum,
         float opacity = sizeFade(boundingRadiusSize, minOrbitSize, 2.0f);
         labelColor.alpha(opacity * labelColor.alpha());
         addSortedAnnotation(nullptr, body->getName(true), labelColor, pos);
-    } // for each render list entry
+    };
+
+    for (const auto &ri : renderList)
+        addLabel(ri);
+    for (const auto &ri : pointBodyList)
+        addLabel(ri);
 }
 
 
@@ -4334,22 +4387,39 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
     ps.blendFunc = {GL_SRC_ALPHA, GL_ONE};
     setPipelineState(ps);
 
+    if (m_staticStarBuffer != nullptr)
+    {
+        starRenderer.staticDiscs = true;
+        m_staticStarBuffer->update(starDB, *colorTemp);
+        m_staticStarBuffer->render(obsPos,
+                                   observer.getOrientationf(),
+                                   degToRad(fov),
+                                   getAspectRatio(),
+                                   faintestMagNight,
+                                   distanceLimit,
+                                   gaussianDiscTex);
+        renderUnbufferedStars(starRenderer, starDB, faintestMagNight, observer);
+    }
+    else
+    {
 #ifdef OCTREE_DEBUG
-    m_starProcStats.nodes = 0;
-    m_starProcStats.height = 0;
-    m_starProcStats.objects = 0;
+        m_starProcStats.nodes = 0;
+        m_starProcStats.height = 0;
+        m_starProcStats.objects = 0;
 #endif
-    starDB.findVisibleStars(starRenderer,
-                            obsPos.cast<float>(),
-                            observer.getOrientationf(),
-                            degToRad(fov),
-                            getAspectRatio(),
-                            faintestMagNight,
+        starDB.findVisibleStars(starRenderer,
+                                obsPos.cast<float>(),
+                                observer.getOrientationf(),
+                                degToRad(fov),
+                                getAspectRatio(),
+                                faintestMagNight,
 #ifdef OCTREE_DEBUG
-                            &m_starProcStats);
+                                &m_starProcStats,
 #else
-                            nullptr);
+                                nullptr,
 #endif
+                                m_cullingPool.get());
+    }
 
     starRenderer.starVertexBuffer->finish();
     starRenderer.glareVertexBuffer->finish();
@@ -4361,6 +4431,77 @@ void Renderer::renderPointStars(const StarDatabase& starDB,
 #endif
 }
 
+namespace
+{
+// Passes the stars accepted by a predicate on to a point star renderer
+template<typename P>
+class StarFilter : public StarHandler
+{
+ public:
+    StarFilter(PointStarRenderer& _starRenderer, P _predicate) :
+        starRenderer(_starRenderer),
+        predicate(_predicate)
+    {
+    }
+
+    void process(const Star& star, float distance, float appMag) override
+    {
+        if (predicate(star, distance, appMag))
+            starRenderer.process(star, distance, appMag);
+    }
+
+ private:
+    PointStarRenderer& starRenderer;
+    P predicate;
+};
+} // end unnamed namespace
+
+// Render what the static star buffer leaves out: the nearby stars, the
+// stars with an orbit, and the glare and labels of the bright stars.
+void Renderer::renderUnbufferedStars(PointStarRenderer& starRenderer,
+                                     const StarDatabase& starDB,
+                                     float faintestMagNight,
+                                     const Observer& observer)
+{
+    Vector3f obsPos = starRenderer.obsPos.cast<float>();
+
+    // Stars brighter than this get a glare, see calculatePointSize()
+    float brightestMag = brightnessScale > 0.0f
+                       ? faintestMag - (1.0f - brightnessBias) / brightnessScale
+                       : faintestMagNight;
+    if ((labelMode & StarLabels) != 0)
+        brightestMag = max(brightestMag, starRenderer.labelThresholdMag);
+    brightestMag = min(brightestMag, faintestMagNight);
+
+    StarFilter brightStars(starRenderer, [this](const Star& star, float distance, float)
+    {
+        return distance >= SolarSystemMaxDistance && !StaticStarVertexBuffer::hasOrbit(star);
+    });
+    starDB.findVisibleStars(brightStars,
+                            obsPos,
+                            observer.getOrientationf(),
+                            degToRad(fov),
+                            getAspectRatio(),
+                            brightestMag,
+                            nullptr,
+                            m_cullingPool.get());
+
+    StarFilter closeStars(starRenderer, [faintestMagNight](const Star& star, float, float appMag)
+    {
+        return appMag < faintestMagNight && !StaticStarVertexBuffer::hasOrbit(star);
+    });
+    starDB.findCloseStars(closeStars, obsPos, SolarSystemMaxDistance);
+
+    // Same test as the star octree traversal, see MAX_STAR_ORBIT_RADIUS
+    for (const Star* star : m_staticStarBuffer->getOrbitingStars())
+    {
+        float distance = (obsPos - star->getPosition()).norm();
+        float appMag = star->getApparentMagnitude(distance);
+        if (appMag < faintestMagNight || (distance < 1.0f && star->getOrbit() != nullptr))
+            starRenderer.process(*star, distance, appMag);
+    }
+}
+
 void Renderer::renderDeepSkyObjects(const Universe& universe,
                                     const Observer& observer,
                                     const float     faintestMagNight)
@@ -4414,10 +4555,11 @@ void Renderer::renderDeepSkyObjects(const Universe& universe,
                            getAspectRatio(),
                            2 * faintestMagNight,
 #ifdef OCTREE_DEBUG
-                           &m_dsoProcStats);
+                           &m_dsoProcStats,
 #else
-                            nullptr);
+                           nullptr,
 #endif
+                           m_cullingPool.get());
 
     // clog << "DSOs processed: " << dsoRenderer.dsosProcessed << endl;
 }
@@ -4930,7 +5072,19 @@ void Renderer::loadTextures(Body* body)
 
 void Renderer::invalidateOrbitCache()
 {
-    orbitCache.clear();
+    if (m_orbitPathCache != nullptr)
+        m_orbitPathCache->clear();
+}
+
+
+const OrbitPathCache::Statistics& Renderer::getOrbitCacheStatistics() const
+{
+    // The cache is only created by init()
+    static const OrbitPathCache::Statistics emptyStatistics{};
+    if (m_orbitPathCache == nullptr)
+        return emptyStatistics;
+
+    return m_orbitPathCache->getStatistics();
 }
 
 
@@ -5354,112 +5508,120 @@ Renderer::removeInvisibleItems(const Frustum &frustum)
 {
     // Remove objects from the render list that lie completely outside the
     // view frustum.
-    auto notCulled = renderList.begin();
-    for (auto &ri : renderList)
-    {
-        bool convex = true;
-        float radius = 1.0f;
-        float cullRadius = 1.0f;
-        float cloudHeight = 0.0f;
+    Matrix3f cameraMatrix = getCameraOrientation().toRotationMatrix();
+    float maxSpan = hypot((float) windowWidth, (float) windowHeight);
+    float nearZcoeff = cos(degToRad(fov / 2.0f)) * ((float) windowHeight / maxSpan);
 
-        switch (ri.renderableType)
+    auto cull = [&](vector<RenderListEntry>& entries)
+    {
+        auto notCulled = entries.begin();
+        for (auto &ri : entries)
         {
-        case RenderListEntry::RenderableStar:
-            radius = ri.star->getRadius();
-            cullRadius = radius * (1.0f + CoronaHeight);
-            break;
-
-        case RenderListEntry::RenderableCometTail:
-        case RenderListEntry::RenderableReferenceMark:
-            radius = ri.radius;
-            cullRadius = radius;
-            convex = false;
-            break;
+            bool convex = true;
+            float radius = 1.0f;
+            float cullRadius = 1.0f;
+            float cloudHeight = 0.0f;
 
-        case RenderListEntry::RenderableBody:
-            radius = ri.body->getBoundingRadius();
-            if (ri.body->getRings() != nullptr)
+            switch (ri.renderableType)
             {
-                radius = ri.body->getRings()->outerRadius;
-                convex = false;
-            }
+            case RenderListEntry::RenderableStar:
+                radius = ri.star->getRadius();
+                cullRadius = radius * (1.0f + CoronaHeight);
+                break;
 
-            if (!ri.body->isEllipsoid())
+            case RenderListEntry::RenderableCometTail:
+            case RenderListEntry::RenderableReferenceMark:
+                radius = ri.radius;
+                cullRadius = radius;
                 convex = false;
+                break;
 
-            cullRadius = radius;
-            if (ri.body->getAtmosphere() != nullptr)
-            {
-                auto *a = ri.body->getAtmosphere();
-                cullRadius += a->height;
-                cloudHeight = max(a->cloudHeight,
-                                  a->mieScaleHeight * -log(AtmosphereExtinctionThreshold));
-            }
-            break;
-
-        default:
-            break;
-        }
+            case RenderListEntry::RenderableBody:
+                radius = ri.body->getBoundingRadius();
+                if (ri.body->getRings() != nullptr)
+                {
+                    radius = ri.body->getRings()->outerRadius;
+                    convex = false;
+                }
 
-        Vector3f center = getCameraOrientation().toRotationMatrix() * ri.position;
-        // Test the object's bounding sphere against the view frustum
-        if (frustum.testSphere(center, cullRadius) != Frustum::Outside)
-        {
-            float nearZ = center.norm() - radius;
-            float maxSpan = hypot((float) windowWidth, (float) windowHeight);
-            float nearZcoeff = cos(degToRad(fov / 2.0f)) * ((float) windowHeight / maxSpan);
-            nearZ = -nearZ * nearZcoeff;
+                if (!ri.body->isEllipsoid())
+                    convex = false;
 
-            if (nearZ > -MinNearPlaneDistance)
-                ri.nearZ = -max(MinNearPlaneDistance, radius / 2000.0f);
-            else
-                ri.nearZ = nearZ;
+                cullRadius = radius;
+                if (ri.body->getAtmosphere() != nullptr)
+                {
+                    auto *a = ri.body->getAtmosphere();
+                    cullRadius += a->height;
+                    cloudHeight = max(a->cloudHeight,
+                                      a->mieScaleHeight * -log(AtmosphereExtinctionThreshold));
+                }
+                break;
 
-            if (!convex)
-            {
-                ri.farZ = center.z() - radius;
-                if (ri.farZ / ri.nearZ > MaxFarNearRatio * 0.5f)
-                    ri.nearZ = ri.farZ / (MaxFarNearRatio * 0.5f);
+            default:
+                break;
             }
-            else
+
+            Vector3f center = cameraMatrix * ri.position;
+            // Test the object's bounding sphere against the view frustum
+            if (frustum.testSphere(center, cullRadius) != Frustum::Outside)
             {
-                // Make the far plane as close as possible
-                float d = center.norm();
+                float nearZ = center.norm() - radius;
+                nearZ = -nearZ * nearZcoeff;
 
-                // Account for ellipsoidal objects
-                float eradius = radius;
-                if (ri.renderableType == RenderListEntry::RenderableBody)
-                {
-                    float minSemiAxis = ri.body->getSemiAxes().minCoeff();
-                    eradius *= minSemiAxis / radius;
-                }
+                if (nearZ > -MinNearPlaneDistance)
+                    ri.nearZ = -max(MinNearPlaneDistance, radius / 2000.0f);
+                else
+                    ri.nearZ = nearZ;
 
-                if (d > eradius)
+                if (!convex)
                 {
-                    ri.farZ = ri.centerZ - ri.radius;
+                    ri.farZ = center.z() - radius;
+                    if (ri.farZ / ri.nearZ > MaxFarNearRatio * 0.5f)
+                        ri.nearZ = ri.farZ / (MaxFarNearRatio * 0.5f);
                 }
                 else
                 {
-                    // We're inside the bounding sphere (and, if the planet
-                    // is spherical, inside the planet.)
-                    ri.farZ = ri.nearZ * 2.0f;
-                }
+                    // Make the far plane as close as possible
+                    float d = center.norm();
 
-                if (cloudHeight > 0.0f)
-                {
-                    // If there's a cloud layer, we need to move the
-                    // far plane out so that the clouds aren't clipped
-                    float cloudLayerRadius = eradius + cloudHeight;
-                    ri.farZ -= sqrt(square(cloudLayerRadius) - square(eradius));
+                    // Account for ellipsoidal objects
+                    float eradius = radius;
+                    if (ri.renderableType == RenderListEntry::RenderableBody)
+                    {
+                        float minSemiAxis = ri.body->getSemiAxes().minCoeff();
+                        eradius *= minSemiAxis / radius;
+                    }
+
+                    if (d > eradius)
+                    {
+                        ri.farZ = ri.centerZ - ri.radius;
+                    }
+                    else
+                    {
+                        // We're inside the bounding sphere (and, if the planet
+                        // is spherical, inside the planet.)
+                        ri.farZ = ri.nearZ * 2.0f;
+                    }
+
+                    if (cloudHeight > 0.0f)
+                    {
+                        // If there's a cloud layer, we need to move the
+                        // far plane out so that the clouds aren't clipped
+                        float cloudLayerRadius = eradius + cloudHeight;
+                        ri.farZ -= sqrt(square(cloudLayerRadius) - square(eradius));
+                    }
                 }
-            }
 
-            *notCulled = ri;
-            notCulled++;
+                *notCulled = ri;
+                notCulled++;
+            }
         }
-    }
 
-    renderList.resize(notCulled - renderList.begin());
+        entries.resize(notCulled - entries.begin());
+    };
+
+    cull(renderList);
+    cull(pointBodyList);
 
     // The calls to buildRenderLists/renderStars filled renderList
     // with visible bodies.  Sort it front to back, then
@@ -5468,6 +5630,7 @@ Renderer::removeInvisibleItems(const Frustum &frustum)
     // back, then translucent objects back to front. However, the
     // amount of overdraw in Celestia is typically low.)
     sort(renderList.begin(), renderList.end());
+    sort(pointBodyList.begin(), pointBodyList.end());
 }
 
 bool
@@ -5647,6 +5810,11 @@ Renderer::buildDepthPartitions()
     float prevNear = -1e12f; // ~ 1 light year
     if (nEntries > 0)
         prevNear = renderList[nEntries - 1].farZ * 1.01f;
+    if (!pointBodyList.empty())
+    {
+        float pointBodyFar = pointBodyList.back().farZ * 1.01f;
+        prevNear = nEntries > 0 ? min(prevNear, pointBodyFar) : pointBodyFar;
+    }
 
     int i;
 
@@ -5736,16 +5904,19 @@ Renderer::buildDepthPartitions()
     // TODO: closest object may not be at entry 0, since objects are
     // sorted by far distance.
     float closest = zNearest;
-    if (nEntries > 0)
+    if (nEntries > 0 || !pointBodyList.empty())
     {
-        closest = max(closest, renderList[0].nearZ);
+        float nearest = nEntries > 0 ? renderList[0].nearZ : pointBodyList.front().nearZ;
+        if (nEntries > 0 && !pointBodyList.empty())
+            nearest = max(nearest, pointBodyList.front().nearZ);
+        closest = max(closest, nearest);
 
         // Setting a the near plane distance to zero results in unreliable rendering, even
         // if we don't care about the depth buffer. Compromise and set the near plane
         // distance to a small fraction of distance to the nearest object.
         if (closest == 0.0f)
         {
-            closest = renderList[0].nearZ * 0.01f;
+            closest = nearest * 0.01f;
         }
     }
 
@@ -5780,6 +5951,7 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
     auto annotation = depthSortedAnnotations.begin();
     float intervalSize = 1.0f / static_cast<float>(max(1, nIntervals));
     int i = static_cast<int>(renderList.size()) - 1;
+    int j = static_cast<int>(pointBodyList.size()) - 1;
     for (int interval = 0; interval < nIntervals; interval++)
     {
         currentIntervalIndex = interval;
@@ -5866,6 +6038,27 @@ Renderer::renderSolarSystemObjects(const Observer &observer,
         ps.depthTest = true;
         setPipelineState(ps);
 
+        // Add the sub-pixel bodies in this interval to the point star
+        // buffers so that they're drawn with a single call.
+        if (starStyle != PointStars)
+            gaussianDiscTex->bind();
+        while (j >= 0 && pointBodyList[j].farZ < depthPartitions[interval].nearZ)
+        {
+            const RenderListEntry& rle = pointBodyList[j];
+            if (rle.body->isVisibleAsPoint())
+            {
+                float altitude = rle.distance - rle.radius;
+                float discSizeInPixels = rle.radius / (max(nearPlaneDistance, altitude) * pixelSize);
+                addObjectPointSprite(rle.position,
+                                     rle.radius,
+                                     rle.appMag,
+                                     discSizeInPixels,
+                                     rle.body->getSurface().color,
+                                     false, false, m);
+            }
+            j--;
+        }
+
         PointStarVertexBuffer::enable();
         glareVertexBuffer->startSprites();
         glareVertexBuffer->render();
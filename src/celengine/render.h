@@ -18,6 +18,7 @@
 #include <Eigen/Core>
 
 #include <celengine/lightenv.h>
+#include <celengine/orbitpathcache.h>
 #include <celengine/universe.h>
 #include <celengine/selection.h>
 #include <celengine/starcolors.h>
@@ -29,7 +30,9 @@ class RendererWatcher;
 class FrameTree;
 class ReferenceMark;
 class CurvePlot;
+class PointStarRenderer;
 class PointStarVertexBuffer;
+class StaticStarVertexBuffer;
 class AsterismRenderer;
 class BoundariesRenderer;
 class Observer;
@@ -122,6 +125,16 @@ class Renderer
         double orbitWindowEnd;
         double orbitPeriodsShown;
         double linearFadeFraction;
+        // Number of threads culling the star and DSO octrees; zero for one
+        // per hardware thread
+        unsigned int cullingThreads;
+        // Keep the star catalog in a static vertex buffer drawn by the GPU
+        bool staticStarBuffer;
+        // Number of threads sampling orbit paths; zero to sample them when
+        // they are first drawn
+        unsigned int orbitSamplingThreads;
+        // Memory budget of the sampled orbit paths, in bytes
+        std::size_t orbitCacheSize;
     };
 
     enum class ProjectionMode
@@ -423,6 +436,7 @@ class Renderer
     void clearAnnotations(std::vector<Annotation>&);
 
     void invalidateOrbitCache();
+    const OrbitPathCache::Statistics& getOrbitCacheStatistics() const;
 
     struct OrbitPathListEntry
     {
@@ -538,6 +552,10 @@ class Renderer
     void renderPointStars(const StarDatabase& starDB,
                           float faintestVisible,
                           const Observer& observer);
+    void renderUnbufferedStars(PointStarRenderer& starRenderer,
+                               const StarDatabase& starDB,
+                               float faintestMagNight,
+                               const Observer& observer);
     void renderDeepSkyObjects(const Universe&,
                               const Observer&,
                               float faintestMagNight);
@@ -637,6 +655,14 @@ class Renderer
                              bool useHalos,
                              bool emissive,
                              const Matrices&);
+    void addObjectPointSprite(const Eigen::Vector3f& center,
+                              float radius,
+                              float appMag,
+                              float discSizeInPixels,
+                              const Color& color,
+                              bool useHalos,
+                              bool emissive,
+                              const Matrices&);
 
     void renderEllipsoidAtmosphere(const Atmosphere& atmosphere,
                                    const Eigen::Vector3f& center,
@@ -767,6 +793,9 @@ class Renderer
     PointStarVertexBuffer* pointStarVertexBuffer;
     PointStarVertexBuffer* glareVertexBuffer;
     std::vector<RenderListEntry> renderList;
+    // Bodies too small to be drawn as geometry; these bypass renderItem
+    // and are drawn in one batch per depth buffer interval.
+    std::vector<RenderListEntry> pointBodyList;
     std::vector<SecondaryIlluminator> secondaryIlluminators;
     std::vector<DepthBufferPartition> depthPartitions;
     std::vector<Particle> glareParticles;
@@ -799,9 +828,7 @@ class Renderer
 
     std::array<int, 4> m_viewport { 0, 0, 0, 0 };
 
-    typedef std::map<const Orbit*, CurvePlot*> OrbitCache;
-    OrbitCache orbitCache;
-    uint32_t lastOrbitCacheFlush;
+    std::unique_ptr<OrbitPathCache> m_orbitPathCache;
 
     float minOrbitSize;
     float distanceLimit;
@@ -835,6 +862,11 @@ class Renderer
     unsigned m_shadowMapSize { 0 };
     std::unique_ptr<FramebufferObject> m_shadowFBO;
 
+    // Worker threads for octree culling, if more than one thread is used
+    std::unique_ptr<celestia::util::ThreadPool> m_cullingPool;
+
+    std::unique_ptr<StaticStarVertexBuffer> m_staticStarBuffer;
+
     std::array<celestia::render::VertexObject*, static_cast<size_t>(VOType::Count)> m_VertexObjects;
 
     // Saturation magnitude used to calculate a point star size
@@ -898,6 +930,7 @@ class Renderer
     static Color SelectionCursorColor;
 
     friend class PointStarRenderer;
+    friend class StaticStarVertexBuffer;
 };
 
 
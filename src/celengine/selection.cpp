@@ -9,14 +9,20 @@
 // of the License, or (at your option) any later version.
 
 #include <cassert>
+#include <vector>
 #include <fmt/format.h>
 #include "astro.h"
 #include "selection.h"
+#include "frame.h"
 #include "frametree.h"
+#include "timeline.h"
+#include "timelinephase.h"
 #include <celengine/star.h>
 #include <celengine/body.h>
 #include <celengine/location.h>
 #include <celengine/deepskyobj.h>
+#include <celephem/orbit.h>
+#include <celephem/rotation.h>
 
 using namespace Eigen;
 using namespace std;
@@ -85,6 +91,53 @@ UniversalCoord Selection::getPosition(double t) const
 }
 
 
+bool Selection::isThreadSafe(std::unordered_set<const Body*>& visited) const
+{
+    switch (type)
+    {
+    case Type_Body:
+        {
+            if (!visited.insert(body()).second)
+                return true;
+
+            vector<Selection> references;
+            const Timeline* timeline = body()->getTimeline();
+            for (unsigned int i = 0; i < timeline->phaseCount(); i++)
+            {
+                const TimelinePhase& phase = *timeline->getPhase(i);
+                if (!phase.orbit()->isThreadSafe() || !phase.rotationModel()->isThreadSafe())
+                    return false;
+
+                phase.orbitFrame()->getReferencedObjects(references);
+                phase.bodyFrame()->getReferencedObjects(references);
+            }
+
+            for (const Selection& sel : references)
+            {
+                if (!sel.isThreadSafe(visited))
+                    return false;
+            }
+
+            return true;
+        }
+
+    case Type_Star:
+        for (const Star* s = star(); s != nullptr; s = s->getOrbitBarycenter())
+        {
+            if (s->getOrbit() != nullptr && !s->getOrbit()->isThreadSafe())
+                return false;
+        }
+        return true;
+
+    case Type_Location:
+        return Selection(location()->getParentBody()).isThreadSafe(visited);
+
+    default:
+        return true;
+    }
+}
+
+
 Vector3d Selection::getVelocity(double t) const
 {
     switch (type)
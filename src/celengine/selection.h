@@ -11,6 +11,7 @@
 #define _CELENGINE_SELECTION_H_
 
 #include <string>
+#include <unordered_set>
 #include <celengine/univcoord.h>
 #include <Eigen/Core>
 
@@ -46,6 +47,10 @@ class Selection
     double radius() const;
     UniversalCoord getPosition(double t) const;
     Eigen::Vector3d getVelocity(double t) const;
+    // Return whether the orbits and rotations of the object, and those of
+    // every object its position depends on, can be evaluated concurrently.
+    // Bodies in visited have already been checked, or are being checked.
+    bool isThreadSafe(std::unordered_set<const Body*>& visited) const;
     std::string getName(bool i18n = false) const;
     Selection parent() const;
 
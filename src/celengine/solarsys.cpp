@@ -1119,6 +1119,14 @@ bool LoadSolarSystemObjects(std::istream& in,
                             const fs::path& directory)
 {
     Tokenizer tokenizer(&in);
+    return LoadSolarSystemObjects(tokenizer, universe, directory);
+}
+
+
+bool LoadSolarSystemObjects(Tokenizer& tokenizer,
+                            Universe& universe,
+                            const fs::path& directory)
+{
     Parser parser(&tokenizer);
 
 #ifdef ENABLE_NLS
@@ -20,6 +20,7 @@
 class FrameTree;
 class PlanetarySystem;
 class Star;
+class Tokenizer;
 class Universe;
 
 class SolarSystem
@@ -44,3 +45,8 @@ using SolarSystemCatalog = std::map<std::uint32_t, SolarSystem*>;
 bool LoadSolarSystemObjects(std::istream& in,
                             Universe& universe,
                             const fs::path& dir = fs::path());
+// Load from a tokenizer, which may have been filled in advance by
+// Tokenizer::readAll() on another thread.
+bool LoadSolarSystemObjects(Tokenizer& tokenizer,
+                            Universe& universe,
+                            const fs::path& dir = fs::path());
@@ -11,7 +11,6 @@
 
 #include <string>
 #include <algorithm>
-#include <set>
 #include "starbrowser.h"
 
 using namespace Eigen;
@@ -46,145 +45,76 @@ struct BrighterStarPredicate
     }
 };
 
-struct BrightestStarPredicate
-{
-    bool operator()(const Star* star0, const Star* star1) const
-    {
-        return star0->getAbsoluteMagnitude() < star1->getAbsoluteMagnitude();
-    }
-};
-
-struct SolarSystemPredicate
-{
-    Vector3f pos;
-    SolarSystemCatalog* solarSystems;
-
-    bool operator()(const Star* star0, const Star* star1) const
-    {
-        SolarSystemCatalog::iterator iter;
-
-        iter = solarSystems->find(star0->getIndex());
-        bool hasPlanets0 = (iter != solarSystems->end());
-        iter = solarSystems->find(star1->getIndex());
-        bool hasPlanets1 = (iter != solarSystems->end());
-        if (hasPlanets1 == hasPlanets0)
-        {
-            return ((pos - star0->getPosition()).squaredNorm() < (pos - star1->getPosition()).squaredNorm());
-        }
-        else
-        {
-            return hasPlanets0;
-        }
-    }
-};
-
-
-// Find the nearest/brightest/X-est N stars in a database.  The
-// supplied predicate determines which of two stars is a better match.
-template<class Pred> static std::vector<const Star*>*
-findStars(const StarDatabase& stardb, Pred pred, int nStars)
-{
-    std::vector<const Star*>* finalStars = new std::vector<const Star*>();
-    if (nStars == 0)
-        return finalStars;
-    if(nStars > 500)
-        nStars = 500;
-
-    typedef std::multiset<const Star*, Pred> StarSet;
-    StarSet firstStars(pred);
-
-    int totalStars = stardb.size();
-    if (totalStars < nStars)
-        nStars = totalStars;
-
-    // We'll need at least nStars in the set, so first fill
-    // up the list indiscriminately.
-    int i = 0;
-    for (i = 0; i < nStars; i++)
-        firstStars.insert(stardb.getStar(i));
-
-    // From here on, only add a star to the set if it's
-    // a better match than the worst matching star already
-    // in the set.
-    const Star* lastStar = *--firstStars.end();
-    for (; i < totalStars; i++)
-    {
-        Star* star = stardb.getStar(i);
-        if (pred(star, lastStar))
-        {
-            firstStars.insert(star);
-            firstStars.erase(--firstStars.end());
-            lastStar = *--firstStars.end();
-        }
-    }
-
-    // Move the best matching stars into the vector
-    finalStars->reserve(nStars);
-    for (const auto& star : firstStars)
-        finalStars->push_back(star);
-
-    return finalStars;
-}
+// The browser lists at most this many stars
+constexpr unsigned int MaxListStars = 500;
 
 
 const Star* StarBrowser::nearestStar()
 {
-    Universe* univ = appSim->getUniverse();
-    CloserStarPredicate closerPred;
-    closerPred.pos = pos;
-    std::vector<const Star*>* stars = findStars(*(univ->getStarCatalog()), closerPred, 1);
-    const Star *star = (*stars)[0];
-    delete stars;
-    return star;
+    std::vector<const Star*> stars;
+    appSim->getUniverse()->getStarCatalog()->findNearestStars(stars, pos, 1);
+    return stars.empty() ? nullptr : stars.front();
 }
 
 
+// Find the nearest/brightest/X-est N stars in the database.  The star
+// database queries only visit the part of the star octree that can
+// hold the best matches.
 std::vector<const Star*>*
 StarBrowser::listStars(unsigned int nStars)
 {
     Universe* univ = appSim->getUniverse();
+    const StarDatabase& stardb = *univ->getStarCatalog();
+    nStars = min(nStars, MaxListStars);
+
+    auto* stars = new std::vector<const Star*>();
+    stars->reserve(nStars);
     switch(predicate)
     {
     case BrighterStars:
         {
+            stardb.findBrightestStars(*stars, pos, nStars);
+
+            // Rank the stars closer than one light year using a more
+            // precise distance
             BrighterStarPredicate brighterPred;
             brighterPred.pos = pos;
             brighterPred.ucPos = ucPos;
-            return findStars(*(univ->getStarCatalog()), brighterPred, nStars);
+            stable_sort(stars->begin(), stars->end(), brighterPred);
         }
         break;
 
     case BrightestStars:
-        {
-            BrightestStarPredicate brightestPred;
-            return findStars(*(univ->getStarCatalog()), brightestPred, nStars);
-        }
+        stardb.findMostLuminousStars(*stars, nStars);
         break;
 
     case StarsWithPlanets:
         {
             SolarSystemCatalog* solarSystems = univ->getSolarSystemCatalog();
             if (!solarSystems)
+            {
+                delete stars;
                 return nullptr;
-            SolarSystemPredicate solarSysPred;
-            solarSysPred.pos = pos;
-            solarSysPred.solarSystems = solarSystems;
-            return findStars(*(univ->getStarCatalog()), solarSysPred,
-                             min((size_t) nStars, solarSystems->size()));
+            }
+
+            for (const auto& solarSystem : *solarSystems)
+                stars->push_back(solarSystem.second->getStar());
+
+            CloserStarPredicate closerPred;
+            closerPred.pos = pos;
+            auto nSystems = min(static_cast<std::size_t>(nStars), stars->size());
+            partial_sort(stars->begin(), stars->begin() + nSystems, stars->end(), closerPred);
+            stars->resize(nSystems);
         }
         break;
 
     case NearestStars:
     default:
-        {
-            CloserStarPredicate closerPred;
-            closerPred.pos = pos;
-            return findStars(*(univ->getStarCatalog()), closerPred, nStars);
-        }
+        stardb.findNearestStars(*stars, pos, nStars);
         break;
     }
 
-    return nullptr;  // keep compiler happy
+    return stars;
 }
 
 
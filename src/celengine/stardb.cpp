@@ -13,7 +13,10 @@
 #include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <fstream>
 #include <istream>
+#include <numeric>
+#include <ostream>
 #include <set>
 #include <string_view>
 #include <system_error>
@@ -22,9 +25,11 @@
 #include <fmt/format.h>
 
 #include <celcompat/charconv.h>
+#include <celutil/binarywrite.h>
 #include <celutil/bytes.h>
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
+#include <celutil/mappedfile.h>
 #include <celutil/timer.h>
 #include <celutil/tokenizer.h>
 #include <celutil/stringutils.h>
@@ -63,8 +68,18 @@ constexpr inline float STAR_OCTREE_MAGNITUDE   = 6.0f;
 //constexpr const float STAR_EXTRA_ROOM        = 0.01f; // Reserve 1% capacity for extra stars
 
 constexpr inline std::string_view STARSDAT_MAGIC   = "CELSTARS"sv;
+constexpr inline std::string_view OCTREE_MAGIC     = "CELOCTRE"sv;
 constexpr inline std::string_view CROSSINDEX_MAGIC = "CELINDEX"sv;
 
+// Version 0x0100 star databases store spectral types packed with
+// StellarClass::packV1(). Version 0x0200 uses packV2(), and the star records
+// may be followed by an octree section with the stars already sorted into
+// octree order.
+constexpr inline std::uint16_t STARSDAT_VERSION_1 = 0x0100;
+constexpr inline std::uint16_t STARSDAT_VERSION_2 = 0x0200;
+
+constexpr inline std::uint32_t OCTREE_NODE_HAS_CHILDREN = 0x1;
+
 constexpr inline AstroCatalog::IndexNumber TYC3_MULTIPLIER = 1000000000u;
 constexpr inline AstroCatalog::IndexNumber TYC2_MULTIPLIER = 10000u;
 constexpr inline AstroCatalog::IndexNumber TYC123_MIN = 1u;
@@ -105,6 +120,33 @@ struct StarsDatRecord
 
 static_assert(std::is_standard_layout_v<StarsDatRecord>);
 
+// stars.dat octree section header, follows the star records
+struct StarsDatOctreeHeader
+{
+    StarsDatOctreeHeader() = delete;
+    char magic[8];
+    std::uint32_t nodeCount;
+};
+
+static_assert(std::is_standard_layout_v<StarsDatOctreeHeader>);
+
+// stars.dat octree node record; nodes are stored in depth-first order and
+// are followed by the catalog number index, an array of star record
+// numbers sorted by catalog number.
+struct StarsDatOctreeNode
+{
+    StarsDatOctreeNode() = delete;
+    float x;
+    float y;
+    float z;
+    float exclusionFactor;
+    std::uint32_t firstStar;
+    std::uint32_t starCount;
+    std::uint32_t flags;
+};
+
+static_assert(std::is_standard_layout_v<StarsDatOctreeNode>);
+
 // cross-index header structure
 struct CrossIndexHeader
 {
@@ -261,11 +303,224 @@ std::string catalogNumberToString(AstroCatalog::IndexNumber catalogNumber)
 }
 
 
+bool parseStarsDatHeader(const char* header,
+                         std::uint16_t& version,
+                         std::uint32_t& nStarsInFile)
+{
+    // Verify the magic string
+    if (std::string_view(header + offsetof(StarsDatHeader, magic), STARSDAT_MAGIC.size()) != STARSDAT_MAGIC)
+        return false;
+
+    // Verify the version
+    std::memcpy(&version, header + offsetof(StarsDatHeader, version), sizeof(version));
+    LE_TO_CPU_INT16(version, version);
+    if (version != STARSDAT_VERSION_1 && version != STARSDAT_VERSION_2)
+        return false;
+
+    // Read the star count
+    std::memcpy(&nStarsInFile, header + offsetof(StarsDatHeader, counter), sizeof(nStarsInFile));
+    LE_TO_CPU_INT32(nStarsInFile, nStarsInFile);
+    return true;
+}
+
+
+bool decodeStarRecord(const char* ptr, std::uint16_t version, Star& star)
+{
+    AstroCatalog::IndexNumber catNo;
+    std::memcpy(&catNo, ptr + offsetof(StarsDatRecord, catNo), sizeof(catNo));
+    LE_TO_CPU_INT32(catNo, catNo);
+
+    float x;
+    std::memcpy(&x, ptr + offsetof(StarsDatRecord, x), sizeof(x));
+    LE_TO_CPU_FLOAT(x, x);
+
+    float y;
+    std::memcpy(&y, ptr + offsetof(StarsDatRecord, y), sizeof(y));
+    LE_TO_CPU_FLOAT(y, y);
+
+    float z;
+    std::memcpy(&z, ptr + offsetof(StarsDatRecord, z), sizeof(z));
+    LE_TO_CPU_FLOAT(z, z);
+
+    std::int16_t absMag;
+    std::memcpy(&absMag, ptr + offsetof(StarsDatRecord, absMag), sizeof(absMag));
+    LE_TO_CPU_INT16(absMag, absMag);
+
+    std::uint16_t spectralType;
+    std::memcpy(&spectralType, ptr + offsetof(StarsDatRecord, spectralType), sizeof(spectralType));
+    LE_TO_CPU_INT16(spectralType, spectralType);
+
+    StarDetails* details = nullptr;
+    StellarClass sc;
+    if (version == STARSDAT_VERSION_1 ? sc.unpackV1(spectralType) : sc.unpackV2(spectralType))
+        details = StarDetails::GetStarDetails(sc);
+
+    if (details == nullptr)
+        return false;
+
+    star.setPosition(x, y, z);
+    star.setAbsoluteMagnitude(static_cast<float>(absMag) / 256.0f);
+    star.setDetails(details);
+    star.setIndex(catNo);
+    return true;
+}
+
+
+// Read the octree section of a presorted star database. The section is
+// rejected unless the node list forms a complete tree whose star ranges
+// cover all stars in depth-first order, and the catalog number index holds
+// every star in ascending catalog number order, as it is binary searched.
+bool readOctreeSection(const char* records,
+                       const char* ptr,
+                       std::size_t size,
+                       std::uint32_t nStarsInFile,
+                       std::vector<StarOctree::FlatNode>& nodes,
+                       std::vector<std::uint32_t>& catalogIndex)
+{
+    if (size < sizeof(StarsDatOctreeHeader)
+        || std::string_view(ptr + offsetof(StarsDatOctreeHeader, magic), OCTREE_MAGIC.size()) != OCTREE_MAGIC)
+    {
+        return false;
+    }
+
+    std::uint32_t nodeCount;
+    std::memcpy(&nodeCount, ptr + offsetof(StarsDatOctreeHeader, nodeCount), sizeof(nodeCount));
+    LE_TO_CPU_INT32(nodeCount, nodeCount);
+
+    ptr += sizeof(StarsDatOctreeHeader);
+    size -= sizeof(StarsDatOctreeHeader);
+    if (nodeCount == 0
+        || size / sizeof(StarsDatOctreeNode) < nodeCount
+        || (size - nodeCount * sizeof(StarsDatOctreeNode)) / sizeof(std::uint32_t) < nStarsInFile)
+    {
+        return false;
+    }
+
+    nodes.reserve(nodeCount);
+    std::uint32_t nextStar = 0;
+    std::uint32_t openNodes = 1;
+    for (std::uint32_t i = 0; i < nodeCount; ++i)
+    {
+        // A node list that completes the tree early is malformed
+        if (openNodes == 0)
+            return false;
+
+        float x, y, z, exclusionFactor;
+        std::uint32_t firstStar, starCount, flags;
+        std::memcpy(&x, ptr + offsetof(StarsDatOctreeNode, x), sizeof(x));
+        LE_TO_CPU_FLOAT(x, x);
+        std::memcpy(&y, ptr + offsetof(StarsDatOctreeNode, y), sizeof(y));
+        LE_TO_CPU_FLOAT(y, y);
+        std::memcpy(&z, ptr + offsetof(StarsDatOctreeNode, z), sizeof(z));
+        LE_TO_CPU_FLOAT(z, z);
+        std::memcpy(&exclusionFactor, ptr + offsetof(StarsDatOctreeNode, exclusionFactor), sizeof(exclusionFactor));
+        LE_TO_CPU_FLOAT(exclusionFactor, exclusionFactor);
+        std::memcpy(&firstStar, ptr + offsetof(StarsDatOctreeNode, firstStar), sizeof(firstStar));
+        LE_TO_CPU_INT32(firstStar, firstStar);
+        std::memcpy(&starCount, ptr + offsetof(StarsDatOctreeNode, starCount), sizeof(starCount));
+        LE_TO_CPU_INT32(starCount, starCount);
+        std::memcpy(&flags, ptr + offsetof(StarsDatOctreeNode, flags), sizeof(flags));
+        LE_TO_CPU_INT32(flags, flags);
+        ptr += sizeof(StarsDatOctreeNode);
+
+        if (firstStar != nextStar || starCount > nStarsInFile - firstStar)
+            return false;
+        nextStar += starCount;
+
+        bool hasChildren = (flags & OCTREE_NODE_HAS_CHILDREN) != 0;
+        openNodes += hasChildren ? 7 : -1;
+        nodes.push_back({ Eigen::Vector3f(x, y, z), exclusionFactor, firstStar, starCount, hasChildren });
+    }
+
+    if (openNodes != 0 || nextStar != nStarsInFile)
+        return false;
+
+    catalogIndex.resize(nStarsInFile);
+    std::vector<bool> indexed(nStarsInFile, false);
+    AstroCatalog::IndexNumber previousCatNo = 0;
+    for (std::uint32_t i = 0; i < nStarsInFile; ++i)
+    {
+        std::uint32_t starIndex;
+        std::memcpy(&starIndex, ptr, sizeof(starIndex));
+        LE_TO_CPU_INT32(starIndex, starIndex);
+        if (starIndex >= nStarsInFile || indexed[starIndex])
+            return false;
+
+        AstroCatalog::IndexNumber catNo;
+        std::memcpy(&catNo,
+                    records + static_cast<std::size_t>(starIndex) * sizeof(StarsDatRecord) + offsetof(StarsDatRecord, catNo),
+                    sizeof(catNo));
+        LE_TO_CPU_INT32(catNo, catNo);
+        if (catNo < previousCatNo)
+            return false;
+
+        previousCatNo = catNo;
+        indexed[starIndex] = true;
+        catalogIndex[i] = starIndex;
+        ptr += sizeof(std::uint32_t);
+    }
+
+    return true;
+}
+
+
+// Record the index one past the subtree of each node in a depth-first node
+// list; the children of a node start right after it, and each following
+// child starts at the end of the previous one's subtree.
+std::uint32_t computeSubtreeEnds(const std::vector<StarOctree::FlatNode>& nodes,
+                                 std::uint32_t node,
+                                 std::vector<std::uint32_t>& subtreeEnds)
+{
+    std::uint32_t next = node + 1;
+    if (nodes[node].hasChildren)
+    {
+        for (int i = 0; i < 8; ++i)
+            next = computeSubtreeEnds(nodes, next, subtreeEnds);
+    }
+
+    subtreeEnds[node] = next;
+    return next;
+}
+
+
+DynamicStarOctree* createDynamicOctree()
+{
+    float absMag = astro::appToAbsMag(STAR_OCTREE_MAGNITUDE,
+                                      STAR_OCTREE_ROOT_SIZE * (float) sqrt(3.0));
+    return new DynamicStarOctree(Eigen::Vector3f(1000.0f, 1000.0f, 1000.0f),
+                                 absMag);
+}
+
+
 void stcError(const Tokenizer& tok,
               std::string_view msg)
 {
     GetLogger()->error(_("Error in .stc file (line {}): {}\n"), tok.getLineNumber(), msg);
 }
+
+
+// Compute the bounding planes of an infinite view frustum
+void computeFrustumPlanes(Eigen::Hyperplane<float, 3>* frustumPlanes,
+                          const Eigen::Vector3f& position,
+                          const Eigen::Quaternionf& orientation,
+                          float fovY,
+                          float aspectRatio)
+{
+    Eigen::Vector3f planeNormals[5];
+    Eigen::Matrix3f rot = orientation.toRotationMatrix();
+    float h = (float) tan(fovY / 2);
+    float w = h * aspectRatio;
+    planeNormals[0] = Eigen::Vector3f(0.0f, 1.0f, -h);
+    planeNormals[1] = Eigen::Vector3f(0.0f, -1.0f, -h);
+    planeNormals[2] = Eigen::Vector3f(1.0f, 0.0f, -w);
+    planeNormals[3] = Eigen::Vector3f(-1.0f, 0.0f, -w);
+    planeNormals[4] = Eigen::Vector3f(0.0f, 0.0f, -1.0f);
+    for (int i = 0; i < 5; i++)
+    {
+        planeNormals[i] = rot.transpose() * planeNormals[i].normalized();
+        frustumPlanes[i] = Eigen::Hyperplane<float, 3>(planeNormals[i], position);
+    }
+}
 } // end unnamed namespace
 
 
@@ -543,26 +798,25 @@ void StarDatabase::findVisibleStars(StarHandler& starHandler,
                                     float fovY,
                                     float aspectRatio,
                                     float limitingMag,
-                                    OctreeProcStats *stats) const
+                                    OctreeProcStats *stats,
+                                    celestia::util::ThreadPool* threadPool) const
 {
-    // Compute the bounding planes of an infinite view frustum
     Eigen::Hyperplane<float, 3> frustumPlanes[5];
-    Eigen::Vector3f planeNormals[5];
-    Eigen::Matrix3f rot = orientation.toRotationMatrix();
-    float h = (float) tan(fovY / 2);
-    float w = h * aspectRatio;
-    planeNormals[0] = Eigen::Vector3f(0.0f, 1.0f, -h);
-    planeNormals[1] = Eigen::Vector3f(0.0f, -1.0f, -h);
-    planeNormals[2] = Eigen::Vector3f(1.0f, 0.0f, -w);
-    planeNormals[3] = Eigen::Vector3f(-1.0f, 0.0f, -w);
-    planeNormals[4] = Eigen::Vector3f(0.0f, 0.0f, -1.0f);
-    for (int i = 0; i < 5; i++)
+    computeFrustumPlanes(frustumPlanes, position, orientation, fovY, aspectRatio);
+
+    // Statistics are only gathered by serial traversals
+    if (threadPool != nullptr && threadPool->size() > 1)
     {
-        planeNormals[i] = rot.transpose() * planeNormals[i].normalized();
-        frustumPlanes[i] = Eigen::Hyperplane<float, 3>(planeNormals[i], position);
+        octreeIndex.processVisibleObjects(starHandler,
+                                          position,
+                                          frustumPlanes,
+                                          limitingMag,
+                                          STAR_OCTREE_ROOT_SIZE,
+                                          *threadPool);
+        return;
     }
 
-    octreeRoot->processVisibleObjects(starHandler,
+    octreeIndex.processVisibleObjects(starHandler,
                                       position,
                                       frustumPlanes,
                                       limitingMag,
@@ -571,17 +825,65 @@ void StarDatabase::findVisibleStars(StarHandler& starHandler,
 }
 
 
+void StarDatabase::findVisibleStarRanges(std::vector<StarRange>& ranges,
+                                         const Eigen::Vector3f& position,
+                                         const Eigen::Quaternionf& orientation,
+                                         float fovY,
+                                         float aspectRatio,
+                                         float limitingMag) const
+{
+    Eigen::Hyperplane<float, 3> frustumPlanes[5];
+    computeFrustumPlanes(frustumPlanes, position, orientation, fovY, aspectRatio);
+
+    octreeIndex.findVisibleRanges(ranges,
+                                  position,
+                                  frustumPlanes,
+                                  limitingMag,
+                                  STAR_OCTREE_ROOT_SIZE);
+}
+
+
 void StarDatabase::findCloseStars(StarHandler& starHandler,
                                   const Eigen::Vector3f& position,
                                   float radius) const
 {
-    octreeRoot->processCloseObjects(starHandler,
+    octreeIndex.processCloseObjects(starHandler,
                                     position,
                                     radius,
                                     STAR_OCTREE_ROOT_SIZE);
 }
 
 
+void StarDatabase::findNearestStars(std::vector<const Star*>& stars,
+                                    const Eigen::Vector3f& position,
+                                    std::uint32_t nStars) const
+{
+    octreeIndex.findNearestStars(stars, position, nStars, STAR_OCTREE_ROOT_SIZE);
+}
+
+
+void StarDatabase::findBrightestStars(std::vector<const Star*>& stars,
+                                      const Eigen::Vector3f& position,
+                                      std::uint32_t nStars) const
+{
+    octreeIndex.findBrightestStars(stars, position, nStars, STAR_OCTREE_ROOT_SIZE);
+}
+
+
+void StarDatabase::findMostLuminousStars(std::vector<const Star*>& stars,
+                                         std::uint32_t nStars) const
+{
+    octreeIndex.findMostLuminousStars(stars, nStars);
+}
+
+
+void StarDatabase::findStars(std::vector<const Star*>& stars,
+                             const CatalogQuery& query) const
+{
+    octreeIndex.findStars(stars, query, STAR_OCTREE_ROOT_SIZE);
+}
+
+
 StarNameDatabase* StarDatabase::getNameDatabase() const
 {
     return namesDB;
@@ -687,23 +989,12 @@ bool StarDatabase::loadCrossIndex(const Catalog catalog, std::istream& in)
 bool StarDatabase::loadBinary(std::istream& in)
 {
     Timer timer{};
+    std::uint16_t version = 0;
     std::uint32_t nStarsInFile = 0;
     {
         std::array<char, sizeof(StarsDatHeader)> header;
         if (!in.read(header.data(), header.size()).good()) { return false; }
-
-        // Verify the magic string
-        if (std::string_view(header.data() + offsetof(StarsDatHeader, magic), STARSDAT_MAGIC.size()) != STARSDAT_MAGIC) { return false; }
-
-        // Verify the version
-        std::uint16_t version;
-        std::memcpy(&version, header.data() + offsetof(StarsDatHeader, version), sizeof(version));
-        LE_TO_CPU_INT16(version, version);
-        if (version != 0x0100) { return false; }
-
-        // Read the star count
-        std::memcpy(&nStarsInFile, header.data() + offsetof(StarsDatHeader, counter), sizeof(nStarsInFile));
-        LE_TO_CPU_INT32(nStarsInFile, nStarsInFile);
+        if (!parseStarsDatHeader(header.data(), version, nStarsInFile)) { return false; }
     }
 
     constexpr std::uint32_t BUFFER_RECORDS = UINT32_C(4096) / sizeof(StarsDatRecord);
@@ -717,47 +1008,13 @@ bool StarDatabase::loadBinary(std::istream& in)
         const char* ptr = buffer.data();
         for (std::uint32_t i = 0; i < recordsToRead; ++i)
         {
-            AstroCatalog::IndexNumber catNo;
-            std::memcpy(&catNo, ptr + offsetof(StarsDatRecord, catNo), sizeof(catNo));
-            LE_TO_CPU_INT32(catNo, catNo);
-
-            float x;
-            std::memcpy(&x, ptr + offsetof(StarsDatRecord, x), sizeof(x));
-            LE_TO_CPU_FLOAT(x, x);
-
-            float y;
-            std::memcpy(&y, ptr + offsetof(StarsDatRecord, y), sizeof(y));
-            LE_TO_CPU_FLOAT(y, y);
-
-            float z;
-            std::memcpy(&z, ptr + offsetof(StarsDatRecord, z), sizeof(z));
-            LE_TO_CPU_FLOAT(z, z);
-
-            std::int16_t absMag;
-            std::memcpy(&absMag, ptr + offsetof(StarsDatRecord, absMag), sizeof(absMag));
-            LE_TO_CPU_INT16(absMag, absMag);
-
-            std::uint16_t spectralType;
-            std::memcpy(&spectralType, ptr + offsetof(StarsDatRecord, spectralType), sizeof(spectralType));
-            LE_TO_CPU_INT16(spectralType, spectralType);
-
             Star star;
-            star.setPosition(x, y, z);
-            star.setAbsoluteMagnitude(static_cast<float>(absMag) / 256.0f);
-
-            StarDetails* details = nullptr;
-            StellarClass sc;
-            if (sc.unpackV1(spectralType))
-                details = StarDetails::GetStarDetails(sc);
-
-            if (details == nullptr)
+            if (!decodeStarRecord(ptr, version, star))
             {
                 GetLogger()->error(_("Bad spectral type in star database, star #{}\n"), nStars);
                 return false;
             }
 
-            star.setDetails(details);
-            star.setIndex(catNo);
             unsortedStars.add(star);
 
             ptr += sizeof(StarsDatRecord);
@@ -775,32 +1032,206 @@ bool StarDatabase::loadBinary(std::istream& in)
     GetLogger()->debug("StarDatabase::read: nStars = {}, time = {} ms\n", nStarsInFile, loadTime);
     GetLogger()->info(_("{} stars in binary database\n"), nStars);
 
-    // Create the temporary list of stars sorted by catalog number; this
-    // will be used to lookup stars during file loading. After loading is
-    // complete, the stars are sorted into an octree and this list gets
-    // replaced.
-    if (unsortedStars.size() > 0)
+    indexBinaryStars();
+
+    return true;
+}
+
+
+/*! Load a binary star database by mapping it into memory. If the file
+ *  carries an octree section, the stars are decoded directly into their
+ *  final, spatially sorted array and neither the octree nor the catalog
+ *  number index has to be built by finish().
+ */
+bool StarDatabase::loadBinary(const fs::path& path)
+{
+    celutil::MappedFile file(path);
+    if (!file.isOpen())
+    {
+        std::ifstream in(path, std::ios::in | std::ios::binary);
+        return in.good() && loadBinary(in);
+    }
+
+    Timer timer{};
+    std::uint16_t version = 0;
+    std::uint32_t nStarsInFile = 0;
+    if (file.size() < sizeof(StarsDatHeader)
+        || !parseStarsDatHeader(file.data(), version, nStarsInFile))
+    {
+        return false;
+    }
+
+    const char* records = file.data() + sizeof(StarsDatHeader);
+    std::size_t remaining = file.size() - sizeof(StarsDatHeader);
+    if (remaining / sizeof(StarsDatRecord) < nStarsInFile)
+        return false;
+    remaining -= static_cast<std::size_t>(nStarsInFile) * sizeof(StarsDatRecord);
+
+    std::vector<StarOctree::FlatNode> nodes;
+    std::vector<std::uint32_t> catalogIndex;
+    bool presorted = false;
+    if (version == STARSDAT_VERSION_2 && nStars == 0 && nStarsInFile > 0)
+    {
+        presorted = readOctreeSection(records,
+                                      records + static_cast<std::size_t>(nStarsInFile) * sizeof(StarsDatRecord),
+                                      remaining, nStarsInFile, nodes, catalogIndex);
+        if (!presorted)
+            GetLogger()->warn(_("Invalid octree section in star database, rebuilding the octree\n"));
+    }
+
+    if (presorted)
+    {
+        stars = new Star[nStarsInFile];
+        binFileCatalogNumberIndex = new Star*[nStarsInFile];
+        binFileStarCount = nStarsInFile;
+    }
+
+    const char* ptr = records;
+    for (std::uint32_t i = 0; i < nStarsInFile; ++i)
     {
-        binFileStarCount = unsortedStars.size();
-        binFileCatalogNumberIndex = new Star*[binFileStarCount];
-        for (unsigned int i = 0; i < binFileStarCount; i++)
+        Star star;
+        if (!decodeStarRecord(ptr, version, presorted ? stars[i] : star))
         {
-            binFileCatalogNumberIndex[i] = &unsortedStars[i];
+            GetLogger()->error(_("Bad spectral type in star database, star #{}\n"), nStars);
+            if (presorted)
+            {
+                delete[] stars;
+                delete[] binFileCatalogNumberIndex;
+                stars = nullptr;
+                binFileCatalogNumberIndex = nullptr;
+                binFileStarCount = 0;
+                nStars = 0;
+            }
+            return false;
         }
-        std::sort(binFileCatalogNumberIndex, binFileCatalogNumberIndex + binFileStarCount,
-                  [](const Star* star0, const Star* star1) { return star0->getIndex() < star1->getIndex(); });
+
+        if (!presorted)
+            unsortedStars.add(star);
+
+        ptr += sizeof(StarsDatRecord);
+        nStars++;
+    }
+
+    GetLogger()->debug("StarDatabase::read: nStars = {}, time = {} ms\n", nStarsInFile, timer.getTime());
+    GetLogger()->info(_("{} stars in binary database\n"), nStars);
+
+    if (presorted)
+    {
+        for (std::uint32_t i = 0; i < nStarsInFile; ++i)
+            binFileCatalogNumberIndex[i] = stars + catalogIndex[i];
+        prebuiltOctree = std::move(nodes);
+    }
+    else
+    {
+        indexBinaryStars();
     }
 
     return true;
 }
 
 
+/*! Sort stars loaded from a binary database file into octree order and
+ *  write them out together with the octree and the catalog number index.
+ */
+bool StarDatabase::writeBinary(std::ostream& out, const std::vector<BinaryRecord>& records)
+{
+    auto nRecords = static_cast<std::uint32_t>(records.size());
+
+    // While sorting, each star's index is its record number
+    std::vector<Star> recordStars(nRecords);
+    for (std::uint32_t i = 0; i < nRecords; ++i)
+    {
+        StarDetails* details = StarDetails::GetStarDetails(records[i].stellarClass);
+        if (details == nullptr)
+        {
+            GetLogger()->error(_("Bad spectral type for star {}\n"), records[i].catalogNumber);
+            return false;
+        }
+
+        // Sort by the magnitude as it will be stored in the file
+        auto absMag = static_cast<std::int16_t>(records[i].absMag * 256.0f);
+        Star& star = recordStars[i];
+        star.setPosition(records[i].position);
+        star.setAbsoluteMagnitude(static_cast<float>(absMag) / 256.0f);
+        star.setDetails(details);
+        star.setIndex(i);
+    }
+
+    DynamicStarOctree* root = createDynamicOctree();
+    for (const Star& star : recordStars)
+        root->insertObject(star, STAR_OCTREE_ROOT_SIZE);
+
+    Star* sortedStars = new Star[nRecords];
+    Star* firstStar = sortedStars;
+    StarOctree* octree = nullptr;
+    root->rebuildAndSort(octree, firstStar);
+    delete root;
+
+    std::vector<StarOctree::FlatNode> nodes;
+    octree->flatten(nodes, sortedStars);
+    delete octree;
+
+    std::vector<std::uint32_t> catalogIndex(nRecords);
+    std::iota(catalogIndex.begin(), catalogIndex.end(), UINT32_C(0));
+    std::stable_sort(catalogIndex.begin(), catalogIndex.end(),
+                     [&](std::uint32_t i0, std::uint32_t i1)
+                     {
+                         return records[sortedStars[i0].getIndex()].catalogNumber <
+                                records[sortedStars[i1].getIndex()].catalogNumber;
+                     });
+
+    out.write(STARSDAT_MAGIC.data(), STARSDAT_MAGIC.size());
+    celutil::writeLE<std::uint16_t>(out, STARSDAT_VERSION_2);
+    celutil::writeLE<std::uint32_t>(out, nRecords);
+
+    for (std::uint32_t i = 0; i < nRecords; ++i)
+    {
+        const BinaryRecord& record = records[sortedStars[i].getIndex()];
+        celutil::writeLE<std::uint32_t>(out, record.catalogNumber);
+        celutil::writeLE<float>(out, record.position.x());
+        celutil::writeLE<float>(out, record.position.y());
+        celutil::writeLE<float>(out, record.position.z());
+        celutil::writeLE<std::int16_t>(out, static_cast<std::int16_t>(record.absMag * 256.0f));
+        celutil::writeLE<std::uint16_t>(out, record.stellarClass.packV2());
+    }
+
+    delete[] sortedStars;
+
+    out.write(OCTREE_MAGIC.data(), OCTREE_MAGIC.size());
+    celutil::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(nodes.size()));
+    for (const auto& node : nodes)
+    {
+        celutil::writeLE<float>(out, node.cellCenterPos.x());
+        celutil::writeLE<float>(out, node.cellCenterPos.y());
+        celutil::writeLE<float>(out, node.cellCenterPos.z());
+        celutil::writeLE<float>(out, node.exclusionFactor);
+        celutil::writeLE<std::uint32_t>(out, node.firstObject);
+        celutil::writeLE<std::uint32_t>(out, node.nObjects);
+        celutil::writeLE<std::uint32_t>(out, node.hasChildren ? OCTREE_NODE_HAS_CHILDREN : 0);
+    }
+
+    for (std::uint32_t starIndex : catalogIndex)
+        celutil::writeLE<std::uint32_t>(out, starIndex);
+
+    return out.good();
+}
+
+
 void StarDatabase::finish()
 {
     GetLogger()->info(_("Total star count: {}\n"), nStars);
 
-    buildOctree();
-    buildIndexes();
+    if (!prebuiltOctree.empty())
+    {
+        finishPrebuiltOctree();
+    }
+    else
+    {
+        buildOctree();
+        buildIndexes();
+    }
+
+    octreeIndex = StarOctreeIndex(*octreeRoot, stars, nStars);
 
     // Delete the temporary indices used only during loading
     delete[] binFileCatalogNumberIndex;
@@ -825,6 +1256,9 @@ void StarDatabase::finish()
     }
 
     barycenters.clear();
+
+    if (namesDB != nullptr)
+        namesDB->buildCompletionIndex();
 }
 
 
@@ -1250,6 +1684,12 @@ bool StarDatabase::createStar(Star* star,
 bool StarDatabase::load(std::istream& in, const fs::path& resourcePath)
 {
     Tokenizer tokenizer(&in);
+    return load(tokenizer, resourcePath);
+}
+
+
+bool StarDatabase::load(Tokenizer& tokenizer, const fs::path& resourcePath)
+{
     Parser parser(&tokenizer);
 
 #ifdef ENABLE_NLS
@@ -1420,6 +1860,11 @@ bool StarDatabase::load(std::istream& in, const fs::path& resourcePath)
         {
             ok = createStar(star, disposition, catalogNumber, starData, resourcePath, !isStar);
             star->loadCategories(starData, disposition, resourcePath.string());
+
+            // A changed star from a presorted binary file may no longer
+            // belong to the octree node it was stored in.
+            if (!isNewStar && isPrebuiltStar(star))
+                relocatedStars.push_back(static_cast<std::uint32_t>(star - stars));
         }
         delete starDataValue;
 
@@ -1478,10 +1923,7 @@ void StarDatabase::buildOctree()
     // ASSERT(octreeRoot == nullptr);
 
     GetLogger()->debug("Sorting stars into octree . . .\n");
-    float absMag = astro::appToAbsMag(STAR_OCTREE_MAGNITUDE,
-                                      STAR_OCTREE_ROOT_SIZE * (float) sqrt(3.0));
-    DynamicStarOctree* root = new DynamicStarOctree(Eigen::Vector3f(1000.0f, 1000.0f, 1000.0f),
-                                                    absMag);
+    DynamicStarOctree* root = createDynamicOctree();
     for (unsigned int i = 0; i < unsortedStars.size(); ++i)
     {
         root->insertObject(unsortedStars[i], STAR_OCTREE_ROOT_SIZE);
@@ -1537,6 +1979,163 @@ void StarDatabase::buildIndexes()
 }
 
 
+/*! Complete the octree loaded from a presorted binary file. Stars added by
+ *  stc files, and binary stars that stc files changed, are placed into the
+ *  nodes of the existing octree following the same rules as when the octree
+ *  is built from scratch. The star array is then laid out again in octree
+ *  order, which is a single pass over the stars rather than a full rebuild.
+ */
+void StarDatabase::finishPrebuiltOctree()
+{
+    std::sort(relocatedStars.begin(), relocatedStars.end());
+    relocatedStars.erase(std::unique(relocatedStars.begin(), relocatedStars.end()), relocatedStars.end());
+
+    if (unsortedStars.size() > 0 || !relocatedStars.empty())
+    {
+        GetLogger()->debug("Merging {} stars into prebuilt octree . . .\n",
+                           unsortedStars.size() + relocatedStars.size());
+
+        std::vector<std::uint32_t> subtreeEnds(prebuiltOctree.size());
+        computeSubtreeEnds(prebuiltOctree, 0, subtreeEnds);
+
+        auto findNode = [&](const Star& star)
+        {
+            std::uint32_t node = 0;
+            for (;;)
+            {
+                const StarOctree::FlatNode& flat = prebuiltOctree[node];
+                if (!flat.hasChildren
+                    || starAbsoluteMagnitudePredicate(star, flat.exclusionFactor)
+                    || starOrbitStraddlesNodesPredicate(flat.cellCenterPos, star, flat.exclusionFactor))
+                {
+                    return node;
+                }
+
+                Eigen::Vector3f pos = star.getPosition();
+                int child = 0;
+                child |= pos.x() < flat.cellCenterPos.x() ? 0 : XPos;
+                child |= pos.y() < flat.cellCenterPos.y() ? 0 : YPos;
+                child |= pos.z() < flat.cellCenterPos.z() ? 0 : ZPos;
+
+                node = node + 1;
+                for (int i = 0; i < child; ++i)
+                    node = subtreeEnds[node];
+            }
+        };
+
+        struct PendingStar
+        {
+            std::uint32_t node;
+            const Star* star;
+            std::uint32_t prebuiltIndex;
+        };
+
+        std::vector<PendingStar> pending;
+        pending.reserve(unsortedStars.size() + relocatedStars.size());
+        for (std::uint32_t index : relocatedStars)
+            pending.push_back({ findNode(stars[index]), &stars[index], index });
+        for (unsigned int i = 0; i < unsortedStars.size(); ++i)
+            pending.push_back({ findNode(unsortedStars[i]), &unsortedStars[i], AstroCatalog::InvalidIndex });
+        std::stable_sort(pending.begin(), pending.end(),
+                         [](const PendingStar& p0, const PendingStar& p1) { return p0.node < p1.node; });
+
+        Star* sortedStars = new Star[nStars];
+        std::vector<std::uint32_t> newIndex(binFileStarCount);
+        std::vector<Star*> addedStars;
+        addedStars.reserve(unsortedStars.size());
+
+        std::uint32_t nSorted = 0;
+        auto relocated = relocatedStars.cbegin();
+        auto next = pending.cbegin();
+        for (std::uint32_t node = 0; node < prebuiltOctree.size(); ++node)
+        {
+            StarOctree::FlatNode& flat = prebuiltOctree[node];
+            std::uint32_t firstObject = nSorted;
+            for (std::uint32_t i = flat.firstObject; i < flat.firstObject + flat.nObjects; ++i)
+            {
+                if (relocated != relocatedStars.cend() && *relocated == i)
+                {
+                    ++relocated;
+                    continue;
+                }
+
+                newIndex[i] = nSorted;
+                sortedStars[nSorted++] = stars[i];
+            }
+
+            for (; next != pending.cend() && next->node == node; ++next)
+            {
+                if (next->prebuiltIndex == AstroCatalog::InvalidIndex)
+                    addedStars.push_back(sortedStars + nSorted);
+                else
+                    newIndex[next->prebuiltIndex] = nSorted;
+                sortedStars[nSorted++] = *next->star;
+            }
+
+            flat.firstObject = firstObject;
+            flat.nObjects = nSorted - firstObject;
+        }
+        assert(nSorted == nStars);
+
+        catalogNumberIndex = new Star*[nStars];
+        for (std::uint32_t i = 0; i < binFileStarCount; ++i)
+            catalogNumberIndex[i] = sortedStars + newIndex[binFileCatalogNumberIndex[i] - stars];
+
+        auto compareIndex = [](const Star* star0, const Star* star1) { return star0->getIndex() < star1->getIndex(); };
+        std::sort(addedStars.begin(), addedStars.end(), compareIndex);
+        std::copy(addedStars.begin(), addedStars.end(), catalogNumberIndex + binFileStarCount);
+        std::inplace_merge(catalogNumberIndex,
+                           catalogNumberIndex + binFileStarCount,
+                           catalogNumberIndex + nStars,
+                           compareIndex);
+
+        delete[] stars;
+        stars = sortedStars;
+    }
+    else
+    {
+        // The binary file index is already the final catalog number index
+        catalogNumberIndex = binFileCatalogNumberIndex;
+        binFileCatalogNumberIndex = nullptr;
+    }
+
+    const StarOctree::FlatNode* node = prebuiltOctree.data();
+    octreeRoot = StarOctree::unflatten(node, node + prebuiltOctree.size(), stars);
+
+    GetLogger()->debug("Octree has {} nodes and {} stars.\n",
+                       prebuiltOctree.size(), octreeRoot->countObjects());
+
+    unsortedStars.clear();
+    prebuiltOctree.clear();
+    relocatedStars.clear();
+}
+
+
+bool StarDatabase::isPrebuiltStar(const Star* star) const
+{
+    return !prebuiltOctree.empty() && star >= stars && star < stars + binFileStarCount;
+}
+
+
+// Create the temporary list of stars sorted by catalog number; this will be
+// used to lookup stars during file loading. After loading is complete, the
+// stars are sorted into an octree and this list gets replaced.
+void StarDatabase::indexBinaryStars()
+{
+    if (unsortedStars.size() == 0)
+        return;
+
+    binFileStarCount = unsortedStars.size();
+    binFileCatalogNumberIndex = new Star*[binFileStarCount];
+    for (unsigned int i = 0; i < binFileStarCount; i++)
+    {
+        binFileCatalogNumberIndex[i] = &unsortedStars[i];
+    }
+    std::sort(binFileCatalogNumberIndex, binFileCatalogNumberIndex + binFileStarCount,
+              [](const Star* star0, const Star* star1) { return star0->getIndex() < star1->getIndex(); });
+}
+
+
 /*! While loading the star catalogs, this function must be called instead of
  *  find(). The final catalog number index for stars cannot be built until
  *  after all stars have been loaded. During catalog loading, there are two
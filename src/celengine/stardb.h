@@ -25,9 +25,11 @@
 #include "astroobj.h"
 #include "hash.h"
 #include "staroctree.h"
+#include "stellarclass.h"
 
 
 class StarNameDatabase;
+class Tokenizer;
 
 
 constexpr inline unsigned int MAX_STAR_NAMES = 10;
@@ -41,6 +43,8 @@ class StarDatabase
 
     inline Star* getStar(const std::uint32_t) const;
     inline std::uint32_t size() const;
+    // Number of nodes of the star octree, once finish() has been called
+    std::uint32_t getOctreeNodeCount() const { return octreeIndex.nodeCount(); }
 
     Star* find(AstroCatalog::IndexNumber catalogNumber) const;
     Star* find(const std::string&, bool i18n) const;
@@ -54,12 +58,43 @@ class StarDatabase
                           float fovY,
                           float aspectRatio,
                           float limitingMag,
-                          OctreeProcStats * = nullptr) const;
+                          OctreeProcStats * = nullptr,
+                          celestia::util::ThreadPool* threadPool = nullptr) const;
+
+    // Append the ranges of getStar() indices which may hold stars visible
+    // from the observer. The star array is in octree order, so the ranges
+    // are those of the octree nodes which findVisibleStars would process.
+    void findVisibleStarRanges(std::vector<StarRange>& ranges,
+                               const Eigen::Vector3f& obsPosition,
+                               const Eigen::Quaternionf& obsOrientation,
+                               float fovY,
+                               float aspectRatio,
+                               float limitingMag) const;
 
     void findCloseStars(StarHandler& starHandler,
                         const Eigen::Vector3f& obsPosition,
                         float radius) const;
 
+    // Append the nStars stars nearest to obsPosition, nearest first
+    void findNearestStars(std::vector<const Star*>& stars,
+                          const Eigen::Vector3f& obsPosition,
+                          std::uint32_t nStars) const;
+
+    // Append the nStars apparently brightest stars seen from obsPosition,
+    // brightest first
+    void findBrightestStars(std::vector<const Star*>& stars,
+                            const Eigen::Vector3f& obsPosition,
+                            std::uint32_t nStars) const;
+
+    // Append the nStars stars with the brightest absolute magnitude,
+    // brightest first
+    void findMostLuminousStars(std::vector<const Star*>& stars,
+                               std::uint32_t nStars) const;
+
+    // Append the stars matching the query, see StarOctreeIndex::findStars
+    void findStars(std::vector<const Star*>& stars,
+                   const CatalogQuery& query) const;
+
     std::string getStarName(const Star&, bool i18n = false) const;
     std::string getStarNameList(const Star&, const unsigned int maxNames = MAX_STAR_NAMES) const;
 
@@ -67,7 +102,22 @@ class StarDatabase
     void setNameDatabase(StarNameDatabase*);
 
     bool load(std::istream&, const fs::path& resourcePath = fs::path());
+    bool load(Tokenizer&, const fs::path& resourcePath = fs::path());
     bool loadBinary(std::istream&);
+    bool loadBinary(const fs::path&);
+
+    struct BinaryRecord
+    {
+        AstroCatalog::IndexNumber catalogNumber;
+        Eigen::Vector3f position;
+        float absMag;
+        StellarClass stellarClass;
+    };
+
+    // Write a star database in the version 0x0200 format. The stars are
+    // sorted into octree order and followed by the octree node table and the
+    // catalog number index, so neither has to be rebuilt when it's loaded.
+    static bool writeBinary(std::ostream&, const std::vector<BinaryRecord>&);
 
     enum Catalog
     {
@@ -108,6 +158,9 @@ private:
 
     void buildOctree();
     void buildIndexes();
+    void finishPrebuiltOctree();
+    bool isPrebuiltStar(const Star*) const;
+    void indexBinaryStars();
     Star* findWhileLoading(AstroCatalog::IndexNumber catalogNumber) const;
 
     std::uint32_t nStars{ 0 };
@@ -116,6 +169,8 @@ private:
     StarNameDatabase* namesDB{ nullptr };
     Star**            catalogNumberIndex{ nullptr };
     StarOctree*       octreeRoot{ nullptr };
+    // Compact copy of the octree used by findVisibleStars and findCloseStars
+    StarOctreeIndex   octreeIndex;
     AstroCatalog::IndexNumber nextAutoCatalogNumber{ 0xfffffffe };
 
     std::vector<CrossIndex*> crossIndexes;
@@ -128,6 +183,13 @@ private:
     unsigned int binFileStarCount{ 0 };
     // Catalog number -> star mapping for stars loaded from stc files
     std::map<AstroCatalog::IndexNumber, Star*> stcFileCatalogNumberIndex;
+    // Octree loaded along with a presorted binary file; the binary stars
+    // are then kept directly in the stars array, and stc stars are merged
+    // into this octree instead of building a new one.
+    std::vector<StarOctree::FlatNode> prebuiltOctree;
+    // Presorted binary stars changed by stc files, which have to be placed
+    // into the octree again
+    std::vector<std::uint32_t> relocatedStars;
 
     struct BarycenterUsage
     {
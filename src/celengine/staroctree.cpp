@@ -10,6 +10,16 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <queue>
+#include <utility>
+#include <vector>
+
+#include <celcompat/numbers.h>
+#include <celengine/astro.h>
 #include <celengine/staroctree.h>
 
 using namespace Eigen;
@@ -24,6 +34,13 @@ using namespace Eigen;
 // render stars with orbits that are closer than MAX_STAR_ORBIT_RADIUS.
 static const float MAX_STAR_ORBIT_RADIUS = 1.0f;
 
+// Stars in a node are culled in batches: the candidates are gathered into
+// fixed size arrays, so that their distances and apparent magnitudes are
+// computed with Eigen's packet math (SSE or AVX when the compiler targets
+// them, scalar code otherwise), and the visible ones are then passed to the
+// processor together.
+static constexpr unsigned int STAR_BATCH_SIZE = 64;
+
 
 // The octree node into which a star is placed is dependent on two properties:
 // its obsPosition and its luminosity--the fainter the star, the deeper the node
@@ -83,22 +100,194 @@ template<> DynamicStarOctree::ExclusionFactorDecayFunction*
            DynamicStarOctree::decayFunction = starAbsoluteMagnitudeDecayFunction;
 
 
-// total specialization of the StaticOctree template process*() methods for stars:
-template<>
-void StarOctree::processVisibleObjects(StarHandler&    processor,
-                                       const Vector3f& obsPosition,
-                                       const Hyperplane<float, 3>*   frustumPlanes,
-                                       float           limitingFactor,
-                                       float           scale,
-                                       OctreeProcStats *stats) const
+StarOctreeIndex::StarOctreeIndex(const StarOctree& root, const Star* _stars, std::uint32_t nStars) :
+    stars(_stars)
+{
+    std::vector<StarOctree::FlatNode> flatNodes;
+    root.flatten(flatNodes, stars);
+
+    nodes.reserve(flatNodes.size());
+    for (const auto& flat : flatNodes)
+    {
+        nodes.push_back({ flat.cellCenterPos,
+                          flat.exclusionFactor,
+                          std::numeric_limits<float>::infinity(),
+                          flat.firstObject,
+                          flat.nObjects,
+                          0,
+                          flat.hasChildren,
+                          false });
+    }
+
+    // Nodes are in depth-first order: the first child of a node follows it,
+    // and each following child starts where its predecessor's subtree ends.
+    std::vector<std::uint32_t> openNodes;
+    std::vector<unsigned int> remainingChildren;
+    for (std::uint32_t i = 0; i < nodes.size(); ++i)
+    {
+        if (!openNodes.empty())
+            --remainingChildren.back();
+
+        if (nodes[i].hasChildren)
+        {
+            openNodes.push_back(i);
+            remainingChildren.push_back(8);
+            continue;
+        }
+
+        nodes[i].subtreeEnd = i + 1;
+        while (!openNodes.empty() && remainingChildren.back() == 0)
+        {
+            nodes[openNodes.back()].subtreeEnd = i + 1;
+            openNodes.pop_back();
+            remainingChildren.pop_back();
+        }
+    }
+
+    packedStars.reserve(nStars);
+    for (std::uint32_t i = 0; i < nStars; ++i)
+    {
+        Vector3f position = stars[i].getPosition();
+        packedStars.push_back({ position.x(), position.y(), position.z(), stars[i].getAbsoluteMagnitude() });
+    }
+
+    for (auto& node : nodes)
+    {
+        for (std::uint32_t i = node.firstStar; i < node.firstStar + node.nStars; ++i)
+        {
+            node.brightestStar = std::min(node.brightestStar, packedStars[i].absMag);
+            node.hasExtinction |= stars[i].getExtinction() != 0.0f;
+        }
+    }
+}
+
+
+void StarOctreeIndex::processVisibleObjects(StarHandler&                processor,
+                                            const Vector3f&             obsPosition,
+                                            const Hyperplane<float, 3>* frustumPlanes,
+                                            float                       limitingFactor,
+                                            float                       scale,
+                                            OctreeProcStats*            stats) const
+{
+    if (!nodes.empty())
+        processVisibleNode(0, processor, obsPosition, frustumPlanes, limitingFactor, scale, stats);
+}
+
+
+void StarOctreeIndex::processVisibleObjects(StarHandler&                processor,
+                                            const Vector3f&             obsPosition,
+                                            const Hyperplane<float, 3>* frustumPlanes,
+                                            float                       limitingFactor,
+                                            float                       scale,
+                                            celestia::util::ThreadPool& pool) const
+{
+    if (nodes.empty())
+        return;
+
+    processOctreeInParallel(processor, std::uint32_t(0), scale, pool,
+        [&](std::uint32_t index, float nodeScale, StarHandler& nodeProcessor)
+        {
+            return processVisibleNodeStars(index, nodeProcessor, obsPosition, frustumPlanes,
+                                           limitingFactor, nodeScale, nullptr);
+        },
+        [&](std::uint32_t index, float nodeScale, StarHandler& nodeProcessor)
+        {
+            processVisibleNode(index, nodeProcessor, obsPosition, frustumPlanes,
+                               limitingFactor, nodeScale, nullptr);
+        },
+        [this](std::uint32_t index, auto&& f)
+        {
+            if (!nodes[index].hasChildren)
+                return;
+
+            std::uint32_t child = index + 1;
+            for (int i = 0; i < 8; ++i)
+            {
+                f(child);
+                child = nodes[child].subtreeEnd;
+            }
+        });
+}
+
+
+void StarOctreeIndex::findVisibleRanges(std::vector<StarRange>&     ranges,
+                                        const Vector3f&             obsPosition,
+                                        const Hyperplane<float, 3>* frustumPlanes,
+                                        float                       limitingFactor,
+                                        float                       scale) const
+{
+    if (!nodes.empty())
+        findVisibleNodeRanges(0, ranges, obsPosition, frustumPlanes, limitingFactor, scale);
+}
+
+
+void StarOctreeIndex::processCloseObjects(StarHandler&    processor,
+                                          const Vector3f& obsPosition,
+                                          float           boundingRadius,
+                                          float           scale) const
+{
+    if (!nodes.empty())
+        processCloseNode(0, processor, obsPosition, boundingRadius, scale);
+}
+
+
+void StarOctreeIndex::processVisibleNode(std::uint32_t               index,
+                                         StarHandler&                processor,
+                                         const Vector3f&             obsPosition,
+                                         const Hyperplane<float, 3>* frustumPlanes,
+                                         float                       limitingFactor,
+                                         float                       scale,
+                                         OctreeProcStats*            stats) const
 {
 #ifdef OCTREE_DEBUG
     size_t h;
     if (stats != nullptr)
-    {
         h = stats->height + 1;
-        stats->nodes++;
+#endif
+
+    if (!processVisibleNodeStars(index, processor, obsPosition, frustumPlanes, limitingFactor, scale, stats) ||
+        !nodes[index].hasChildren)
+    {
+        return;
     }
+
+    // Recurse into the child nodes
+    std::uint32_t child = index + 1;
+    for (int i = 0; i < 8; ++i)
+    {
+        processVisibleNode(child,
+                           processor,
+                           obsPosition,
+                           frustumPlanes,
+                           limitingFactor,
+                           scale * 0.5f,
+                           stats);
+        child = nodes[child].subtreeEnd;
+#ifdef OCTREE_DEBUG
+        if (stats != nullptr && stats->height > h)
+            h = stats->height;
+#endif
+    }
+#ifdef OCTREE_DEBUG
+    if (stats != nullptr)
+        stats->height = h;
+#endif
+}
+
+
+bool StarOctreeIndex::processVisibleNodeStars(std::uint32_t               index,
+                                              StarHandler&                processor,
+                                              const Vector3f&             obsPosition,
+                                              const Hyperplane<float, 3>* frustumPlanes,
+                                              float                       limitingFactor,
+                                              float                       scale,
+                                              OctreeProcStats*            stats) const
+{
+    const Node& node = nodes[index];
+
+#ifdef OCTREE_DEBUG
+    if (stats != nullptr)
+        stats->nodes++;
 #endif
     // See if this node lies within the view frustum
 
@@ -108,74 +297,148 @@ void StarOctree::processVisibleObjects(StarHandler&    processor,
     {
         const Hyperplane<float, 3>& plane = frustumPlanes[i];
         float r = scale * plane.normal().cwiseAbs().sum();
-        if (plane.signedDistance(cellCenterPos) < -r)
-            return;
+        if (plane.signedDistance(node.cellCenterPos) < -r)
+            return false;
     }
 
     // Compute the distance to node; this is equal to the distance to
     // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
-    float minDistance = (obsPosition - cellCenterPos).norm() - scale * StarOctree::SQRT3;
+    float minDistance = (obsPosition - node.cellCenterPos).norm() - scale * celestia::numbers::sqrt3_v<float>;
 
     // Process the objects in this node
     float dimmest     = minDistance > 0 ? astro::appToAbsMag(limitingFactor, minDistance) : 1000;
 
-    for (unsigned int i=0; i<nObjects; ++i)
-    {
 #ifdef OCTREE_DEBUG
-        if (stats != nullptr)
-            stats->objects++;
+    if (stats != nullptr)
+        stats->objects += node.nStars;
 #endif
-        const Star& obj = _firstObject[i];
 
-        if (obj.getAbsoluteMagnitude() < dimmest)
+    using BatchArray = Array<float, STAR_BATCH_SIZE, 1>;
+    BatchArray dx, dy, dz, absMag, extinction, distance, appMag;
+    std::array<std::uint32_t, STAR_BATCH_SIZE> candidates;
+    std::array<const Star*, STAR_BATCH_SIZE> visibleStars;
+
+    // 5 * log10(d / LY_PER_PARSEC) is computed with a natural logarithm,
+    // which Eigen vectorizes on all targets
+    constexpr float magnitudeScale = 5.0f / celestia::numbers::ln10_v<float>;
+    const float logParsec = std::log(LY_PER_PARSEC<float>);
+
+    const std::uint32_t lastStar = node.firstStar + node.nStars;
+    for (std::uint32_t i = node.firstStar; i < lastStar;)
+    {
+        unsigned int nCandidates = 0;
+        for (; i < lastStar && nCandidates < STAR_BATCH_SIZE; ++i)
         {
-            float distance    = (obsPosition - obj.getPosition()).norm();
-            float appMag      = obj.getApparentMagnitude(distance);
+            const PackedStar& star = packedStars[i];
+            if (star.absMag >= dimmest)
+                continue;
+
+            dx[nCandidates] = obsPosition.x() - star.x;
+            dy[nCandidates] = obsPosition.y() - star.y;
+            dz[nCandidates] = obsPosition.z() - star.z;
+            absMag[nCandidates] = star.absMag;
+            candidates[nCandidates] = i;
+            ++nCandidates;
+        }
 
-            if (appMag < limitingFactor || (distance < MAX_STAR_ORBIT_RADIUS && obj.getOrbit()))
-                processor.process(obj, distance, appMag);
+        if (nCandidates == 0)
+            continue;
+
+        // Same as Star::getApparentMagnitude()
+        auto d = distance.head(nCandidates);
+        d = (dx.head(nCandidates).square() +
+             dy.head(nCandidates).square() +
+             dz.head(nCandidates).square()).sqrt();
+        appMag.head(nCandidates) = absMag.head(nCandidates) - 5.0f +
+                                   magnitudeScale * (d.log() - logParsec);
+        if (node.hasExtinction)
+        {
+            for (unsigned int j = 0; j < nCandidates; ++j)
+                extinction[j] = stars[candidates[j]].getExtinction();
+            appMag.head(nCandidates) += extinction.head(nCandidates) * d;
         }
-    }
 
-    // See if any of the objects in child nodes are potentially included
-    // that we need to recurse deeper.
-    if (minDistance <= 0 || astro::absToAppMag(exclusionFactor, minDistance) <= limitingFactor)
-    {
-        // Recurse into the child nodes
-        if (_children != nullptr)
+        // Compact the visible stars to the front of the batch
+        unsigned int nVisible = 0;
+        for (unsigned int j = 0; j < nCandidates; ++j)
         {
-            for (int i=0; i<8; ++i)
+            const Star& star = stars[candidates[j]];
+            if (appMag[j] < limitingFactor || (distance[j] < MAX_STAR_ORBIT_RADIUS && star.getOrbit()))
             {
-                _children[i]->processVisibleObjects(processor,
-                                                    obsPosition,
-                                                    frustumPlanes,
-                                                    limitingFactor,
-                                                    scale * 0.5f,
-                                                    stats
-                                                   );
-#ifdef OCTREE_DEBUG
-                if (stats != nullptr && stats->height > h)
-                    h = stats->height;
-#endif
+                visibleStars[nVisible] = &star;
+                distance[nVisible] = distance[j];
+                appMag[nVisible] = appMag[j];
+                ++nVisible;
             }
-#ifdef OCTREE_DEBUG
-            if (stats != nullptr)
-                stats->height = h;
-#endif
         }
+
+        if (nVisible > 0)
+            processor.processBatch(visibleStars.data(), distance.data(), appMag.data(), nVisible);
     }
+
+    // See if any of the objects in child nodes are potentially included
+    // that we need to recurse deeper.
+    return minDistance <= 0 || astro::absToAppMag(node.exclusionFactor, minDistance) <= limitingFactor;
 }
 
 
-template<>
-void StarOctree::processCloseObjects(StarHandler&    processor,
-                                     const Vector3f& obsPosition,
-                                     float           boundingRadius,
-                                     float           scale) const
+void StarOctreeIndex::findVisibleNodeRanges(std::uint32_t               index,
+                                            std::vector<StarRange>&     ranges,
+                                            const Vector3f&             obsPosition,
+                                            const Hyperplane<float, 3>* frustumPlanes,
+                                            float                       limitingFactor,
+                                            float                       scale) const
+{
+    const Node& node = nodes[index];
+
+    // Same culling as processVisibleNodeStars, down to the node level
+    for (unsigned int i = 0; i < 5; ++i)
+    {
+        const Hyperplane<float, 3>& plane = frustumPlanes[i];
+        float r = scale * plane.normal().cwiseAbs().sum();
+        if (plane.signedDistance(node.cellCenterPos) < -r)
+            return;
+    }
+
+    float minDistance = (obsPosition - node.cellCenterPos).norm() - scale * celestia::numbers::sqrt3_v<float>;
+    float dimmest     = minDistance > 0 ? astro::appToAbsMag(limitingFactor, minDistance) : 1000;
+
+    // Stars with an extinction may be dimmer than their absolute magnitude
+    // suggests, but never brighter, so the node can still be skipped
+    if (node.nStars > 0 && node.brightestStar < dimmest)
+    {
+        if (!ranges.empty() && ranges.back().first + ranges.back().count == node.firstStar)
+            ranges.back().count += node.nStars;
+        else
+            ranges.push_back({ node.firstStar, node.nStars });
+    }
+
+    if (!node.hasChildren ||
+        (minDistance > 0 && astro::absToAppMag(node.exclusionFactor, minDistance) > limitingFactor))
+    {
+        return;
+    }
+
+    std::uint32_t child = index + 1;
+    for (int i = 0; i < 8; ++i)
+    {
+        findVisibleNodeRanges(child, ranges, obsPosition, frustumPlanes, limitingFactor, scale * 0.5f);
+        child = nodes[child].subtreeEnd;
+    }
+}
+
+
+void StarOctreeIndex::processCloseNode(std::uint32_t   index,
+                                       StarHandler&    processor,
+                                       const Vector3f& obsPosition,
+                                       float           boundingRadius,
+                                       float           scale) const
 {
+    const Node& node = nodes[index];
+
     // Compute the distance to node; this is equal to the distance to
     // the cellCenterPos of the node minus the boundingRadius of the node, scale * SQRT3.
-    float nodeDistance    = (obsPosition - cellCenterPos).norm() - scale * StarOctree::SQRT3;
+    float nodeDistance    = (obsPosition - node.cellCenterPos).norm() - scale * celestia::numbers::sqrt3_v<float>;
 
     if (nodeDistance > boundingRadius)
         return;
@@ -188,28 +451,304 @@ void StarOctree::processCloseObjects(StarHandler&    processor,
     float radiusSquared    = boundingRadius * boundingRadius;
 
     // Check all the objects in the node.
-    for (unsigned int i = 0; i < nObjects; ++i)
+    const std::uint32_t lastStar = node.firstStar + node.nStars;
+    for (std::uint32_t i = node.firstStar; i < lastStar; ++i)
     {
-        Star& obj = _firstObject[i];
-
-        if ((obsPosition - obj.getPosition()).squaredNorm() < radiusSquared)
+        const PackedStar& star = packedStars[i];
+        float distanceSquared = (obsPosition - Vector3f(star.x, star.y, star.z)).squaredNorm();
+        if (distanceSquared < radiusSquared)
         {
-            float distance    = (obsPosition - obj.getPosition()).norm();
-            float appMag      = obj.getApparentMagnitude(distance);
+            float distance    = std::sqrt(distanceSquared);
+            float appMag      = stars[i].getApparentMagnitude(distance);
 
-            processor.process(obj, distance, appMag);
+            processor.process(stars[i], distance, appMag);
         }
     }
 
     // Recurse into the child nodes
-    if (_children != nullptr)
+    if (node.hasChildren)
     {
+        std::uint32_t child = index + 1;
         for (int i = 0; i < 8; ++i)
         {
-            _children[i]->processCloseObjects(processor,
-                                              obsPosition,
-                                              boundingRadius,
-                                              scale * 0.5f);
+            processCloseNode(child, processor, obsPosition, boundingRadius, scale * 0.5f);
+            child = nodes[child].subtreeEnd;
         }
     }
 }
+
+
+namespace
+{
+
+constexpr auto AcceptAllStars = [](std::uint32_t) { return true; };
+
+} // end unnamed namespace
+
+
+// Best-first search for the nStars stars with the lowest key. Nodes are
+// visited in the order of a lower bound of the keys of their stars, given
+// by nodeBounds(node, scale) as a pair: the bound for the stars of the
+// node itself, and the bound for the stars of its descendants. An infinite
+// bound means that there are no candidates there. Only the stars accepted
+// by starFilter(i) are considered. The search stops as soon as no unvisited
+// node can hold a better star than the worst one found so far, so that only
+// the part of the octree around the best stars is visited.
+template<typename NodeBounds, typename StarKey, typename StarFilter>
+void StarOctreeIndex::findBestStars(std::vector<const Star*>& result,
+                                    std::uint32_t             nStars,
+                                    float                     scale,
+                                    NodeBounds                nodeBounds,
+                                    StarKey                   starKey,
+                                    StarFilter                starFilter) const
+{
+    if (nodes.empty() || nStars == 0)
+        return;
+
+    struct NodeEntry
+    {
+        float         bound;
+        float         scale;
+        std::uint32_t index;
+        bool          children;
+
+        bool operator<(const NodeEntry& other) const { return bound > other.bound; }
+    };
+
+    // Max-heap of the best stars found so far, the worst one on top
+    using StarEntry = std::pair<float, std::uint32_t>;
+    std::priority_queue<StarEntry> best;
+    std::priority_queue<NodeEntry> open;
+
+    auto openNode = [&](std::uint32_t index, float nodeScale)
+    {
+        const Node& node = nodes[index];
+        auto [starsBound, childrenBound] = nodeBounds(node, nodeScale);
+        constexpr float noCandidates = std::numeric_limits<float>::infinity();
+        if (node.nStars > 0 && starsBound < noCandidates)
+            open.push({ starsBound, nodeScale, index, false });
+        if (node.hasChildren && childrenBound < noCandidates)
+            open.push({ childrenBound, nodeScale, index, true });
+    };
+
+    openNode(0, scale);
+    while (!open.empty())
+    {
+        NodeEntry entry = open.top();
+        if (best.size() == nStars && entry.bound >= best.top().first)
+            break;
+        open.pop();
+
+        const Node& node = nodes[entry.index];
+        if (entry.children)
+        {
+            std::uint32_t child = entry.index + 1;
+            for (int i = 0; i < 8; ++i)
+            {
+                openNode(child, entry.scale * 0.5f);
+                child = nodes[child].subtreeEnd;
+            }
+            continue;
+        }
+
+        const std::uint32_t lastStar = node.firstStar + node.nStars;
+        for (std::uint32_t i = node.firstStar; i < lastStar; ++i)
+        {
+            if (!starFilter(i))
+                continue;
+
+            float key = starKey(i);
+            if (best.size() < nStars)
+            {
+                best.emplace(key, i);
+            }
+            else if (key < best.top().first)
+            {
+                best.pop();
+                best.emplace(key, i);
+            }
+        }
+    }
+
+    std::size_t first = result.size();
+    result.resize(first + best.size());
+    for (auto i = result.size(); i > first; --i)
+    {
+        result[i - 1] = &stars[best.top().second];
+        best.pop();
+    }
+}
+
+
+void StarOctreeIndex::findNearestStars(std::vector<const Star*>& result,
+                                       const Vector3f&           obsPosition,
+                                       std::uint32_t             nStars,
+                                       float                     scale) const
+{
+    findBestStars(result, nStars, scale,
+        [&](const Node& node, float nodeScale)
+        {
+            float minDistance = (obsPosition - node.cellCenterPos).norm() - nodeScale * celestia::numbers::sqrt3_v<float>;
+            float bound = minDistance > 0.0f ? minDistance * minDistance : 0.0f;
+            return std::make_pair(bound, bound);
+        },
+        [&](std::uint32_t i)
+        {
+            const PackedStar& star = packedStars[i];
+            return (obsPosition - Vector3f(star.x, star.y, star.z)).squaredNorm();
+        },
+        AcceptAllStars);
+}
+
+
+void StarOctreeIndex::findBrightestStars(std::vector<const Star*>& result,
+                                         const Vector3f&           obsPosition,
+                                         std::uint32_t             nStars,
+                                         float                     scale) const
+{
+    // Extinction only dims stars, so the absolute magnitude of the
+    // brightest star of a node, or the exclusion factor for its children,
+    // seen from the nearest point of the node bounds their magnitudes.
+    findBestStars(result, nStars, scale,
+        [&](const Node& node, float nodeScale)
+        {
+            float minDistance = (obsPosition - node.cellCenterPos).norm() - nodeScale * celestia::numbers::sqrt3_v<float>;
+            if (minDistance <= 0.0f)
+            {
+                constexpr float brightest = -std::numeric_limits<float>::infinity();
+                return std::make_pair(brightest, brightest);
+            }
+
+            return std::make_pair(astro::absToAppMag(node.brightestStar, minDistance),
+                                  astro::absToAppMag(node.exclusionFactor, minDistance));
+        },
+        [&](std::uint32_t i)
+        {
+            const PackedStar& star = packedStars[i];
+            return stars[i].getApparentMagnitude((obsPosition - Vector3f(star.x, star.y, star.z)).norm());
+        },
+        AcceptAllStars);
+}
+
+
+void StarOctreeIndex::findMostLuminousStars(std::vector<const Star*>& result,
+                                            std::uint32_t             nStars) const
+{
+    findBestStars(result, nStars, 1.0f,
+        [](const Node& node, float /*nodeScale*/)
+        {
+            return std::make_pair(node.brightestStar, node.exclusionFactor);
+        },
+        [&](std::uint32_t i)
+        {
+            return packedStars[i].absMag;
+        },
+        AcceptAllStars);
+}
+
+
+void StarOctreeIndex::findStars(std::vector<const Star*>& result,
+                                const CatalogQuery&       query,
+                                float                     scale) const
+{
+    constexpr float noCandidates = std::numeric_limits<float>::infinity();
+    const Vector3f obsPosition = query.observer.cast<float>();
+
+    // Bound the keys of the stars of a node, and rule out nodes outside
+    // the distance range or cone, or whose brightest star is too faint.
+    auto nodeBounds = [&](const Node& node, float nodeScale)
+    {
+        const float nodeRadius = nodeScale * celestia::numbers::sqrt3_v<float>;
+        Vector3f offset = node.cellCenterPos - obsPosition;
+        float centerDistance = offset.norm();
+        float minDistance = std::max(centerDistance - nodeRadius, 0.0f);
+        if (minDistance > query.maxDistance ||
+            centerDistance + nodeRadius < query.minDistance ||
+            !query.sphereInCone(offset.cast<double>(), nodeRadius))
+        {
+            return std::make_pair(noCandidates, noCandidates);
+        }
+
+        float starsBound = node.brightestStar;
+        float childrenBound = node.exclusionFactor;
+        float starsAppMag = -noCandidates;
+        float childrenAppMag = -noCandidates;
+        if (minDistance > 0.0f)
+        {
+            starsAppMag = astro::absToAppMag(starsBound, minDistance);
+            childrenAppMag = astro::absToAppMag(childrenBound, minDistance);
+        }
+
+        switch (query.sortKey)
+        {
+        case CatalogQuery::SortKey::ApparentMagnitude:
+            starsBound = starsAppMag;
+            childrenBound = childrenAppMag;
+            break;
+        case CatalogQuery::SortKey::AbsoluteMagnitude:
+            break;
+        case CatalogQuery::SortKey::Distance:
+            starsBound = childrenBound = minDistance;
+            break;
+        default:
+            starsBound = childrenBound = 0.0f;
+            break;
+        }
+
+        if (node.brightestStar > query.maxAbsMag || starsAppMag > query.maxAppMag)
+            starsBound = noCandidates;
+        if (node.exclusionFactor > query.maxAbsMag || childrenAppMag > query.maxAppMag)
+            childrenBound = noCandidates;
+
+        return std::make_pair(starsBound, childrenBound);
+    };
+
+    auto starDistance = [&](std::uint32_t i)
+    {
+        const PackedStar& star = packedStars[i];
+        return (Vector3f(star.x, star.y, star.z) - obsPosition).norm();
+    };
+
+    auto starKey = [&](std::uint32_t i)
+    {
+        switch (query.sortKey)
+        {
+        case CatalogQuery::SortKey::ApparentMagnitude:
+            return stars[i].getApparentMagnitude(starDistance(i));
+        case CatalogQuery::SortKey::AbsoluteMagnitude:
+            return packedStars[i].absMag;
+        case CatalogQuery::SortKey::Distance:
+            return starDistance(i);
+        default:
+            return 0.0f;
+        }
+    };
+
+    // Test the packed star first, and read the star record only when needed
+    auto starFilter = [&](std::uint32_t i)
+    {
+        const PackedStar& star = packedStars[i];
+        if (star.absMag < query.minAbsMag || star.absMag > query.maxAbsMag)
+            return false;
+
+        Vector3f offset = Vector3f(star.x, star.y, star.z) - obsPosition;
+        float distance = offset.norm();
+        if (distance < query.minDistance || distance > query.maxDistance ||
+            !query.inCone(offset.cast<double>(), distance))
+        {
+            return false;
+        }
+
+        if (query.hasAppMagLimits())
+        {
+            float appMag = stars[i].getApparentMagnitude(distance);
+            if (appMag < query.minAppMag || appMag > query.maxAppMag)
+                return false;
+        }
+
+        return query.spectralClassMask == CatalogQuery::AllSpectralClasses ||
+               (CatalogQuery::spectralClassBit(stars[i].getSpectralType()[0]) & query.spectralClassMask) != 0;
+    };
+
+    findBestStars(result, query.maxResults, scale, nodeBounds, starKey, starFilter);
+}
@@ -13,6 +13,13 @@
 #ifndef _CELENGINE_STAROCTREE_H_
 #define _CELENGINE_STAROCTREE_H_
 
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celengine/catalogquery.h>
 #include <celengine/star.h>
 #include <celengine/octree.h>
 
@@ -21,4 +28,150 @@ typedef DynamicOctree  <Star, float> DynamicStarOctree;
 typedef StaticOctree   <Star, float> StarOctree;
 typedef OctreeProcessor<Star, float> StarHandler;
 
+// Range of consecutive stars in the star array
+struct StarRange
+{
+    std::uint32_t first;
+    std::uint32_t count;
+};
+
+// Placement rules of the star octree, shared with code that inserts stars
+// into a prebuilt octree loaded from a catalog file.
+bool starAbsoluteMagnitudePredicate(const Star& star, const float absMag);
+bool starOrbitStraddlesNodesPredicate(const Eigen::Vector3f& cellCenterPos, const Star& star, const float);
+
+// Copy of a star octree holding only what the per-frame star queries need:
+// the nodes in depth-first order, and the position and absolute magnitude of
+// every star packed together in the order of the star array. Traversals only
+// read the Star records of the stars that pass the culling tests, instead of
+// pulling every star of the visited nodes into the cache.
+class StarOctreeIndex
+{
+ public:
+    StarOctreeIndex() = default;
+    StarOctreeIndex(const StarOctree& root, const Star* stars, std::uint32_t nStars);
+
+    std::uint32_t nodeCount() const { return static_cast<std::uint32_t>(nodes.size()); }
+
+    // See StaticOctree::processVisibleObjects
+    void processVisibleObjects(StarHandler&                       processor,
+                               const Eigen::Vector3f&             obsPosition,
+                               const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                               float                              limitingFactor,
+                               float                              scale,
+                               OctreeProcStats*                   stats = nullptr) const;
+
+    // See StaticOctree::processVisibleObjects
+    void processVisibleObjects(StarHandler&                       processor,
+                               const Eigen::Vector3f&             obsPosition,
+                               const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                               float                              limitingFactor,
+                               float                              scale,
+                               celestia::util::ThreadPool&        pool) const;
+
+    // Append the ranges of the star array holding the stars of the octree
+    // nodes that processVisibleObjects would visit and which may contain a
+    // star brighter than limitingFactor. Adjacent ranges are merged.
+    void findVisibleRanges(std::vector<StarRange>&            ranges,
+                           const Eigen::Vector3f&             obsPosition,
+                           const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                           float                              limitingFactor,
+                           float                              scale) const;
+
+    // See StaticOctree::processCloseObjects
+    void processCloseObjects(StarHandler&           processor,
+                             const Eigen::Vector3f& obsPosition,
+                             float                  boundingRadius,
+                             float                  scale) const;
+
+    // Append the nStars stars nearest to the observer, nearest first
+    void findNearestStars(std::vector<const Star*>& result,
+                          const Eigen::Vector3f&    obsPosition,
+                          std::uint32_t             nStars,
+                          float                     scale) const;
+
+    // Append the nStars stars with the brightest apparent magnitude seen
+    // from the observer, brightest first
+    void findBrightestStars(std::vector<const Star*>& result,
+                            const Eigen::Vector3f&    obsPosition,
+                            std::uint32_t             nStars,
+                            float                     scale) const;
+
+    // Append the nStars stars with the brightest absolute magnitude,
+    // brightest first
+    void findMostLuminousStars(std::vector<const Star*>& result,
+                               std::uint32_t             nStars) const;
+
+    // Append the stars matching the query, in the order of its sort key,
+    // up to query.maxResults stars. Nodes which can't hold a matching star
+    // are skipped.
+    void findStars(std::vector<const Star*>& result,
+                   const CatalogQuery&       query,
+                   float                     scale) const;
+
+ private:
+    struct Node
+    {
+        Eigen::Vector3f cellCenterPos;
+        float           exclusionFactor;
+        // Absolute magnitude of the brightest star of the node
+        float           brightestStar;
+        std::uint32_t   firstStar;
+        std::uint32_t   nStars;
+        // Index following the last node of this node's subtree
+        std::uint32_t   subtreeEnd;
+        bool            hasChildren;
+        // Whether any star of the node has a non-zero extinction, which
+        // then has to be read from the Star records
+        bool            hasExtinction;
+    };
+
+    struct PackedStar
+    {
+        float x;
+        float y;
+        float z;
+        float absMag;
+    };
+
+    void processVisibleNode(std::uint32_t                      index,
+                            StarHandler&                       processor,
+                            const Eigen::Vector3f&             obsPosition,
+                            const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                            float                              limitingFactor,
+                            float                              scale,
+                            OctreeProcStats*                   stats) const;
+    // Process the stars of a single node; returns whether the child nodes
+    // need to be visited.
+    bool processVisibleNodeStars(std::uint32_t                      index,
+                                 StarHandler&                       processor,
+                                 const Eigen::Vector3f&             obsPosition,
+                                 const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                                 float                              limitingFactor,
+                                 float                              scale,
+                                 OctreeProcStats*                   stats) const;
+    void findVisibleNodeRanges(std::uint32_t                      index,
+                               std::vector<StarRange>&            ranges,
+                               const Eigen::Vector3f&             obsPosition,
+                               const Eigen::Hyperplane<float, 3>* frustumPlanes,
+                               float                              limitingFactor,
+                               float                              scale) const;
+    void processCloseNode(std::uint32_t          index,
+                          StarHandler&           processor,
+                          const Eigen::Vector3f& obsPosition,
+                          float                  boundingRadius,
+                          float                  scale) const;
+    template<typename NodeBounds, typename StarKey, typename StarFilter>
+    void findBestStars(std::vector<const Star*>& result,
+                       std::uint32_t             nStars,
+                       float                     scale,
+                       NodeBounds                nodeBounds,
+                       StarKey                   starKey,
+                       StarFilter                starFilter) const;
+
+    std::vector<Node>       nodes;
+    std::vector<PackedStar> packedStars;
+    const Star*             stars{ nullptr };
+};
+
 #endif  // _CELENGINE_STAROCTREE_H_
@@ -0,0 +1,131 @@
+// staticstarvertexbuffer.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <cstddef>
+
+#include <celengine/star.h>
+#include <celengine/starcolors.h>
+#include <celengine/stardb.h>
+#include <celrender/vertexobject.h>
+#include <celutil/color.h>
+#include "glsupport.h"
+#include "pointstarrenderer.h"
+#include "render.h"
+#include "shadermanager.h"
+#include "texture.h"
+#include "staticstarvertexbuffer.h"
+
+using celestia::render::VertexObject;
+
+StaticStarVertexBuffer::StaticStarVertexBuffer(const Renderer& _renderer) :
+    renderer(_renderer)
+{
+}
+
+StaticStarVertexBuffer::~StaticStarVertexBuffer() = default;
+
+bool StaticStarVertexBuffer::hasOrbit(const Star& star)
+{
+    return star.getOrbitalRadius() > 0.0f;
+}
+
+void StaticStarVertexBuffer::update(const StarDatabase& _starDB,
+                                    const ColorTemperatureTable& _colorTemp)
+{
+    if (vo != nullptr && starDB == &_starDB && colorTemp == &_colorTemp && nStars == _starDB.size())
+        return;
+
+    starDB = &_starDB;
+    colorTemp = &_colorTemp;
+    nStars = _starDB.size();
+    orbitingStars.clear();
+
+    std::vector<StarVertex> vertices;
+    vertices.reserve(nStars);
+    for (std::uint32_t i = 0; i < nStars; ++i)
+    {
+        const Star* star = starDB->getStar(i);
+
+        StarVertex& vtx = vertices.emplace_back();
+        vtx.position = star->getPosition();
+        vtx.absMag = star->getAbsoluteMagnitude();
+        vtx.extinction = star->getExtinction();
+        colorTemp->lookupColor(star->getTemperature()).get(vtx.color);
+        vtx.color[3] = 255;
+
+        if (hasOrbit(*star))
+        {
+            vtx.color[3] = 0;
+            orbitingStars.push_back(star);
+        }
+    }
+
+    vo = std::make_unique<VertexObject>(GL_ARRAY_BUFFER, vertices.size() * sizeof(StarVertex), GL_STATIC_DRAW);
+    vo->bind();
+    vo->allocate(vertices.data());
+    vo->setVertexAttribArray(CelestiaGLProgram::VertexCoordAttributeIndex,
+                             3, GL_FLOAT, false, sizeof(StarVertex), offsetof(StarVertex, position));
+    vo->setVertexAttribArray(CelestiaGLProgram::TextureCoord0AttributeIndex,
+                             2, GL_FLOAT, false, sizeof(StarVertex), offsetof(StarVertex, absMag));
+    vo->setVertexAttribArray(CelestiaGLProgram::ColorAttributeIndex,
+                             4, GL_UNSIGNED_BYTE, true, sizeof(StarVertex), offsetof(StarVertex, color));
+    vo->unbind();
+}
+
+void StaticStarVertexBuffer::render(const Eigen::Vector3d& obsPosition,
+                                    const Eigen::Quaternionf& obsOrientation,
+                                    float fovY,
+                                    float aspectRatio,
+                                    float limitingMag,
+                                    float distanceLimit,
+                                    Texture* starTexture)
+{
+    if (vo == nullptr)
+        return;
+
+    Eigen::Vector3f obsPosHigh = obsPosition.cast<float>();
+    Eigen::Vector3f obsPosLow = (obsPosition - obsPosHigh.cast<double>()).cast<float>();
+
+    ranges.clear();
+    starDB->findVisibleStarRanges(ranges, obsPosHigh, obsOrientation, fovY, aspectRatio, limitingMag);
+    if (ranges.empty())
+        return;
+
+    CelestiaGLProgram* prog = renderer.getShaderManager().getShader("staticstar");
+    if (prog == nullptr)
+        return;
+
+    bool points = renderer.starStyle == Renderer::PointStars;
+
+    prog->use();
+    prog->setMVPMatrices(renderer.getCurrentProjectionMatrix(), renderer.getCurrentModelViewMatrix());
+    // The star position minus the high part of the observer position is
+    // exact for nearby stars, so that they stay steady far from the Sun.
+    prog->vec3Param("obsPosHigh") = obsPosHigh;
+    prog->vec3Param("obsPosLow") = obsPosLow;
+    prog->floatParam("limitingMag") = limitingMag;
+    prog->floatParam("faintestMag") = renderer.faintestMag;
+    prog->floatParam("brightnessScale") = renderer.brightnessScale;
+    prog->floatParam("brightnessBias") = renderer.brightnessBias;
+    prog->floatParam("satPoint") = renderer.satPoint;
+    prog->floatParam("discSize") = (points ? 1.0f : BaseStarDiscSize) * static_cast<float>(renderer.getScreenDpi()) / 96.0f;
+    prog->floatParam("maxScaledDiscSize") = MaxScaledDiscStarSize;
+    prog->floatParam("minDistance") = renderer.SolarSystemMaxDistance;
+    prog->floatParam("maxDistance") = distanceLimit;
+    prog->intParam("starStyle") = static_cast<int>(renderer.starStyle);
+    prog->samplerParam("starTex") = 0;
+
+    if (!points && starTexture != nullptr)
+        starTexture->bind();
+
+    vo->bind();
+    for (const StarRange& range : ranges)
+        vo->draw(GL_POINTS, static_cast<GLsizei>(range.count), static_cast<GLint>(range.first));
+    vo->unbind();
+}
@@ -0,0 +1,90 @@
+// staticstarvertexbuffer.h
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celengine/staroctree.h>
+
+class ColorTemperatureTable;
+class Renderer;
+class Star;
+class StarDatabase;
+class Texture;
+
+namespace celestia::render
+{
+class VertexObject;
+}
+
+// The star catalog kept in a static vertex buffer, in the order of the star
+// array, which is the order of the star octree. The star shader computes the
+// apparent magnitude, size and brightness of each star, so that drawing the
+// visible stars only takes a draw call per range of visible octree nodes,
+// without any per star work on the CPU or per frame upload.
+//
+// The buffer only draws the discs of the stars that are further than
+// SolarSystemMaxDistance and don't have an orbit. Nearby and orbiting stars,
+// and the glare and labels of the bright stars, are left to the
+// PointStarRenderer.
+class StaticStarVertexBuffer
+{
+ public:
+    explicit StaticStarVertexBuffer(const Renderer& _renderer);
+    ~StaticStarVertexBuffer();
+    StaticStarVertexBuffer() = delete;
+    StaticStarVertexBuffer(const StaticStarVertexBuffer&) = delete;
+    StaticStarVertexBuffer(StaticStarVertexBuffer&&) = delete;
+    StaticStarVertexBuffer& operator=(const StaticStarVertexBuffer&) = delete;
+    StaticStarVertexBuffer& operator=(StaticStarVertexBuffer&&) = delete;
+
+    // Upload the stars of the database, unless the buffer already holds
+    // them with the same colors.
+    void update(const StarDatabase& _starDB, const ColorTemperatureTable& _colorTemp);
+
+    void render(const Eigen::Vector3d& obsPosition,
+                const Eigen::Quaternionf& obsOrientation,
+                float fovY,
+                float aspectRatio,
+                float limitingMag,
+                float distanceLimit,
+                Texture* starTexture);
+
+    // Stars whose discs are not drawn from the buffer because they move
+    const std::vector<const Star*>& getOrbitingStars() const { return orbitingStars; }
+
+    static bool hasOrbit(const Star& star);
+
+ private:
+    struct StarVertex
+    {
+        Eigen::Vector3f position;
+        float absMag;
+        // Extinction in magnitudes per light year
+        float extinction;
+        // Alpha is zero for the stars the buffer doesn't draw
+        unsigned char color[4];
+    };
+
+    const Renderer& renderer;
+    std::unique_ptr<celestia::render::VertexObject> vo;
+
+    const StarDatabase* starDB                  { nullptr };
+    const ColorTemperatureTable* colorTemp      { nullptr };
+    std::uint32_t nStars                        { 0 };
+
+    std::vector<const Star*> orbitingStars;
+    std::vector<StarRange> ranges;
+};
@@ -7,10 +7,12 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <celutil/filetype.h>
 #include <celutil/logger.h>
 #include <celutil/fsutils.h>
 #include <fstream>
 #include <array>
+#include <memory>
 #include "multitexture.h"
 #include "texmanager.h"
 
@@ -18,7 +20,6 @@ using namespace std;
 using namespace celestia;
 using celestia::util::GetLogger;
 
-static TextureManager* textureManager = nullptr;
 
 static std::array<const char*, 3> directories =
 {
@@ -48,8 +49,8 @@ static std::array<const char*, nExt> extensions =
 
 TextureManager* GetTextureManager()
 {
-    if (textureManager == nullptr)
-        textureManager = new TextureManager("textures");
+    // Also called by threads loading models in the background
+    static TextureManager* textureManager = new TextureManager("textures");
     return textureManager;
 }
 
@@ -87,18 +88,26 @@ fs::path TextureInfo::resolve(const fs::path& baseDir)
 }
 
 
-Texture* TextureInfo::load(const fs::path& name)
+Texture::AddressMode TextureInfo::getAddressMode() const
 {
-    Texture::AddressMode addressMode = Texture::EdgeClamp;
-    Texture::MipMapMode mipMode = Texture::DefaultMipMaps;
-
     if (flags & WrapTexture)
-        addressMode = Texture::Wrap;
-    else if (flags & BorderClamp)
-        addressMode = Texture::BorderClamp;
+        return Texture::Wrap;
+    if (flags & BorderClamp)
+        return Texture::BorderClamp;
+    return Texture::EdgeClamp;
+}
+
+
+Texture::MipMapMode TextureInfo::getMipMapMode() const
+{
+    return (flags & NoMipMaps) ? Texture::NoMipMaps : Texture::DefaultMipMaps;
+}
+
 
-    if (flags & NoMipMaps)
-        mipMode = Texture::NoMipMaps;
+Texture* TextureInfo::load(const fs::path& name)
+{
+    Texture::AddressMode addressMode = getAddressMode();
+    Texture::MipMapMode mipMode = getMipMapMode();
 
     if (bumpHeight == 0.0f)
     {
@@ -109,3 +118,30 @@ Texture* TextureInfo::load(const fs::path& name)
     GetLogger()->debug("Loading bump map: {}\n", name);
     return LoadHeightMapFromFile(name, bumpHeight, addressMode);
 }
+
+
+// Read and decode the image, and compute the normal map of bump maps, on the
+// worker thread; only the creation of the texture is left to the caller.
+std::function<Texture*()> TextureInfo::loadInBackground(const fs::path& name)
+{
+    Texture::AddressMode addressMode = getAddressMode();
+    Texture::MipMapMode mipMode = getMipMapMode();
+
+    // Virtual textures load their tiles in the background themselves
+    if (DetermineFileType(name) == Content_CelestiaTexture)
+        return [name, addressMode, mipMode] { return LoadTextureFromFile(name, addressMode, mipMode); };
+
+    GetLogger()->debug(bumpHeight == 0.0f ? "Loading texture: {}\n" : "Loading bump map: {}\n", name);
+    std::shared_ptr<Image> img(LoadImageFromFile(name));
+    if (img == nullptr)
+        return {};
+
+    if (bumpHeight == 0.0f)
+        return [img, name, addressMode, mipMode] { return CreateTextureFromImage(*img, name, addressMode, mipMode); };
+
+    std::shared_ptr<Image> normalMap(img->computeNormalMap(bumpHeight, addressMode == Texture::Wrap));
+    if (normalMap == nullptr)
+        return {};
+
+    return [normalMap, addressMode] { return CreateTextureFromImage(*normalMap, addressMode, Texture::DefaultMipMaps); };
+}
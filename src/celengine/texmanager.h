@@ -65,6 +65,12 @@ class TextureInfo : public ResourceInfo<Texture>
 
     fs::path resolve(const fs::path&) override;
     Texture* load(const fs::path&) override;
+    bool hasBackgroundLoad() const override { return true; }
+    std::function<Texture*()> loadInBackground(const fs::path&) override;
+
+ private:
+    Texture::AddressMode getAddressMode() const;
+    Texture::MipMapMode getMipMapMode() const;
 };
 
 inline bool operator<(const TextureInfo& ti0, const TextureInfo& ti1)
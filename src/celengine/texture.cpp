@@ -895,9 +895,9 @@ Texture* CreateProceduralCubeMap(int size,
 }
 
 
-static Texture* CreateTextureFromImage(Image& img,
-                                       Texture::AddressMode addressMode,
-                                       Texture::MipMapMode mipMode)
+Texture* CreateTextureFromImage(Image& img,
+                                Texture::AddressMode addressMode,
+                                Texture::MipMapMode mipMode)
 {
     Texture* tex = nullptr;
 
@@ -938,22 +938,33 @@ Texture* LoadTextureFromFile(const fs::path& filename,
     if (img == nullptr)
         return nullptr;
 
-    Texture* tex = CreateTextureFromImage(*img, addressMode, mipMode);
+    Texture* tex = CreateTextureFromImage(*img, filename, addressMode, mipMode);
 
-    if (contentType == Content_DXT5NormalMap)
+    delete img;
+
+    return tex;
+}
+
+
+Texture* CreateTextureFromImage(Image& img,
+                                const fs::path& filename,
+                                Texture::AddressMode addressMode,
+                                Texture::MipMapMode mipMode)
+{
+    Texture* tex = CreateTextureFromImage(img, addressMode, mipMode);
+
+    if (DetermineFileType(filename) == Content_DXT5NormalMap)
     {
         // If the texture came from a .dxt5nm file then mark it as a dxt5
         // compressed normal map. There's no separate OpenGL format for dxt5
         // normal maps, so the file extension is the only thing that
         // distinguishes it from a plain old dxt5 texture.
-        if (img->getFormat() == PixelFormat::DXT5)
+        if (img.getFormat() == PixelFormat::DXT5)
         {
             tex->setFormatOptions(Texture::DXT5NormalMap);
         }
     }
 
-    delete img;
-
     return tex;
 }
 
@@ -188,5 +188,17 @@ extern Texture* LoadHeightMapFromFile(const fs::path& filename,
                                       float height,
                                       Texture::AddressMode addressMode = Texture::EdgeClamp);
 
+// Create a texture from an image in memory. Images can be loaded on any
+// thread, but textures must be created on the thread using OpenGL.
+extern Texture* CreateTextureFromImage(Image& img,
+                                       Texture::AddressMode addressMode,
+                                       Texture::MipMapMode mipMode);
+
+// Same as LoadTextureFromFile for an image already read from filename
+extern Texture* CreateTextureFromImage(Image& img,
+                                       const fs::path& filename,
+                                       Texture::AddressMode addressMode,
+                                       Texture::MipMapMode mipMode);
+
 
 #endif // _CELENGINE_TEXTURE_H_
@@ -7,9 +7,10 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
 #include <cmath>
 #include <cassert>
-#include <cmath>
+#include <chrono>
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -18,8 +19,10 @@
 #include <celcompat/filesystem.h>
 #include <celutil/filetype.h>
 #include <celutil/logger.h>
+#include <celutil/threadpool.h>
 #include <celutil/tokenizer.h>
 #include "glsupport.h"
+#include "image.h"
 #include "parser.h"
 #include "virtualtex.h"
 
@@ -29,6 +32,29 @@ using celestia::util::GetLogger;
 
 static const int MaxResolutionLevels = 13;
 
+// Texture memory which the tiles of a virtual texture may use before the
+// least recently used tiles are evicted
+static std::size_t tileMemoryBudget = 256 * 1024 * 1024;
+
+// Whether tiles are loaded by the worker threads, or by the render thread
+// when they're first needed
+static bool backgroundLoading = true;
+
+// Maximum number of tiles of a virtual texture being loaded at once. Tiles
+// that are still needed when the limit is reached are requested again in a
+// later frame, so that the queue doesn't fill up with tiles that are no
+// longer visible when moving quickly over the surface.
+static const std::size_t MaxPendingTiles = 16;
+
+// Tile images are read and decoded by worker threads shared by all virtual
+// textures; only the creation of the GL textures is left to the render
+// thread.
+static celestia::util::ThreadPool& tileLoaderPool()
+{
+    static celestia::util::ThreadPool pool(2);
+    return pool;
+}
+
 
 // Virtual textures are composed of tiles that are loaded from the hard drive
 // as they become visible.  Hidden tiles may be evicted from graphics memory
@@ -40,6 +66,10 @@ static const int MaxResolutionLevels = 13;
 // a power of two, with width = 2 * height.  The baseSplit determines the
 // number of tiles at the lowest LOD.  It is the log base 2 of the width in
 // tiles of LOD zero.  Though it's not required
+//
+// Tiles are loaded in the background, unless background loading is
+// disabled. Until a tile is resident, the part of the nearest resident
+// coarser tile covering it is used instead.
 
 static bool isPow2(int x)
 {
@@ -81,6 +111,27 @@ VirtualTexture::VirtualTexture(const fs::path& _tilePath,
 }
 
 
+VirtualTexture::~VirtualTexture()
+{
+    // Loads still in progress only use their file name, and their images
+    // are released with the futures.
+    deleteTileTree(tileTree[0]);
+    deleteTileTree(tileTree[1]);
+}
+
+
+void VirtualTexture::setMemoryBudget(std::size_t bytes)
+{
+    tileMemoryBudget = bytes;
+}
+
+
+void VirtualTexture::setBackgroundLoading(bool enable)
+{
+    backgroundLoading = enable;
+}
+
+
 const TextureTile VirtualTexture::getTile(int lod, int u, int v)
 {
     tilesRequested++;
@@ -101,6 +152,13 @@ const TextureTile VirtualTexture::getTile(int lod, int u, int v)
     Tile* tile = node->tile;
     unsigned int tileLOD = 0;
 
+    // The coarsest tile covering the requested one, and the finest
+    // resident tile
+    Tile* baseTile = tile;
+    unsigned int baseLOD = 0;
+    Tile* residentTile = tile != nullptr && tile->tex != nullptr ? tile : nullptr;
+    unsigned int residentLOD = 0;
+
     for (int n = 0; n < lod; n++)
     {
         unsigned int mask = 1 << (lod - n - 1);
@@ -114,6 +172,16 @@ const TextureTile VirtualTexture::getTile(int lod, int u, int v)
         {
             tile = node->tile;
             tileLOD = n + 1;
+            if (baseTile == nullptr)
+            {
+                baseTile = tile;
+                baseLOD = tileLOD;
+            }
+            if (tile->tex != nullptr)
+            {
+                residentTile = tile;
+                residentLOD = tileLOD;
+            }
         }
     }
 
@@ -121,18 +189,37 @@ const TextureTile VirtualTexture::getTile(int lod, int u, int v)
     if (!tile)
         return TextureTile(0);
 
-    // Make the tile resident.
-    unsigned int tileU = u >> (lod - tileLOD);
-    unsigned int tileV = v >> (lod - tileLOD);
-    makeResident(tile, tileLOD, tileU, tileV);
+    // With nothing resident at all, the coarsest tile is loaded right away,
+    // so that the surface is never drawn untextured.
+    if (residentTile == nullptr)
+    {
+        makeResident(baseTile, baseLOD, u >> (lod - baseLOD), v >> (lod - baseLOD));
+        residentTile = baseTile;
+        residentLOD = baseLOD;
+    }
 
-    // It's possible that we failed to make the tile resident, either
-    // because the texture file was bad, or there was an unresolvable
-    // out of memory situation.  In that case there is nothing else to
-    // do but return a texture tile with a null texture name.
+    // Request the tile, and use the finest resident tile in the meantime.
+    if (tile != residentTile)
+    {
+        requestTile(tile, tileLOD, u >> (lod - tileLOD), v >> (lod - tileLOD));
+        if (tile->tex != nullptr)
+        {
+            residentTile = tile;
+            residentLOD = tileLOD;
+        }
+    }
+
+    tile = residentTile;
+    tileLOD = residentLOD;
+
+    // It's possible that we failed to make the tile resident because the
+    // texture file was bad. In that case there is nothing else to do but
+    // return a texture tile with a null texture name.
     if (!tile->tex)
         return TextureTile(0);
 
+    tile->lastUsed = ticks;
+
     // Set up the texture subrect to be the entire texture
     float texU = 0.0f;
     float texV = 0.0f;
@@ -183,11 +270,13 @@ void VirtualTexture::beginUsage()
 {
     ticks++;
     tilesRequested = 0;
+    uploadPendingTiles();
 }
 
 
 void VirtualTexture::endUsage()
 {
+    evictTiles();
 }
 
 
@@ -201,51 +290,121 @@ unsigned int VirtualTexture::tileIndex(unsigned int lod,
 #endif
 
 
-ImageTexture* VirtualTexture::loadTileTexture(unsigned int lod, unsigned int u, unsigned int v)
+fs::path VirtualTexture::tileFileName(unsigned int lod, unsigned int u, unsigned int v) const
 {
-    lod >>= baseSplit;
+    lod -= baseSplit;
     assert(lod < (unsigned)MaxResolutionLevels);
 
-    auto path = tilePath /
-                fmt::format("level{:d}", lod) /
-                fmt::format("{:s}{:d}_{:d}{:s}", tilePrefix, u, v, tileExt.string());
+    return tilePath /
+           fmt::format("level{:d}", lod) /
+           fmt::format("{:s}{:d}_{:d}{:s}", tilePrefix, u, v, tileExt.string());
+}
 
-    Image* img = LoadImageFromFile(path);
-    if (img == nullptr)
-        return nullptr;
 
-    ImageTexture* tex = nullptr;
+void VirtualTexture::uploadTile(Tile* tile, unsigned int lod, Image* img)
+{
+    if (img != nullptr && isPow2(img->getWidth()) && isPow2(img->getHeight()))
+    {
+        // Only use mip maps for the LOD 0; for higher LODs, the function of mip
+        // mapping is built into the texture.
+        MipMapMode mipMapMode = lod == baseSplit ? DefaultMipMaps : NoMipMaps;
+        tile->tex = new ImageTexture(*img, EdgeClamp, mipMapMode);
+        tile->size = static_cast<std::size_t>(img->getSize());
+        if (mipMapMode == DefaultMipMaps)
+            tile->size += tile->size / 3;
+
+        // TODO: Virtual textures can have tiles in different formats, some
+        // compressed and some not. The compression flag doesn't make much
+        // sense for them.
+        compressed = img->isCompressed();
+
+        residentTiles.push_back(tile);
+        residentSize += tile->size;
+    }
+    else
+    {
+        tile->loadFailed = true;
+    }
+}
 
-    // Only use mip maps for the LOD 0; for higher LODs, the function of mip
-    // mapping is built into the texture.
-    MipMapMode mipMapMode = lod == 0 ? DefaultMipMaps : NoMipMaps;
 
-    if (isPow2(img->getWidth()) && isPow2(img->getHeight()))
-        tex = new ImageTexture(*img, EdgeClamp, mipMapMode);
+void VirtualTexture::makeResident(Tile* tile, unsigned int lod, unsigned int u, unsigned int v)
+{
+    if (tile->tex != nullptr || tile->loadFailed)
+        return;
+
+    // A background load of the tile may be under way; it will find the
+    // tile resident and drop its image.
+    std::unique_ptr<Image> img(LoadImageFromFile(tileFileName(lod, u, v)));
+    uploadTile(tile, lod, img.get());
+}
+
+
+void VirtualTexture::requestTile(Tile* tile, unsigned int lod, unsigned int u, unsigned int v)
+{
+    if (!backgroundLoading)
+    {
+        makeResident(tile, lod, u, v);
+        return;
+    }
+
+    if (tile->tex != nullptr || tile->loadFailed || tile->loading ||
+        pendingTiles.size() >= MaxPendingTiles)
+    {
+        return;
+    }
 
-    // TODO: Virtual textures can have tiles in different formats, some
-    // compressed and some not. The compression flag doesn't make much
-    // sense for them.
-    compressed = img->isCompressed();
+    tile->loading = true;
+    pendingTiles.push_back({ tile,
+                             lod,
+                             tileLoaderPool().submit([path = tileFileName(lod, u, v)]
+                             {
+                                 return std::unique_ptr<Image>(LoadImageFromFile(path));
+                             }) });
+}
 
-    delete img;
 
-    return tex;
+void VirtualTexture::uploadPendingTiles()
+{
+    auto it = std::remove_if(pendingTiles.begin(), pendingTiles.end(),
+                             [this](PendingTile& pending)
+                             {
+                                 if (pending.image.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                                     return false;
+
+                                 std::unique_ptr<Image> img = pending.image.get();
+                                 pending.tile->loading = false;
+                                 if (pending.tile->tex == nullptr && !pending.tile->loadFailed)
+                                     uploadTile(pending.tile, pending.lod, img.get());
+                                 return true;
+                             });
+    pendingTiles.erase(it, pendingTiles.end());
 }
 
 
-void VirtualTexture::makeResident(Tile* tile, unsigned int lod, unsigned int u, unsigned int v)
+void VirtualTexture::evictTiles()
 {
-    if (tile->tex == nullptr && !tile->loadFailed)
+    if (residentSize <= tileMemoryBudget)
+        return;
+
+    // Least recently used tiles first; tiles used by the current frame are
+    // never evicted, even if that leaves the texture over its budget.
+    std::sort(residentTiles.begin(), residentTiles.end(),
+              [](const Tile* a, const Tile* b) { return a->lastUsed < b->lastUsed; });
+
+    auto it = residentTiles.begin();
+    for (; it != residentTiles.end() && residentSize > tileMemoryBudget; ++it)
     {
-        // Potentially evict other tiles in order to make this one fit
-        tile->tex = loadTileTexture(lod, u, v);
-        if (tile->tex == nullptr)
-        {
-            // cout << "Texture load failed!\n";
-            tile->loadFailed = true;
-        }
+        Tile* tile = *it;
+        if (tile->lastUsed == ticks)
+            break;
+
+        delete tile->tex;
+        tile->tex = nullptr;
+        residentSize -= tile->size;
+        tile->size = 0;
     }
+    residentTiles.erase(residentTiles.begin(), it);
 }
 
 
@@ -289,6 +448,21 @@ void VirtualTexture::populateTileTree()
 }
 
 
+void VirtualTexture::deleteTileTree(TileQuadtreeNode* node)
+{
+    if (node == nullptr)
+        return;
+
+    for (auto* child : node->children)
+        deleteTileTree(child);
+
+    if (node->tile != nullptr)
+        delete node->tile->tex;
+    delete node->tile;
+    delete node;
+}
+
+
 void VirtualTexture::addTileToTree(Tile* tile, unsigned int lod, unsigned int u, unsigned int v)
 {
     TileQuadtreeNode* node = tileTree[u >> lod];
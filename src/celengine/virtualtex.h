@@ -10,9 +10,15 @@
 #ifndef _CELENGINE_VIRTUALTEX_H_
 #define _CELENGINE_VIRTUALTEX_H_
 
+#include <cstddef>
+#include <future>
+#include <memory>
 #include <string>
+#include <vector>
 #include <celengine/texture.h>
 
+class Image;
+
 
 class VirtualTexture : public Texture
 {
@@ -22,7 +28,7 @@ class VirtualTexture : public Texture
                    unsigned int _tileSize,
                    const std::string& _tilePrefix,
                    const std::string& _tileType);
-    ~VirtualTexture() = default;
+    ~VirtualTexture();
 
     const TextureTile getTile(int lod, int u, int v) override;
     void bind() override;
@@ -33,13 +39,30 @@ class VirtualTexture : public Texture
     void beginUsage() override;
     void endUsage() override;
 
+    // Set the amount of texture memory that the tiles of each virtual
+    // texture may occupy before the least recently used ones are evicted.
+    static void setMemoryBudget(std::size_t bytes);
+    // Load tiles in the background, drawing coarser tiles until they're
+    // ready, or in the frame that first needs them.
+    static void setBackgroundLoading(bool enable);
+
  private:
     struct Tile
     {
         Tile() = default;
         unsigned int lastUsed{ 0 };
         ImageTexture* tex{ nullptr };
+        std::size_t size{ 0 };
         bool loadFailed{ false };
+        bool loading{ false };
+    };
+
+    // Tile image being read and decoded by a worker thread
+    struct PendingTile
+    {
+        Tile* tile;
+        unsigned int lod;
+        std::future<std::unique_ptr<Image>> image;
     };
 
     struct TileQuadtreeNode
@@ -50,9 +73,14 @@ class VirtualTexture : public Texture
     };
 
     void populateTileTree();
+    static void deleteTileTree(TileQuadtreeNode* node);
     void addTileToTree(Tile* tile, unsigned int lod, unsigned int u, unsigned int v);
     void makeResident(Tile* tile, unsigned int lod, unsigned int u, unsigned int v);
-    ImageTexture* loadTileTexture(unsigned int lod, unsigned int u, unsigned int v);
+    void requestTile(Tile* tile, unsigned int lod, unsigned int u, unsigned int v);
+    void uploadTile(Tile* tile, unsigned int lod, Image* img);
+    void uploadPendingTiles();
+    void evictTiles();
+    fs::path tileFileName(unsigned int lod, unsigned int u, unsigned int v) const;
 
     Tile* tiles{ nullptr };
     Tile* findTile(unsigned int lod,
@@ -68,6 +96,10 @@ class VirtualTexture : public Texture
     unsigned int tilesRequested{ 0 };
     unsigned int nResolutionLevels{ 0 };
 
+    std::vector<PendingTile> pendingTiles;
+    std::vector<Tile*> residentTiles;
+    std::size_t residentSize{ 0 };
+
     enum
     {
         TileNotLoaded  = -1,
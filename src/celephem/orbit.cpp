@@ -14,6 +14,7 @@
 #include <celmath/mathlib.h>
 #include <celmath/solve.h>
 #include <celmath/geomutil.h>
+#include <celutil/timecache.h>
 #include <functional>
 #include <algorithm>
 #include <cmath>
@@ -29,6 +30,27 @@ using namespace celmath;
 static const double ORBITAL_VELOCITY_DIFF_DELTA = 1.0 / 1440.0;
 
 
+namespace
+{
+
+// Recently computed state of a CachingOrbit
+struct OrbitState
+{
+    Vector3d position;
+    Vector3d velocity;
+};
+
+enum
+{
+    PositionValid = 0x1,
+    VelocityValid = 0x2,
+};
+
+using OrbitCache = celestia::util::TimeCache<OrbitState, 512>;
+
+} // end unnamed namespace
+
+
 static Vector3d cubicInterpolate(const Vector3d& p0, const Vector3d& v0,
                                  const Vector3d& p1, const Vector3d& v1,
                                  double t)
@@ -436,41 +458,59 @@ double EllipticalOrbit::getBoundingRadius() const
 }
 
 
+// The speed is highest at the pericenter: v^2 = mu (1 + e) / q, with
+// mu = n^2 |a|^3 from the mean motion n.
+double EllipticalOrbit::getMaximumSpeed() const
+{
+    if (eccentricity == 1.0)
+        return -1.0;
+
+    double a = std::abs(pericenterDistance / (1.0 - eccentricity));
+    double meanMotion = 2.0 * celestia::numbers::pi / std::abs(period);
+    return meanMotion * std::sqrt(cube(a) * (1.0 + eccentricity) / pericenterDistance);
+}
+
+
+CachingOrbit::CachingOrbit() :
+    cacheKey(OrbitCache::newKey())
+{
+}
+
+
+CachingOrbit::CachingOrbit(const CachingOrbit& other) :
+    Orbit(other),
+    cacheKey(OrbitCache::newKey())
+{
+}
+
+
 Vector3d CachingOrbit::positionAtTime(double jd) const
 {
-    if (jd != lastTime)
-    {
-        lastTime = jd;
-        lastPosition = computePosition(jd);
-        positionCacheValid = true;
-        velocityCacheValid = false;
-    }
-    else if (!positionCacheValid)
-    {
-        lastPosition = computePosition(jd);
-        positionCacheValid = true;
-    }
+    OrbitCache::Entry& entry = OrbitCache::entry(cacheKey, jd);
+    if (entry.has(cacheKey, jd, PositionValid))
+        return entry.values.position;
 
-    return lastPosition;
+    Vector3d position = computePosition(jd);
+    entry.claim(cacheKey, jd);
+    entry.values.position = position;
+    entry.valid |= PositionValid;
+
+    return position;
 }
 
 
 Vector3d CachingOrbit::velocityAtTime(double jd) const
 {
-    if (jd != lastTime)
-    {
-        lastVelocity = computeVelocity(jd);
-        lastTime = jd;  // must be set *after* call to computeVelocity
-        positionCacheValid = false;
-        velocityCacheValid = true;
-    }
-    else if (!velocityCacheValid)
-    {
-        lastVelocity = computeVelocity(jd);
-        velocityCacheValid = true;
-    }
+    OrbitCache::Entry& entry = OrbitCache::entry(cacheKey, jd);
+    if (entry.has(cacheKey, jd, VelocityValid))
+        return entry.values.velocity;
+
+    Vector3d velocity = computeVelocity(jd);
+    entry.claim(cacheKey, jd);
+    entry.values.velocity = velocity;
+    entry.valid |= VelocityValid;
 
-    return lastVelocity;
+    return velocity;
 }
 
 
@@ -619,6 +659,12 @@ double MixedOrbit::getBoundingRadius() const
 }
 
 
+bool MixedOrbit::isThreadSafe() const
+{
+    return primary->isThreadSafe();
+}
+
+
 void MixedOrbit::sample(double startTime, double endTime, OrbitSampleProc& proc) const
 {
     Orbit* o;
@@ -10,6 +10,8 @@
 #ifndef _CELENGINE_ORBIT_H_
 #define _CELENGINE_ORBIT_H_
 
+#include <cstdint>
+
 #include <Eigen/Core>
 
 
@@ -39,6 +41,14 @@ class Orbit
 
     virtual bool isPeriodic() const { return true; };
 
+    // Return an upper bound of the speed in kilometers per day, or a
+    // negative value when none is known, e.g. for sampled orbits.
+    virtual double getMaximumSpeed() const { return -1.0; }
+
+    // Return false if the orbit can't be evaluated by several threads at
+    // once, e.g. because it calls into a script.
+    virtual bool isThreadSafe() const { return true; }
+
     // Return the time range over which the orbit is valid; if the orbit
     // is always valid, begin and end should be equal.
     virtual void getValidRange(double& begin, double& end) const
@@ -68,6 +78,7 @@ class EllipticalOrbit : public Orbit
     virtual Eigen::Vector3d velocityAtTime(double) const;
     double getPeriod() const;
     double getBoundingRadius() const;
+    double getMaximumSpeed() const override;
 
  private:
     double eccentricAnomaly(double) const;
@@ -103,13 +114,21 @@ class OrbitSampleProc
  * orbits can be expensive to compute, with more than 50 periodic terms.
  * Celestia may need require position of a planet more than once per frame; in
  * order to avoid redundant calculation, the CachingOrbit class saves the
- * result of the last calculation and uses it if the time matches the cached
+ * results of recent calculations and uses them if the time matches a cached
  * time.
+ *
+ * The cache is kept per thread and holds several orbits and times, so that
+ * orbits may be evaluated concurrently, and so that callers querying
+ * different times, e.g. the renderer and the orbit path sampler, don't evict
+ * each other's results. computePosition() and computeVelocity() must thus be
+ * safe to call from several threads at once.
  */
 class CachingOrbit : public Orbit
 {
  public:
-    CachingOrbit() = default;
+    CachingOrbit();
+    CachingOrbit(const CachingOrbit&);
+    CachingOrbit& operator=(const CachingOrbit&) = delete;
     virtual ~CachingOrbit() = default;
 
     virtual Eigen::Vector3d computePosition(double jd) const = 0;
@@ -121,11 +140,9 @@ class CachingOrbit : public Orbit
     Eigen::Vector3d velocityAtTime(double jd) const;
 
  private:
-    mutable Eigen::Vector3d lastPosition;
-    mutable Eigen::Vector3d lastVelocity;
-    mutable double lastTime{ -1.0e30 };
-    mutable bool positionCacheValid{ false };
-    mutable bool velocityCacheValid{ false };
+    // Identifies the orbit in the cache; unlike the address of the orbit,
+    // it is never reused by another orbit.
+    const std::uint64_t cacheKey;
 };
 
 
@@ -146,6 +163,7 @@ class MixedOrbit : public Orbit
     virtual double getPeriod() const;
     virtual double getBoundingRadius() const;
     virtual void sample(double startTime, double endTime, OrbitSampleProc& proc) const;
+    bool isThreadSafe() const override;
 
  private:
     Orbit* primary;
@@ -196,6 +214,7 @@ class FixedOrbit : public Orbit
     virtual double getPeriod() const;
     virtual bool isPeriodic() const;
     virtual double getBoundingRadius() const;
+    double getMaximumSpeed() const override { return 0.0; }
     virtual void sample(double, double, OrbitSampleProc&) const;
 
  private:
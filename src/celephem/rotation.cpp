@@ -15,6 +15,7 @@
 #include <celcompat/numbers.h>
 #include <celmath/geomutil.h>
 #include <celmath/mathlib.h>
+#include <celutil/timecache.h>
 #include <cmath>
 
 using namespace Eigen;
@@ -24,6 +25,28 @@ using namespace celmath;
 
 static const double ANGULAR_VELOCITY_DIFF_DELTA = 1.0 / 1440.0;
 
+namespace
+{
+
+// Recently computed state of a CachingRotationModel
+struct RotationState
+{
+    Quaterniond spin;
+    Quaterniond equator;
+    Vector3d angularVelocity;
+};
+
+enum
+{
+    SpinValid            = 0x1,
+    EquatorValid         = 0x2,
+    AngularVelocityValid = 0x4,
+};
+
+using RotationCache = celestia::util::TimeCache<RotationState, 256>;
+
+} // end unnamed namespace
+
 // Choose a time interval for numerically differentiating orientation
 // to get the angular velocity for a rotation model.
 static double chooseDiffTimeDelta(const RotationModel& rm)
@@ -57,10 +80,14 @@ RotationModel::angularVelocityAtTime(double tdb) const
 /***** CachingRotationModel *****/
 
 CachingRotationModel::CachingRotationModel() :
-    lastTime(365.0),
-    spinCacheValid(false),
-    equatorCacheValid(false),
-    angularVelocityCacheValid(false)
+    cacheKey(RotationCache::newKey())
+{
+}
+
+
+CachingRotationModel::CachingRotationModel(const CachingRotationModel& other) :
+    RotationModel(other),
+    cacheKey(RotationCache::newKey())
 {
 }
 
@@ -68,63 +95,48 @@ CachingRotationModel::CachingRotationModel() :
 Quaterniond
 CachingRotationModel::spin(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastSpin = computeSpin(tjd);
-        spinCacheValid = true;
-        equatorCacheValid = false;
-        angularVelocityCacheValid = false;
-    }
-    else if (!spinCacheValid)
-    {
-        lastSpin = computeSpin(tjd);
-        spinCacheValid = true;
-    }
+    RotationCache::Entry& entry = RotationCache::entry(cacheKey, tjd);
+    if (entry.has(cacheKey, tjd, SpinValid))
+        return entry.values.spin;
 
-    return lastSpin;
+    Quaterniond spin = computeSpin(tjd);
+    entry.claim(cacheKey, tjd);
+    entry.values.spin = spin;
+    entry.valid |= SpinValid;
+
+    return spin;
 }
 
 
 Quaterniond
 CachingRotationModel::equatorOrientationAtTime(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastTime = tjd;
-        lastEquator = computeEquatorOrientation(tjd);
-        spinCacheValid = false;
-        equatorCacheValid = true;
-        angularVelocityCacheValid = false;
-    }
-    else if (!equatorCacheValid)
-    {
-        lastEquator = computeEquatorOrientation(tjd);
-        equatorCacheValid = true;
-    }
+    RotationCache::Entry& entry = RotationCache::entry(cacheKey, tjd);
+    if (entry.has(cacheKey, tjd, EquatorValid))
+        return entry.values.equator;
 
-    return lastEquator;
+    Quaterniond equator = computeEquatorOrientation(tjd);
+    entry.claim(cacheKey, tjd);
+    entry.values.equator = equator;
+    entry.valid |= EquatorValid;
+
+    return equator;
 }
 
 
 Vector3d
 CachingRotationModel::angularVelocityAtTime(double tjd) const
 {
-    if (tjd != lastTime)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        lastTime = tjd;
-        spinCacheValid = false;
-        equatorCacheValid = false;
-        angularVelocityCacheValid = true;
-    }
-    else if (!angularVelocityCacheValid)
-    {
-        lastAngularVelocity = computeAngularVelocity(tjd);
-        angularVelocityCacheValid = true;
-    }
+    RotationCache::Entry& entry = RotationCache::entry(cacheKey, tjd);
+    if (entry.has(cacheKey, tjd, AngularVelocityValid))
+        return entry.values.angularVelocity;
+
+    Vector3d angularVelocity = computeAngularVelocity(tjd);
+    entry.claim(cacheKey, tjd);
+    entry.values.angularVelocity = angularVelocity;
+    entry.valid |= AngularVelocityValid;
 
-    return lastAngularVelocity;
+    return angularVelocity;
 }
 
 
@@ -11,6 +11,8 @@
 #ifndef _CELENGINE_ROTATION_H_
 #define _CELENGINE_ROTATION_H_
 
+#include <cstdint>
+
 #include <Eigen/Geometry>
 
 
@@ -64,6 +66,13 @@ class RotationModel
         return false;
     };
 
+    // Return false if the rotation model can't be evaluated by several
+    // threads at once, e.g. because it calls into a script.
+    virtual bool isThreadSafe() const
+    {
+        return true;
+    }
+
     // Return the time range over which the orientation model is valid;
     // if the model is always valid, begin and end should be equal.
     virtual void getValidRange(double& begin, double& end) const
@@ -75,9 +84,11 @@ class RotationModel
 
 
 /*! CachingRotationModel is an abstract base class for complicated rotation
- *  models that are computationally expensive. The last calculated spin,
- *  equator orientation, and angular velocity are all cached and reused in
- *  order to avoid redundant calculation. Subclasses must override computeSpin(),
+ *  models that are computationally expensive. The recently calculated spins,
+ *  equator orientations, and angular velocities are all cached and reused in
+ *  order to avoid redundant calculation. As for CachingOrbit, the cache is
+ *  kept per thread, so the compute methods must be safe to call from several
+ *  threads at once. Subclasses must override computeSpin(),
  *  computeEquatorOrientation(), and getPeriod(). The default implementation
  *  of computeAngularVelocity uses differentiation to approximate the
  *  the instantaneous angular velocity. It may be overridden if there is some
@@ -88,6 +99,8 @@ class CachingRotationModel : public RotationModel
 {
  public:
     CachingRotationModel();
+    CachingRotationModel(const CachingRotationModel&);
+    CachingRotationModel& operator=(const CachingRotationModel&) = delete;
     virtual ~CachingRotationModel() = default;
 
     Eigen::Quaterniond spin(double tjd) const;
@@ -101,13 +114,8 @@ class CachingRotationModel : public RotationModel
     virtual bool isPeriodic() const = 0;
 
 private:
-    mutable Eigen::Quaterniond lastSpin;
-    mutable Eigen::Quaterniond lastEquator;
-    mutable Eigen::Vector3d lastAngularVelocity;
-    mutable double lastTime;
-    mutable bool spinCacheValid;
-    mutable bool equatorCacheValid;
-    mutable bool angularVelocityCacheValid;
+    // Identifies the rotation model in the cache
+    const std::uint64_t cacheKey;
 };
 
 
@@ -21,6 +21,7 @@
 #include <cmath>
 #include <string>
 #include <algorithm>
+#include <atomic>
 #include <vector>
 #include <iostream>
 #include <fstream>
@@ -89,7 +90,9 @@ private:
     vector<Sample<T> > samples;
     double boundingRadius;
     double period;
-    mutable int lastSample;
+    // Hint for the sample search; it may be shared by several threads
+    // evaluating the orbit, so that it is only accessed atomically.
+    mutable std::atomic<int> lastSample;
 
     TrajectoryInterpolation interpolation;
 };
@@ -178,7 +181,7 @@ template <typename T> Vector3d SampledOrbit<T>::computePosition(double jd) const
     {
         Sample<T> samp;
         samp.t = jd;
-        int n = lastSample;
+        int n = lastSample.load(std::memory_order_relaxed);
 
         if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
         {
@@ -190,7 +193,7 @@ template <typename T> Vector3d SampledOrbit<T>::computePosition(double jd) const
             else
                 n = iter - samples.begin();
 
-            lastSample = n;
+            lastSample.store(n, std::memory_order_relaxed);
         }
 
         if (n == 0)
@@ -293,7 +296,7 @@ template <typename T> Vector3d SampledOrbit<T>::computeVelocity(double jd) const
     {
         Sample<T> samp;
         samp.t = jd;
-        int n = lastSample;
+        int n = lastSample.load(std::memory_order_relaxed);
 
         if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
         {
@@ -304,7 +307,7 @@ template <typename T> Vector3d SampledOrbit<T>::computeVelocity(double jd) const
                 n = samples.size();
             else
                 n = iter - samples.begin();
-            lastSample = n;
+            lastSample.store(n, std::memory_order_relaxed);
         }
 
         if (n == 0)
@@ -454,7 +457,9 @@ private:
     vector<SampleXYZV<T> > samples;
     double boundingRadius;
     double period;
-    mutable int lastSample;
+    // Hint for the sample search; it may be shared by several threads
+    // evaluating the orbit, so that it is only accessed atomically.
+    mutable std::atomic<int> lastSample;
 
     TrajectoryInterpolation interpolation;
 };
@@ -530,7 +535,7 @@ template <typename T> Vector3d SampledOrbitXYZV<T>::computePosition(double jd) c
     {
         SampleXYZV<T> samp;
         samp.t = jd;
-        int n = lastSample;
+        int n = lastSample.load(std::memory_order_relaxed);
 
         if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
         {
@@ -542,7 +547,7 @@ template <typename T> Vector3d SampledOrbitXYZV<T>::computePosition(double jd) c
             else
                 n = iter - samples.begin();
 
-            lastSample = n;
+            lastSample.store(n, std::memory_order_relaxed);
         }
 
         if (n == 0)
@@ -601,7 +606,7 @@ template <typename T> Vector3d SampledOrbitXYZV<T>::computeVelocity(double jd) c
     {
         SampleXYZV<T> samp;
         samp.t = jd;
-        int n = lastSample;
+        int n = lastSample.load(std::memory_order_relaxed);
 
         if (n < 1 || n >= (int) samples.size() || jd < samples[n - 1].t || jd > samples[n].t)
         {
@@ -613,7 +618,7 @@ template <typename T> Vector3d SampledOrbitXYZV<T>::computeVelocity(double jd) c
             else
                 n = iter - samples.begin();
 
-            lastSample = n;
+            lastSample.store(n, std::memory_order_relaxed);
         }
 
         if (n > 0 && n < (int) samples.size())
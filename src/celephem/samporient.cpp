@@ -19,6 +19,7 @@
 #include <cassert>
 #include <string>
 #include <algorithm>
+#include <atomic>
 #include <vector>
 #include <iostream>
 #include <fstream>
@@ -98,7 +99,9 @@ private:
 
 private:
     OrientationSampleVector samples;
-    mutable int lastSample{0};
+    // Hint for the sample search, shared by the threads evaluating the
+    // rotation model
+    mutable std::atomic<int> lastSample{0};
 
     enum InterpolationType
     {
@@ -164,7 +167,7 @@ SampledOrientation::getOrientation(double tjd) const
     {
         OrientationSample samp;
         samp.t = tjd;
-        int n = lastSample;
+        int n = lastSample.load(std::memory_order_relaxed);
 
         // Do a binary search to find the samples that define the orientation
         // at the current time. Cache the previous sample used and avoid
@@ -179,7 +182,7 @@ SampledOrientation::getOrientation(double tjd) const
             else
                 n = iter - samples.begin();
 
-            lastSample = n;
+            lastSample.store(n, std::memory_order_relaxed);
         }
 
         if (n == 0)
@@ -30,6 +30,7 @@ class ScriptedOrbit : public CachingOrbit
     virtual Eigen::Vector3d computePosition(double tjd) const;
     //virtual Vec3d computeVelocity(double tjd) const;
     virtual bool isPeriodic() const;
+    bool isThreadSafe() const override { return false; }
     virtual double getPeriod() const;
     virtual double getBoundingRadius() const;
     virtual void getValidRange(double& begin, double& end) const;
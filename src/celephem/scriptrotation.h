@@ -30,6 +30,7 @@ class ScriptedRotation : public RotationModel
     virtual Eigen::Quaterniond spin(double tjd) const;
 
     virtual bool isPeriodic() const;
+    bool isThreadSafe() const override { return false; }
     virtual double getPeriod() const;
     virtual void getValidRange(double& begin, double& end) const;
 
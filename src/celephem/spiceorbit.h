@@ -37,6 +37,7 @@ class SpiceOrbit : public CachingOrbit
               const std::list<std::string>* requiredKernels);
 
     virtual bool isPeriodic() const;
+    bool isThreadSafe() const override { return false; }
     virtual double getPeriod() const;
 
     virtual double getBoundingRadius() const
@@ -35,6 +35,7 @@ class SpiceRotation : public CachingRotationModel
               const std::list<std::string>* requiredKernels);
 
     bool isPeriodic() const;
+    bool isThreadSafe() const override { return false; }
     double getPeriod() const;
 
     // No notion of an equator for SPICE rotation models
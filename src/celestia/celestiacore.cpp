@@ -37,6 +37,9 @@
 #include <celengine/planetgrid.h>
 #include <celengine/visibleregion.h>
 #include <celengine/framebuffer.h>
+#include <celengine/meshmanager.h>
+#include <celengine/texmanager.h>
+#include <celengine/virtualtex.h>
 #include <celimage/imageformats.h>
 #include <celmath/geomutil.h>
 #include <celutil/color.h>
@@ -44,12 +47,15 @@
 #include <celutil/formatnum.h>
 #include <celutil/fsutils.h>
 #include <celutil/logger.h>
+#include <celutil/threadpool.h>
+#include <celutil/tokenizer.h>
 #include <celutil/gettext.h>
 #include <celutil/utf8.h>
 #include <celcompat/filesystem.h>
 #include <Eigen/Geometry>
 #include <iostream>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <algorithm>
 #include <cstdlib>
@@ -252,8 +258,17 @@ CelestiaCore::CelestiaCore() :
 
 CelestiaCore::~CelestiaCore()
 {
-    if (movieCapture != nullptr)
-        recordEnd();
+    // Without a current OpenGL context, the capture finishes the file
+    // without the frames still being read; front ends call
+    // finishMovieCapture() before to keep them.
+    delete movieCapture;
+    delete pendingMovieCapture;
+
+    if (resourceLoaderPool != nullptr)
+    {
+        GetTextureManager()->setLoaderPool(nullptr);
+        GetGeometryManager()->setLoaderPool(nullptr);
+    }
 
     delete timer;
     delete renderer;
@@ -1965,6 +1980,22 @@ void CelestiaCore::tick()
         dt = sysTime - lastTime;
     }
 
+    advance(dt);
+}
+
+
+// Advance by a fixed time step instead of the time elapsed since the last
+// tick, so that frames don't depend on how long they take to render, e.g.
+// when rendering offscreen.
+void CelestiaCore::tick(double dt)
+{
+    sysTime += dt;
+    advance(dt);
+}
+
+
+void CelestiaCore::advance(double dt)
+{
     // Pause script execution
     if (scriptState == ScriptPaused)
         dt = 0.0;
@@ -2173,8 +2204,18 @@ void CelestiaCore::draw()
     if (toggleAA)
         renderer->enableMSAA();
 
-    if (movieCapture != nullptr && recording)
+    if (movieCapture != nullptr && movieCaptureEnding)
+    {
+        movieCapture->end();
+        delete movieCapture;
+        movieCapture = pendingMovieCapture;
+        pendingMovieCapture = nullptr;
+        movieCaptureEnding = false;
+    }
+    else if (movieCapture != nullptr && recording)
+    {
         movieCapture->captureFrame();
+    }
 
     // Frame rate counter
     nFrames++;
@@ -3609,6 +3650,8 @@ void CelestiaCore::renderOverlay()
                               movieWidth, movieHeight,
                               movieCapture->getFrameRate(),
                               recording ? _("Recording") : _("Paused"));
+        if (int dropped = movieCapture->getDroppedFrameCount(); dropped > 0)
+            overlay->printf(_("  %d frames dropped"), dropped);
 
         overlay->endText();
         overlay->restorePos();
@@ -3655,93 +3698,134 @@ void CelestiaCore::renderOverlay()
 }
 
 
-class SolarSystemLoader
+// Text catalogs are read and tokenized ahead of time on worker threads,
+// which is where most of the time spent loading them goes. The objects are
+// still created on the main thread in the original file order, so catalogs
+// that modify or replace objects defined by earlier ones behave as before.
+class CatalogQueue
 {
-    Universe* universe;
+    struct Entry
+    {
+        fs::path filepath;
+        fs::path resourcePath;
+        bool isExtra;
+        std::future<std::unique_ptr<Tokenizer>> tokens;
+    };
+
+    celestia::util::ThreadPool& pool;
+    string typeDesc;
     ProgressNotifier* notifier;
-    const vector<fs::path>& skip;
+    vector<Entry> entries;
+
+    static std::unique_ptr<Tokenizer> tokenize(const fs::path& filepath)
+    {
+        auto in = std::make_unique<ifstream>(filepath, ios::in);
+        if (!in->good())
+            return nullptr;
+
+        auto tokenizer = std::make_unique<Tokenizer>(in.get());
+        tokenizer->readAll();
+        return tokenizer;
+    }
+
+    void enqueue(const fs::path& filepath, const fs::path& resourcePath, bool isExtra)
+    {
+        auto tokens = pool.submit([filepath] { return tokenize(filepath); });
+        entries.push_back({ filepath, resourcePath, isExtra, std::move(tokens) });
+    }
 
  public:
-    SolarSystemLoader(Universe* u,
-                      ProgressNotifier* pn,
-                      const vector<fs::path>& skip) :
-        universe(u),
-        notifier(pn),
-        skip(skip)
+    CatalogQueue(celestia::util::ThreadPool& pool,
+                 const std::string& typeDesc,
+                 ProgressNotifier* pn) :
+        pool       (pool),
+        typeDesc   (typeDesc),
+        notifier   (pn)
     {
     }
 
-    void process(const fs::path& filepath)
+    // Queue a catalog file listed in the configuration file.
+    void add(const fs::path& filepath)
     {
-        if (DetermineFileType(filepath) != Content_CelestiaCatalog)
-            return;
+        if (!filepath.empty())
+            enqueue(filepath, fs::path(), false);
+    }
 
-        if (find(begin(skip), end(skip), filepath) != end(skip))
+    // Queue the catalogs of the given type from a list of extras files.
+    void addExtras(const vector<fs::path>& files,
+                   ContentType contentType,
+                   const vector<fs::path>& skip)
+    {
+        for (const auto& filepath : files)
         {
-            GetLogger()->info(_("Skipping solar system catalog: {}\n"), filepath);
-            return;
+            if (DetermineFileType(filepath) != contentType)
+                continue;
+
+            if (find(begin(skip), end(skip), filepath) != end(skip))
+            {
+                GetLogger()->info(_("Skipping {} catalog: {}\n"), typeDesc, filepath);
+                continue;
+            }
+
+            enqueue(filepath, filepath.parent_path(), true);
         }
-        GetLogger()->info(_("Loading solar system catalog: {}\n"), filepath);
-        if (notifier != nullptr)
-            notifier->update(filepath.filename().string());
+    }
 
-        ifstream solarSysFile(filepath, ios::in);
-        if (solarSysFile.good())
+    // Load the queued catalogs in order, waiting for each one to be
+    // tokenized if necessary.
+    template<typename F> void load(F&& loadCatalog)
+    {
+        for (auto& entry : entries)
         {
-            LoadSolarSystemObjects(solarSysFile,
-                                   *universe,
-                                   filepath.parent_path());
+            if (entry.isExtra)
+                GetLogger()->info(_("Loading {} catalog: {}\n"), typeDesc, entry.filepath);
+            if (notifier != nullptr)
+            {
+                notifier->update(entry.isExtra ? entry.filepath.filename().string()
+                                               : entry.filepath.string());
+            }
+
+            std::unique_ptr<Tokenizer> tokenizer = entry.tokens.get();
+            if (tokenizer == nullptr)
+                GetLogger()->error(_("Error opening {} catalog {}\n"), typeDesc, entry.filepath);
+            else if (!loadCatalog(*tokenizer, entry.resourcePath))
+                GetLogger()->error(_("Error reading {} catalog file: {}\n"), typeDesc, entry.filepath);
         }
+
+        entries.clear();
     }
 };
 
-template <class OBJDB> class CatalogLoader
+namespace
 {
-    OBJDB*      objDB;
-    string      typeDesc;
-    ContentType contentType;
-    ProgressNotifier* notifier;
-    const vector<fs::path>& skip;
 
- public:
-    CatalogLoader(OBJDB* db,
-                  const std::string& typeDesc,
-                  const ContentType& contentType,
-                  ProgressNotifier* pn,
-                  const vector<fs::path>& skip) :
-        objDB      (db),
-        typeDesc   (typeDesc),
-        contentType(contentType),
-        notifier   (pn),
-        skip       (skip)
-    {
-    }
-
-    void process(const fs::path& filepath)
+// List the files in the extras directories: each directory is traversed
+// recursively and its files sorted, directories are kept in the given order.
+vector<fs::path> listExtrasFiles(const vector<fs::path>& extrasDirs)
+{
+    vector<fs::path> files;
+    for (const auto& dir : extrasDirs)
     {
-        if (DetermineFileType(filepath) != contentType)
-            return;
-
-        if (find(begin(skip), end(skip), filepath) != end(skip))
-        {
-            GetLogger()->info(_("Skipping {} catalog: {}\n"), typeDesc, filepath);
-            return;
-        }
-        GetLogger()->info(_("Loading {} catalog: {}\n"), typeDesc, filepath);
-        if (notifier != nullptr)
-            notifier->update(filepath.filename().string());
+        if (!is_valid_directory(dir))
+            continue;
 
-        ifstream catalogFile(filepath, ios::in);
-        if (catalogFile.good())
+        auto first = files.size();
+        std::error_code ec;
+        auto iter = fs::recursive_directory_iterator(dir, ec);
+        for (; iter != end(iter); iter.increment(ec))
         {
-            if (!objDB->load(catalogFile, filepath.parent_path()))
-                GetLogger()->error(_("Error reading {} catalog file: {}\n"), typeDesc, filepath);
+            if (ec)
+                continue;
+            if (!fs::is_directory(iter->path(), ec))
+                files.push_back(iter->path());
         }
+        std::sort(files.begin() + first, files.end());
     }
-};
 
-using StarLoader = CatalogLoader<StarDatabase>;
-using DeepSkyLoader = CatalogLoader<DSODatabase>;
+    return files;
+}
+
+} // end unnamed namespace
 
 
 bool CelestiaCore::initSimulation(const fs::path& configFileName,
@@ -3822,7 +3906,45 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
 
     /***** Load star catalogs *****/
 
-    if (!readStars(*config, progressNotifier))
+    // Queue the catalogs before anything else is read, so that the worker
+    // threads can tokenize them while the binary star database is loaded.
+    celestia::util::ThreadPool loaderPool;
+    vector<fs::path> extrasFiles = listExtrasFiles(config->extrasDirs);
+
+    CatalogQueue starCatalogs(loaderPool, "star", progressNotifier);
+    for (const auto& file : config->starCatalogFiles)
+        starCatalogs.add(file);
+    starCatalogs.addExtras(extrasFiles, Content_CelestiaStarCatalog, config->skipExtras);
+
+    CatalogQueue dsoCatalogs(loaderPool, "deep sky object", progressNotifier);
+    for (const auto& file : config->dsoCatalogFiles)
+        dsoCatalogs.add(file);
+    dsoCatalogs.addExtras(extrasFiles, Content_CelestiaDeepSkyCatalog, config->skipExtras);
+
+    CatalogQueue solarSystemCatalogs(loaderPool, "solar system", progressNotifier);
+    for (const auto& file : config->solarSystemFiles)
+        solarSystemCatalogs.add(file);
+    solarSystemCatalogs.addExtras(extrasFiles, Content_CelestiaCatalog, config->skipExtras);
+
+    // The boundaries are owned by the task result until they're handed to
+    // the universe, so that they aren't leaked if loading fails before.
+    std::future<std::unique_ptr<ConstellationBoundaries>> boundaries;
+    if (!config->boundariesFile.empty())
+    {
+        boundaries = loaderPool.submit([&boundariesFile = config->boundariesFile]
+        {
+            ifstream in(boundariesFile, ios::in);
+            if (!in.good())
+            {
+                GetLogger()->error(_("Error opening constellation boundaries file {}.\n"),
+                                   boundariesFile);
+                return std::unique_ptr<ConstellationBoundaries>();
+            }
+            return std::unique_ptr<ConstellationBoundaries>(ReadBoundaries(in));
+        });
+    }
+
+    if (!readStars(*config, progressNotifier, loaderPool, starCatalogs))
     {
         fatalError(_("Cannot read star database."), false);
         return false;
@@ -3835,102 +3957,25 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
     DSODatabase*     dsoDB      = new DSODatabase;
     dsoDB->setNameDatabase(dsoNameDB);
 
-    // Load first the vector of dsoCatalogFiles in the data directory (deepsky.dsc, globulars.dsc,...):
-
-    for (const auto& file : config->dsoCatalogFiles)
+    // The catalogs listed in the config file (deepsky.dsc, globulars.dsc,...)
+    // come first, followed by the deep sky files in the extras directories.
+    dsoCatalogs.load([dsoDB](Tokenizer& tokenizer, const fs::path& resourcePath)
     {
-        if (progressNotifier)
-            progressNotifier->update(file.string());
-
-        ifstream dsoFile(file, ios::in);
-        if (!dsoFile.good())
-        {
-            GetLogger()->error(_("Error opening deepsky catalog file {}.\n"), file);
-        }
-        if (!dsoDB->load(dsoFile, ""))
-        {
-            GetLogger()->error(_("Cannot read Deep Sky Objects database {}.\n"), file);
-        }
-    }
-
-    // Next, read all the deep sky files in the extras directories
-    {
-        vector<fs::path> entries;
-        DeepSkyLoader loader(dsoDB, "deep sky object",
-                             Content_CelestiaDeepSkyCatalog,
-                             progressNotifier,
-                             config->skipExtras);
-        for (const auto& dir : config->extrasDirs)
-        {
-            if (!is_valid_directory(dir))
-                continue;
-
-            entries.clear();
-            std::error_code ec;
-            auto iter = fs::recursive_directory_iterator(dir, ec);
-            for (; iter != end(iter); iter.increment(ec))
-            {
-                if (ec)
-                    continue;
-                if (!fs::is_directory(iter->path(), ec))
-                    entries.push_back(iter->path());
-            }
-            std::sort(begin(entries), end(entries));
-            for (const auto& fn : entries)
-                loader.process(fn);
-        }
-    }
+        return dsoDB->load(tokenizer, resourcePath);
+    });
     dsoDB->finish();
     universe->setDSOCatalog(dsoDB);
 
 
     /***** Load the solar system catalogs *****/
     // First read the solar system files listed individually in the
-    // config file.
-    {
-        SolarSystemCatalog* solarSystemCatalog = new SolarSystemCatalog();
-        universe->setSolarSystemCatalog(solarSystemCatalog);
-        for (const auto& file : config->solarSystemFiles)
-        {
-            if (progressNotifier)
-                progressNotifier->update(file.string());
-
-            ifstream solarSysFile(file, ios::in);
-            if (!solarSysFile.good())
-            {
-                GetLogger()->error(_("Error opening solar system catalog {}.\n"), file);
-            }
-            else
-            {
-                LoadSolarSystemObjects(solarSysFile, *universe);
-            }
-        }
-    }
-
-    // Next, read all the solar system files in the extras directories
+    // config file, then the ones in the extras directories.
+    SolarSystemCatalog* solarSystemCatalog = new SolarSystemCatalog();
+    universe->setSolarSystemCatalog(solarSystemCatalog);
+    solarSystemCatalogs.load([this](Tokenizer& tokenizer, const fs::path& resourcePath)
     {
-        vector<fs::path> entries;
-        SolarSystemLoader loader(universe, progressNotifier, config->skipExtras);
-        for (const auto& dir : config->extrasDirs)
-        {
-            if (!is_valid_directory(dir))
-                continue;
-
-            entries.clear();
-            std::error_code ec;
-            auto iter = fs::recursive_directory_iterator(dir, ec);
-            for (; iter != end(iter); iter.increment(ec))
-            {
-                if (ec)
-                    continue;
-                if (!fs::is_directory(iter->path(), ec))
-                    entries.push_back(iter->path());
-            }
-            sort(begin(entries), end(entries));
-            for(const auto& fn : entries)
-                loader.process(fn);
-        }
-    }
+        return LoadSolarSystemObjects(tokenizer, *universe, resourcePath);
+    });
 
     // Load asterisms:
     if (!config->asterismsFile.empty())
@@ -3949,20 +3994,8 @@ bool CelestiaCore::initSimulation(const fs::path& configFileName,
         }
     }
 
-    if (!config->boundariesFile.empty())
-    {
-        ifstream boundariesFile(config->boundariesFile, ios::in);
-        if (!boundariesFile.good())
-        {
-            GetLogger()->error(_("Error opening constellation boundaries file {}.\n"),
-                               config->boundariesFile);
-        }
-        else
-        {
-            ConstellationBoundaries* boundaries = ReadBoundaries(boundariesFile);
-            universe->setBoundaries(boundaries);
-        }
-    }
+    if (boundaries.valid())
+        universe->setBoundaries(boundaries.get().release());
 
     // Load destinations list
     if (!config->destinationsFile.empty())
@@ -4084,6 +4117,21 @@ bool CelestiaCore::initRenderer()
     detailOptions.orbitWindowEnd = config->orbitWindowEnd;
     detailOptions.orbitPeriodsShown = config->orbitPeriodsShown;
     detailOptions.linearFadeFraction = config->linearFadeFraction;
+    detailOptions.cullingThreads = config->cullingThreads;
+    detailOptions.staticStarBuffer = config->staticStarBuffer;
+    detailOptions.orbitSamplingThreads = config->orbitSamplingThreads;
+    detailOptions.orbitCacheSize = static_cast<std::size_t>(config->orbitCacheMemory) * 1024 * 1024;
+
+    VirtualTexture::setMemoryBudget(static_cast<std::size_t>(config->virtualTextureMemory) * 1024 * 1024);
+    VirtualTexture::setBackgroundLoading(config->virtualTextureBackgroundLoading);
+    GeometryInfo::setReorderMeshes(config->reorderModelMeshes);
+
+    if (config->resourceLoadingThreads > 0)
+    {
+        resourceLoaderPool = std::make_unique<celestia::util::ThreadPool>(config->resourceLoadingThreads);
+        GetTextureManager()->setLoaderPool(resourceLoaderPool.get());
+        GetGeometryManager()->setLoaderPool(resourceLoaderPool.get());
+    }
 
     // Prepare the scene for rendering.
     if (!renderer->init((int) width, (int) height, detailOptions))
@@ -4149,22 +4197,29 @@ static void loadCrossIndex(StarDatabase* starDB,
 
 
 bool CelestiaCore::readStars(const CelestiaConfig& cfg,
-                             ProgressNotifier* progressNotifier)
+                             ProgressNotifier* progressNotifier,
+                             celestia::util::ThreadPool& loaderPool,
+                             CatalogQueue& starCatalogs)
 {
     StarDetails::SetStarTextures(cfg.starTextures);
 
-    StarNameDatabase* starNameDB = nullptr;
-    ifstream starNamesFile(cfg.starNamesFile, ios::in);
-    if (starNamesFile.good())
+    // The star names are read while the binary database is being loaded.
+    auto starNames = loaderPool.submit([&starNamesFile = cfg.starNamesFile]
     {
-        starNameDB = StarNameDatabase::readNames(starNamesFile);
-        if (starNameDB == nullptr)
-            GetLogger()->error(_("Error reading star names file\n"));
-    }
-    else
-    {
-        GetLogger()->error(_("Error opening {}\n"), cfg.starNamesFile);
-    }
+        StarNameDatabase* starNameDB = nullptr;
+        ifstream in(starNamesFile, ios::in);
+        if (in.good())
+        {
+            starNameDB = StarNameDatabase::readNames(in);
+            if (starNameDB == nullptr)
+                GetLogger()->error(_("Error reading star names file\n"));
+        }
+        else
+        {
+            GetLogger()->error(_("Error opening {}\n"), starNamesFile);
+        }
+        return starNameDB;
+    });
 
     // First load the binary star database file.  The majority of stars
     // will be defined here.
@@ -4174,24 +4229,25 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
         if (progressNotifier)
             progressNotifier->update(cfg.starDatabaseFile.string());
 
-        ifstream starFile(cfg.starDatabaseFile, ios::in | ios::binary);
-        if (!starFile.good())
+        std::error_code ec;
+        if (!fs::is_regular_file(cfg.starDatabaseFile, ec))
         {
             GetLogger()->error(_("Error opening {}\n"), cfg.starDatabaseFile);
             delete starDB;
-            delete starNameDB;
+            delete starNames.get();
             return false;
         }
 
-        if (!starDB->loadBinary(starFile))
+        if (!starDB->loadBinary(cfg.starDatabaseFile))
         {
             GetLogger()->error(_("Error reading stars file\n"));
             delete starDB;
-            delete starNameDB;
+            delete starNames.get();
             return false;
         }
     }
 
+    StarNameDatabase* starNameDB = starNames.get();
     if (starNameDB == nullptr)
         starNameDB = new StarNameDatabase();
     starDB->setNameDatabase(starNameDB);
@@ -4201,47 +4257,11 @@ bool CelestiaCore::readStars(const CelestiaConfig& cfg,
     loadCrossIndex(starDB, StarDatabase::Gliese,      cfg.GlieseCrossIndexFile);
 
     // Next, read any ASCII star catalog files specified in the StarCatalogs
-    // list.
-    for (const auto& file : config->starCatalogFiles)
+    // list, then the supplemental star files from the extras directories.
+    starCatalogs.load([starDB](Tokenizer& tokenizer, const fs::path& resourcePath)
     {
-        if (file.empty())
-            continue;
-
-        ifstream starFile(file, ios::in);
-        if (starFile.good())
-            starDB->load(starFile);
-        else
-            GetLogger()->error(_("Error opening star catalog {}\n"), file);
-    }
-
-    // Now, read supplemental star files from the extras directories
-    {
-        vector<fs::path> entries;
-        StarLoader loader(starDB,
-                          "star",
-                          Content_CelestiaStarCatalog,
-                          progressNotifier,
-                          config->skipExtras);
-        for (const auto& dir : config->extrasDirs)
-        {
-            if (!is_valid_directory(dir))
-                continue;
-
-            entries.clear();
-            std::error_code ec;
-            auto iter = fs::recursive_directory_iterator(dir, ec);
-            for (; iter != end(iter); iter.increment(ec))
-            {
-                if (ec)
-                    continue;
-                if (!fs::is_directory(iter->path(), ec))
-                    entries.push_back(iter->path());
-            }
-            std::sort(begin(entries), end(entries));
-            for (const auto& fn : entries)
-                loader.process(fn);
-        }
-    }
+        return starDB->load(tokenizer, resourcePath);
+    });
 
     starDB->finish();
 
@@ -4491,12 +4511,24 @@ void CelestiaCore::setOverlayElements(int _overlayElements)
 void CelestiaCore::initMovieCapture(MovieCapture* mc)
 {
     if (movieCapture == nullptr)
+    {
         movieCapture = mc;
+    }
+    else if (movieCaptureEnding && pendingMovieCapture == nullptr)
+    {
+        // The next draw() ends the previous capture and switches to this one
+        pendingMovieCapture = mc;
+    }
+    else
+    {
+        GetLogger()->error(_("A movie capture is already active.\n"));
+        delete mc;
+    }
 }
 
 void CelestiaCore::recordBegin()
 {
-    if (movieCapture != nullptr)
+    if (movieCapture != nullptr && !movieCaptureEnding)
     {
         recording = true;
         movieCapture->recordingStatus(true);
@@ -4509,20 +4541,39 @@ void CelestiaCore::recordPause()
     if (movieCapture != nullptr) movieCapture->recordingStatus(false);
 }
 
+// The capture is only ended by the next call to draw(), as reading the last
+// frames requires the OpenGL context.
 void CelestiaCore::recordEnd()
 {
     if (movieCapture != nullptr)
     {
         recordPause();
-        movieCapture->end();
-        delete movieCapture;
-        movieCapture = nullptr;
+        movieCaptureEnding = true;
+    }
+}
+
+// Must be called with the OpenGL context current, so that the frames still
+// being read are written.
+void CelestiaCore::finishMovieCapture()
+{
+    recording = false;
+    for (MovieCapture* mc : { movieCapture, pendingMovieCapture })
+    {
+        if (mc != nullptr)
+        {
+            mc->end();
+            delete mc;
+        }
     }
+
+    movieCapture = nullptr;
+    pendingMovieCapture = nullptr;
+    movieCaptureEnding = false;
 }
 
 bool CelestiaCore::isCaptureActive()
 {
-    return movieCapture != nullptr;
+    return (movieCapture != nullptr && !movieCaptureEnding) || pendingMovieCapture != nullptr;
 }
 
 bool CelestiaCore::isRecording()
@@ -43,6 +43,7 @@
 #include <celscript/common/scriptmaps.h>
 
 class Url;
+class CatalogQueue;
 // class CelestiaWatcher;
 class CelestiaCore;
 // class astro::Date;
@@ -54,6 +55,10 @@ class TextPrintPosition;
 #ifdef USE_MINIAUDIO
 class AudioSession;
 #endif
+namespace util
+{
+class ThreadPool;
+}
 }
 
 typedef Watcher<CelestiaCore> CelestiaWatcher;
@@ -243,6 +248,7 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     void draw();
     void draw(View*);
     void tick();
+    void tick(double dt);
 
     Simulation* getSimulation() const;
     Renderer* getRenderer() const;
@@ -278,6 +284,7 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     void recordBegin();
     void recordPause();
     void recordEnd();
+    void finishMovieCapture();
     bool isCaptureActive();
     bool isRecording();
 
@@ -415,8 +422,10 @@ class CelestiaCore // : public Watchable<CelestiaCore>
     TemperatureScale getTemperatureScale() const;
 
  protected:
-    bool readStars(const CelestiaConfig&, ProgressNotifier*);
+    bool readStars(const CelestiaConfig&, ProgressNotifier*,
+                   celestia::util::ThreadPool&, CatalogQueue&);
     void renderOverlay();
+    void advance(double dt);
 #ifdef CELX
     bool initLuaHook(ProgressNotifier*);
 #endif // CELX
@@ -450,6 +459,9 @@ class CelestiaCore // : public Watchable<CelestiaCore>
 
     std::unique_ptr<OverlayImage> image;
 
+    // Worker threads loading textures and models in the background
+    std::unique_ptr<celestia::util::ThreadPool> resourceLoaderPool;
+
     std::string typedText;
     std::vector<std::string> typedTextCompletion;
     int typedTextCompletionIdx{ -1 };
@@ -512,6 +524,11 @@ class CelestiaCore // : public Watchable<CelestiaCore>
 
     MovieCapture* movieCapture{ nullptr };
     bool recording{ false };
+    // The capture is ended by the next draw(), where the OpenGL context
+    // is current
+    bool movieCaptureEnding{ false };
+    // Capture started while the previous one was ending
+    MovieCapture* pendingMovieCapture{ nullptr };
 
 #ifdef USE_MINIAUDIO
     std::map<int, std::shared_ptr<celestia::AudioSession>> audioSessions;
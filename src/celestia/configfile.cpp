@@ -132,6 +132,17 @@ CelestiaConfig* ReadCelestiaConfig(const fs::path& filename, CelestiaConfig *con
     config->orbitPathSamplePoints = getUint(configParams, "OrbitPathSamplePoints", 100);
     config->shadowTextureSize = getUint(configParams, "ShadowTextureSize", 256);
     config->eclipseTextureSize = getUint(configParams, "EclipseTextureSize", 128);
+    config->cullingThreads = getUint(configParams, "CullingThreads", 1);
+    config->staticStarBuffer = false;
+    configParams->getBoolean("StaticStarVertexBuffer", config->staticStarBuffer);
+    config->virtualTextureMemory = getUint(configParams, "VirtualTextureMemory", 256);
+    config->virtualTextureBackgroundLoading = true;
+    configParams->getBoolean("VirtualTextureBackgroundLoading", config->virtualTextureBackgroundLoading);
+    config->resourceLoadingThreads = getUint(configParams, "ResourceLoadingThreads", 0);
+    config->orbitSamplingThreads = getUint(configParams, "OrbitSamplingThreads", 1);
+    config->orbitCacheMemory = getUint(configParams, "OrbitCacheMemory", 64);
+    config->reorderModelMeshes = false;
+    configParams->getBoolean("ReorderModelMeshes", config->reorderModelMeshes);
 
     config->consoleLogRows = getUint(configParams, "LogSize", 200);
 
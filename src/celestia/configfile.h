@@ -64,6 +64,22 @@ public:
     unsigned int shadowTextureSize;
     unsigned int eclipseTextureSize;
     unsigned int orbitPathSamplePoints;
+    unsigned int cullingThreads;
+    bool staticStarBuffer;
+    // Texture memory budget of each virtual texture, in MiB
+    unsigned int virtualTextureMemory;
+    // Load virtual texture tiles in the background
+    bool virtualTextureBackgroundLoading;
+    // Number of threads loading textures and models in the background;
+    // zero to load them when they are first used
+    unsigned int resourceLoadingThreads;
+    // Number of threads sampling orbit paths in the background; zero to
+    // sample them when they are first drawn
+    unsigned int orbitSamplingThreads;
+    // Memory budget of the sampled orbit paths, in MiB
+    unsigned int orbitCacheMemory;
+    // Reorder the triangles of cmod models for the vertex cache
+    bool reorderModelMeshes;
 
     unsigned int aaSamples;
 
@@ -10,20 +10,34 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
-#include <cstring>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <unordered_set>
+#include <vector>
 
 #include <Eigen/Geometry>
 
 #include <celengine/body.h>
+#include <celengine/frame.h>
+#include <celengine/selection.h>
+#include <celengine/timeline.h>
+#include <celengine/timelinephase.h>
+#include <celephem/orbit.h>
+#include <celephem/rotation.h>
 #include <celmath/distance.h>
-#include <celmath/ray.h>
+#include <celutil/threadpool.h>
 #include "eclipsefinder.h"
 
 using namespace Eigen;
 using namespace std;
 using namespace celmath;
 
+namespace
+{
 
 constexpr const double dT = 1.0 / (24.0 * 60.0);
 constexpr const int EclipseObjectMask = Body::Planet      |
@@ -33,175 +47,370 @@ constexpr const int EclipseObjectMask = Body::Planet      |
                                         Body::Asteroid;
 
 // TODO: share this constant and function with render.cpp
-static const float MinRelativeOccluderRadius = 0.005f;
+constexpr const double MinRelativeOccluderRadius = 0.005;
 
-EclipseFinder::EclipseFinder(Body* _body,
-                             EclipseFinderWatcher* _watcher) :
-    body(_body),
-    watcher(_watcher)
+// Largest step of the search for bodies with non-periodic orbits, and the
+// step used when the geometry doesn't tell how far the next eclipse is.
+constexpr const double SearchStep = 1.0 / 24.0; // one hour
+
+// Precision of eclipse duration calculation
+constexpr const double DurationPrecision = 1.0 / (24.0 * 360.0); // ten seconds
+
+// The rate at which the receiver approaches the edge of the shadow is
+// estimated from the velocities at the start of a step; the estimate is
+// scaled by this factor to account for changes of velocity during the step.
+constexpr const double RateSafetyFactor = 2.0;
+
+// Time span searched by a single task
+constexpr const double TaskSpan = 30.0;
+
+// Interval between the positions of the primary body stored by a track
+constexpr const double TrackStep = 0.25;
+
+// Time between progress updates when searching on worker threads
+constexpr const std::chrono::milliseconds ProgressInterval{ 50 };
+
+
+// Ignore situations where the shadow casting body is much smaller than
+// the receiver, as these shadows aren't likely to be relevant.  Also,
+// ignore eclipses where the caster is not an ellipsoid, since we can't
+// generate correct shadows in this case.
+bool canCastShadow(const Body& receiver, const Body& caster)
 {
+    return caster.getRadius() >= receiver.getRadius() * MinRelativeOccluderRadius &&
+           caster.isEllipsoid();
 }
 
 
-bool testEclipse(const Body& receiver, const Body& caster, double now)
+// Astrocentric positions of the body whose satellites are searched for
+// eclipses. Planetary theories are much more expensive to evaluate than
+// the orbits of satellites, so the positions are evaluated at regular times
+// over the span of a task, and interpolated in between; the error is far
+// below the precision of the search.
+class PrimaryTrack
 {
-    // Ignore situations where the shadow casting body is much smaller than
-    // the receiver, as these shadows aren't likely to be relevant.  Also,
-    // ignore eclipses where the caster is not an ellipsoid, since we can't
-    // generate correct shadows in this case.
-    if (caster.getRadius() >= receiver.getRadius() * MinRelativeOccluderRadius &&
-        caster.isEllipsoid())
+ public:
+    PrimaryTrack(const Body& _body, double _startTime, double endTime) :
+        body(_body),
+        startTime(_startTime - TrackStep)
+    {
+        auto nPositions = static_cast<std::size_t>(std::ceil((endTime - _startTime) / TrackStep)) + 4;
+        positions.reserve(nPositions);
+        for (std::size_t i = 0; i < nPositions; i++)
+            positions.push_back(body.getAstrocentricPosition(startTime + i * TrackStep));
+    }
+
+    const Body& getBody() const { return body; }
+
+    Vector3d position(double t) const
     {
-        // All of the eclipse related code assumes that both the caster
-        // and receiver are spherical.  Irregular receivers will work more
-        // or less correctly, but casters that are sufficiently non-spherical
-        // will produce obviously incorrect shadows.  Another assumption we
-        // make is that the distance between the caster and receiver is much
-        // less than the distance between the sun and the receiver.  This
-        // approximation works everywhere in the solar system, and likely
-        // works for any orbitally stable pair of objects orbiting a star.
-        Vector3d posReceiver = receiver.getAstrocentricPosition(now);
-        Vector3d posCaster = caster.getAstrocentricPosition(now);
-
-        const Star* sun = receiver.getSystem()->getStar();
-        assert(sun != nullptr);
-        double distToSun = posReceiver.norm();
-        float appSunRadius = (float) (sun->getRadius() / distToSun);
-
-        Vector3d dir = posCaster - posReceiver;
-        double distToCaster = dir.norm() - receiver.getRadius();
-        float appOccluderRadius = (float) (caster.getRadius() / distToCaster);
-
-        // The shadow radius is the radius of the occluder plus some additional
-        // amount that depends upon the apparent radius of the sun.  For
-        // a sun that's distant/small and effectively a point, the shadow
-        // radius will be the same as the radius of the occluder.
-        float shadowRadius = (1 + appSunRadius / appOccluderRadius) *
-            caster.getRadius();
-
-        // Test whether a shadow is cast on the receiver.  We want to know
-        // if the receiver lies within the shadow volume of the caster.  Since
-        // we're assuming that everything is a sphere and the sun is far
-        // away relative to the caster, the shadow volume is a
-        // cylinder capped at one end.  Testing for the intersection of a
-        // singly capped cylinder is as simple as checking the distance
-        // from the center of the receiver to the axis of the shadow cylinder.
-        // If the distance is less than the sum of the caster's and receiver's
-        // radii, then we have an eclipse.
-        float R = receiver.getRadius() + shadowRadius;
-        double dist = distance(posReceiver, Eigen::ParametrizedLine<double, 3>(posCaster, posCaster));
-        if (dist < R)
+        double x = (t - startTime) / TrackStep;
+        double i = std::floor(x);
+        if (i < 1.0 || i + 2.0 >= static_cast<double>(positions.size()))
+            return body.getAstrocentricPosition(t);
+
+        // Cubic Lagrange interpolation between positions k and k + 1
+        auto k = static_cast<std::size_t>(i);
+        double u = x - i;
+        double w0 = -u * (u - 1.0) * (u - 2.0) / 6.0;
+        double w1 = (u + 1.0) * (u - 1.0) * (u - 2.0) / 2.0;
+        double w2 = -(u + 1.0) * u * (u - 2.0) / 2.0;
+        double w3 = (u + 1.0) * u * (u - 1.0) / 6.0;
+        return w0 * positions[k - 1] + w1 * positions[k] + w2 * positions[k + 1] + w3 * positions[k + 2];
+    }
+
+ private:
+    const Body& body;
+    double startTime;
+    std::vector<Vector3d> positions;
+};
+
+
+// A satellite of the primary body, and the kind of eclipse searched
+struct SearchTarget
+{
+    const Body* satellite;
+    // Solar eclipses are cast by the satellite on the primary body, lunar
+    // eclipses by the primary body on the satellite.
+    Eclipse::Type type;
+    // Largest time step of the search
+    double maxStep;
+};
+
+
+// State of a receiver relative to the shadow of a caster at some time
+struct ShadowSample
+{
+    // Distance from the receiver to the edge of the shadow, negative when
+    // the receiver is in the shadow
+    double margin;
+    // Upper bound of the rate of change of the margin
+    double rate;
+    bool eclipsed;
+};
+
+
+// Finds the eclipses of a receiver by a caster. The search steps through
+// time, choosing each step so that the receiver can't reach the shadow
+// before the next sample, which skips the spans where no eclipse is
+// possible, and then brackets the start and end of each eclipse.
+class EclipseSearch
+{
+ public:
+    EclipseSearch(const PrimaryTrack& _primary, const SearchTarget& _target) :
+        primary(_primary),
+        target(_target),
+        receiver(_target.type == Eclipse::Solar ? _primary.getBody() : *_target.satellite),
+        caster(_target.type == Eclipse::Solar ? *_target.satellite : _primary.getBody())
+    {
+    }
+
+    // Find the eclipses which are in progress between startDate and
+    // endDate. Unless keepEarlier is set, eclipses which started before
+    // startDate are omitted.
+    void find(double startDate, double endDate, bool keepEarlier,
+              vector<Eclipse>& eclipses,
+              const atomic<bool>& aborted) const;
+
+ private:
+    void getPositions(double t, Vector3d& posReceiver, Vector3d& posCaster) const;
+    double shadowMargin(const Vector3d& posReceiver, const Vector3d& posCaster, bool& eclipsed) const;
+    bool isEclipsed(double t) const;
+    ShadowSample sample(double t) const;
+    double nextStep(const ShadowSample&) const;
+    double findEdge(double t, const ShadowSample&, double direction) const;
+    double bisect(double clear, double shadowed) const;
+
+    const PrimaryTrack& primary;
+    const SearchTarget& target;
+    const Body& receiver;
+    const Body& caster;
+};
+
+
+void
+EclipseSearch::find(double startDate, double endDate, bool keepEarlier,
+                    vector<Eclipse>& eclipses,
+                    const atomic<bool>& aborted) const
+{
+    double t = startDate;
+    ShadowSample s = sample(t);
+    double lastClear = t;
+    bool hasLastClear = false;
+
+    for (;;)
+    {
+        if (aborted.load(memory_order_relaxed))
+            return;
+
+        if (s.eclipsed)
         {
-            // Ignore "eclipses" where the caster and receiver have
-            // intersecting bounding spheres.
-            if (distToCaster > caster.getRadius())
-                return true;
+            double start = hasLastClear ? bisect(lastClear, t) : findEdge(t, s, -1.0);
+            double end = findEdge(t, s, 1.0);
+            if (keepEarlier || start >= startDate)
+            {
+                Eclipse& eclipse = eclipses.emplace_back();
+                eclipse.startTime = start;
+                eclipse.endTime = end;
+                eclipse.receiver = const_cast<Body*>(&receiver);
+                eclipse.occulter = const_cast<Body*>(&caster);
+            }
+
+            t = end;
+            s = sample(t);
         }
-    }
 
-    return false;
+        if (t >= endDate)
+            break;
+
+        lastClear = t;
+        hasLastClear = true;
+        t = min(t + nextStep(s), endDate);
+        s = sample(t);
+    }
 }
 
-#if 1
-double findEclipseSpan(const Body& receiver, const Body& caster,
-                       double now, double dt)
+
+void
+EclipseSearch::getPositions(double t, Vector3d& posReceiver, Vector3d& posCaster) const
 {
-    double t = now;
-    while (testEclipse(receiver, caster, t))
-        t += dt;
+    Vector3d posPrimary = primary.position(t);
+
+    // Compute the position of the satellite relative to the primary body
+    // when the satellite orbits it, so that it doesn't depend on the
+    // precision of the primary track.
+    Vector3d posSatellite;
+    const TimelinePhase& phase = *target.satellite->getTimeline()->findPhase(t);
+    const ReferenceFrame& frame = *phase.orbitFrame();
+    if (frame.getCenter().body() == &primary.getBody())
+        posSatellite = posPrimary + frame.getOrientation(t).conjugate() * phase.orbit()->positionAtTime(t);
+    else
+        posSatellite = target.satellite->getAstrocentricPosition(t);
+
+    if (target.type == Eclipse::Solar)
+    {
+        posReceiver = posPrimary;
+        posCaster = posSatellite;
+    }
+    else
+    {
+        posReceiver = posSatellite;
+        posCaster = posPrimary;
+    }
+}
 
-    return t;
+
+double
+EclipseSearch::shadowMargin(const Vector3d& posReceiver,
+                            const Vector3d& posCaster,
+                            bool& eclipsed) const
+{
+    // All of the eclipse related code assumes that both the caster
+    // and receiver are spherical.  Irregular receivers will work more
+    // or less correctly, but casters that are sufficiently non-spherical
+    // will produce obviously incorrect shadows.  Another assumption we
+    // make is that the distance between the caster and receiver is much
+    // less than the distance between the sun and the receiver.  This
+    // approximation works everywhere in the solar system, and likely
+    // works for any orbitally stable pair of objects orbiting a star.
+    const Star* sun = receiver.getSystem()->getStar();
+    assert(sun != nullptr);
+    double distToSun = posReceiver.norm();
+    double appSunRadius = sun->getRadius() / distToSun;
+
+    Vector3d dir = posCaster - posReceiver;
+    double distToCaster = dir.norm() - receiver.getRadius();
+    double appOccluderRadius = caster.getRadius() / distToCaster;
+
+    // The shadow radius is the radius of the occluder plus some additional
+    // amount that depends upon the apparent radius of the sun.  For
+    // a sun that's distant/small and effectively a point, the shadow
+    // radius will be the same as the radius of the occluder.
+    double shadowRadius = (1 + appSunRadius / appOccluderRadius) * caster.getRadius();
+
+    // Test whether a shadow is cast on the receiver.  We want to know
+    // if the receiver lies within the shadow volume of the caster.  Since
+    // we're assuming that everything is a sphere and the sun is far
+    // away relative to the caster, the shadow volume is a
+    // cylinder capped at one end.  Testing for the intersection of a
+    // singly capped cylinder is as simple as checking the distance
+    // from the center of the receiver to the axis of the shadow cylinder.
+    // If the distance is less than the sum of the caster's and receiver's
+    // radii, then we have an eclipse.
+    double R = receiver.getRadius() + shadowRadius;
+    double dist = distance(posReceiver, Eigen::ParametrizedLine<double, 3>(posCaster, posCaster));
+
+    // Ignore "eclipses" where the caster and receiver have
+    // intersecting bounding spheres.
+    eclipsed = dist < R && distToCaster > caster.getRadius();
+
+    return dist - R;
 }
-#else
-// Given a time during an eclipse, find the start of the eclipse to
-// a precision of minStep.
-double findEclipseStart(const Body& receiver, const Body& occulter,
-                        double now,
-                        double startStep,
-                        double minStep)
+
+
+bool
+EclipseSearch::isEclipsed(double t) const
 {
-    double step = startStep / 2;
-    double t = now - step;
-    bool eclipsed = true;
+    Vector3d posReceiver;
+    Vector3d posCaster;
+    getPositions(t, posReceiver, posCaster);
 
-    // Perform a binary search to find the end of the eclipse
-    while (step > minStep)
-    {
-        eclipsed = testEclipse(receiver, occulter, t);
-        step *= 0.5;
-        if (eclipsed)
-            t -= step;
-        else
-            t += step;
-    }
+    bool eclipsed;
+    shadowMargin(posReceiver, posCaster, eclipsed);
+    return eclipsed;
+}
 
-    // Always return a time when the receiver is /not/ in eclipse
-    if (eclipsed)
-        t -= step;
 
-    return t;
+ShadowSample
+EclipseSearch::sample(double t) const
+{
+    Vector3d posReceiver;
+    Vector3d posCaster;
+    getPositions(t, posReceiver, posCaster);
+
+    ShadowSample s;
+    s.margin = shadowMargin(posReceiver, posCaster, s.eclipsed);
+
+    // The distance to the shadow axis changes with the velocity of the
+    // receiver relative to the caster, and with the rotation of the axis
+    // as the caster orbits the sun.
+    Vector3d nextPosReceiver;
+    Vector3d nextPosCaster;
+    getPositions(t + dT, nextPosReceiver, nextPosCaster);
+    Vector3d offset = posReceiver - posCaster;
+    double relativeSpeed = ((nextPosReceiver - nextPosCaster) - offset).norm() / dT;
+    double axisRate = (nextPosCaster.normalized() - posCaster.normalized()).norm() / dT;
+    s.rate = RateSafetyFactor * (relativeSpeed + axisRate * offset.norm());
+
+    return s;
 }
 
-// Given a time during an eclipse, find the end of the eclipse to
-// a precision of minStep.
-double findEclipseEnd(const Body& receiver, const Body& occulter,
-                      double now,
-                      double startStep,
-                      double minStep)
+
+// Return the time to the next sample: no longer than the time needed by
+// the receiver to reach the edge of the shadow, but at least a minute, as
+// the edge is then found by bisection.
+double
+EclipseSearch::nextStep(const ShadowSample& s) const
 {
-    // First do a coarse search to find the eclipse end to within the precision
-    // of startStep.
-    while (testEclipse(receiver, occulter, now + startStep))
-        now += startStep;
+    double step;
+    if (!s.eclipsed && s.margin < 0.0)
+        step = SearchStep; // in the shadow, but too close to the caster
+    else if (s.rate > 0.0)
+        step = std::abs(s.margin) / s.rate;
+    else
+        step = target.maxStep;
+
+    return std::clamp(step, dT, target.maxStep);
+}
 
-    double step = startStep / 2;
-    double t = now + step;
-    bool eclipsed = true;
+
+// Given a time during an eclipse, find the start (direction < 0) or end
+// (direction > 0) of the eclipse.
+double
+EclipseSearch::findEdge(double t, const ShadowSample& s, double direction) const
+{
+    double shadowed = t;
+    ShadowSample next = s;
+    for (;;)
+    {
+        double t1 = shadowed + direction * nextStep(next);
+        next = sample(t1);
+        if (!next.eclipsed)
+            return bisect(t1, shadowed);
+        shadowed = t1;
+    }
+}
 
 
-    // Perform a binary search to find the end of the eclipse
-    while (step > minStep)
+// Find the edge of the eclipse between a time when the receiver is not in
+// eclipse and a time when it is, to a precision of DurationPrecision.
+// Always return a time when the receiver is /not/ in eclipse.
+double
+EclipseSearch::bisect(double clear, double shadowed) const
+{
+    while (std::abs(shadowed - clear) > DurationPrecision)
     {
-        eclipsed = testEclipse(receiver, occulter, t);
-        step *= 0.5;
-        if (eclipsed)
-            t += step;
+        double t = (clear + shadowed) * 0.5;
+        if (isEclipsed(t))
+            shadowed = t;
         else
-            t -= step;
+            clear = t;
     }
 
-    // Always return a time when the receiver is /not/ in eclipse
-    if (eclipsed)
-        t += step;
-
-    return t;
+    return clear;
 }
-#endif
 
-void addEclipse(const Body& receiver, const Body& occulter,
-                double now,
-                double /*startStep*/, double /*minStep*/,
-                vector<Eclipse>& eclipses,
-                vector<double>& previousEclipseEndTimes, int i)
+} // end unnamed namespace
+
+
+EclipseFinder::EclipseFinder(Body* _body,
+                             EclipseFinderWatcher* _watcher) :
+    body(_body),
+    watcher(_watcher)
 {
-    if (testEclipse(receiver, occulter, now))
-    {
-        Eclipse eclipse;
-#if 1
-        eclipse.startTime = findEclipseSpan(receiver, occulter, now, -dT);
-        eclipse.endTime = findEclipseSpan(receiver, occulter, now, dT);
-#else
-        eclipse.startTime = findEclipseStart(receiver, occulter, now, searchStep, minStep);
-        eclipse.endTime = findEclipseEnd(receiver, occulter, now, searchStep, minStep);
-#endif
-        eclipse.receiver = const_cast<Body*>(&receiver);
-        eclipse.occulter = const_cast<Body*>(&occulter);
-        eclipses.emplace_back(eclipse);
-
-        previousEclipseEndTimes[i] = eclipse.endTime;
-    }
 }
 
+
 void EclipseFinder::findEclipses(double startDate,
                                  double endDate,
                                  int eclipseTypeMask,
@@ -213,53 +422,92 @@ void EclipseFinder::findEclipses(double startDate,
     if (satellites == nullptr)
         return;
 
-    // For each body, we'll need to store the time when the last eclipse ended
-    vector<double> previousEclipseEndTimes;
-
-    // Make a list of satellites that we'll actually test for eclipses; ignore
-    // spacecraft and very small objects.
-    vector<Body*> testBodies;
+    // Make a list of satellites that we'll actually test for eclipses;
+    // ignore spacecraft and very small objects.
+    vector<SearchTarget> targets;
+    std::unordered_set<const Body*> checkedBodies;
+    bool threadSafe = Selection(body).isThreadSafe(checkedBodies);
     for (int i = 0; i < satellites->getSystemSize(); i++)
     {
         Body* obj = satellites->getBody(i);
-        if ((obj->getClassification() & EclipseObjectMask) != 0 &&
-            obj->getRadius() >= body->getRadius() * MinRelativeOccluderRadius)
+        if ((obj->getClassification() & EclipseObjectMask) == 0 ||
+            obj->getRadius() < body->getRadius() * MinRelativeOccluderRadius)
         {
-            testBodies.push_back(obj);
-            previousEclipseEndTimes.push_back(startDate - 1.0);
+            continue;
         }
+
+        // Limit the steps to a fraction of the orbital period, over which
+        // the velocities used to choose the steps don't change much.
+        double maxStep = SearchStep;
+        const Orbit* orbit = obj->getOrbit(startDate);
+        if (orbit->isPeriodic())
+            maxStep = std::max(orbit->getPeriod() / 16.0, dT);
+
+        if ((eclipseTypeMask & Eclipse::Solar) != 0 && canCastShadow(*body, *obj))
+            targets.push_back({ obj, Eclipse::Solar, maxStep });
+
+        if ((eclipseTypeMask & Eclipse::Lunar) != 0 && canCastShadow(*obj, *body))
+            targets.push_back({ obj, Eclipse::Lunar, maxStep });
+
+        threadSafe = threadSafe && Selection(obj).isThreadSafe(checkedBodies);
     }
 
-    if (testBodies.empty())
+    if (targets.empty())
         return;
 
-    // TODO: Use a fixed step of one hour for now; we should use a binary
-    // search instead.
-    double searchStep = 1.0 / 24.0; // one hour
+    // Split the date range into spans searched by separate tasks. Each task
+    // reports the eclipses starting in its span, and those in progress at
+    // the start date for the first one.
+    double span = endDate - startDate;
+    auto nTasks = static_cast<unsigned int>(std::max(std::ceil(span / TaskSpan), 1.0));
 
-    // Precision of eclipse duration calculation
-    double durationPrecision = 1.0 / (24.0 * 360.0); // ten seconds
-
-    for (double t = startDate; t <= endDate; t += searchStep)
+    atomic<bool> aborted{ false };
+    vector<vector<Eclipse>> results(nTasks);
+    auto search = [&](unsigned int task)
+    {
+        double taskStart = startDate + span * task / nTasks;
+        double taskEnd = task + 1 == nTasks ? endDate : startDate + span * (task + 1) / nTasks;
+        PrimaryTrack primary(*body, taskStart, taskEnd);
+        for (const SearchTarget& target : targets)
+            EclipseSearch(primary, target).find(taskStart, taskEnd, task == 0, results[task], aborted);
+    };
+
+    auto progress = [&](unsigned int tasksDone)
     {
-        if (watcher != nullptr)
+        if (watcher != nullptr &&
+            watcher->eclipseFinderProgressUpdate(startDate + span * tasksDone / nTasks) == EclipseFinderWatcher::AbortOperation)
         {
-            if (watcher->eclipseFinderProgressUpdate(t) == EclipseFinderWatcher::AbortOperation)
-                return;
+            aborted = true;
         }
+    };
 
-        for (unsigned int i = 0; i < testBodies.size(); i++)
-        {
-            // Only test for an eclipse if we're not in the middle of
-            // of previous one.
-            if (t <= previousEclipseEndTimes[i])
-                continue;
-
-            if (eclipseTypeMask & Eclipse::Solar)
-                addEclipse(*body, *testBodies[i], t, searchStep, durationPrecision, eclipses, previousEclipseEndTimes, i);
+    if (threadSafe)
+    {
+        celestia::util::ThreadPool pool;
+        vector<future<void>> tasks;
+        tasks.reserve(nTasks);
+        for (unsigned int task = 0; task < nTasks; task++)
+            tasks.push_back(pool.submit([&search, task] { search(task); }));
 
-            if (eclipseTypeMask & Eclipse::Lunar)
-                addEclipse(*testBodies[i], *body, t, searchStep, durationPrecision, eclipses, previousEclipseEndTimes, i);
+        for (unsigned int task = 0; task < nTasks; task++)
+        {
+            while (tasks[task].wait_for(ProgressInterval) != future_status::ready)
+                progress(task);
+        }
+    }
+    else
+    {
+        for (unsigned int task = 0; task < nTasks && !aborted; task++)
+        {
+            progress(task);
+            search(task);
         }
     }
+
+    size_t first = eclipses.size();
+    for (const vector<Eclipse>& result : results)
+        eclipses.insert(eclipses.end(), result.begin(), result.end());
+
+    stable_sort(eclipses.begin() + first, eclipses.end(),
+                [](const Eclipse& a, const Eclipse& b) { return a.startTime < b.startTime; });
 }
@@ -13,10 +13,18 @@ extern "C"
 #include <libswscale/swscale.h>
 }
 
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <fmt/format.h>
 
+#include <celengine/framereadback.h>
 #include <celengine/pixelformat.h>
 #include <celengine/render.h>
 
@@ -33,8 +41,13 @@ class FFMPEGCapturePrivate
     bool addStream(int w, int h, float fps);
     bool openVideo();
     bool start();
-    bool writeVideoFrame(bool = false);
-    void finish();
+    bool startEncoder();
+    bool captureFrame();
+    bool queueFrame();
+    void encodeFrames();
+    bool encodeFrame(const uint8_t *pixels, int64_t pts);
+    bool sendFrame(AVFrame *);
+    void finish(bool contextCurrent);
     void setVideoCodec(int);
 
     bool isSupportedPixelFormat(enum AVPixelFormat) const;
@@ -43,7 +56,6 @@ class FFMPEGCapturePrivate
 
     AVStream        *st       { nullptr };
     AVFrame         *frame    { nullptr };
-    AVFrame         *tmpfr    { nullptr };
     AVCodecContext  *enc      { nullptr };
     AVFormatContext *oc       { nullptr };
     const AVCodec   *vc       { nullptr };
@@ -54,6 +66,8 @@ class FFMPEGCapturePrivate
 
     // pts of the next frame that will be generated
     int64_t         nextPts   { 0       };
+    // pts of the next frame that will be queued
+    int64_t         queuedPts { 0       };
     // requested bitrate
     int64_t         bit_rate  { 400000  };
 
@@ -66,6 +80,34 @@ class FFMPEGCapturePrivate
     fs::path        filename;
     std::string     vc_options;
 
+    // Frames read before being queued, allowing the GPU to finish them
+    static constexpr int ReadbackBuffers = 3;
+    std::unique_ptr<FrameReadback> readback;
+    // Layout of the frames read, kept for the encoder thread
+    int             stride    { 0       };
+    bool            topDown   { false   };
+
+    struct QueuedFrame
+    {
+        std::vector<uint8_t> pixels;
+        int64_t pts;
+    };
+
+    // Frames waiting for the encoder thread, and pixel buffers for reuse.
+    // Everything below is guarded by mutex.
+    std::deque<QueuedFrame> queue;
+    std::vector<std::vector<uint8_t>> freeBuffers;
+    std::mutex              mutex;
+    std::condition_variable frameQueued;
+    std::condition_variable frameTaken;
+    FFMPEGCapture::Statistics stats;
+    int             maxQueued     { 4       };
+    bool            blockWhenFull { false   };
+    bool            stopEncoder   { false   };
+    bool            encoderFailed { false   };
+
+    std::thread     encoder;
+
  public:
 #if (LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 10, 100)) // ffmpeg < 4.0
     static bool     registered;
@@ -377,24 +419,6 @@ bool FFMPEGCapturePrivate::openVideo()
             cout << "Failed to allocate SWS context\n";
             return false;
         }
-
-        // allocate and init a temporary frame
-        if((tmpfr = av_frame_alloc()) == nullptr)
-        {
-            cout << "Failed to allocate temp frame\n";
-            return false;
-        }
-
-        tmpfr->format = format;
-        tmpfr->width  = enc->width;
-        tmpfr->height = enc->height;
-
-        // allocate the buffers for the frame data
-        if (av_frame_get_buffer(tmpfr, 32) < 0)
-        {
-            cout << "Failed to allocate temp frame buffer\n";
-            return false;
-        }
     }
 
     // copy the stream parameters to the muxer
@@ -407,52 +431,182 @@ bool FFMPEGCapturePrivate::openVideo()
     return true;
 }
 
-static void captureImage(AVFrame *pict, int width, int height, const Renderer *r)
+bool FFMPEGCapturePrivate::startEncoder()
 {
+    encoder = std::thread(&FFMPEGCapturePrivate::encodeFrames, this);
+    return true;
+}
+
+// Read the current frame and queue the oldest frame read. This is the only
+// work done by the render thread while recording.
+bool FFMPEGCapturePrivate::captureFrame()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (encoderFailed)
+            return false;
+    }
+
+    // The readback is created here rather than in start(), as the OpenGL
+    // context is only sure to be current while drawing.
+    if (readback == nullptr)
+    {
+        readback = std::make_unique<FrameReadback>(enc->width, enc->height,
+                                                   renderer->getPreferredCaptureFormat(),
+                                                   ReadbackBuffers);
+        stride = readback->getStride();
+        topDown = readback->isTopDown();
+    }
+
+    if (readback->full() && !queueFrame())
+        return false;
+
     int x, y, w, h;
-    r->getViewport(&x, &y, &w, &h);
+    renderer->getViewport(&x, &y, &w, &h);
+
+    x += (w - enc->width) / 2;
+    y += (h - enc->height) / 2;
+    if (!readback->read(x, y))
+        return false;
 
-    x += (w - width) / 2;
-    y += (h - height) / 2;
-    r->captureFrame(x, y, width, height,
-                    r->getPreferredCaptureFormat(),
-                    pict->data[0]);
+    nextPts++;
+    return true;
 }
 
-// encode one video frame and send it to the muxer
-// return 1 when encoding is finished, 0 otherwise
-bool FFMPEGCapturePrivate::writeVideoFrame(bool finalize)
+// Copy the oldest frame read to the queue, or drop it when the queue is full
+bool FFMPEGCapturePrivate::queueFrame()
 {
-    AVFrame *frame = finalize ? nullptr : this->frame;
-    const int bytesPerPixel = hasAlpha ? 4 : 3;
+    const uint8_t *pixels = readback->map();
+    if (pixels == nullptr)
+    {
+        readback->unmap();
+        return false;
+    }
 
-    // check if we want to generate more frames
-    if (!finalize)
+    const std::size_t size = static_cast<std::size_t>(stride) * enc->height;
+    std::vector<uint8_t> buffer;
     {
-        // when we pass a frame to the encoder, it may keep a reference to it
-        // internally; make sure we do not overwrite it here
-        if (av_frame_make_writable(frame) < 0)
+        std::unique_lock<std::mutex> lock(mutex);
+        if (static_cast<int>(queue.size()) >= maxQueued)
+        {
+            if (!blockWhenFull)
+            {
+                stats.dropped++;
+                queuedPts++;
+                readback->unmap();
+                return true;
+            }
+
+            frameTaken.wait(lock, [this] { return static_cast<int>(queue.size()) < maxQueued || encoderFailed; });
+        }
+
+        // Nothing takes frames from the queue anymore
+        if (encoderFailed)
         {
-            cout << "Failed to make the frame writable\n";
+            readback->unmap();
             return false;
         }
 
-        if (enc->pix_fmt != format)
+        if (!freeBuffers.empty())
         {
-            captureImage(tmpfr, enc->width, enc->height, renderer);
-            // we need to compute the correct line width of our source data
-            const int linesize = bytesPerPixel * enc->width;
-            sws_scale(swsc, tmpfr->data, &linesize, 0, enc->height,
-                      frame->data, frame->linesize);
+            buffer = std::move(freeBuffers.back());
+            freeBuffers.pop_back();
         }
-        else
+    }
+
+    buffer.resize(size);
+    std::memcpy(buffer.data(), pixels, size);
+    readback->unmap();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back({ std::move(buffer), queuedPts++ });
+        stats.queued = static_cast<int>(queue.size());
+        stats.maxQueued = std::max(stats.maxQueued, stats.queued);
+    }
+    frameQueued.notify_one();
+
+    return true;
+}
+
+// Encoder thread: encode the queued frames until stopEncoder is set and the
+// queue is empty
+void FFMPEGCapturePrivate::encodeFrames()
+{
+    for (;;)
+    {
+        QueuedFrame queued;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            frameQueued.wait(lock, [this] { return !queue.empty() || stopEncoder; });
+            if (queue.empty())
+                break;
+
+            queued = std::move(queue.front());
+            queue.pop_front();
+            stats.queued = static_cast<int>(queue.size());
+        }
+        frameTaken.notify_one();
+
+        bool ok = encodeFrame(queued.pixels.data(), queued.pts);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        freeBuffers.push_back(std::move(queued.pixels));
+        if (!ok)
         {
-            captureImage(frame, enc->width, enc->height, renderer);
+            encoderFailed = true;
+            frameTaken.notify_all();
+            break;
         }
+        stats.encoded++;
+    }
+}
+
+// convert one video frame and send it to the encoder
+bool FFMPEGCapturePrivate::encodeFrame(const uint8_t *pixels, int64_t pts)
+{
+    // when we pass a frame to the encoder, it may keep a reference to it
+    // internally; make sure we do not overwrite it here
+    if (av_frame_make_writable(frame) < 0)
+    {
+        cout << "Failed to make the frame writable\n";
+        return false;
+    }
+
+    // OpenGL returns the rows from the bottom of the frame, a negative
+    // line size flips them
+    int linesize = stride;
+    const uint8_t *src = pixels;
+    if (!topDown)
+    {
+        src += static_cast<std::ptrdiff_t>(linesize) * (enc->height - 1);
+        linesize = -linesize;
+    }
 
-        frame->pts = nextPts++;
+    if (enc->pix_fmt != format)
+    {
+        sws_scale(swsc, &src, &linesize, 0, enc->height,
+                  frame->data, frame->linesize);
+    }
+    else
+    {
+        const int bytesPerPixel = hasAlpha ? 4 : 3;
+        for (int row = 0; row < enc->height; row++)
+        {
+            std::memcpy(frame->data[0] + static_cast<std::ptrdiff_t>(frame->linesize[0]) * row,
+                        src + static_cast<std::ptrdiff_t>(linesize) * row,
+                        static_cast<std::size_t>(bytesPerPixel) * enc->width);
+        }
     }
 
+    frame->pts = pts;
+    return sendFrame(frame);
+}
+
+// encode one video frame, or flush the encoder when frame is nullptr, and
+// send the packets to the muxer
+bool FFMPEGCapturePrivate::sendFrame(AVFrame *frame)
+{
 #if (LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 133, 100))
     av_init_packet(pkt);
 #endif
@@ -487,9 +641,36 @@ bool FFMPEGCapturePrivate::writeVideoFrame(bool finalize)
     return true;
 }
 
-void FFMPEGCapturePrivate::finish()
+// Let the encoder empty the queue and finish the file. The frames still
+// being read are queued first when the OpenGL context is current, otherwise
+// they are lost and the pixel buffers are left to the context.
+void FFMPEGCapturePrivate::finish(bool contextCurrent)
 {
-    writeVideoFrame(true);
+    if (readback != nullptr)
+    {
+        if (contextCurrent)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                blockWhenFull = true;
+            }
+            while (readback->pending() > 0 && queueFrame());
+        }
+        else
+        {
+            readback->abandon();
+        }
+        readback.reset();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopEncoder = true;
+    }
+    frameQueued.notify_one();
+    encoder.join();
+
+    sendFrame(nullptr);
 
     // Write the trailer, if any. The trailer must be written before you
     // close the CodecContexts open when you wrote the header; otherwise
@@ -503,10 +684,14 @@ void FFMPEGCapturePrivate::finish()
 
 FFMPEGCapturePrivate::~FFMPEGCapturePrivate()
 {
+    // The capture wasn't ended, finish the file without touching OpenGL as
+    // the context may not be current here
+    if (capturing)
+        finish(false);
+
     avcodec_free_context(&enc);
     av_frame_free(&frame);
-    if (tmpfr != nullptr)
-        av_frame_free(&tmpfr);
+    sws_freeContext(swsc);
     avformat_free_context(oc);
     av_packet_free(&pkt);
 }
@@ -530,6 +715,12 @@ int FFMPEGCapture::getFrameCount() const
     return d->nextPts;
 }
 
+int FFMPEGCapture::getDroppedFrameCount() const
+{
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return d->stats.dropped;
+}
+
 int FFMPEGCapture::getWidth() const
 {
     return d->enc->width;
@@ -550,7 +741,8 @@ bool FFMPEGCapture::start(const fs::path& filename, int width, int height, float
     if (!d->init(filename) ||
         !d->addStream(width, height, fps) ||
         !d->openVideo() ||
-        !d->start())
+        !d->start() ||
+        !d->startEncoder())
     {
         return false;
     }
@@ -565,7 +757,7 @@ bool FFMPEGCapture::end()
     if (!d->capturing)
         return false;
 
-    d->finish();
+    d->finish(true);
 
     d->capturing = false;
 
@@ -574,7 +766,7 @@ bool FFMPEGCapture::end()
 
 bool FFMPEGCapture::captureFrame()
 {
-    return d->capturing && d->writeVideoFrame();
+    return d->capturing && d->captureFrame();
 }
 
 void FFMPEGCapture::setVideoCodec(AVCodecID vc_id)
@@ -591,3 +783,21 @@ void FFMPEGCapture::setEncoderOptions(const std::string &s)
 {
     d->vc_options = s;
 }
+
+void FFMPEGCapture::setMaxQueuedFrames(int n)
+{
+    std::lock_guard<std::mutex> lock(d->mutex);
+    d->maxQueued = std::max(n, 1);
+}
+
+void FFMPEGCapture::setBlockWhenFull(bool block)
+{
+    std::lock_guard<std::mutex> lock(d->mutex);
+    d->blockWhenFull = block;
+}
+
+FFMPEGCapture::Statistics FFMPEGCapture::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(d->mutex);
+    return d->stats;
+}
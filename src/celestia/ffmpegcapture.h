@@ -11,17 +11,34 @@ extern "C"
 
 class FFMPEGCapturePrivate;
 
+// Frames are read from the frame buffer asynchronously and queued for an
+// encoder thread, so that recording only costs the render thread a copy of
+// the pixels of each frame. When the encoder is too slow and the queue is
+// full, frames are dropped, or the render thread waits for the encoder if
+// setBlockWhenFull(true) was called, e.g. for offline rendering.
 class FFMPEGCapture : public MovieCapture
 {
  public:
+    struct Statistics
+    {
+        int queued      { 0 }; // frames waiting for the encoder
+        int maxQueued   { 0 }; // highest number of frames waiting
+        int dropped     { 0 }; // frames dropped because the queue was full
+        int encoded     { 0 }; // frames sent to the encoder
+    };
+
     FFMPEGCapture(const Renderer *r);
     ~FFMPEGCapture() override;
 
     bool start(const fs::path&, int, int, float) override;
+    // Must be called with the OpenGL context current, to read the last
+    // frames. Destroying a capture which wasn't ended finishes the file
+    // without them.
     bool end() override;
     bool captureFrame() override;
 
     int getFrameCount() const override;
+    int getDroppedFrameCount() const override;
     int getWidth() const override;
     int getHeight() const override;
     float getFrameRate() const override;
@@ -33,6 +50,10 @@ class FFMPEGCapture : public MovieCapture
     void setVideoCodec(AVCodecID);
     void setBitRate(int64_t);
     void setEncoderOptions(const std::string&);
+    void setMaxQueuedFrames(int);
+    void setBlockWhenFull(bool);
+
+    Statistics getStatistics() const;
 
  private:
     FFMPEGCapturePrivate *d{ nullptr };
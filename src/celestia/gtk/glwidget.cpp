@@ -28,6 +28,7 @@
 /* Declarations: Callbacks */
 static gint glarea_idle(AppData* app);
 static gint glarea_configure(GtkWidget* widget, GdkEventConfigure*, AppData* app);
+static void glarea_unrealize(GtkWidget* widget, AppData* app);
 #if GTK_MAJOR_VERSION == 2
 static gint glarea_expose(GtkWidget* widget, GdkEventExpose* event, AppData* app);
 #else
@@ -57,6 +58,8 @@ void initGLCallbacks(AppData* app)
 #endif
     g_signal_connect(G_OBJECT(app->glArea), "configure_event",
                      G_CALLBACK(glarea_configure), app);
+    g_signal_connect(G_OBJECT(app->glArea), "unrealize",
+                     G_CALLBACK(glarea_unrealize), app);
     g_signal_connect(G_OBJECT(app->glArea), "button_press_event",
                      G_CALLBACK(glarea_button_press), app);
     g_signal_connect(G_OBJECT(app->glArea), "button_release_event",
@@ -111,6 +114,29 @@ static gint glarea_configure(GtkWidget* widget, GdkEventConfigure*, AppData* app
 }
 
 
+/* CALLBACK: GL Function for event "unrealize"
+ *           Finish the movie capture while the context still exists. */
+static void glarea_unrealize(GtkWidget* widget, AppData* app)
+{
+#ifdef GTKGLEXT
+    GdkGLContext *glcontext = gtk_widget_get_gl_context (widget);
+    GdkGLDrawable *gldrawable = gtk_widget_get_gl_drawable (widget);
+
+    if (!gdk_gl_drawable_gl_begin (gldrawable, glcontext))
+        return;
+#else
+    if (!gtk_egl_drawable_make_current(widget))
+        return;
+#endif
+
+    app->core->finishMovieCapture();
+
+#ifdef GTKGLEXT
+    gdk_gl_drawable_gl_end (gldrawable);
+#endif
+}
+
+
 #if GTK_MAJOR_VERSION == 2
 /* CALLBACK: GL Function for event "expose_event" */
 static gint glarea_expose(GtkWidget*, GdkEventExpose* event, AppData* app)
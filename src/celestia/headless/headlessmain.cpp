@@ -0,0 +1,471 @@
+// headlessmain.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// Headless front-end for Celestia: renders frames offscreen with a fixed
+// time step and writes them to image files or to the standard output.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <vector>
+#include <getopt.h>
+#include <fmt/format.h>
+#include <celcompat/charconv.h>
+#include <celcompat/filesystem.h>
+#include <celengine/astro.h>
+#include <celengine/glsupport.h>
+#include <celengine/pixelformat.h>
+#include <celutil/gettext.h>
+#include <celutil/logger.h>
+#include <epoxy/egl.h>
+#include <celestia/celestiacore.h>
+
+using celestia::util::GetLogger;
+
+namespace celestia
+{
+namespace
+{
+
+struct Options
+{
+    int width{ 1280 };
+    int height{ 720 };
+    int frames{ 1 };
+    double fps{ 30.0 };
+    // Start time as a TDB Julian date, the current time when unset
+    double startTime{ 0.0 };
+    bool hasStartTime{ false };
+    std::string url;
+    fs::path script;
+    fs::path config;
+    std::vector<fs::path> extrasDirs;
+    // File name format with the frame number as argument, or "-" for raw
+    // frames written to the standard output
+    std::string output{ "frame-{:05}.png" };
+    bool verbose{ false };
+};
+
+// Offscreen OpenGL context drawing to an EGL pixel buffer surface. With
+// Mesa, EGL_PLATFORM=surfaceless selects a display which needs neither a
+// window system nor a GPU.
+class OffscreenContext
+{
+ public:
+    OffscreenContext() = default;
+    ~OffscreenContext();
+    OffscreenContext(const OffscreenContext&) = delete;
+    OffscreenContext& operator=(const OffscreenContext&) = delete;
+
+    bool create(int width, int height);
+
+ private:
+    EGLDisplay display{ EGL_NO_DISPLAY };
+    EGLSurface surface{ EGL_NO_SURFACE };
+    EGLContext context{ EGL_NO_CONTEXT };
+};
+
+OffscreenContext::~OffscreenContext()
+{
+    if (display == EGL_NO_DISPLAY)
+        return;
+
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT)
+        eglDestroyContext(display, context);
+    if (surface != EGL_NO_SURFACE)
+        eglDestroySurface(display, surface);
+    eglTerminate(display);
+}
+
+bool
+OffscreenContext::create(int width, int height)
+{
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || eglInitialize(display, nullptr, nullptr) != EGL_TRUE)
+    {
+        GetLogger()->error("Could not initialize EGL\n");
+        display = EGL_NO_DISPLAY;
+        return false;
+    }
+
+#ifdef GL_ES
+    const EGLint renderableType = EGL_OPENGL_ES2_BIT;
+    const EGLenum api = EGL_OPENGL_ES_API;
+    const EGLint contextAttribs[] = { EGL_CONTEXT_CLIENT_VERSION, 2, EGL_NONE };
+#else
+    const EGLint renderableType = EGL_OPENGL_BIT;
+    const EGLenum api = EGL_OPENGL_API;
+    const EGLint contextAttribs[] = { EGL_NONE };
+#endif
+
+    const EGLint configAttribs[] =
+    {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, renderableType,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+
+    EGLConfig config;
+    EGLint nConfigs = 0;
+    if (eglChooseConfig(display, configAttribs, &config, 1, &nConfigs) != EGL_TRUE || nConfigs == 0)
+    {
+        GetLogger()->error("No suitable EGL configuration\n");
+        return false;
+    }
+
+    const EGLint surfaceAttribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+    surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+    if (surface == EGL_NO_SURFACE)
+    {
+        GetLogger()->error("Could not create a {}x{} pixel buffer\n", width, height);
+        return false;
+    }
+
+    if (eglBindAPI(api) != EGL_TRUE)
+    {
+        GetLogger()->error("Could not bind the OpenGL API\n");
+        return false;
+    }
+
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (context == EGL_NO_CONTEXT)
+    {
+        GetLogger()->error("Could not create an OpenGL context\n");
+        return false;
+    }
+
+    if (eglMakeCurrent(display, surface, surface, context) != EGL_TRUE)
+    {
+        GetLogger()->error("Could not make the OpenGL context current\n");
+        return false;
+    }
+
+    return true;
+}
+
+void
+usage()
+{
+    std::cout << "Usage: celestia-headless [options]\n"
+                 "  -s, --size WxH        frame size, 1280x720 by default\n"
+                 "  -n, --frames N        number of frames to render, 1 by default\n"
+                 "  -r, --fps RATE        frames per second of simulated time, 30 by default\n"
+                 "  -t, --time DATE       start time (UTC), e.g. 2023-06-21T12:00:00\n"
+                 "  -u, --url URL         cel:// URL to go to before rendering\n"
+                 "  -f, --script FILE     script to run before rendering\n"
+                 "  -c, --conf FILE       configuration file\n"
+                 "  -e, --extrasdir DIR   additional extras directory\n"
+                 "  -o, --output FORMAT   output file name with the frame number as {},\n"
+                 "                        frame-{:05}.png by default; PNG and JPEG are\n"
+                 "                        supported. With -, raw RGB frames are written\n"
+                 "                        to the standard output, e.g. for\n"
+                 "                        ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH -i -\n"
+                 "  -v, --verbose         verbose output\n";
+}
+
+template<typename T>
+bool
+parseNumber(const char* s, T& value)
+{
+    const char* end = s + std::char_traits<char>::length(s);
+    auto [ptr, ec] = compat::from_chars(s, end, value);
+    return ec == std::errc() && ptr == end;
+}
+
+bool
+parseOptions(int argc, char** argv, Options& options)
+{
+    static const option longOptions[] =
+    {
+        { "size",      required_argument, nullptr, 's' },
+        { "frames",    required_argument, nullptr, 'n' },
+        { "fps",       required_argument, nullptr, 'r' },
+        { "time",      required_argument, nullptr, 't' },
+        { "url",       required_argument, nullptr, 'u' },
+        { "script",    required_argument, nullptr, 'f' },
+        { "conf",      required_argument, nullptr, 'c' },
+        { "extrasdir", required_argument, nullptr, 'e' },
+        { "output",    required_argument, nullptr, 'o' },
+        { "verbose",   no_argument,       nullptr, 'v' },
+        { "help",      no_argument,       nullptr, 'h' },
+        { nullptr,     0,                 nullptr, 0   }
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "s:n:r:t:u:f:c:e:o:vh", longOptions, nullptr)) != -1)
+    {
+        switch (c)
+        {
+        case 's':
+            if (std::sscanf(optarg, "%dx%d", &options.width, &options.height) != 2 ||
+                options.width <= 0 || options.height <= 0)
+            {
+                std::cerr << "Invalid frame size: " << optarg << '\n';
+                return false;
+            }
+            break;
+        case 'n':
+            if (!parseNumber(optarg, options.frames) || options.frames <= 0)
+            {
+                std::cerr << "Invalid number of frames: " << optarg << '\n';
+                return false;
+            }
+            break;
+        case 'r':
+            if (!parseNumber(optarg, options.fps) || options.fps <= 0.0)
+            {
+                std::cerr << "Invalid frame rate: " << optarg << '\n';
+                return false;
+            }
+            break;
+        case 't':
+            {
+                astro::Date date;
+                if (!astro::parseDate(optarg, date))
+                {
+                    std::cerr << "Invalid date: " << optarg << '\n';
+                    return false;
+                }
+                options.startTime = astro::UTCtoTDB(date);
+                options.hasStartTime = true;
+            }
+            break;
+        case 'u':
+            options.url = optarg;
+            break;
+        case 'f':
+            options.script = optarg;
+            break;
+        case 'c':
+            options.config = optarg;
+            break;
+        case 'e':
+            options.extrasDirs.emplace_back(optarg);
+            break;
+        case 'o':
+            options.output = optarg;
+            break;
+        case 'v':
+            options.verbose = true;
+            break;
+        default:
+            usage();
+            return false;
+        }
+    }
+
+    if (optind < argc)
+    {
+        usage();
+        return false;
+    }
+
+    // Paths are relative to the current directory, not the data directory
+    if (!options.script.empty())
+        options.script = fs::absolute(options.script);
+    if (!options.config.empty())
+        options.config = fs::absolute(options.config);
+    for (auto& dir : options.extrasDirs)
+        dir = fs::absolute(dir);
+    if (options.output != "-")
+        options.output = fs::absolute(options.output).string();
+
+    return true;
+}
+
+// Return the file name of a frame, or an empty path when the output format
+// is invalid
+fs::path
+frameFileName(const std::string& output, int frame)
+{
+    if (output.find('{') == std::string::npos)
+        return output;
+
+    try
+    {
+        return fmt::vformat(output, fmt::make_format_args(frame));
+    }
+    catch (const fmt::format_error&)
+    {
+        return fs::path();
+    }
+}
+
+bool
+writeRawFrame(const CelestiaCore& appCore, std::vector<std::uint8_t>& buffer)
+{
+    std::array<int, 4> viewport;
+    PixelFormat format;
+    appCore.getCaptureInfo(viewport, format);
+
+    // Rows are aligned on 4 bytes by glReadPixels
+    const int rowSize = viewport[2] * 3;
+    const int stride = (rowSize + 3) & ~3;
+    buffer.resize(static_cast<std::size_t>(stride) * viewport[3]);
+    if (!appCore.captureImage(buffer.data(), viewport, PixelFormat::RGB))
+        return false;
+
+    for (int row = 0; row < viewport[3]; row++)
+    {
+        if (std::fwrite(buffer.data() + static_cast<std::size_t>(stride) * row, 1, rowSize, stdout) != static_cast<std::size_t>(rowSize))
+            return false;
+    }
+
+    return true;
+}
+
+int
+headlessmain(int argc, char **argv)
+{
+    setlocale(LC_ALL, "");
+    setlocale(LC_NUMERIC, "C");
+    bindtextdomain(PACKAGE, LOCALEDIR);
+    bind_textdomain_codeset(PACKAGE, "UTF-8");
+    textdomain(PACKAGE);
+
+    Options options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    bool raw = options.output == "-";
+    if (!raw && options.frames > 1 && options.output.find('{') == std::string::npos)
+    {
+        std::cerr << "The output file name needs a {} for the frame number\n";
+        return 1;
+    }
+    if (!raw && frameFileName(options.output, 0).empty())
+    {
+        std::cerr << "Invalid output file name: " << options.output << '\n';
+        return 1;
+    }
+
+    const char *dataDir = getenv("CELESTIA_DATA_DIR");
+    if (dataDir == nullptr)
+        dataDir = CONFIG_DATA_DIR;
+
+    std::error_code ec;
+    fs::current_path(dataDir, ec);
+    if (ec)
+    {
+        std::cerr << fmt::format("Cannot chdir to {}, probably due to improper installation\n", dataDir);
+        return 1;
+    }
+
+    // CelestiaCore sends std::clog and std::cerr to its console, which is
+    // never displayed here
+    std::streambuf *clogBuf = std::clog.rdbuf();
+    std::streambuf *cerrBuf = std::cerr.rdbuf();
+    CelestiaCore appCore;
+    std::clog.rdbuf(clogBuf);
+    std::cerr.rdbuf(cerrBuf);
+    if (options.verbose)
+        GetLogger()->setLevel(util::Level::Verbose);
+
+    OffscreenContext context;
+    if (!context.create(options.width, options.height))
+        return 2;
+
+    if (!gl::init() || !gl::checkVersion(
+#ifdef GL_ES
+                                         gl::GLES_2
+#else
+                                         gl::GL_2_1
+#endif
+                                         ))
+    {
+        std::cerr << "Celestia requires OpenGL 2.1 or OpenGL ES 2.0!\n";
+        return 2;
+    }
+
+    if (!appCore.initSimulation(options.config, options.extrasDirs))
+    {
+        std::cerr << "Could not initialize Celestia!\n";
+        return 3;
+    }
+
+    // Load resources and virtual texture tiles and sample orbits as they
+    // are needed, rather than in the background, so that every frame is
+    // complete and the output is reproducible.
+    CelestiaConfig *config = appCore.getConfig();
+    config->resourceLoadingThreads = 0;
+    config->virtualTextureBackgroundLoading = false;
+    config->orbitSamplingThreads = 0;
+
+    if (!appCore.initRenderer())
+    {
+        std::cerr << "Could not initialize the renderer!\n";
+        return 3;
+    }
+
+    Renderer *renderer = appCore.getRenderer();
+    renderer->setRenderFlags(Renderer::DefaultRenderFlags);
+    renderer->setShadowMapSize(config->ShadowMapSize);
+    renderer->setSolarSystemMaxDistance(config->SolarSystemMaxDistance);
+
+    if (options.hasStartTime)
+        appCore.start(options.startTime);
+    else
+        appCore.start();
+
+    appCore.resize(options.width, options.height);
+
+    if (!options.script.empty())
+        appCore.runScript(options.script);
+    if (!options.url.empty())
+        appCore.goToUrl(options.url);
+
+    std::vector<std::uint8_t> buffer;
+    const double dt = 1.0 / options.fps;
+    for (int frame = 0; frame < options.frames; frame++)
+    {
+        // The first frame is drawn at the start time
+        appCore.tick(frame == 0 ? 0.0 : dt);
+        appCore.draw();
+
+        bool ok;
+        if (raw)
+        {
+            ok = writeRawFrame(appCore, buffer);
+        }
+        else
+        {
+            ok = appCore.saveScreenShot(frameFileName(options.output, frame));
+        }
+
+        if (!ok)
+        {
+            std::cerr << fmt::format("Could not write frame {}\n", frame);
+            return 4;
+        }
+    }
+
+    if (raw)
+        std::fflush(stdout);
+
+    return 0;
+}
+
+} // end unnamed namespace
+} // end namespace celestia
+
+int
+main(int argc, char **argv)
+{
+    return celestia::headlessmain(argc, argv);
+}
@@ -27,6 +27,7 @@ class MovieCapture
     virtual bool captureFrame() = 0;
 
     virtual int getFrameCount() const = 0;
+    virtual int getDroppedFrameCount() const = 0;
     virtual int getWidth() const = 0;
     virtual int getHeight() const = 0;
     virtual float getFrameRate() const = 0;
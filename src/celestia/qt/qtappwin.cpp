@@ -1565,6 +1565,10 @@ void CelestiaAppWindow::closeEvent(QCloseEvent* event)
     writeSettings();
     saveBookmarks();
 
+    glWidget->makeCurrent();
+    m_appCore->finishMovieCapture();
+    glWidget->doneCurrent();
+
     event->accept();
 }
 
@@ -3625,6 +3625,10 @@ int APIENTRY WinMain(HINSTANCE hInstance,
     // Not ready to render anymore.
     bReady = false;
 
+    // Write the last frames of the movie while the context is current
+    if (appCore != NULL)
+        appCore->finishMovieCapture();
+
     // Clean up the window
     if (currentScreenMode != 0)
         RestoreDisplayMode();
@@ -13,6 +13,7 @@
 #include <fstream>
 #include <algorithm>
 #include <memory>
+#include <vector>
 #include <celengine/glsupport.h>
 #include <celengine/image.h>
 #include <celutil/logger.h>
@@ -86,53 +87,6 @@ constexpr uint32_t FourCC(const char* s)
             (uint32_t) s[0]);
 }
 
-// decompress a DXTc texture to a RGBA texture, taken from https://github.com/ptitSeb/gl4es
-uint32_t* decompressDXTc(uint32_t width, uint32_t height, GLenum format, bool transparent0, ifstream &in)
-{
-    // TODO: check with the size of the input data stream if the stream is in fact decompressed
-    // alloc memory
-    auto *pixels = new uint32_t[((width + 3) & ~3) * ((height + 3) & ~3)];
-
-    int blocksize = 0;
-#define DDS_MAX_BLOCK_SIZE      16
-    switch (format)
-    {
-    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
-        blocksize = 8;
-        break;
-    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
-    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
-        blocksize = 16;
-        break;
-    }
-    uint8_t block[DDS_MAX_BLOCK_SIZE]; // enough to hold DXT1/3/5 blocks
-    for (uint32_t y = 0; y < height; y += 4)
-    {
-        for (uint32_t x = 0; x < width; x += 4)
-        {
-            if (!in.good())
-            {
-                delete[] pixels;
-                return nullptr;
-            }
-            in.read((char*)block, blocksize);
-            switch(format)
-            {
-            case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
-                DecompressBlockDXT1(x, y, width, block, transparent0, pixels);
-                break;
-            case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
-                DecompressBlockDXT3(x, y, width, block, transparent0, pixels);
-                break;
-            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
-                DecompressBlockDXT5(x, y, width, block, transparent0, pixels);
-                break;
-            }
-        }
-    }
-    return pixels;
-}
-
 } // anonymous namespace
 
 Image* LoadDDSImage(const fs::path& filename)
@@ -246,49 +200,29 @@ Image* LoadDDSImage(const fs::path& filename)
         if (!gl::EXT_texture_compression_s3tc)
         {
             // DXTc texture not supported, decompress DXTc to RGB/RGBA
-            uint32_t *pixels = nullptr;
-            bool transparent0 = format == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
-            if ((ddsd.width & 3) != 0 || (ddsd.height & 3) != 0)
+            DXTFormat dxtFormat = DXTFormat::DXT1;
+            if (format == GL_COMPRESSED_RGBA_S3TC_DXT3_EXT)
+                dxtFormat = DXTFormat::DXT3;
+            else if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+                dxtFormat = DXTFormat::DXT5;
+
+            std::size_t dataSize = static_cast<std::size_t>((ddsd.width + 3) / 4) *
+                                   static_cast<std::size_t>((ddsd.height + 3) / 4) *
+                                   DXTBlockSize(dxtFormat);
+            std::vector<uint8_t> blocks(dataSize);
+            in.read(reinterpret_cast<char*>(blocks.data()), dataSize);
+            if (static_cast<std::size_t>(in.gcount()) != dataSize)
             {
-                uint32_t nw = max(ddsd.width, 4u);
-                uint32_t nh = max(ddsd.height, 4u);
-                auto *tmp = decompressDXTc(nw, nh, format, transparent0, in);
-                if (tmp != nullptr)
-                {
-                    pixels = new uint32_t[ddsd.width * ddsd.height];
-                    // crop
-                    for (uint32_t y = 0; y < ddsd.height; y++)
-                        memcpy((char *)pixels + y * ddsd.width * 4, (char *)tmp + y * nw * 4, ddsd.width * 4);
-                    delete[] tmp;
-                }
-            }
-            else
-            {
-                pixels = decompressDXTc(ddsd.width, ddsd.height, format, transparent0, in);
-            }
-
-            if (pixels == nullptr)
-            {
-                GetLogger()->error("Failed to decompress DDS texture file {}.\n", filename);
+                GetLogger()->error("Failed reading data from DDS texture file {}.\n", filename);
                 return nullptr;
             }
 
-            if (transparent0)
-            {
-                // Remove the alpha channel for DXT1 since DXT1 textures
-                // are deemed not to contain alpha values in Celestia
-                // https://github.com/CelestiaProject/Celestia/pull/1086
-                char *ptr = reinterpret_cast<char*>(pixels);
-                uint32_t numberOfPixels = ddsd.width * ddsd.height;
-                for (uint32_t index = 0; index < numberOfPixels; ++index)
-                {
-                    memcpy(&ptr[3 * index], &ptr[4 * index], sizeof(char) * 3);
-                }
-            }
-
-            Image *img = new Image(transparent0 ? PixelFormat::RGB : PixelFormat::RGBA, ddsd.width, ddsd.height);
-            memcpy(img->getPixels(), pixels, (transparent0 ? 3 : 4) * ddsd.width * ddsd.height);
-            delete[] pixels;
+            // DXT1 textures are deemed not to contain alpha values in Celestia
+            // https://github.com/CelestiaProject/Celestia/pull/1086
+            Image *img = new Image(dxtFormat == DXTFormat::DXT1 ? PixelFormat::RGB : PixelFormat::RGBA,
+                                   ddsd.width, ddsd.height);
+            DecompressDXTc(dxtFormat, blocks.data(), ddsd.width, ddsd.height,
+                           img->getPixels(), img->getPitch(), &GetImageThreadPool());
             return img;
         }
     }
@@ -1,5 +1,11 @@
-#include <stddef.h>
-#include <stdint.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <celutil/threadpool.h>
+#include "dds_decompress.h"
 
 /*
 DXT1/DXT3/DXT5 texture decompression
@@ -54,316 +60,221 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 
 ---
+
+The block decoders were changed to build the palettes of a block once and
+to look the pixels up in them, and to decompress whole rows of blocks.
 */
-constexpr uint32_t PackRGBA(uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+
+namespace
+{
+
+constexpr uint32_t PackRGBA(uint32_t r, uint32_t g, uint32_t b, uint32_t a)
 {
     return r | (g << 8) | (b << 16) | (a << 24);
 }
 
-static void DecompressBlockDXT1Internal(const uint8_t* block,
-                                        uint32_t* output,
-                                        uint32_t outputStride,
-                                        bool transparent0,
-                                        const uint8_t* alphaValues)
+uint16_t ReadUint16(const uint8_t* p)
 {
-    uint32_t temp, code;
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
 
-    uint16_t color0, color1;
-    uint8_t r0, g0, b0, r1, g1, b1;
+uint32_t ReadUint32(const uint8_t* p)
+{
+    return static_cast<uint32_t>(p[0]) |
+           (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
 
-    int i, j;
+// Expand a 5 or 6 bit color channel to 8 bits
+uint32_t Expand5(uint32_t c)
+{
+    uint32_t temp = c * 255 + 16;
+    return (temp / 32 + temp) / 32;
+}
 
-    color0 = *(const uint16_t*)(block);
-    color1 = *(const uint16_t*)(block + 2);
+uint32_t Expand6(uint32_t c)
+{
+    uint32_t temp = c * 255 + 32;
+    return (temp / 64 + temp) / 64;
+}
 
-    temp = (color0 >> 11) * 255 + 16;
-    r0 = (uint8_t)((temp / 32 + temp) / 32);
-    temp = ((color0 & 0x07E0) >> 5) * 255 + 32;
-    g0 = (uint8_t)((temp / 64 + temp) / 64);
-    temp = (color0 & 0x001F) * 255 + 16;
-    b0 = (uint8_t)((temp / 32 + temp) / 32);
+// Compute the four colors of a DXT color block, without alpha. Blocks are
+// in the three color mode when color0 <= color1, unless forced to the four
+// color mode.
+void ColorPalette(const uint8_t* block, bool fourColors, uint32_t palette[4])
+{
+    uint16_t color0 = ReadUint16(block);
+    uint16_t color1 = ReadUint16(block + 2);
 
-    temp = (color1 >> 11) * 255 + 16;
-    r1 = (uint8_t)((temp / 32 + temp) / 32);
-    temp = ((color1 & 0x07E0) >> 5) * 255 + 32;
-    g1 = (uint8_t)((temp / 64 + temp) / 64);
-    temp = (color1 & 0x001F) * 255 + 16;
-    b1 = (uint8_t)((temp / 32 + temp) / 32);
+    uint32_t r0 = Expand5(color0 >> 11);
+    uint32_t g0 = Expand6((color0 & 0x07E0) >> 5);
+    uint32_t b0 = Expand5(color0 & 0x001F);
 
-    code = *(const uint32_t*)(block + 4);
+    uint32_t r1 = Expand5(color1 >> 11);
+    uint32_t g1 = Expand6((color1 & 0x07E0) >> 5);
+    uint32_t b1 = Expand5(color1 & 0x001F);
 
-    if (color0 > color1)
+    palette[0] = PackRGBA(r0, g0, b0, 0);
+    palette[1] = PackRGBA(r1, g1, b1, 0);
+    if (fourColors || color0 > color1)
     {
-        for (j = 0; j < 4; ++j)
-        {
-            for (i = 0; i < 4; ++i)
-            {
-                uint32_t finalColor, positionCode;
-                uint8_t alpha;
-
-                alpha = alphaValues[j * 4 + i];
-
-                finalColor = 0;
-                positionCode = (code >> 2 * (4 * j + i)) & 0x03;
-
-                switch (positionCode)
-                {
-                case 0:
-                    finalColor = PackRGBA(r0, g0, b0, alpha);
-                    break;
-                case 1:
-                    finalColor = PackRGBA(r1, g1, b1, alpha);
-                    break;
-                case 2:
-                    finalColor = PackRGBA((2 * r0 + r1) / 3, (2 * g0 + g1) / 3,
-                                          (2 * b0 + b1) / 3, alpha);
-                    break;
-                case 3:
-                    finalColor = PackRGBA((r0 + 2 * r1) / 3, (g0 + 2 * g1) / 3,
-                                          (b0 + 2 * b1) / 3, alpha);
-                    break;
-                }
-                if (transparent0 && (finalColor == PackRGBA(0, 0, 0, 0xff)))
-                {
-                    alpha = 0;
-                    finalColor = 0;
-                }
-                output[j * outputStride + i] = finalColor;
-            }
-        }
+        palette[2] = PackRGBA((2 * r0 + r1) / 3, (2 * g0 + g1) / 3, (2 * b0 + b1) / 3, 0);
+        palette[3] = PackRGBA((r0 + 2 * r1) / 3, (g0 + 2 * g1) / 3, (b0 + 2 * b1) / 3, 0);
     }
     else
     {
-        for (j = 0; j < 4; ++j)
-        {
-            for (i = 0; i < 4; ++i)
-            {
-                uint32_t finalColor, positionCode;
-                uint8_t alpha;
-
-                alpha = alphaValues[j * 4 + i];
-
-                finalColor = 0;
-                positionCode = (code >> 2 * (4 * j + i)) & 0x03;
-
-                switch (positionCode)
-                {
-                case 0:
-                    finalColor = PackRGBA(r0, g0, b0, alpha);
-                    break;
-                case 1:
-                    finalColor = PackRGBA(r1, g1, b1, alpha);
-                    break;
-                case 2:
-                    finalColor = PackRGBA((r0 + r1) / 2, (g0 + g1) / 2, (b0 + b1) / 2, alpha);
-                    break;
-                case 3:
-                    finalColor = PackRGBA(0, 0, 0, alpha);
-                    break;
-                }
+        palette[2] = PackRGBA((r0 + r1) / 2, (g0 + g1) / 2, (b0 + b1) / 2, 0);
+        palette[3] = PackRGBA(0, 0, 0, 0);
+    }
+}
 
-                if (transparent0 && (finalColor == PackRGBA(0, 0, 0, 0xff)))
-                {
-                    alpha = 0;
-                    finalColor = 0;
-                }
+// Decompress the colors of a block, combined with the alpha values of its
+// pixels already stored in output
+void DecompressColors(const uint8_t* block, bool fourColors, uint32_t* output, uint32_t outputStride)
+{
+    uint32_t palette[4];
+    ColorPalette(block, fourColors, palette);
 
-                output[j * outputStride + i] = finalColor;
-            }
-        }
+    uint32_t code = ReadUint32(block + 4);
+    for (uint32_t j = 0; j < 4; ++j)
+    {
+        uint32_t* row = output + j * outputStride;
+        for (uint32_t i = 0; i < 4; ++i)
+            row[i] |= palette[(code >> (2 * (4 * j + i))) & 0x03];
     }
 }
 
-/*
-void DecompressBlockDXT1(): Decompresses one block of a DXT1 texture and stores the resulting pixels at the appropriate offset in 'image'.
-
-uint32_t x:                     x-coordinate of the first pixel in the block.
-uint32_t y:                     y-coordinate of the first pixel in the block.
-uint32_t width:                 width of the texture being decompressed.
-const uint8_t *blockStorage:    pointer to the block to decompress.
-uint32_t *image:                pointer to image where the decompressed pixel data should be stored.
-*/
-void DecompressBlockDXT1(uint32_t x,
-                         uint32_t y,
-                         uint32_t width,
-                         const uint8_t* blockStorage,
-                         bool transparent0,
-                         uint32_t* image)
+void DecompressBlockDXT1(const uint8_t* block, uint32_t* output, uint32_t outputStride)
 {
-    static const uint8_t const_alpha[] = { 255, 255, 255, 255, 255, 255,
-                                           255, 255, 255, 255, 255, 255,
-                                           255, 255, 255, 255 };
+    for (uint32_t j = 0; j < 4; ++j)
+    {
+        uint32_t* row = output + j * outputStride;
+        for (uint32_t i = 0; i < 4; ++i)
+            row[i] = PackRGBA(0, 0, 0, 0xff);
+    }
 
-    DecompressBlockDXT1Internal(blockStorage, image + x + (y * width), width,
-                                transparent0, const_alpha);
+    DecompressColors(block, false, output, outputStride);
 }
 
-/*
-void DecompressBlockDXT5(): Decompresses one block of a DXT5 texture and stores the resulting pixels at the appropriate offset in 'image'.
-
-uint32_t x:                     x-coordinate of the first pixel in the block.
-uint32_t y:                     y-coordinate of the first pixel in the block.
-uint32_t width:                 width of the texture being decompressed.
-const uint8_t *blockStorage:    pointer to the block to decompress.
-uint32_t *image:                pointer to image where the decompressed pixel data should be stored.
-*/
-void DecompressBlockDXT5(uint32_t x,
-                         uint32_t y,
-                         uint32_t width,
-                         const uint8_t* blockStorage,
-                         bool transparent0,
-                         uint32_t* image)
+void DecompressBlockDXT3(const uint8_t* block, uint32_t* output, uint32_t outputStride)
 {
-    uint8_t alpha0, alpha1;
-    const uint8_t* bits;
-    uint32_t alphaCode1;
-    uint16_t alphaCode2;
+    for (uint32_t j = 0; j < 4; ++j)
+    {
+        uint32_t alphaData = ReadUint16(block + 2 * j);
+        uint32_t* row = output + j * outputStride;
+        for (uint32_t i = 0; i < 4; ++i)
+            row[i] = PackRGBA(0, 0, 0, ((alphaData >> (4 * i)) & 0xF) * 17);
+    }
 
-    uint16_t color0, color1;
-    uint8_t r0, g0, b0, r1, g1, b1;
+    DecompressColors(block + 8, false, output, outputStride);
+}
 
-    int i, j;
+void DecompressBlockDXT5(const uint8_t* block, uint32_t* output, uint32_t outputStride)
+{
+    uint32_t alpha0 = block[0];
+    uint32_t alpha1 = block[1];
 
-    uint32_t temp, code;
+    uint32_t alphaPalette[8];
+    alphaPalette[0] = alpha0;
+    alphaPalette[1] = alpha1;
+    if (alpha0 > alpha1)
+    {
+        for (uint32_t code = 2; code < 8; ++code)
+            alphaPalette[code] = ((8 - code) * alpha0 + (code - 1) * alpha1) / 7;
+    }
+    else
+    {
+        for (uint32_t code = 2; code < 6; ++code)
+            alphaPalette[code] = ((6 - code) * alpha0 + (code - 1) * alpha1) / 5;
+        alphaPalette[6] = 0;
+        alphaPalette[7] = 255;
+    }
 
-    alpha0 = *(blockStorage);
-    alpha1 = *(blockStorage + 1);
+    // 16 alpha codes of 3 bits
+    uint64_t alphaCodes = static_cast<uint64_t>(ReadUint16(block + 2)) |
+                          (static_cast<uint64_t>(ReadUint32(block + 4)) << 16);
+    for (uint32_t j = 0; j < 4; ++j)
+    {
+        uint32_t* row = output + j * outputStride;
+        for (uint32_t i = 0; i < 4; ++i)
+            row[i] = PackRGBA(0, 0, 0, alphaPalette[(alphaCodes >> (3 * (4 * j + i))) & 0x07]);
+    }
 
-    bits = blockStorage + 2;
-    alphaCode1 = bits[2] | (bits[3] << 8) | (bits[4] << 16) | (bits[5] << 24);
-    alphaCode2 = bits[0] | (bits[1] << 8);
+    DecompressColors(block + 8, true, output, outputStride);
+}
 
-    color0 = *(const uint16_t*)(blockStorage + 8);
-    color1 = *(const uint16_t*)(blockStorage + 10);
+} // end unnamed namespace
 
-    temp = (color0 >> 11) * 255 + 16;
-    r0 = (uint8_t)((temp / 32 + temp) / 32);
-    temp = ((color0 & 0x07E0) >> 5) * 255 + 32;
-    g0 = (uint8_t)((temp / 64 + temp) / 64);
-    temp = (color0 & 0x001F) * 255 + 16;
-    b0 = (uint8_t)((temp / 32 + temp) / 32);
+std::size_t DXTBlockSize(DXTFormat format)
+{
+    return format == DXTFormat::DXT1 ? 8 : 16;
+}
 
-    temp = (color1 >> 11) * 255 + 16;
-    r1 = (uint8_t)((temp / 32 + temp) / 32);
-    temp = ((color1 & 0x07E0) >> 5) * 255 + 32;
-    g1 = (uint8_t)((temp / 64 + temp) / 64);
-    temp = (color1 & 0x001F) * 255 + 16;
-    b1 = (uint8_t)((temp / 32 + temp) / 32);
+void DecompressBlockRow(DXTFormat format,
+                        const uint8_t* blocks,
+                        uint32_t nBlocks,
+                        uint32_t* strip)
+{
+    uint32_t stride = nBlocks * 4;
+    switch (format)
+    {
+    case DXTFormat::DXT1:
+        for (uint32_t i = 0; i < nBlocks; ++i, blocks += 8)
+            DecompressBlockDXT1(blocks, strip + i * 4, stride);
+        break;
+    case DXTFormat::DXT3:
+        for (uint32_t i = 0; i < nBlocks; ++i, blocks += 16)
+            DecompressBlockDXT3(blocks, strip + i * 4, stride);
+        break;
+    case DXTFormat::DXT5:
+        for (uint32_t i = 0; i < nBlocks; ++i, blocks += 16)
+            DecompressBlockDXT5(blocks, strip + i * 4, stride);
+        break;
+    }
+}
 
-    code = *(const uint32_t*)(blockStorage + 12);
+void DecompressDXTc(DXTFormat format,
+                    const uint8_t* blocks,
+                    uint32_t width,
+                    uint32_t height,
+                    uint8_t* pixels,
+                    std::size_t pitch,
+                    celestia::util::ThreadPool* pool)
+{
+    uint32_t blocksPerRow = (width + 3) / 4;
+    uint32_t blockRows = (height + 3) / 4;
+    std::size_t blockRowSize = blocksPerRow * DXTBlockSize(format);
+    bool rgb = format == DXTFormat::DXT1;
 
-    for (j = 0; j < 4; j++)
+    auto decompressRows = [&](std::size_t firstRow, std::size_t lastRow)
     {
-        for (i = 0; i < 4; i++)
+        std::vector<uint32_t> strip(blocksPerRow * 16);
+        for (std::size_t blockRow = firstRow; blockRow < lastRow; ++blockRow)
         {
-            uint8_t finalAlpha;
-            int alphaCode, alphaCodeIndex;
-            uint8_t colorCode;
-            uint32_t finalColor;
-
-            alphaCodeIndex = 3 * (4 * j + i);
-            if (alphaCodeIndex <= 12)
-            {
-                alphaCode = (alphaCode2 >> alphaCodeIndex) & 0x07;
-            }
-            else if (alphaCodeIndex == 15)
-            {
-                alphaCode = (alphaCode2 >> 15) | ((alphaCode1 << 1) & 0x06);
-            }
-            else /* alphaCodeIndex >= 18 && alphaCodeIndex <= 45 */
-            {
-                alphaCode = (alphaCode1 >> (alphaCodeIndex - 16)) & 0x07;
-            }
+            DecompressBlockRow(format, blocks + blockRow * blockRowSize, blocksPerRow, strip.data());
 
-            if (alphaCode == 0)
-            {
-                finalAlpha = alpha0;
-            }
-            else if (alphaCode == 1)
+            // Copy the rows of the strip inside of the image
+            uint32_t y0 = static_cast<uint32_t>(blockRow) * 4;
+            for (uint32_t y = y0; y < y0 + 4 && y < height; ++y)
             {
-                finalAlpha = alpha1;
-            }
-            else
-            {
-                if (alpha0 > alpha1)
+                const uint32_t* src = strip.data() + (y - y0) * blocksPerRow * 4;
+                uint8_t* dst = pixels + y * pitch;
+                if (rgb)
                 {
-                    finalAlpha = (uint8_t)(((8 - alphaCode) * alpha0 + (alphaCode - 1) * alpha1) / 7);
+                    for (uint32_t x = 0; x < width; ++x)
+                        std::memcpy(dst + x * 3, src + x, 3);
                 }
                 else
                 {
-                    if (alphaCode == 6)
-                    {
-                        finalAlpha = 0;
-                    }
-                    else if (alphaCode == 7)
-                    {
-                        finalAlpha = 255;
-                    }
-                    else
-                    {
-                        finalAlpha = (uint8_t)(((6 - alphaCode) * alpha0 + (alphaCode - 1) * alpha1) / 5);
-                    }
+                    std::memcpy(dst, src, width * 4);
                 }
             }
-
-            colorCode = (code >> 2 * (4 * j + i)) & 0x03;
-            finalColor = 0;
-
-            switch (colorCode)
-            {
-            case 0:
-                finalColor = PackRGBA(r0, g0, b0, finalAlpha);
-                break;
-            case 1:
-                finalColor = PackRGBA(r1, g1, b1, finalAlpha);
-                break;
-            case 2:
-                finalColor = PackRGBA((2 * r0 + r1) / 3, (2 * g0 + g1) / 3,
-                                      (2 * b0 + b1) / 3, finalAlpha);
-                break;
-            case 3:
-                finalColor = PackRGBA((r0 + 2 * r1) / 3, (g0 + 2 * g1) / 3,
-                                      (b0 + 2 * b1) / 3, finalAlpha);
-                break;
-            }
-
-            image[i + x + (width * (y + j))] = finalColor;
         }
-    }
-}
+    };
 
-/*
-void DecompressBlockDXT3(): Decompresses one block of a DXT3 texture and stores the resulting pixels at the appropriate offset in 'image'.
-
-uint32_t x:                     x-coordinate of the first pixel in the block.
-uint32_t y:                     y-coordinate of the first pixel in the block.
-uint32_t height:                height of the texture being decompressed.
-const uint8_t *blockStorage:    pointer to the block to decompress.
-uint32_t *image:                pointer to image where the decompressed pixel data should be stored.
-*/
-void DecompressBlockDXT3(uint32_t x,
-                         uint32_t y,
-                         uint32_t width,
-                         const uint8_t* blockStorage,
-                         bool transparent0,
-                         uint32_t* image)
-{
-    int i;
-
-    uint8_t alphaValues[16] = { 0 };
-
-    for (i = 0; i < 4; ++i)
-    {
-        const uint16_t* alphaData = (const uint16_t*)(blockStorage);
-
-        alphaValues[i * 4 + 0] = (((*alphaData) >> 0) & 0xF) * 17;
-        alphaValues[i * 4 + 1] = (((*alphaData) >> 4) & 0xF) * 17;
-        alphaValues[i * 4 + 2] = (((*alphaData) >> 8) & 0xF) * 17;
-        alphaValues[i * 4 + 3] = (((*alphaData) >> 12) & 0xF) * 17;
-
-        blockStorage += 2;
-    }
-
-    DecompressBlockDXT1Internal(blockStorage, image + x + (y * width), width,
-                                transparent0, alphaValues);
+    if (pool == nullptr)
+        decompressRows(0, blockRows);
+    else
+        pool->parallelFor(blockRows, std::max(1u, 4096u / blocksPerRow), decompressRows);
 }
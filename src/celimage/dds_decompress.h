@@ -1,16 +1,37 @@
 #pragma once
 
-void DecompressBlockDXT1(uint32_t x, uint32_t y, uint32_t width,
-    const uint8_t* blockStorage,
-    bool transparent0,
-    uint32_t* image);
+#include <cstddef>
+#include <cstdint>
 
-void DecompressBlockDXT3(uint32_t x, uint32_t y, uint32_t width,
-    const uint8_t* blockStorage,
-    bool transparent0,
-    uint32_t* image);
+namespace celestia::util
+{
+class ThreadPool;
+}
 
-void DecompressBlockDXT5(uint32_t x, uint32_t y, uint32_t width,
-    const uint8_t* blockStorage,
-    bool transparent0,
-    uint32_t* image);
+enum class DXTFormat
+{
+    DXT1,
+    DXT3,
+    DXT5,
+};
+
+// Size in bytes of a block of 4x4 pixels
+std::size_t DXTBlockSize(DXTFormat format);
+
+// Decompress a row of nBlocks blocks into 4 rows of 4 * nBlocks RGBA pixels.
+void DecompressBlockRow(DXTFormat format,
+                        const uint8_t* blocks,
+                        uint32_t nBlocks,
+                        uint32_t* strip);
+
+// Decompress a DXTc image into rows of pixels separated by pitch bytes. DXT1
+// images are decompressed to RGB, since they are deemed not to contain alpha
+// values in Celestia, and DXT3 and DXT5 images to RGBA. The rows of blocks
+// are split across the threads of the pool if there is one.
+void DecompressDXTc(DXTFormat format,
+                    const uint8_t* blocks,
+                    uint32_t width,
+                    uint32_t height,
+                    uint8_t* pixels,
+                    std::size_t pitch,
+                    celestia::util::ThreadPool* pool);
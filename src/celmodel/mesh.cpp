@@ -21,6 +21,7 @@
 #endif
 
 #include "mesh.h"
+#include "meshbvh.h"
 
 using celestia::util::GetLogger;
 
@@ -29,6 +30,9 @@ namespace cmod
 namespace
 {
 
+// Meshes with fewer triangles are picked without building a BVH
+constexpr unsigned int MinBVHTriangles = 64;
+
 bool
 isOpaqueMaterial(const Material &material)
 {
@@ -152,6 +156,12 @@ PrimitiveGroup::getPrimitiveCount() const
 }
 
 
+Mesh::Mesh() = default;
+Mesh::~Mesh() = default;
+Mesh::Mesh(Mesh&&) = default;
+Mesh& Mesh::operator=(Mesh&&) = default;
+
+
 Mesh
 Mesh::clone() const
 {
@@ -170,6 +180,7 @@ Mesh::clone() const
 void
 Mesh::setVertices(unsigned int _nVertices, std::vector<VWord>&& vertexData)
 {
+    bvh.reset();
     nVertices = _nVertices;
     vertices = std::move(vertexData);
 }
@@ -178,6 +189,7 @@ Mesh::setVertices(unsigned int _nVertices, std::vector<VWord>&& vertexData)
 bool
 Mesh::setVertexDescription(VertexDescription&& desc)
 {
+    bvh.reset();
     if (!desc.validate())
         return false;
 
@@ -205,6 +217,9 @@ Mesh::getGroup(unsigned int index) const
 PrimitiveGroup*
 Mesh::getGroup(unsigned int index)
 {
+    // The caller may modify the group
+    bvh.reset();
+
     if (index >= groups.size())
         return nullptr;
 
@@ -215,6 +230,7 @@ Mesh::getGroup(unsigned int index)
 unsigned int
 Mesh::addGroup(PrimitiveGroup&& group)
 {
+    bvh.reset();
     groups.push_back(std::move(group));
     return groups.size();
 }
@@ -244,6 +260,7 @@ Mesh::getGroupCount() const
 void
 Mesh::clearGroups()
 {
+    bvh.reset();
     groups.clear();
 }
 
@@ -265,6 +282,7 @@ Mesh::setName(std::string&& _name)
 void
 Mesh::remapIndices(const std::vector<Index32>& indexMap)
 {
+    bvh.reset();
     for (auto& group : groups)
     {
         for (auto& index : group.indices)
@@ -298,6 +316,7 @@ Mesh::aggregateByMaterial()
 void
 Mesh::mergePrimitiveGroups()
 {
+    bvh.reset();
     if (groups.size() < 2)
         return;
 
@@ -353,6 +372,7 @@ Mesh::mergePrimitiveGroups()
 void
 Mesh::optimize()
 {
+    bvh.reset();
 #ifdef HAVE_MESHOPTIMIZER
     if (groups.size() > 1)
         return;
@@ -367,12 +387,33 @@ Mesh::optimize()
 
 bool
 Mesh::pick(const Eigen::Vector3d& rayOrigin, const Eigen::Vector3d& rayDirection, PickResult* result) const
+{
+    // Pick will automatically fail without vertex positions--no reasonable
+    // mesh should lack these.
+    if (vertexDesc.getAttribute(VertexAttributeSemantic::Position).semantic != VertexAttributeSemantic::Position ||
+        vertexDesc.getAttribute(VertexAttributeSemantic::Position).format != VertexAttributeFormat::Float3)
+    {
+        return false;
+    }
+
+    if (bvh == nullptr)
+    {
+        if (getPrimitiveCount() < MinBVHTriangles)
+            return pickExhaustive(rayOrigin, rayDirection, result);
+
+        bvh = std::make_unique<MeshBVH>(*this);
+    }
+
+    return bvh->pick(*this, rayOrigin, rayDirection, result);
+}
+
+
+bool
+Mesh::pickExhaustive(const Eigen::Vector3d& rayOrigin, const Eigen::Vector3d& rayDirection, PickResult* result) const
 {
     double maxDistance = 1.0e30;
     double closest = maxDistance;
 
-    // Pick will automatically fail without vertex positions--no reasonable
-    // mesh should lack these.
     if (vertexDesc.getAttribute(VertexAttributeSemantic::Position).semantic != VertexAttributeSemantic::Position ||
         vertexDesc.getAttribute(VertexAttributeSemantic::Position).format != VertexAttributeFormat::Float3)
     {
@@ -383,69 +424,26 @@ Mesh::pick(const Eigen::Vector3d& rayOrigin, const Eigen::Vector3d& rayDirection
     unsigned int posOffset = vertexDesc.getAttribute(VertexAttributeSemantic::Position).offsetWords;
     const VWord* vdata = vertices.data();
 
-    // Iterate over all primitive groups in the mesh
+    auto position = [&](Index32 index)
+    {
+        float fv[3];
+        std::memcpy(fv, vdata + index * stride + posOffset, sizeof(float) * 3);
+        return Eigen::Map<Eigen::Vector3f>(fv).cast<double>().eval();
+    };
+
+    // Iterate over the triangles of all primitive groups in the mesh
     for (const auto& group : groups)
     {
-        PrimitiveGroupType primType = group.prim;
-        Index32 nIndices = group.indices.size();
-
-        // Only attempt to compute the intersection of the ray with triangle
-        // groups.
-        if ((primType == PrimitiveGroupType::TriList
-             || primType == PrimitiveGroupType::TriStrip
-             || primType == PrimitiveGroupType::TriFan) &&
-            (nIndices >= 3) &&
-            !(primType == PrimitiveGroupType::TriList && nIndices % 3 != 0))
-        {
-            unsigned int primitiveIndex = 0;
-            Index32 index = 0;
-            Index32 i0 = group.indices[0];
-            Index32 i1 = group.indices[1];
-            Index32 i2 = group.indices[2];
-
-            // Iterate over the triangles in the primitive group
-            do
-            {
-                // Get the triangle vertices v0, v1, and v2
-                float fv[3];
-                std::memcpy(fv, vdata + i0 * stride + posOffset, sizeof(float) * 3);
-                Eigen::Vector3d v0 = Eigen::Map<Eigen::Vector3f>(fv).cast<double>();
-                std::memcpy(fv, vdata + i1 * stride + posOffset, sizeof(float) * 3);
-                Eigen::Vector3d v1 = Eigen::Map<Eigen::Vector3f>(fv).cast<double>();
-                std::memcpy(fv, vdata + i2 * stride + posOffset, sizeof(float) * 3);
-                Eigen::Vector3d v2 = Eigen::Map<Eigen::Vector3f>(fv).cast<double>();
-
-                // Compute the edge vectors e0 and e1, and the normal n
-                Eigen::Vector3d e0 = v1 - v0;
-                Eigen::Vector3d e1 = v2 - v0;
-                Eigen::Vector3d n = e0.cross(e1);
-
-                // c is the cosine of the angle between the ray and triangle normal
-                double c = n.dot(rayDirection);
-
-                // If the ray is parallel to the triangle, it either misses the
-                // triangle completely, or is contained in the triangle's plane.
-                // If it's contained in the plane, we'll still call it a miss.
-                if (c != 0.0)
-                {
-                    double t = (n.dot(v0 - rayOrigin)) / c;
-                    if (t < closest && t > 0.0)
-                    {
-                        double m00 = e0.dot(e0);
-                        double m01 = e0.dot(e1);
-                        double m10 = e1.dot(e0);
-                        double m11 = e1.dot(e1);
-                        double det = m00 * m11 - m01 * m10;
-                        if (det != 0.0)
+        ForEachTriangle(group,
+                        [&](Index32 i0, Index32 i1, Index32 i2, unsigned int primitiveIndex)
                         {
-                            Eigen::Vector3d p = rayOrigin + rayDirection * t;
-                            Eigen::Vector3d q = p - v0;
-                            double q0 = e0.dot(q);
-                            double q1 = e1.dot(q);
-                            double d = 1.0 / det;
-                            double s0 = (m11 * q0 - m01 * q1) * d;
-                            double s1 = (m00 * q1 - m10 * q0) * d;
-                            if (s0 >= 0.0 && s1 >= 0.0 && s0 + s1 <= 1.0)
+                            if (i0 >= nVertices || i1 >= nVertices || i2 >= nVertices)
+                                return;
+
+                            double t;
+                            if (IntersectTriangle(rayOrigin, rayDirection,
+                                                  position(i0), position(i1), position(i2),
+                                                  closest, t))
                             {
                                 closest = t;
                                 if (result)
@@ -455,47 +453,7 @@ Mesh::pick(const Eigen::Vector3d& rayOrigin, const Eigen::Vector3d& rayDirection
                                     result->distance = closest;
                                 }
                             }
-                        }
-                    }
-                }
-
-                // Get the indices for the next triangle
-                if (primType == PrimitiveGroupType::TriList)
-                {
-                    index += 3;
-                    if (index < nIndices)
-                    {
-                        i0 = group.indices[index + 0];
-                        i1 = group.indices[index + 1];
-                        i2 = group.indices[index + 2];
-                    }
-                }
-                else if (primType == PrimitiveGroupType::TriStrip)
-                {
-                    index += 1;
-                    if (index < nIndices)
-                    {
-                        i0 = i1;
-                        i1 = i2;
-                        i2 = group.indices[index];
-                        // TODO: alternate orientation of triangles in a strip
-                    }
-                }
-                else // primType == TriFan
-                {
-                    index += 1;
-                    if (index < nIndices)
-                    {
-                        index += 1;
-                        i1 = i2;
-                        i2 = group.indices[index];
-                    }
-                }
-
-                primitiveIndex++;
-
-            } while (index < nIndices);
-        }
+                        });
     }
 
     return closest != maxDistance;
@@ -568,6 +526,8 @@ Mesh::transform(const Eigen::Vector3f& translation, float scale)
     if (vertexDesc.getAttribute(VertexAttributeSemantic::Position).format != VertexAttributeFormat::Float3)
         return;
 
+    bvh.reset();
+
     VWord* vdata = vertices.data() + vertexDesc.getAttribute(VertexAttributeSemantic::Position).offsetWords;
     unsigned int i;
 
@@ -611,6 +571,7 @@ Mesh::getPrimitiveCount() const
 void
 Mesh::merge(const Mesh &other)
 {
+    bvh.reset();
     auto &ti = groups.front().indices;
     const auto &oi = other.groups.front().indices;
 
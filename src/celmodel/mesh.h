@@ -13,6 +13,7 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -153,6 +154,9 @@ bool operator==(const VertexDescription& a, const VertexDescription& b);
 bool operator<(const VertexDescription& a, const VertexDescription& b);
 
 
+class MeshBVH;
+
+
 struct PrimitiveGroup
 {
     PrimitiveGroup() = default;
@@ -185,12 +189,12 @@ class Mesh
         double distance{ -1.0 };
     };
 
-    Mesh() = default;
-    ~Mesh() = default;
+    Mesh();
+    ~Mesh();
     Mesh(const Mesh&) = delete;
     Mesh& operator=(const Mesh&) = delete;
-    Mesh(Mesh&&) = default;
-    Mesh& operator=(Mesh&&) = default;
+    Mesh(Mesh&&);
+    Mesh& operator=(Mesh&&);
 
     Mesh clone() const;
 
@@ -219,9 +223,18 @@ class Mesh
     const std::string& getName() const;
     void setName(std::string&&);
 
+    /*! Find the closest intersection of the ray with the triangles of the
+     *  mesh. For large meshes, a bounding volume hierarchy is built on the
+     *  first call and reused until the mesh geometry is modified.
+     */
     bool pick(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, PickResult* result) const;
     bool pick(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, double& distance) const;
 
+    /*! Find the closest intersection of the ray by testing every triangle
+     *  of the mesh.
+     */
+    bool pickExhaustive(const Eigen::Vector3d& origin, const Eigen::Vector3d& direction, PickResult* result) const;
+
     Eigen::AlignedBox<float, 3> getBoundingBox() const;
     void transform(const Eigen::Vector3f& translation, float scale);
 
@@ -245,6 +258,9 @@ class Mesh
     std::vector<PrimitiveGroup> groups;
 
     std::string name;
+
+    // Built lazily by pick(), reset when the geometry changes
+    mutable std::unique_ptr<MeshBVH> bvh;
 };
 
 } // namespace cmod
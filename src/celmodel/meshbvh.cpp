@@ -0,0 +1,416 @@
+// meshbvh.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#include <Eigen/Geometry>
+
+#include "meshbvh.h"
+
+
+namespace cmod
+{
+namespace
+{
+
+constexpr unsigned int BinCount = 16;
+constexpr unsigned int MaxLeafSize = 4;
+
+// Cost of visiting a node, relative to the cost of a ray-triangle test
+constexpr float TraversalCost = 1.0f;
+
+constexpr double MaxDistance = 1.0e30;
+
+
+float
+surfaceArea(const Eigen::AlignedBox<float, 3>& box)
+{
+    if (box.isEmpty())
+        return 0.0f;
+
+    Eigen::Vector3f d = box.sizes();
+    return 2.0f * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+}
+
+
+bool
+intersectBox(const Eigen::Vector3d& origin,
+             const Eigen::Vector3d& invDirection,
+             const Eigen::Vector3f& lower,
+             const Eigen::Vector3f& upper,
+             double maxDistance,
+             double& tEntry)
+{
+    Eigen::Vector3d t0 = (lower.cast<double>() - origin).cwiseProduct(invDirection);
+    Eigen::Vector3d t1 = (upper.cast<double>() - origin).cwiseProduct(invDirection);
+    double tmin = t0.cwiseMin(t1).maxCoeff();
+    double tmax = t0.cwiseMax(t1).minCoeff();
+
+    tEntry = tmin;
+    return tmax >= std::max(tmin, 0.0) && tmin < maxDistance;
+}
+
+
+// Accessor for the vertex positions of a mesh
+class PositionReader
+{
+ public:
+    explicit PositionReader(const Mesh& mesh) :
+        vdata(mesh.getVertexData()),
+        stride(mesh.getVertexStrideWords()),
+        offset(mesh.getVertexDescription().getAttribute(VertexAttributeSemantic::Position).offsetWords)
+    {
+    }
+
+    Eigen::Vector3f operator()(Index32 index) const
+    {
+        float fv[3];
+        std::memcpy(fv, vdata + index * stride + offset, sizeof(float) * 3);
+        return Eigen::Map<Eigen::Vector3f>(fv);
+    }
+
+ private:
+    const VWord* vdata;
+    unsigned int stride;
+    unsigned int offset;
+};
+
+} // end unnamed namespace
+
+
+bool
+IntersectTriangle(const Eigen::Vector3d& origin,
+                  const Eigen::Vector3d& direction,
+                  const Eigen::Vector3d& v0,
+                  const Eigen::Vector3d& v1,
+                  const Eigen::Vector3d& v2,
+                  double maxDistance,
+                  double& t)
+{
+    // Compute the edge vectors e0 and e1, and the normal n
+    Eigen::Vector3d e0 = v1 - v0;
+    Eigen::Vector3d e1 = v2 - v0;
+    Eigen::Vector3d n = e0.cross(e1);
+
+    // c is the cosine of the angle between the ray and triangle normal
+    double c = n.dot(direction);
+
+    // If the ray is parallel to the triangle, it either misses the
+    // triangle completely, or is contained in the triangle's plane.
+    // If it's contained in the plane, we'll still call it a miss.
+    if (c == 0.0)
+        return false;
+
+    double tPlane = (n.dot(v0 - origin)) / c;
+    if (!(tPlane < maxDistance && tPlane > 0.0))
+        return false;
+
+    double m00 = e0.dot(e0);
+    double m01 = e0.dot(e1);
+    double m10 = e1.dot(e0);
+    double m11 = e1.dot(e1);
+    double det = m00 * m11 - m01 * m10;
+    if (det == 0.0)
+        return false;
+
+    Eigen::Vector3d p = origin + direction * tPlane;
+    Eigen::Vector3d q = p - v0;
+    double q0 = e0.dot(q);
+    double q1 = e1.dot(q);
+    double d = 1.0 / det;
+    double s0 = (m11 * q0 - m01 * q1) * d;
+    double s1 = (m00 * q1 - m10 * q0) * d;
+    if (s0 >= 0.0 && s1 >= 0.0 && s0 + s1 <= 1.0)
+    {
+        t = tPlane;
+        return true;
+    }
+
+    return false;
+}
+
+
+MeshBVH::MeshBVH(const Mesh& mesh)
+{
+    build(mesh);
+}
+
+
+void
+MeshBVH::build(const Mesh& mesh)
+{
+    PositionReader position(mesh);
+    unsigned int nVertices = mesh.getVertexCount();
+
+    for (unsigned int g = 0; g < mesh.getGroupCount(); g++)
+    {
+        ForEachTriangle(*mesh.getGroup(g),
+                        [&](Index32 i0, Index32 i1, Index32 i2, unsigned int primitiveIndex)
+                        {
+                            if (i0 < nVertices && i1 < nVertices && i2 < nVertices)
+                                triangles.push_back({ { i0, i1, i2 }, g, primitiveIndex });
+                        });
+    }
+
+    if (triangles.empty())
+        return;
+
+    auto nTriangles = static_cast<std::uint32_t>(triangles.size());
+
+    // Bounding boxes and centroids of the triangles; the build partitions
+    // the order array and the triangles are permuted once it's complete.
+    std::vector<Eigen::AlignedBox<float, 3>> bounds;
+    std::vector<Eigen::Vector3f> centroids;
+    std::vector<std::uint32_t> order(nTriangles);
+    bounds.reserve(nTriangles);
+    centroids.reserve(nTriangles);
+    for (std::uint32_t i = 0; i < nTriangles; i++)
+    {
+        const Triangle& tri = triangles[i];
+        Eigen::AlignedBox<float, 3> box(position(tri.indices[0]));
+        box.extend(position(tri.indices[1]));
+        box.extend(position(tri.indices[2]));
+        bounds.push_back(box);
+        centroids.push_back(box.center());
+        order[i] = i;
+    }
+
+    struct BuildItem
+    {
+        std::uint32_t node;
+        std::uint32_t begin;
+        std::uint32_t end;
+    };
+
+    // Build the tree iteratively; recursion depth isn't bounded for
+    // pathological meshes.
+    nodes.reserve(2 * nTriangles / MaxLeafSize + 1);
+    nodes.push_back({});
+    std::vector<BuildItem> work;
+    work.push_back({ 0, 0, nTriangles });
+
+    while (!work.empty())
+    {
+        BuildItem item = work.back();
+        work.pop_back();
+
+        Eigen::AlignedBox<float, 3> nodeBounds;
+        Eigen::AlignedBox<float, 3> centroidBounds;
+        for (std::uint32_t i = item.begin; i < item.end; i++)
+        {
+            nodeBounds.extend(bounds[order[i]]);
+            centroidBounds.extend(centroids[order[i]]);
+        }
+
+        Node& node = nodes[item.node];
+        node.lower = nodeBounds.min();
+        node.upper = nodeBounds.max();
+        node.offset = item.begin;
+        node.count = item.end - item.begin;
+
+        if (node.count <= 1)
+            continue;
+
+        // Bin the centroids along the axis of greatest extent
+        Eigen::Vector3f extents = centroidBounds.sizes();
+        int axis;
+        float extent = extents.maxCoeff(&axis);
+        if (extent <= 0.0f)
+            continue;
+
+        float binScale = static_cast<float>(BinCount) / extent;
+        float binBase = centroidBounds.min()[axis];
+        auto binIndex = [&](std::uint32_t tri)
+        {
+            auto bin = static_cast<unsigned int>((centroids[tri][axis] - binBase) * binScale);
+            return std::min(bin, BinCount - 1);
+        };
+
+        std::array<unsigned int, BinCount> binCounts{};
+        std::array<Eigen::AlignedBox<float, 3>, BinCount> binBounds;
+        for (std::uint32_t i = item.begin; i < item.end; i++)
+        {
+            unsigned int bin = binIndex(order[i]);
+            binCounts[bin]++;
+            binBounds[bin].extend(bounds[order[i]]);
+        }
+
+        // Sweep from the right to get the cost of the right side of each
+        // candidate split, then from the left to find the cheapest split.
+        std::array<float, BinCount> rightCost{};
+        Eigen::AlignedBox<float, 3> rightBounds;
+        unsigned int rightCount = 0;
+        for (unsigned int bin = BinCount - 1; bin > 0; bin--)
+        {
+            rightBounds.extend(binBounds[bin]);
+            rightCount += binCounts[bin];
+            rightCost[bin - 1] = rightCount == 0 ? -1.0f : surfaceArea(rightBounds) * static_cast<float>(rightCount);
+        }
+
+        float bestCost = -1.0f;
+        unsigned int bestBin = 0;
+        Eigen::AlignedBox<float, 3> leftBounds;
+        unsigned int leftCount = 0;
+        for (unsigned int bin = 0; bin < BinCount - 1; bin++)
+        {
+            leftBounds.extend(binBounds[bin]);
+            leftCount += binCounts[bin];
+            if (leftCount == 0 || rightCost[bin] < 0.0f)
+                continue;
+
+            float cost = surfaceArea(leftBounds) * static_cast<float>(leftCount) + rightCost[bin];
+            if (bestCost < 0.0f || cost < bestCost)
+            {
+                bestCost = cost;
+                bestBin = bin;
+            }
+        }
+
+        if (bestCost < 0.0f)
+            continue;
+
+        // Keep small ranges as leaves when splitting doesn't pay off
+        float splitCost = TraversalCost + bestCost / surfaceArea(nodeBounds);
+        if (node.count <= MaxLeafSize && splitCost >= static_cast<float>(node.count))
+            continue;
+
+        auto middle = std::partition(order.begin() + item.begin, order.begin() + item.end,
+                                     [&](std::uint32_t tri) { return binIndex(tri) <= bestBin; });
+        auto mid = static_cast<std::uint32_t>(middle - order.begin());
+
+        auto left = static_cast<std::uint32_t>(nodes.size());
+        node.offset = left;
+        node.count = 0;
+        nodes.resize(nodes.size() + 2);
+
+        work.push_back({ left + 1, mid, item.end });
+        work.push_back({ left, item.begin, mid });
+    }
+
+    std::vector<Triangle> sorted;
+    sorted.reserve(nTriangles);
+    for (std::uint32_t i : order)
+        sorted.push_back(triangles[i]);
+    triangles = std::move(sorted);
+}
+
+
+bool
+MeshBVH::pick(const Mesh& mesh,
+              const Eigen::Vector3d& origin,
+              const Eigen::Vector3d& direction,
+              Mesh::PickResult* result) const
+{
+    if (nodes.empty())
+        return false;
+
+    // Avoid infinities, so that rays parallel to a slab don't produce NaNs
+    Eigen::Vector3d invDirection;
+    for (int i = 0; i < 3; i++)
+    {
+        invDirection[i] = direction[i] != 0.0
+            ? 1.0 / direction[i]
+            : std::copysign(MaxDistance * MaxDistance, direction[i]);
+    }
+
+    struct StackEntry
+    {
+        std::uint32_t node;
+        double tEntry;
+    };
+
+    double tEntry;
+    if (!intersectBox(origin, invDirection, nodes[0].lower, nodes[0].upper, MaxDistance, tEntry))
+        return false;
+
+    PositionReader position(mesh);
+    double closest = MaxDistance;
+    const Triangle* closestTriangle = nullptr;
+
+    std::vector<StackEntry> stack;
+    stack.reserve(64);
+    stack.push_back({ 0, tEntry });
+
+    while (!stack.empty())
+    {
+        StackEntry entry = stack.back();
+        stack.pop_back();
+
+        // Skip nodes that are farther than an intersection found since
+        // they were pushed.
+        if (entry.tEntry >= closest)
+            continue;
+
+        const Node& node = nodes[entry.node];
+        if (node.count != 0)
+        {
+            for (std::uint32_t i = node.offset; i < node.offset + node.count; i++)
+            {
+                const Triangle& tri = triangles[i];
+                double t;
+                if (IntersectTriangle(origin, direction,
+                                      position(tri.indices[0]).cast<double>(),
+                                      position(tri.indices[1]).cast<double>(),
+                                      position(tri.indices[2]).cast<double>(),
+                                      closest, t))
+                {
+                    closest = t;
+                    closestTriangle = &tri;
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first
+        const Node& left = nodes[node.offset];
+        const Node& right = nodes[node.offset + 1];
+        double tLeft;
+        double tRight;
+        bool hitLeft = intersectBox(origin, invDirection, left.lower, left.upper, closest, tLeft);
+        bool hitRight = intersectBox(origin, invDirection, right.lower, right.upper, closest, tRight);
+        if (hitLeft && hitRight)
+        {
+            if (tLeft <= tRight)
+            {
+                stack.push_back({ node.offset + 1, tRight });
+                stack.push_back({ node.offset, tLeft });
+            }
+            else
+            {
+                stack.push_back({ node.offset, tLeft });
+                stack.push_back({ node.offset + 1, tRight });
+            }
+        }
+        else if (hitLeft)
+        {
+            stack.push_back({ node.offset, tLeft });
+        }
+        else if (hitRight)
+        {
+            stack.push_back({ node.offset + 1, tRight });
+        }
+    }
+
+    if (closestTriangle == nullptr)
+        return false;
+
+    if (result != nullptr)
+    {
+        result->group = mesh.getGroup(closestTriangle->group);
+        result->primitiveIndex = closestTriangle->primitiveIndex;
+        result->distance = closest;
+    }
+
+    return true;
+}
+
+} // namespace cmod
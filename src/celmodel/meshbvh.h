@@ -0,0 +1,119 @@
+// meshbvh.h
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "mesh.h"
+
+
+namespace cmod
+{
+
+/*! Call fn(i0, i1, i2, primitiveIndex) for each triangle of a primitive
+ *  group. Groups that are not made up of triangles are skipped.
+ */
+template<typename F>
+void
+ForEachTriangle(const PrimitiveGroup& group, F&& fn)
+{
+    auto nIndices = static_cast<unsigned int>(group.indices.size());
+    if (nIndices < 3)
+        return;
+
+    const Index32* indices = group.indices.data();
+    switch (group.prim)
+    {
+    case PrimitiveGroupType::TriList:
+        if (nIndices % 3 != 0)
+            return;
+        for (unsigned int i = 0; i < nIndices / 3; i++)
+            fn(indices[i * 3], indices[i * 3 + 1], indices[i * 3 + 2], i);
+        break;
+    case PrimitiveGroupType::TriStrip:
+        // Winding order doesn't matter for picking
+        for (unsigned int i = 0; i < nIndices - 2; i++)
+            fn(indices[i], indices[i + 1], indices[i + 2], i);
+        break;
+    case PrimitiveGroupType::TriFan:
+        for (unsigned int i = 0; i < nIndices - 2; i++)
+            fn(indices[0], indices[i + 1], indices[i + 2], i);
+        break;
+    default:
+        break;
+    }
+}
+
+
+/*! Compute the intersection of a ray with the triangle v0 v1 v2. Return
+ *  true and set t to the distance along the ray if there is an
+ *  intersection closer than maxDistance.
+ */
+bool IntersectTriangle(const Eigen::Vector3d& origin,
+                       const Eigen::Vector3d& direction,
+                       const Eigen::Vector3d& v0,
+                       const Eigen::Vector3d& v1,
+                       const Eigen::Vector3d& v2,
+                       double maxDistance,
+                       double& t);
+
+
+/*! A bounding volume hierarchy over the triangles of a mesh, used to
+ *  accelerate picking. The hierarchy is built with a binned surface area
+ *  heuristic and stored as a flat array of nodes. It doesn't keep a
+ *  reference to the mesh, so the same mesh must be passed to pick(), and
+ *  the hierarchy must be rebuilt whenever the mesh geometry changes.
+ */
+class MeshBVH
+{
+ public:
+    explicit MeshBVH(const Mesh& mesh);
+    ~MeshBVH() = default;
+    MeshBVH(const MeshBVH&) = delete;
+    MeshBVH& operator=(const MeshBVH&) = delete;
+
+    bool pick(const Mesh& mesh,
+              const Eigen::Vector3d& origin,
+              const Eigen::Vector3d& direction,
+              Mesh::PickResult* result) const;
+
+    std::size_t getNodeCount() const { return nodes.size(); }
+    std::size_t getTriangleCount() const { return triangles.size(); }
+
+ private:
+    struct Triangle
+    {
+        Index32 indices[3];
+        std::uint32_t group;
+        std::uint32_t primitiveIndex;
+    };
+
+    // Interior nodes have count == 0, and their children are stored at
+    // offset and offset + 1. Leaf nodes refer to count triangles starting
+    // at offset.
+    struct Node
+    {
+        Eigen::Vector3f lower;
+        Eigen::Vector3f upper;
+        std::uint32_t offset;
+        std::uint32_t count;
+    };
+
+    void build(const Mesh& mesh);
+
+    std::vector<Node> nodes;
+    std::vector<Triangle> triangles;
+};
+
+} // namespace cmod
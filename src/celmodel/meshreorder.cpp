@@ -0,0 +1,441 @@
+// meshreorder.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Triangle ordering follows Sander, Nehab and Barczak, "Fast Triangle
+// Reordering for Vertex Locality and Reduced Overdraw", SIGGRAPH 2007.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include "mesh.h"
+#include "meshreorder.h"
+
+
+namespace cmod
+{
+namespace
+{
+
+// FIFO post-transform cache simulation. A vertex is in the cache if it
+// was transformed less than cacheSize misses ago.
+class FifoCache
+{
+ public:
+    FifoCache(unsigned int _cacheSize, unsigned int nVertices) :
+        cacheSize(_cacheSize),
+        time(_cacheSize + 1),
+        timestamps(nVertices, 0)
+    {
+    }
+
+    // Return the number of misses for the triangle
+    unsigned int addTriangle(const Index32* tri)
+    {
+        unsigned int misses = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            if (time - timestamps[tri[i]] > cacheSize)
+            {
+                timestamps[tri[i]] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    }
+
+    void clear()
+    {
+        time += cacheSize + 1;
+    }
+
+ private:
+    unsigned int cacheSize;
+    unsigned int time;
+    std::vector<unsigned int> timestamps;
+};
+
+
+bool
+isValidTriangleList(const PrimitiveGroup& group, unsigned int nVertices)
+{
+    if (group.prim != PrimitiveGroupType::TriList ||
+        group.indices.empty() ||
+        group.indices.size() % 3 != 0)
+    {
+        return false;
+    }
+
+    return std::all_of(group.indices.begin(), group.indices.end(),
+                       [nVertices](Index32 i) { return i < nVertices; });
+}
+
+
+// Tipsify: emit triangle fans around vertices chosen to keep the fan's
+// vertices in the cache. The start of each cluster of triangles emitted
+// after a dead end, where the cache contents are unrelated to the next
+// fan, is recorded in clusters.
+std::vector<Index32>
+optimizeVertexCache(const std::vector<Index32>& indices,
+                    unsigned int nVertices,
+                    unsigned int cacheSize,
+                    std::vector<std::size_t>& clusters)
+{
+    std::size_t nTriangles = indices.size() / 3;
+
+    // Triangles adjacent to each vertex
+    std::vector<unsigned int> liveCount(nVertices, 0);
+    for (Index32 i : indices)
+        liveCount[i]++;
+
+    std::vector<std::size_t> offsets(nVertices + 1, 0);
+    for (unsigned int v = 0; v < nVertices; v++)
+        offsets[v + 1] = offsets[v] + liveCount[v];
+
+    std::vector<std::uint32_t> adjacency(indices.size());
+    {
+        std::vector<std::size_t> fill(offsets.begin(), offsets.end() - 1);
+        for (std::size_t i = 0; i < indices.size(); i++)
+            adjacency[fill[indices[i]]++] = static_cast<std::uint32_t>(i / 3);
+    }
+
+    std::vector<unsigned int> timestamps(nVertices, 0);
+    std::vector<bool> emitted(nTriangles, false);
+    std::vector<Index32> deadEnd;
+    deadEnd.reserve(indices.size());
+
+    std::vector<Index32> output;
+    output.reserve(indices.size());
+
+    unsigned int time = cacheSize + 1;
+    unsigned int cursor = 0;
+
+    // Return a vertex with live triangles from the dead end stack, or
+    // failing that, the next one in input order.
+    auto skipDeadEnd = [&]() -> std::int64_t
+    {
+        while (!deadEnd.empty())
+        {
+            Index32 v = deadEnd.back();
+            deadEnd.pop_back();
+            if (liveCount[v] > 0)
+                return v;
+        }
+
+        for (; cursor < nVertices; cursor++)
+        {
+            if (liveCount[cursor] > 0)
+                return cursor;
+        }
+
+        return -1;
+    };
+
+    std::int64_t fan = skipDeadEnd();
+    clusters.push_back(0);
+    while (fan >= 0)
+    {
+        std::size_t firstCandidate = deadEnd.size();
+
+        // Emit all remaining triangles adjacent to the fan vertex
+        for (std::size_t a = offsets[fan]; a < offsets[fan + 1]; a++)
+        {
+            std::uint32_t t = adjacency[a];
+            if (emitted[t])
+                continue;
+
+            for (int k = 0; k < 3; k++)
+            {
+                Index32 v = indices[t * 3 + k];
+                output.push_back(v);
+                deadEnd.push_back(v);
+                liveCount[v]--;
+                if (time - timestamps[v] > cacheSize)
+                    timestamps[v] = time++;
+            }
+            emitted[t] = true;
+        }
+
+        // Choose the next fan vertex among the vertices just emitted,
+        // preferring ones that will still be in the cache when all their
+        // remaining triangles are emitted.
+        std::int64_t next = -1;
+        std::int64_t bestPriority = -1;
+        for (std::size_t i = firstCandidate; i < deadEnd.size(); i++)
+        {
+            Index32 v = deadEnd[i];
+            if (liveCount[v] == 0)
+                continue;
+
+            std::int64_t priority = 0;
+            if (time - timestamps[v] + 2 * liveCount[v] <= cacheSize)
+                priority = time - timestamps[v];
+
+            if (priority > bestPriority)
+            {
+                bestPriority = priority;
+                next = v;
+            }
+        }
+
+        if (next < 0)
+        {
+            next = skipDeadEnd();
+            if (next >= 0)
+                clusters.push_back(output.size() / 3);
+        }
+
+        fan = next;
+    }
+
+    return output;
+}
+
+
+// Split the clusters produced by Tipsify further at points where the ACMR
+// of the triangles so far is within threshold of the cluster's ACMR, then
+// sort the clusters so that those facing away from the mesh centroid are
+// drawn first. These tend to occlude the others.
+void
+optimizeOverdraw(std::vector<Index32>& indices,
+                 const std::vector<std::size_t>& hardClusters,
+                 const std::vector<Eigen::Vector3f>& positions,
+                 unsigned int cacheSize,
+                 float threshold)
+{
+    std::size_t nTriangles = indices.size() / 3;
+    FifoCache cache(cacheSize, static_cast<unsigned int>(positions.size()));
+
+    std::vector<std::size_t> clusters;
+    for (std::size_t c = 0; c < hardClusters.size(); c++)
+    {
+        std::size_t start = hardClusters[c];
+        std::size_t end = c + 1 < hardClusters.size() ? hardClusters[c + 1] : nTriangles;
+
+        cache.clear();
+        std::size_t clusterMisses = 0;
+        for (std::size_t t = start; t < end; t++)
+            clusterMisses += cache.addTriangle(&indices[t * 3]);
+        double clusterThreshold = threshold * static_cast<double>(clusterMisses) / static_cast<double>(end - start);
+
+        cache.clear();
+        clusters.push_back(start);
+        std::size_t softStart = start;
+        std::size_t misses = 0;
+        for (std::size_t t = start; t < end - 1; t++)
+        {
+            misses += cache.addTriangle(&indices[t * 3]);
+            if (static_cast<double>(misses) <= clusterThreshold * static_cast<double>(t + 1 - softStart))
+            {
+                clusters.push_back(t + 1);
+                softStart = t + 1;
+                misses = 0;
+                cache.clear();
+            }
+        }
+    }
+
+    if (clusters.size() < 2)
+        return;
+
+    // Area weighted centroid and normal of each cluster
+    std::size_t nClusters = clusters.size();
+    std::vector<Eigen::Vector3d> centroids(nClusters, Eigen::Vector3d::Zero());
+    std::vector<Eigen::Vector3d> normals(nClusters, Eigen::Vector3d::Zero());
+    std::vector<double> areas(nClusters, 0.0);
+    Eigen::Vector3d meshCentroid = Eigen::Vector3d::Zero();
+    double meshArea = 0.0;
+    for (std::size_t c = 0; c < nClusters; c++)
+    {
+        std::size_t end = c + 1 < nClusters ? clusters[c + 1] : nTriangles;
+        for (std::size_t t = clusters[c]; t < end; t++)
+        {
+            Eigen::Vector3d v0 = positions[indices[t * 3]].cast<double>();
+            Eigen::Vector3d v1 = positions[indices[t * 3 + 1]].cast<double>();
+            Eigen::Vector3d v2 = positions[indices[t * 3 + 2]].cast<double>();
+            Eigen::Vector3d n = (v1 - v0).cross(v2 - v0);
+            double area = n.norm();
+
+            centroids[c] += (v0 + v1 + v2) * (area / 3.0);
+            normals[c] += n;
+            areas[c] += area;
+        }
+
+        meshCentroid += centroids[c];
+        meshArea += areas[c];
+        if (areas[c] > 0.0)
+            centroids[c] /= areas[c];
+    }
+
+    if (meshArea > 0.0)
+        meshCentroid /= meshArea;
+
+    std::vector<double> sortKeys(nClusters);
+    for (std::size_t c = 0; c < nClusters; c++)
+    {
+        double length = normals[c].norm();
+        sortKeys[c] = length > 0.0 ? (centroids[c] - meshCentroid).dot(normals[c]) / length : 0.0;
+    }
+
+    std::vector<std::size_t> order(nClusters);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](std::size_t a, std::size_t b) { return sortKeys[a] > sortKeys[b]; });
+
+    std::vector<Index32> sorted;
+    sorted.reserve(indices.size());
+    for (std::size_t c : order)
+    {
+        std::size_t end = c + 1 < nClusters ? clusters[c + 1] : nTriangles;
+        sorted.insert(sorted.end(), indices.begin() + clusters[c] * 3, indices.begin() + end * 3);
+    }
+
+    indices = std::move(sorted);
+}
+
+
+// Reorder the vertices of the mesh in the order that they're first
+// referenced. Unreferenced vertices are moved to the end.
+void
+optimizeVertexFetch(Mesh& mesh)
+{
+    unsigned int nVertices = mesh.getVertexCount();
+    constexpr Index32 Unused = ~Index32(0);
+    std::vector<Index32> remap(nVertices, Unused);
+    Index32 next = 0;
+    for (unsigned int g = 0; g < mesh.getGroupCount(); g++)
+    {
+        for (Index32 i : mesh.getGroup(g)->indices)
+        {
+            if (i < nVertices && remap[i] == Unused)
+                remap[i] = next++;
+        }
+    }
+
+    for (auto& i : remap)
+    {
+        if (i == Unused)
+            i = next++;
+    }
+
+    unsigned int stride = mesh.getVertexStrideWords();
+    const VWord* vertexData = mesh.getVertexData();
+    std::vector<VWord> newVertexData(static_cast<std::size_t>(nVertices) * stride);
+    for (unsigned int v = 0; v < nVertices; v++)
+    {
+        std::memcpy(newVertexData.data() + static_cast<std::size_t>(remap[v]) * stride,
+                    vertexData + static_cast<std::size_t>(v) * stride,
+                    stride * sizeof(VWord));
+    }
+
+    mesh.setVertices(nVertices, std::move(newVertexData));
+    mesh.remapIndices(remap);
+}
+
+} // end unnamed namespace
+
+
+double
+VertexCacheStatistics::acmr() const
+{
+    return triangleCount == 0 ? 0.0 : static_cast<double>(transformCount) / static_cast<double>(triangleCount);
+}
+
+
+double
+VertexCacheStatistics::atvr() const
+{
+    return vertexCount == 0 ? 0.0 : static_cast<double>(transformCount) / static_cast<double>(vertexCount);
+}
+
+
+VertexCacheStatistics&
+VertexCacheStatistics::operator+=(const VertexCacheStatistics& other)
+{
+    triangleCount += other.triangleCount;
+    vertexCount += other.vertexCount;
+    transformCount += other.transformCount;
+    return *this;
+}
+
+
+VertexCacheStatistics
+AnalyzeVertexCache(const Mesh& mesh, unsigned int cacheSize)
+{
+    VertexCacheStatistics stats;
+    unsigned int nVertices = mesh.getVertexCount();
+    std::vector<bool> referenced(nVertices, false);
+    FifoCache cache(cacheSize, nVertices);
+
+    for (unsigned int g = 0; g < mesh.getGroupCount(); g++)
+    {
+        const PrimitiveGroup* group = mesh.getGroup(g);
+        if (!isValidTriangleList(*group, nVertices))
+            continue;
+
+        // Each group is drawn separately, starting with a cold cache
+        cache.clear();
+        for (std::size_t i = 0; i < group->indices.size(); i += 3)
+            stats.transformCount += cache.addTriangle(&group->indices[i]);
+        stats.triangleCount += group->indices.size() / 3;
+
+        for (Index32 i : group->indices)
+            referenced[i] = true;
+    }
+
+    stats.vertexCount = std::count(referenced.begin(), referenced.end(), true);
+    return stats;
+}
+
+
+bool
+ReorderMesh(Mesh& mesh, unsigned int cacheSize, float overdrawThreshold)
+{
+    unsigned int nVertices = mesh.getVertexCount();
+
+    // Positions are needed to sort clusters for overdraw
+    std::vector<Eigen::Vector3f> positions;
+    const VertexAttribute& posAttr = mesh.getVertexDescription().getAttribute(VertexAttributeSemantic::Position);
+    if (posAttr.format == VertexAttributeFormat::Float3)
+    {
+        unsigned int stride = mesh.getVertexStrideWords();
+        const VWord* vertexData = mesh.getVertexData() + posAttr.offsetWords;
+        positions.resize(nVertices);
+        for (unsigned int v = 0; v < nVertices; v++)
+            std::memcpy(positions[v].data(), vertexData + static_cast<std::size_t>(v) * stride, sizeof(float) * 3);
+    }
+
+    bool reordered = false;
+    for (unsigned int g = 0; g < mesh.getGroupCount(); g++)
+    {
+        const PrimitiveGroup* group = static_cast<const Mesh&>(mesh).getGroup(g);
+        if (!isValidTriangleList(*group, nVertices))
+            continue;
+
+        std::vector<std::size_t> clusters;
+        std::vector<Index32> indices = optimizeVertexCache(group->indices, nVertices, cacheSize, clusters);
+        if (!positions.empty() && overdrawThreshold >= 1.0f)
+            optimizeOverdraw(indices, clusters, positions, cacheSize, overdrawThreshold);
+
+        mesh.getGroup(g)->indices = std::move(indices);
+        reordered = true;
+    }
+
+    if (reordered)
+        optimizeVertexFetch(mesh);
+
+    return reordered;
+}
+
+} // namespace cmod
@@ -0,0 +1,52 @@
+// meshreorder.h
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Reorder the triangles and vertices of a mesh for efficient rendering.
+
+#pragma once
+
+#include <cstddef>
+
+
+namespace cmod
+{
+class Mesh;
+
+struct VertexCacheStatistics
+{
+    std::size_t triangleCount{ 0 };
+    // Distinct vertices referenced by the triangles
+    std::size_t vertexCount{ 0 };
+    // Vertices transformed, i.e. post-transform cache misses
+    std::size_t transformCount{ 0 };
+
+    // Average cache miss ratio: transformed vertices per triangle
+    double acmr() const;
+    // Average transformed vertex ratio: transformed vertices per vertex
+    double atvr() const;
+
+    VertexCacheStatistics& operator+=(const VertexCacheStatistics&);
+};
+
+/*! Simulate a FIFO post-transform vertex cache with cacheSize entries
+ *  while drawing the triangle list groups of a mesh.
+ */
+VertexCacheStatistics AnalyzeVertexCache(const Mesh& mesh, unsigned int cacheSize);
+
+/*! Reorder the triangles of each triangle list group of the mesh for
+ *  vertex cache efficiency using the Tipsify algorithm. Clusters of
+ *  triangles are then sorted so that outward facing ones are drawn first,
+ *  reducing overdraw, as long as the ACMR doesn't increase by more than
+ *  a factor of overdrawThreshold. Finally, vertices are reordered by first
+ *  use to improve vertex fetch locality. Other primitive groups are left
+ *  as they are. Returns false if the mesh contains no triangle lists.
+ */
+bool ReorderMesh(Mesh& mesh, unsigned int cacheSize = 16, float overdrawThreshold = 1.05f);
+
+} // namespace cmod
@@ -24,6 +24,7 @@
 #include <celutil/logger.h>
 #include <celutil/tokenizer.h>
 #include "mesh.h"
+#include "meshreorder.h"
 #include "model.h"
 #include "modelfile.h"
 
@@ -1917,7 +1918,7 @@ OpenModel(std::istream& in, HandleGetter& getHandle)
 
 
 std::unique_ptr<Model>
-LoadModel(std::istream& in, HandleGetter handleGetter)
+LoadModel(std::istream& in, HandleGetter handleGetter, bool reorderMeshes)
 {
     std::unique_ptr<ModelLoader> loader = OpenModel(in, handleGetter);
     if (loader == nullptr)
@@ -1928,6 +1929,11 @@ LoadModel(std::istream& in, HandleGetter handleGetter)
     {
         celutil::GetLogger()->error("Error in model file: {}\n", loader->getErrorMessage());
     }
+    else if (reorderMeshes)
+    {
+        for (unsigned int i = 0; i < model->getMeshCount(); i++)
+            ReorderMesh(*model->getMesh(i));
+    }
 
     return model;
 }
@@ -24,7 +24,11 @@ namespace cmod
 using HandleGetter = std::function<ResourceHandle(const fs::path&)>;
 using SourceGetter = std::function<fs::path(ResourceHandle)>;
 
-std::unique_ptr<Model> LoadModel(std::istream& in, HandleGetter getHandle);
+/*! Load a model from a cmod file. If reorderMeshes is true, the triangles
+ *  and vertices of the meshes are reordered for rendering efficiency; see
+ *  ReorderMesh().
+ */
+std::unique_ptr<Model> LoadModel(std::istream& in, HandleGetter getHandle, bool reorderMeshes = false);
 
 bool SaveModelAscii(const Model* model, std::ostream& out, SourceGetter getSource);
 bool SaveModelBinary(const Model* model, std::ostream& out, SourceGetter getSource);
@@ -53,6 +53,7 @@ public:
     bool isAlive() const;
     bool timesliceExpired();
     void requestIO();
+    bool isIOAllowed() const { return ioMode == IOAllowed; }
 
     bool charEntered(const char*);
     double getTime() const;
@@ -9,14 +9,20 @@
 // as published by the Free Software Foundation; either version 2
 // of the License, or (at your option) any later version.
 
+#include <algorithm>
+#include <cctype>
+#include <fstream>
 #include <iostream>
 #include <optional>
+#include <unordered_set>
 
 #include <fmt/format.h>
 
 #include <celcompat/filesystem.h>
+#include <celengine/catalogquery.h>
 #include <celengine/category.h>
 #include <celengine/texture.h>
+#include <celmath/mathlib.h>
 #include <celestia/audiosession.h>
 #include <celestia/url.h>
 #include <celestia/celestiacore.h>
@@ -26,6 +32,7 @@
 #include <celutil/gettext.h>
 #include <celutil/logger.h>
 #include <celutil/stringutils.h>
+#include <celutil/threadpool.h>
 #include "celx.h"
 #include "celx_internal.h"
 #include "celx_celestia.h"
@@ -1486,6 +1493,231 @@ static int celestia_dsos(lua_State* l)
     return 1;
 }
 
+// Read the search criteria table at index of celestia:findstars() or
+// celestia:finddsos(). Positions are in the universal frame, distances in
+// light years and angles in degrees.
+static void getCatalogQuery(lua_State* l, int index, CelestiaCore* appCore, bool stars,
+                            CatalogQuery& query, bool& catalogNumbers)
+{
+    const char* funcName = stars ? "celestia:findstars()" : "celestia:finddsos()";
+    Simulation* sim = appCore->getSimulation();
+    UniversalCoord observer = sim->getActiveObserver()->getPosition();
+    std::optional<Vector3d> direction;
+    std::optional<Selection> directionObject;
+    std::optional<double> coneAngle;
+
+    catalogNumbers = false;
+    if (lua_isnoneornil(l, index))
+    {
+        query.observer = observer.toLy();
+        return;
+    }
+
+    if (!lua_istable(l, index))
+    {
+        Celx_DoError(l, fmt::format("Argument to {} must be a table", funcName).c_str());
+        return;
+    }
+
+    lua_pushnil(l);
+    while (lua_next(l, index) != 0)
+    {
+        if (lua_type(l, -2) != LUA_TSTRING)
+        {
+            Celx_DoError(l, fmt::format("Keys in table-argument to {} must be strings", funcName).c_str());
+            return;
+        }
+        string key = lua_tostring(l, -2);
+
+        auto getNumber = [&]()
+        {
+            if (!lua_isnumber(l, -1))
+                Celx_DoError(l, fmt::format("Value of {} in table-argument to {} must be a number", key, funcName).c_str());
+            return lua_tonumber(l, -1);
+        };
+
+        if (key == "position")
+        {
+            UniversalCoord* uc = to_position(l, -1);
+            if (uc == nullptr)
+            {
+                Celx_DoError(l, fmt::format("Value of position in table-argument to {} must be a position", funcName).c_str());
+                return;
+            }
+            observer = *uc;
+        }
+        else if (key == "direction")
+        {
+            if (Selection* sel = to_object(l, -1); sel != nullptr)
+                directionObject = *sel;
+            else if (Vector3d* v = to_vector(l, -1); v != nullptr && !v->isZero())
+                direction = v->normalized();
+            else
+            {
+                Celx_DoError(l, fmt::format("Value of direction in table-argument to {} must be an object or a non-zero vector", funcName).c_str());
+                return;
+            }
+        }
+        else if (key == "coneangle")
+            coneAngle = celmath::degToRad(getNumber());
+        else if (key == "mindistance")
+            query.minDistance = static_cast<float>(getNumber());
+        else if (key == "maxdistance")
+            query.maxDistance = static_cast<float>(getNumber());
+        else if (key == "minappmag")
+            query.minAppMag = static_cast<float>(getNumber());
+        else if (key == "maxappmag")
+            query.maxAppMag = static_cast<float>(getNumber());
+        else if (key == "minabsmag")
+            query.minAbsMag = static_cast<float>(getNumber());
+        else if (key == "maxabsmag")
+            query.maxAbsMag = static_cast<float>(getNumber());
+        else if (key == "maxresults")
+            query.maxResults = static_cast<uint32_t>(std::clamp(getNumber(), 0.0, static_cast<double>(query.maxResults)));
+        else if (key == "sortby")
+        {
+            string sortKey = lua_isstring(l, -1) ? lua_tostring(l, -1) : "";
+            if (sortKey == "distance")
+                query.sortKey = CatalogQuery::SortKey::Distance;
+            else if (sortKey == "appmag")
+                query.sortKey = CatalogQuery::SortKey::ApparentMagnitude;
+            else if (sortKey == "absmag")
+                query.sortKey = CatalogQuery::SortKey::AbsoluteMagnitude;
+            else
+            {
+                Celx_DoError(l, fmt::format("Value of sortby in table-argument to {} must be distance, appmag or absmag", funcName).c_str());
+                return;
+            }
+        }
+        else if (key == "catalognumbers")
+            catalogNumbers = lua_toboolean(l, -1) != 0;
+        else if (key == "spectralclass" && stars)
+        {
+            // A string of the leading letters of the spectral types to match
+            const char* classes = lua_isstring(l, -1) ? lua_tostring(l, -1) : "";
+            query.spectralClassMask = 0;
+            for (const char* c = classes; *c != '\0'; c++)
+            {
+                uint32_t bit = CatalogQuery::spectralClassBit(static_cast<char>(std::toupper(static_cast<unsigned char>(*c))));
+                if (bit == 0)
+                {
+                    Celx_DoError(l, "Value of spectralclass in table-argument to celestia:findstars() must be a string of letters");
+                    return;
+                }
+                query.spectralClassMask |= bit;
+            }
+        }
+        else if (key == "types" && !stars)
+        {
+            // A table of render flag names: galaxies, globulars, nebulae, openclusters
+            if (!lua_istable(l, -1))
+            {
+                Celx_DoError(l, "Value of types in table-argument to celestia:finddsos() must be a table");
+                return;
+            }
+            const auto& renderFlags = appCore->scriptMaps()->RenderFlagMap;
+            query.dsoTypeMask = 0;
+            for (int i = 1; ; i++)
+            {
+                lua_rawgeti(l, -1, i);
+                if (lua_isnil(l, -1))
+                {
+                    lua_pop(l, 1);
+                    break;
+                }
+                auto flag = lua_isstring(l, -1) ? renderFlags.find(lua_tostring(l, -1)) : renderFlags.end();
+                if (flag == renderFlags.end())
+                {
+                    Celx_DoError(l, "Values of types in table-argument to celestia:finddsos() must be render flag names");
+                    return;
+                }
+                query.dsoTypeMask |= flag->second;
+                lua_pop(l, 1);
+            }
+        }
+        else
+        {
+            Celx_DoError(l, fmt::format("Unknown key {} in table-argument to {}", key, funcName).c_str());
+            return;
+        }
+
+        lua_pop(l, 1);
+    }
+
+    query.observer = observer.toLy();
+    if (directionObject.has_value())
+    {
+        Vector3d offset = directionObject->getPosition(sim->getTime()).offsetFromKm(observer);
+        if (!offset.isZero())
+            direction = offset.normalized();
+    }
+
+    if (direction.has_value() != coneAngle.has_value())
+    {
+        Celx_DoError(l, fmt::format("direction and coneangle must be given together to {}", funcName).c_str());
+        return;
+    }
+
+    if (direction.has_value())
+    {
+        query.coneAxis = *direction;
+        query.coneAngle = *coneAngle;
+    }
+}
+
+// Return the stars matching the search criteria as a table of objects, or
+// of catalog numbers. All stars are returned if there are no criteria.
+static int celestia_findstars(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 2, "No or one argument expected for celestia:findstars()");
+    CelestiaCore* appCore = this_celestia(l);
+
+    CatalogQuery query;
+    bool catalogNumbers = false;
+    getCatalogQuery(l, 2, appCore, true, query, catalogNumbers);
+
+    vector<const Star*> stars;
+    appCore->getSimulation()->getUniverse()->getStarCatalog()->findStars(stars, query);
+
+    lua_createtable(l, static_cast<int>(stars.size()), 0);
+    for (size_t i = 0; i < stars.size(); i++)
+    {
+        if (catalogNumbers)
+            lua_pushnumber(l, stars[i]->getIndex());
+        else
+            object_new(l, Selection(const_cast<Star*>(stars[i])));
+        lua_rawseti(l, -2, static_cast<int>(i + 1));
+    }
+
+    return 1;
+}
+
+// Same as celestia:findstars() for deep sky objects
+static int celestia_finddsos(lua_State* l)
+{
+    Celx_CheckArgs(l, 1, 2, "No or one argument expected for celestia:finddsos()");
+    CelestiaCore* appCore = this_celestia(l);
+
+    CatalogQuery query;
+    bool catalogNumbers = false;
+    getCatalogQuery(l, 2, appCore, false, query, catalogNumbers);
+
+    vector<const DeepSkyObject*> dsos;
+    appCore->getSimulation()->getUniverse()->getDSOCatalog()->findDSOs(dsos, query);
+
+    lua_createtable(l, static_cast<int>(dsos.size()), 0);
+    for (size_t i = 0; i < dsos.size(); i++)
+    {
+        if (catalogNumbers)
+            lua_pushnumber(l, dsos[i]->getIndex());
+        else
+            object_new(l, Selection(const_cast<DeepSkyObject*>(dsos[i])));
+        lua_rawseti(l, -2, static_cast<int>(i + 1));
+    }
+
+    return 1;
+}
+
 static int celestia_setambient(lua_State* l)
 {
     Celx_CheckArgs(l, 2, 2, "One argument expected in celestia:setambient");
@@ -1762,6 +1994,281 @@ static int celestia_getdso(lua_State* l)
 }
 
 
+// Read either a single object or an array of objects at index.
+static void getObjectList(lua_State* l, int index, const char* errorMsg, vector<Selection>& objects)
+{
+    if (Selection* sel = to_object(l, index); sel != nullptr)
+    {
+        objects.push_back(*sel);
+        return;
+    }
+
+    if (!lua_istable(l, index))
+    {
+        Celx_DoError(l, errorMsg);
+        return;
+    }
+
+    for (int i = 1; ; i++)
+    {
+        lua_rawgeti(l, index, i);
+        if (lua_isnil(l, -1))
+        {
+            lua_pop(l, 1);
+            break;
+        }
+
+        Selection* sel = to_object(l, -1);
+        if (sel == nullptr)
+        {
+            Celx_DoError(l, errorMsg);
+            return;
+        }
+        objects.push_back(*sel);
+        lua_pop(l, 1);
+    }
+}
+
+// Read either an array of times or a table with start, stop and step
+// fields at index.
+static void getTimeList(lua_State* l, int index, const char* errorMsg, vector<double>& times)
+{
+    if (!lua_istable(l, index))
+    {
+        Celx_DoError(l, errorMsg);
+        return;
+    }
+
+    lua_getfield(l, index, "start");
+    bool isRange = !lua_isnil(l, -1);
+    lua_pop(l, 1);
+
+    if (isRange)
+    {
+        // Guard against scripts accidentally requesting an unbounded amount of memory
+        constexpr double MaxTimeSteps = 1.0e8;
+
+        auto getField = [&](const char* key)
+        {
+            lua_getfield(l, index, key);
+            if (!lua_isnumber(l, -1))
+                Celx_DoError(l, errorMsg);
+            double value = lua_tonumber(l, -1);
+            lua_pop(l, 1);
+            return value;
+        };
+
+        double start = getField("start");
+        double stop = getField("stop");
+        double step = getField("step");
+        if (!(step > 0.0) || stop < start || (stop - start) / step >= MaxTimeSteps)
+        {
+            Celx_DoError(l, errorMsg);
+            return;
+        }
+
+        auto nSteps = static_cast<size_t>((stop - start) / step);
+        times.reserve(nSteps + 1);
+        for (size_t i = 0; i <= nSteps; i++)
+            times.push_back(start + static_cast<double>(i) * step);
+        return;
+    }
+
+    for (int i = 1; ; i++)
+    {
+        lua_rawgeti(l, index, i);
+        if (lua_isnil(l, -1))
+        {
+            lua_pop(l, 1);
+            break;
+        }
+
+        if (!lua_isnumber(l, -1))
+        {
+            Celx_DoError(l, errorMsg);
+            return;
+        }
+        times.push_back(lua_tonumber(l, -1));
+        lua_pop(l, 1);
+    }
+}
+
+// Compute the positions in kilometers of the objects at each time,
+// relative to the center of the frame and in its orientation. Positions
+// are stored object by object, with x, y and z for each time. The frame
+// center and orientation are evaluated only once per time, and the
+// conversion uses double precision after taking the difference with the
+// center instead of rotating with fixed point arithmetic.
+//
+// Large requests are split by time over worker threads, unless an object
+// or the frame depends on an orbit or rotation which can't be evaluated
+// concurrently, e.g. a scripted one.
+static void computePositions(const vector<Selection>& objects,
+                             const vector<double>& times,
+                             const ReferenceFrame& frame,
+                             vector<double>& positions)
+{
+    constexpr size_t MinParallelPositions = 10000;
+    constexpr size_t TimesPerTask = 64;
+
+    positions.resize(objects.size() * times.size() * 3);
+
+    Selection center = frame.getCenter();
+    auto computeTimes = [&](size_t begin, size_t end)
+    {
+        for (size_t j = begin; j < end; j++)
+        {
+            double t = times[j];
+            UniversalCoord centerPos = center.getPosition(t);
+            Matrix3d rotation = frame.getOrientation(t).toRotationMatrix();
+
+            for (size_t i = 0; i < objects.size(); i++)
+            {
+                Vector3d p = rotation * objects[i].getPosition(t).offsetFromKm(centerPos);
+                double* dest = &positions[(i * times.size() + j) * 3];
+                dest[0] = p.x();
+                dest[1] = p.y();
+                dest[2] = p.z();
+            }
+        }
+    };
+
+    bool threadSafe = false;
+    if (objects.size() * times.size() >= MinParallelPositions && times.size() > TimesPerTask)
+    {
+        vector<Selection> references(objects);
+        frame.getReferencedObjects(references);
+
+        std::unordered_set<const Body*> checkedBodies;
+        threadSafe = std::all_of(references.begin(), references.end(),
+                                 [&](const Selection& sel) { return sel.isThreadSafe(checkedBodies); });
+    }
+
+    if (threadSafe)
+    {
+        celestia::util::ThreadPool pool;
+        pool.parallelFor(times.size(), TimesPerTask, computeTimes);
+    }
+    else
+    {
+        computeTimes(0, times.size());
+    }
+}
+
+// Read the object, time and optional frame arguments shared by
+// celestia:getpositions() and celestia:writepositions(), and compute the
+// positions.
+static void getPositionArgs(lua_State* l, int firstArg, const char* funcName,
+                            vector<Selection>& objects,
+                            vector<double>& times,
+                            vector<double>& positions)
+{
+    getObjectList(l, firstArg,
+                  fmt::format("First argument to {} must be an object or a table of objects", funcName).c_str(),
+                  objects);
+    getTimeList(l, firstArg + 1,
+                fmt::format("Second argument to {} must be a table of times or a start, stop, step table", funcName).c_str(),
+                times);
+
+    // Guard against an unbounded amount of memory, and against results
+    // which can't be indexed by a Lua table. Each position is 3 values.
+    constexpr size_t MaxPositions = 100000000;
+    if (!times.empty() && objects.size() > MaxPositions / times.size())
+    {
+        Celx_DoError(l, fmt::format("Too many positions requested from {}", funcName).c_str());
+        return;
+    }
+
+    ObserverFrame universal;
+    const ObserverFrame* frame = &universal;
+    if (lua_gettop(l) >= firstArg + 2)
+    {
+        frame = to_frame(l, firstArg + 2);
+        if (frame == nullptr)
+        {
+            Celx_DoError(l, fmt::format("Third argument to {} must be a frame", funcName).c_str());
+            return;
+        }
+    }
+
+    // make sure we don't timeout because of a long computation:
+    LuaState* luastate = getLuaStateObject(l);
+    double timeToTimeout = luastate->timeout - luastate->getTime();
+    computePositions(objects, times, *frame->getFrame(), positions);
+    luastate->timeout = luastate->getTime() + timeToTimeout;
+}
+
+static int celestia_getpositions(lua_State* l)
+{
+    Celx_CheckArgs(l, 3, 4, "Two or three arguments expected for celestia:getpositions()");
+    this_celestia(l);
+
+    vector<Selection> objects;
+    vector<double> times;
+    vector<double> positions;
+    getPositionArgs(l, 2, "celestia:getpositions()", objects, times, positions);
+
+    lua_createtable(l, static_cast<int>(positions.size()), 0);
+    for (size_t i = 0; i < positions.size(); i++)
+    {
+        lua_pushnumber(l, positions[i]);
+        lua_rawseti(l, -2, static_cast<int>(i + 1));
+    }
+
+    return 1;
+}
+
+static int celestia_writepositions(lua_State* l)
+{
+    Celx_CheckArgs(l, 4, 5, "Three or four arguments expected for celestia:writepositions()");
+    this_celestia(l);
+
+    LuaState* luastate = getLuaStateObject(l);
+    if (!luastate->isIOAllowed())
+    {
+        Celx_DoError(l, "celestia:writepositions() requires system access, see celestia:requestsystemaccess()");
+        return 0;
+    }
+
+    fs::path filename = Celx_SafeGetString(l, 2, AllErrors, "First argument to celestia:writepositions() must be a string");
+
+    vector<Selection> objects;
+    vector<double> times;
+    vector<double> positions;
+    getPositionArgs(l, 3, "celestia:writepositions()", objects, times, positions);
+
+    bool csv = compareIgnoringCase(filename.extension().string(), ".csv") == 0;
+    ofstream out(filename, csv ? ios::out : ios::out | ios::binary);
+    if (!out.good())
+    {
+        GetLogger()->error("Error opening {} for writing.\n", filename);
+        lua_pushboolean(l, false);
+        return 1;
+    }
+
+    if (csv)
+    {
+        out << "object,jd,x,y,z\n";
+        for (size_t i = 0; i < objects.size(); i++)
+        {
+            string name = objects[i].getName();
+            for (size_t j = 0; j < times.size(); j++)
+            {
+                const double* p = &positions[(i * times.size() + j) * 3];
+                out << fmt::format("\"{}\",{:.9f},{:.17g},{:.17g},{:.17g}\n", name, times[j], p[0], p[1], p[2]);
+            }
+        }
+    }
+    else
+    {
+        out.write(reinterpret_cast<const char*>(positions.data()), positions.size() * sizeof(double));
+    }
+
+    lua_pushboolean(l, out.good());
+    return 1;
+}
+
+
 static int celestia_newvector(lua_State* l)
 {
     Celx_CheckArgs(l, 4, 4, "Expected 3 arguments for celestia:newvector");
@@ -2597,6 +3104,8 @@ void CreateCelestiaMetaTable(lua_State* l)
     Celx_RegisterMethod(l, "getdsocount", celestia_getdsocount);
     Celx_RegisterMethod(l, "getstar", celestia_getstar);
     Celx_RegisterMethod(l, "getdso", celestia_getdso);
+    Celx_RegisterMethod(l, "getpositions", celestia_getpositions);
+    Celx_RegisterMethod(l, "writepositions", celestia_writepositions);
     Celx_RegisterMethod(l, "newframe", celestia_newframe);
     Celx_RegisterMethod(l, "newvector", celestia_newvector);
     Celx_RegisterMethod(l, "newposition", celestia_newposition);
@@ -2612,6 +3121,8 @@ void CreateCelestiaMetaTable(lua_State* l)
     Celx_RegisterMethod(l, "geteventhandler", celestia_geteventhandler);
     Celx_RegisterMethod(l, "stars", celestia_stars);
     Celx_RegisterMethod(l, "dsos", celestia_dsos);
+    Celx_RegisterMethod(l, "findstars", celestia_findstars);
+    Celx_RegisterMethod(l, "finddsos", celestia_finddsos);
     Celx_RegisterMethod(l, "windowbordersvisible", celestia_windowbordersvisible);
     Celx_RegisterMethod(l, "setwindowbordersvisible", celestia_setwindowbordersvisible);
     Celx_RegisterMethod(l, "seturl", celestia_seturl);
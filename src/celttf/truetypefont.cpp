@@ -8,7 +8,6 @@
 // of the License, or (at your option) any later version.
 
 #include <algorithm>
-#include <array>
 #include <celcompat/charconv.h>
 #include <celengine/glsupport.h>
 #include <celengine/render.h>
@@ -16,17 +15,13 @@
 #include <celutil/utf8.h>
 #include <ft2build.h>
 #include <map>
+#include <memory>
 #include <system_error>
+#include <unordered_map>
 #include <vector>
 #include FT_FREETYPE_H
 #include "truetypefont.h"
 
-#define DUMP_TEXTURE 0
-
-#if DUMP_TEXTURE
-#include <fstream>
-#endif
-
 using celestia::compat::from_chars;
 using celestia::util::GetLogger;
 
@@ -43,15 +38,174 @@ struct Glyph
     int bl; // bitmap_left;
     int bt; // bitmap_top;
 
-    float tx; // x offset of glyph in texture coordinates
-    float ty; // y offset of glyph in texture coordinates
+    int page; // atlas page holding the bitmap, -1 if there's no bitmap
+    int x;    // x offset of glyph in the page, in pixels
+    int y;    // y offset of glyph in the page, in pixels
 };
 
-struct UnicodeBlock
-{
-    wchar_t first, last;
+// A texture holding glyph bitmaps. Glyphs are packed into shelves, rows as
+// high as the glyph which opened them; a glyph goes into the lowest shelf
+// it fits in. The page starts small and its height is doubled when it is
+// full, until it is square. Bitmaps are copied to a CPU side copy of the
+// page and uploaded together before text using the page is drawn.
+struct AtlasPage
+{
+    AtlasPage(int _width, int _height);
+    ~AtlasPage();
+    AtlasPage(const AtlasPage &) = delete;
+    AtlasPage &operator=(const AtlasPage &) = delete;
+
+    bool place(int w, int h, int &x, int &y);
+    bool canGrow() const { return height < width; }
+    void grow();
+    void copy(const FT_Bitmap &bitmap, int x, int y);
+    void bind();
+
+    struct Shelf
+    {
+        int y;
+        int height;
+        int x;
+    };
+
+    int width;
+    int height;
+    std::vector<std::uint8_t> pixels;
+    std::vector<Shelf> shelves;
+    int top{ 0 };
+
+    GLuint texName{ 0 };
+    // Rows changed since the last upload
+    int dirtyTop;
+    int dirtyBottom{ 0 };
+    bool resized{ true };
 };
 
+AtlasPage::AtlasPage(int _width, int _height) :
+    width(_width),
+    height(_height),
+    pixels(static_cast<std::size_t>(_width) * static_cast<std::size_t>(_height)),
+    dirtyTop(_height)
+{
+}
+
+AtlasPage::~AtlasPage()
+{
+    if (texName != 0) glDeleteTextures(1, &texName);
+}
+
+// Find room for a w x h bitmap, returning false when the page is full at
+// its current height.
+bool
+AtlasPage::place(int w, int h, int &x, int &y)
+{
+    Shelf *best = nullptr;
+    for (auto &shelf : shelves)
+    {
+        if (shelf.height >= h && shelf.x + w <= width &&
+            (best == nullptr || shelf.height < best->height))
+        {
+            best = &shelf;
+        }
+    }
+
+    if (best == nullptr)
+    {
+        if (top + h > height || w > width) return false;
+        best = &shelves.emplace_back(Shelf{ top, h, 0 });
+        top += h;
+    }
+
+    x = best->x;
+    y = best->y;
+    best->x += w;
+    return true;
+}
+
+void
+AtlasPage::grow()
+{
+    height = std::min(height * 2, width);
+    pixels.resize(static_cast<std::size_t>(width) * static_cast<std::size_t>(height));
+    resized = true;
+}
+
+void
+AtlasPage::copy(const FT_Bitmap &bitmap, int x, int y)
+{
+    for (unsigned int row = 0; row < bitmap.rows; row++)
+    {
+        std::copy_n(bitmap.buffer + row * bitmap.pitch,
+                    bitmap.width,
+                    pixels.begin() + (y + row) * width + x);
+    }
+
+    dirtyTop    = std::min(dirtyTop, y);
+    dirtyBottom = std::max(dirtyBottom, y + static_cast<int>(bitmap.rows));
+}
+
+// Bind the texture of the page, uploading the glyphs added since the last
+// time.
+void
+AtlasPage::bind()
+{
+    if (texName == 0)
+    {
+        glGenTextures(1, &texName);
+        glBindTexture(GL_TEXTURE_2D, texName);
+
+        // Clamping to edges is important to prevent artifacts when scaling
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // Linear filtering usually looks best for text
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+#ifndef GL_ES
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+#endif
+    }
+    else
+    {
+        glBindTexture(GL_TEXTURE_2D, texName);
+    }
+
+    if (!resized && dirtyTop >= dirtyBottom) return;
+
+    // We require 1 byte alignment when uploading texture data
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if (resized)
+    {
+        glTexImage2D(GL_TEXTURE_2D,
+                     0,
+                     GL_ALPHA,
+                     width,
+                     height,
+                     0,
+                     GL_ALPHA,
+                     GL_UNSIGNED_BYTE,
+                     pixels.data());
+    }
+    else
+    {
+        glTexSubImage2D(GL_TEXTURE_2D,
+                        0,
+                        0,
+                        dirtyTop,
+                        width,
+                        dirtyBottom - dirtyTop,
+                        GL_ALPHA,
+                        GL_UNSIGNED_BYTE,
+                        pixels.data() + dirtyTop * width);
+    }
+
+    resized     = false;
+    dirtyTop    = height;
+    dirtyBottom = 0;
+}
+
 struct TextureFontPrivate
 {
     struct FontVertex
@@ -68,45 +222,36 @@ struct TextureFontPrivate
     TextureFontPrivate(const Renderer *renderer);
     ~TextureFontPrivate();
     TextureFontPrivate() = delete;
-    TextureFontPrivate(const TextureFontPrivate &) = default;
-    TextureFontPrivate(TextureFontPrivate &&) = default;
-    TextureFontPrivate &operator=(const TextureFontPrivate &) = default;
-    TextureFontPrivate &operator=(TextureFontPrivate &&) = default;
+    TextureFontPrivate(const TextureFontPrivate &) = delete;
+    TextureFontPrivate(TextureFontPrivate &&) = delete;
+    TextureFontPrivate &operator=(const TextureFontPrivate &) = delete;
+    TextureFontPrivate &operator=(TextureFontPrivate &&) = delete;
 
     float render(std::string_view s, float x, float y);
     float render(wchar_t ch, float xoffset, float yoffset);
 
-    bool               buildAtlas();
-    void               computeTextureSize();
-    bool               loadGlyphInfo(wchar_t /*ch*/, Glyph & /*c*/) const;
-    void               initCommonGlyphs();
-    int                getCommonGlyphsCount();
+    bool               addToAtlas(Glyph & /*c*/, const FT_Bitmap & /*bitmap*/);
     Glyph &            getGlyph(wchar_t /*ch*/);
     Glyph &            getGlyph(wchar_t /*ch*/, wchar_t /*fallback*/);
-    [[nodiscard]] int  toPos(wchar_t /*ch*/) const;
-    void               optimize();
+    void               addQuad(const Glyph & /*g*/, float /*x*/, float /*y*/);
     CelestiaGLProgram *getProgram();
     void               flush();
 
     const Renderer    *m_renderer;
     CelestiaGLProgram *m_prog{ nullptr };
 
-    FT_Face m_face; // font face
+    FT_Face m_face{ nullptr }; // font face
 
     int m_maxAscent{ 0 };
     int m_maxDescent{ 0 };
     int m_maxWidth{ 0 };
 
-    int m_texWidth{ 0 };
-    int m_texHeight{ 0 };
-
-    GLuint             m_texName{ 0 };   // texture object
-    std::vector<Glyph> m_glyphs;         // character information
-
-    std::array<UnicodeBlock, 2> m_unicodeBlocks;
-    int                         m_commonGlyphsCount{ 0 };
-
-    int m_inserted{ 0 };
+    // Glyphs are rasterized and added to the atlas when they are first used
+    std::unordered_map<wchar_t, Glyph>      m_glyphs;
+    std::vector<std::unique_ptr<AtlasPage>> m_pages;
+    int                                     m_pageSize{ 0 };
+    // Page used by the vertices waiting to be drawn
+    int                                     m_currentPage{ -1 };
 
     Eigen::Matrix4f         m_projection;
     Eigen::Matrix4f         m_modelView;
@@ -117,6 +262,9 @@ struct TextureFontPrivate
     static GLuint m_vio;
     static constexpr std::size_t MaxVertices = 256; // This gives BO size 4kB, MUST be multiply of 4
     static constexpr std::size_t MaxIndices = MaxVertices / 4 * 6;
+
+    static constexpr int MaxPageSize = 1024;
+    static constexpr int InitialPageHeight = 64;
 };
 
 GLuint TextureFontPrivate::m_vbo = 0;
@@ -131,19 +279,13 @@ pt_to_px(float pt, int dpi = 96)
     return dpi == 0 ? pt : pt / 72.0f * static_cast<float>(dpi);
 }
 
-Glyph g_badGlyph = { 0, 0, 0, 0, 0, 0, 0, 0.0f, 0.0f };
-
 } // namespace
 
-/*
-   first = ((c / 32) + 1) * 32  == c & ~0xdf
-   last  = first + 32
-*/
-
 TextureFontPrivate::TextureFontPrivate(const Renderer *renderer) : m_renderer(renderer)
 {
-    m_unicodeBlocks[0] = { 0x0020, 0x007E }; // Basic Latin
-    m_unicodeBlocks[1] = { 0x03B1, 0x03CF }; // Lower case Greek
+    m_pageSize = celestia::gl::maxTextureSize > 0
+        ? std::min(MaxPageSize, static_cast<int>(celestia::gl::maxTextureSize))
+        : MaxPageSize;
     if (m_vbo == 0) glGenBuffers(1, &m_vbo);
     if (m_vio == 0) glGenBuffers(1, &m_vio);
 }
@@ -151,206 +293,42 @@ TextureFontPrivate::TextureFontPrivate(const Renderer *renderer) : m_renderer(re
 TextureFontPrivate::~TextureFontPrivate()
 {
     if (m_face != nullptr) FT_Done_Face(m_face);
-    if (m_texName != 0) glDeleteTextures(1, &m_texName);
 }
 
 bool
-TextureFontPrivate::loadGlyphInfo(wchar_t ch, Glyph &c) const
-{
-    FT_GlyphSlot g = m_face->glyph;
-    if (FT_Load_Char(m_face, ch, FT_LOAD_RENDER) != 0)
-    {
-        c.ch = 0;
-        return false;
-    }
-
-    c.ch = ch;
-    c.ax = g->advance.x >> 6;
-    c.ay = g->advance.y >> 6;
-    c.bw = g->bitmap.width;
-    c.bh = g->bitmap.rows;
-    c.bl = g->bitmap_left;
-    c.bt = g->bitmap_top;
-    return true;
-}
-
-void
-TextureFontPrivate::initCommonGlyphs()
+TextureFontPrivate::addToAtlas(Glyph &c, const FT_Bitmap &bitmap)
 {
-    if (!m_glyphs.empty()) return;
+    // Leave a pixel between glyphs
+    int w = static_cast<int>(bitmap.width) + 1;
+    int h = static_cast<int>(bitmap.rows) + 1;
+    if (w > m_pageSize || h > m_pageSize) return false;
 
-    m_glyphs.reserve(256);
+    if (m_pages.empty())
+        m_pages.push_back(std::make_unique<AtlasPage>(m_pageSize, std::min(InitialPageHeight, m_pageSize)));
 
-    for (auto const &block : m_unicodeBlocks)
+    int x, y;
+    while (!m_pages.back()->place(w, h, x, y))
     {
-        for (wchar_t ch = block.first, e = block.last; ch <= e; ch++)
+        if (m_pages.back()->canGrow())
         {
-            Glyph c;
-            if (!loadGlyphInfo(ch, c))
-                GetLogger()->warn("Loading character {:x} failed!\n", static_cast<unsigned>(ch));
-            m_glyphs.push_back(c); // still pushing empty
+            // Texture coordinates of the waiting vertices depend on the
+            // height of the page
+            flush();
+            m_pages.back()->grow();
         }
-    }
-}
-
-void
-TextureFontPrivate::computeTextureSize()
-{
-    int roww = 0;
-    int rowh = 0;
-    int w    = 0;
-    int h    = 0;
-
-    // Find minimum size for a texture holding all visible ASCII characters
-    for (const auto &c : m_glyphs)
-    {
-        if (c.ch == 0) continue; // skip bad glyphs
-
-        if (roww + c.bw + 1 >= celestia::gl::maxTextureSize)
+        else
         {
-            w = std::max(w, roww);
-            h += rowh;
-            roww = 0;
-            rowh = 0;
+            m_pages.push_back(std::make_unique<AtlasPage>(m_pageSize, std::min(InitialPageHeight, m_pageSize)));
         }
-        roww += c.bw + 1;
-        rowh = std::max(rowh, static_cast<int>(c.bh));
     }
 
-    w = std::max(w, roww);
-    h += rowh;
-
-    m_texWidth  = w;
-    m_texHeight = h;
-}
-
-bool
-TextureFontPrivate::buildAtlas()
-{
-    FT_GlyphSlot g = m_face->glyph;
-
-    initCommonGlyphs();
-    computeTextureSize();
-
-    // Create a texture that will be used to hold all glyphs
-    glActiveTexture(GL_TEXTURE0);
-    if (m_texName != 0) glDeleteTextures(1, &m_texName);
-    glGenTextures(1, &m_texName);
-    if (m_texName == 0) return false;
-
-    glBindTexture(GL_TEXTURE_2D, m_texName);
-    glTexImage2D(GL_TEXTURE_2D,
-                 0,
-                 GL_ALPHA,
-                 m_texWidth,
-                 m_texHeight,
-                 0,
-                 GL_ALPHA,
-                 GL_UNSIGNED_BYTE,
-                 nullptr);
-
-    // We require 1 byte alignment when uploading texture data
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-    // Clamping to edges is important to prevent artifacts when scaling
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    // Linear filtering usually looks best for text
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-#ifndef GL_ES
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
-#endif
-
-    // Paste all glyph bitmaps into the texture, remembering the offset
-    int ox = 0;
-    int oy = 0;
-
-    int rowh = 0;
-
-    for (auto &c : m_glyphs)
-    {
-        if (c.ch == 0) continue; // skip bad glyphs
-
-        if (FT_Load_Char(m_face, c.ch, FT_LOAD_RENDER) != 0)
-        {
-            GetLogger()->warn("Loading character {:x} failed!\n", static_cast<unsigned>(c.ch));
-            c.ch = 0;
-            continue;
-        }
-
-        if (ox + int(g->bitmap.width) > int(m_texWidth))
-        {
-            oy += rowh;
-            rowh = 0;
-            ox   = 0;
-        }
-
-        glTexSubImage2D(GL_TEXTURE_2D,
-                        0,
-                        ox,
-                        oy,
-                        g->bitmap.width,
-                        g->bitmap.rows,
-                        GL_ALPHA,
-                        GL_UNSIGNED_BYTE,
-                        g->bitmap.buffer);
-        c.tx = static_cast<float>(ox) / static_cast<float>(m_texWidth);
-        c.ty = static_cast<float>(oy) / static_cast<float>(m_texHeight);
-
-        rowh = std::max(rowh, static_cast<int>(g->bitmap.rows));
-        ox += g->bitmap.width + 1;
-    }
-
-#if DUMP_TEXTURE
-    fmt::print("Generated a {} x {} ({} kb) texture atlas\n",
-               m_texWidth, m_texHeight,
-               m_texWidth * m_texHeight / 1024);
-    size_t   img_size = sizeof(uint8_t) * m_texWidth * m_texHeight * 4;
-    uint8_t *raw_img  = new uint8_t[img_size];
-    glGetTexImage(GL_TEXTURE_2D, 0, GL_BGRA, GL_UNSIGNED_BYTE, raw_img);
-    ofstream f(fmt::format("/tmp/texture_{}x{}.data", m_texWidth, m_texHeight), ios::binary);
-    f.write(reinterpret_cast<char *>(raw_img), img_size);
-    f.close();
-    delete[] raw_img;
-#endif
+    m_pages.back()->copy(bitmap, x, y);
+    c.page = static_cast<int>(m_pages.size()) - 1;
+    c.x    = x;
+    c.y    = y;
     return true;
 }
 
-int
-TextureFontPrivate::getCommonGlyphsCount()
-{
-    if (m_commonGlyphsCount == 0)
-    {
-        for (auto const &block : m_unicodeBlocks)
-            m_commonGlyphsCount += (block.last - block.first + 1);
-    }
-    return m_commonGlyphsCount;
-}
-
-int
-TextureFontPrivate::toPos(wchar_t ch) const
-{
-    int pos = 0;
-
-    if (ch > m_unicodeBlocks.back().last) return -1;
-
-    for (const auto &r : m_unicodeBlocks)
-    {
-        if (ch < r.first) return -1;
-
-        if (ch <= r.last)
-        {
-            return pos + ch - r.first;
-        }
-
-        pos += r.last - r.first + 1;
-    }
-    return -1;
-}
-
 Glyph &
 TextureFontPrivate::getGlyph(wchar_t ch, wchar_t fallback)
 {
@@ -361,33 +339,67 @@ TextureFontPrivate::getGlyph(wchar_t ch, wchar_t fallback)
 Glyph &
 TextureFontPrivate::getGlyph(wchar_t ch)
 {
-    if (auto pos = toPos(ch); pos != -1)
-        return m_glyphs[pos];
+    if (auto it = m_glyphs.find(ch); it != m_glyphs.end())
+        return it->second;
 
-    auto it = std::find_if(m_glyphs.begin() + getCommonGlyphsCount(),
-                           m_glyphs.end(),
-                           [ch](const Glyph &g) { return g.ch == ch; });
+    // Glyphs which fail to load are kept with a null character, so that
+    // they are only tried once
+    Glyph &c = m_glyphs[ch];
+    c = { 0, 0, 0, 0, 0, 0, 0, -1, 0, 0 };
 
-    if (it != m_glyphs.end())
-        return *it;
-
-    Glyph c;
-    if (!loadGlyphInfo(ch, c))
-        return g_badGlyph;
+    FT_GlyphSlot g = m_face->glyph;
+    if (FT_Load_Char(m_face, ch, FT_LOAD_RENDER) != 0)
+    {
+        GetLogger()->warn("Loading character {:x} failed!\n", static_cast<unsigned>(ch));
+        return c;
+    }
 
-    flush(); // render text to avoid garbled output due to changed texture
+    c.ch = ch;
+    c.ax = g->advance.x >> 6;
+    c.ay = g->advance.y >> 6;
+    c.bw = g->bitmap.width;
+    c.bh = g->bitmap.rows;
+    c.bl = g->bitmap_left;
+    c.bt = g->bitmap_top;
 
-    m_glyphs.push_back(c);
-    if (++m_inserted == 10) optimize();
-    buildAtlas();
+    if (c.bw > 0 && c.bh > 0 && !addToAtlas(c, g->bitmap))
+    {
+        GetLogger()->warn("Character {:x} is too large for the font atlas!\n", static_cast<unsigned>(ch));
+        c.bw = 0;
+        c.bh = 0;
+    }
 
-    return m_glyphs.back();
+    return c;
 }
 
 void
-TextureFontPrivate::optimize()
+TextureFontPrivate::addQuad(const Glyph &g, float x, float y)
 {
-    m_inserted = 0;
+    if (g.page != m_currentPage)
+    {
+        flush();
+        m_currentPage = g.page;
+    }
+
+    const AtlasPage &page = *m_pages[g.page];
+
+    // Calculate the vertex and texture coordinates
+    const float x1 = x + g.bl;
+    const float y1 = y + g.bt - g.bh;
+    const float x2 = x1 + g.bw;
+    const float y2 = y1 + g.bh;
+
+    const float tx1 = static_cast<float>(g.x) / static_cast<float>(page.width);
+    const float ty1 = static_cast<float>(g.y) / static_cast<float>(page.height);
+    const float tx2 = static_cast<float>(g.x + g.bw) / static_cast<float>(page.width);
+    const float ty2 = static_cast<float>(g.y + g.bh) / static_cast<float>(page.height);
+
+    m_fontVertices.emplace_back(x1, y1, tx1, ty2);
+    m_fontVertices.emplace_back(x2, y1, tx2, ty2);
+    m_fontVertices.emplace_back(x1, y2, tx1, ty1);
+    m_fontVertices.emplace_back(x2, y2, tx2, ty1);
+
+    if (m_fontVertices.size() == MaxVertices) flush();
 }
 
 /*
@@ -398,11 +410,6 @@ TextureFontPrivate::optimize()
 float
 TextureFontPrivate::render(std::string_view s, float x, float y)
 {
-    if (m_texName == 0) return 0;
-
-    // Use the texture containing the atlas
-    glBindTexture(GL_TEXTURE_2D, m_texName);
-
     // Loop through all characters
     int  len       = s.length();
     bool validChar = true;
@@ -417,32 +424,12 @@ TextureFontPrivate::render(std::string_view s, float x, float y)
 
         auto &g = getGlyph(ch, L'?');
 
-        // Calculate the vertex and texture coordinates
-        const float x1 = x + g.bl;
-        const float y1 = y + g.bt - g.bh;
-        const float w  = g.bw;
-        const float h  = g.bh;
-        const float x2 = x1 + w;
-        const float y2 = y1 + h;
+        // Skip glyphs that have no pixels
+        if (g.page >= 0) addQuad(g, x, y);
 
         // Advance the cursor to the start of the next character
         x += g.ax;
         y += g.ay;
-
-        // Skip glyphs that have no pixels
-        if (g.bw == 0 || g.bh == 0) continue;
-
-        const float tx1 = g.tx;
-        const float ty1 = g.ty;
-        const float tx2 = tx1 + w / m_texWidth;
-        const float ty2 = ty1 + h / m_texHeight;
-
-        m_fontVertices.emplace_back(x1, y1, tx1, ty2);
-        m_fontVertices.emplace_back(x2, y1, tx2, ty2);
-        m_fontVertices.emplace_back(x1, y2, tx1, ty1);
-        m_fontVertices.emplace_back(x2, y2, tx2, ty1);
-
-        if (m_fontVertices.size() == MaxVertices) flush();
     }
 
     return x;
@@ -452,24 +439,7 @@ float
 TextureFontPrivate::render(wchar_t ch, float xoffset, float yoffset)
 {
     auto &g = getGlyph(ch, L'?');
-
-    // Calculate the vertex and texture coordinates
-    const float x1 = xoffset + g.bl;
-    const float y1 = yoffset + g.bt - g.bh;
-    const float x2 = x1 + g.bw;
-    const float y2 = y1 + g.bh;
-
-    const float tx1 = g.tx;
-    const float ty1 = g.ty;
-    const float tx2 = tx1 + static_cast<float>(g.bw) / m_texWidth;
-    const float ty2 = ty1 + static_cast<float>(g.bh) / m_texHeight;
-
-    m_fontVertices.emplace_back(x1, y1, tx1, ty2);
-    m_fontVertices.emplace_back(x2, y1, tx2, ty2);
-    m_fontVertices.emplace_back(x1, y2, tx1, ty1);
-    m_fontVertices.emplace_back(x2, y2, tx2, ty1);
-
-    if (m_fontVertices.size() == MaxVertices) flush();
+    if (g.page >= 0) addQuad(g, xoffset, yoffset);
 
     return g.ax;
 }
@@ -487,6 +457,9 @@ TextureFontPrivate::flush()
 {
     if (m_fontVertices.size() < 4) return;
 
+    glActiveTexture(GL_TEXTURE0);
+    m_pages[m_currentPage]->bind();
+
     std::vector<unsigned short> indexes;
     indexes.reserve(MaxIndices);
     for (unsigned short index = 0; index < static_cast<unsigned short>(m_fontVertices.size()); index += 4)
@@ -663,15 +636,10 @@ TextureFont::bind()
     auto *prog = impl->getProgram();
     if (prog == nullptr) return;
 
-    if (impl->m_texName != 0)
-    {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, impl->m_texName);
-        prog->use();
-        prog->samplerParam("atlasTex") = 0;
-        impl->m_shaderInUse            = true;
-        prog->setMVPMatrices(impl->m_projection, impl->m_modelView);
-    }
+    prog->use();
+    prog->samplerParam("atlasTex") = 0;
+    impl->m_shaderInUse            = true;
+    prog->setMVPMatrices(impl->m_projection, impl->m_modelView);
 }
 
 /**
@@ -809,12 +777,6 @@ LoadTextureFont(const Renderer *r, const fs::path &filename, int index, int size
         ret = std::make_shared<TextureFont>(r);
         ret->impl->m_face = face;
 
-        if (!ret->impl->buildAtlas())
-        {
-            FT_Done_Face(face);
-            return nullptr;
-        }
-
         ret->setMaxAscent(static_cast<int>(face->size->metrics.ascender >> 6));
         ret->setMaxDescent(static_cast<int>(-face->size->metrics.descender >> 6));
 
@@ -10,6 +10,7 @@
 // of the License, or (at your option) any later version.
 
 #include <iostream>
+#include <mutex>
 
 #ifdef _MSC_VER
 #include <windows.h>
@@ -20,6 +21,13 @@
 namespace celestia::util
 {
 
+namespace
+{
+// Messages may be logged from worker threads, and the streams a front-end
+// installs aren't necessarily safe to write to concurrently.
+std::mutex logMutex;
+}
+
 Logger* Logger::g_logger = nullptr;
 
 Logger* GetLogger()
@@ -61,7 +69,9 @@ void Logger::vlog(Level level, fmt::string_view format, fmt::format_args args) c
 #endif
 
     auto &stream = (level <= Level::Warning || level == Level::Debug) ? m_err : m_log;
-    fmt::vprint(stream, format, args);
+    std::string message = fmt::vformat(format, args);
+    std::lock_guard<std::mutex> lock(logMutex);
+    stream << message;
 }
 
 } // end namespace celestia::util
@@ -0,0 +1,119 @@
+// mappedfile.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// Read-only memory mapped files.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "mappedfile.h"
+
+namespace celestia::util
+{
+
+MappedFile::MappedFile(const fs::path& path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(file);
+        return;
+    }
+
+    // The view keeps the mapping object, and the mapping object keeps the
+    // file, so both handles can be closed as soon as the view exists.
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (mapping == nullptr)
+        return;
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (view == nullptr)
+        return;
+
+    m_data = static_cast<const char*>(view);
+    m_size = static_cast<std::size_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        ::close(fd);
+        return;
+    }
+
+    void* addr = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+        return;
+
+    m_data = static_cast<const char*>(addr);
+    m_size = static_cast<std::size_t>(st.st_size);
+#endif
+}
+
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+    m_data(std::exchange(other.m_data, nullptr)),
+    m_size(std::exchange(other.m_size, 0))
+{
+}
+
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        m_data = std::exchange(other.m_data, nullptr);
+        m_size = std::exchange(other.m_size, 0);
+    }
+    return *this;
+}
+
+
+void MappedFile::close()
+{
+    if (m_data == nullptr)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+#else
+    ::munmap(const_cast<char*>(m_data), m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+} // end namespace celestia::util
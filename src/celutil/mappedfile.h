@@ -0,0 +1,50 @@
+// mappedfile.h
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// Read-only memory mapped files.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <cstddef>
+
+#include <celcompat/filesystem.h>
+
+namespace celestia::util
+{
+
+/**
+ * Read-only view of a whole file mapped into the address space of the
+ * process. Pages are only read from disk when they are first touched, so
+ * the cost of opening a large catalog depends on how much of it is used
+ * rather than on its size.
+ */
+class MappedFile
+{
+ public:
+    MappedFile() = default;
+    explicit MappedFile(const fs::path&);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) noexcept;
+    MappedFile& operator=(MappedFile&&) noexcept;
+
+    bool isOpen() const { return m_data != nullptr; }
+    const char* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+    void close();
+
+ private:
+    const char* m_data{ nullptr };
+    std::size_t m_size{ 0 };
+};
+
+} // end namespace celestia::util
@@ -10,9 +10,15 @@
 #ifndef _CELUTIL_RESMANAGER_H_
 #define _CELUTIL_RESMANAGER_H_
 
-#include <vector>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
 #include <map>
+#include <mutex>
+#include <utility>
 #include <celutil/reshandle.h>
+#include <celutil/threadpool.h>
 #include <celcompat/filesystem.h>
 
 
@@ -20,6 +26,7 @@ enum ResourceState {
     ResourceNotLoaded     = 0,
     ResourceLoaded        = 1,
     ResourceLoadingFailed = 2,
+    ResourceLoading       = 3,
 };
 
 
@@ -32,6 +39,15 @@ template<class T> class ResourceInfo
     virtual fs::path resolve(const fs::path&) = 0;
     virtual T* load(const fs::path&) = 0;
 
+    // Resources which can be read on a worker thread return true here and
+    // override loadInBackground(). It is called on a copy of the resource
+    // info after resolve(), and returns a function that creates the
+    // resource on the thread calling ResourceManager::find(), e.g. to
+    // upload a decoded image to OpenGL. An empty function means that the
+    // resource could not be loaded.
+    virtual bool hasBackgroundLoad() const { return false; }
+    virtual std::function<T*()> loadInBackground(const fs::path&) { return {}; }
+
     typedef T ResourceType;
     ResourceState state;
     fs::path resolvedName;
@@ -52,20 +68,30 @@ template<class T> class ResourceManager
     typedef typename T::ResourceType ResourceType;
 
  private:
-    typedef std::vector<T> ResourceTable;
+    typedef std::deque<T> ResourceTable;
     typedef std::map<T, ResourceHandle> ResourceHandleMap;
     typedef std::map<fs::path, ResourceType*> NameMap;
 
     typedef typename ResourceHandleMap::value_type ResourceHandleMapValue;
     typedef typename NameMap::value_type NameMapValue;
 
+    // Result of a background load: the resolved name, and the function
+    // creating the resource
+    typedef std::pair<fs::path, std::function<ResourceType*()>> LoadResult;
+
+    // Resource infos are kept in a deque so that they don't move when
+    // handles are added by worker threads loading other resources.
     ResourceTable resources;
     ResourceHandleMap handles;
     NameMap loadedResources;
+    std::map<ResourceHandle, std::future<LoadResult>> pendingLoads;
+    celestia::util::ThreadPool* loaderPool{ nullptr };
+    std::mutex mutex;
 
  public:
     ResourceHandle getHandle(const T& info)
     {
+        std::lock_guard<std::mutex> lock(mutex);
         typename ResourceHandleMap::iterator iter = handles.find(info);
         if (iter != handles.end())
         {
@@ -80,8 +106,18 @@ template<class T> class ResourceManager
         }
     }
 
+    // Load the resources supporting it on the threads of a pool; find()
+    // then returns nullptr until they are ready. Without a pool, resources
+    // are loaded by find() itself.
+    void setLoaderPool(celestia::util::ThreadPool* pool)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        loaderPool = pool;
+    }
+
     ResourceType* find(ResourceHandle h)
     {
+        std::lock_guard<std::mutex> lock(mutex);
         if (h >= (int) handles.size() || h < 0)
         {
             return nullptr;
@@ -90,29 +126,15 @@ template<class T> class ResourceManager
         {
             if (resources[h].state == ResourceNotLoaded)
             {
-                resources[h].resolvedName = resources[h].resolve(baseDir);
-                typename NameMap::iterator iter =
-                    loadedResources.find(resources[h].resolvedName);
-                if (iter != loadedResources.end())
-                {
-                    resources[h].resource = iter->second;
-                    resources[h].state = ResourceLoaded;
-                }
+                if (loaderPool != nullptr && resources[h].hasBackgroundLoad())
+                    startLoading(h);
                 else
-                {
-                    resources[h].resource = resources[h].load(resources[h].resolvedName);
-                    if (resources[h].resource == nullptr)
-                    {
-                        resources[h].state = ResourceLoadingFailed;
-                    }
-                    else
-                    {
-                        resources[h].state = ResourceLoaded;
-                        loadedResources.insert(NameMapValue(resources[h].resolvedName, resources[h].resource));
-                    }
-                }
+                    load(h);
             }
 
+            if (resources[h].state == ResourceLoading)
+                finishLoading(h);
+
             if (resources[h].state == ResourceLoaded)
                 return resources[h].resource;
             else
@@ -120,14 +142,89 @@ template<class T> class ResourceManager
         }
     }
 
+    ResourceState getState(ResourceHandle h)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (h >= (int) handles.size() || h < 0)
+            return ResourceLoadingFailed;
+        else
+            return resources[h].state;
+    }
+
     const T* getResourceInfo(ResourceHandle h)
     {
+        std::lock_guard<std::mutex> lock(mutex);
         if (h >= (int) handles.size() || h < 0)
             return nullptr;
         else
             return &resources[h];
     }
+
+ private:
+    void load(ResourceHandle h)
+    {
+        resources[h].resolvedName = resources[h].resolve(baseDir);
+        typename NameMap::iterator iter =
+            loadedResources.find(resources[h].resolvedName);
+        if (iter != loadedResources.end())
+        {
+            resources[h].resource = iter->second;
+            resources[h].state = ResourceLoaded;
+        }
+        else
+        {
+            resources[h].resource = resources[h].load(resources[h].resolvedName);
+            setLoaded(h);
+        }
+    }
+
+    void startLoading(ResourceHandle h)
+    {
+        resources[h].state = ResourceLoading;
+        pendingLoads[h] = loaderPool->submit([info = resources[h], dir = baseDir]() mutable
+        {
+            fs::path resolvedName = info.resolve(dir);
+            std::function<ResourceType*()> create = info.loadInBackground(resolvedName);
+            return LoadResult(std::move(resolvedName), std::move(create));
+        });
+    }
+
+    void finishLoading(ResourceHandle h)
+    {
+        auto iter = pendingLoads.find(h);
+        if (iter->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return;
+
+        LoadResult result = iter->second.get();
+        pendingLoads.erase(iter);
+
+        // Another handle may have loaded the same file in the meantime
+        resources[h].resolvedName = std::move(result.first);
+        typename NameMap::iterator loaded =
+            loadedResources.find(resources[h].resolvedName);
+        if (loaded != loadedResources.end())
+        {
+            resources[h].resource = loaded->second;
+            resources[h].state = ResourceLoaded;
+            return;
+        }
+
+        resources[h].resource = result.second ? result.second() : nullptr;
+        setLoaded(h);
+    }
+
+    void setLoaded(ResourceHandle h)
+    {
+        if (resources[h].resource == nullptr)
+        {
+            resources[h].state = ResourceLoadingFailed;
+        }
+        else
+        {
+            resources[h].state = ResourceLoaded;
+            loadedResources.insert(NameMapValue(resources[h].resolvedName, resources[h].resource));
+        }
+    }
 };
 
 #endif // _CELUTIL_RESMANAGER_H_
-
@@ -0,0 +1,75 @@
+// threadpool.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// Fixed size pool of worker threads.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#include <algorithm>
+
+#include "threadpool.h"
+
+namespace celestia::util
+{
+
+ThreadPool::ThreadPool(unsigned int nThreads)
+{
+    if (nThreads == 0)
+        nThreads = std::max(std::thread::hardware_concurrency(), 1u);
+
+    m_threads.reserve(nThreads);
+    for (unsigned int i = 0; i < nThreads; ++i)
+        m_threads.emplace_back(&ThreadPool::run, this);
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    for (auto& thread : m_threads)
+        thread.join();
+}
+
+
+void ThreadPool::enqueue(std::function<void()>&& task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+
+void ThreadPool::run()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+
+            // Remaining tasks are still run when the pool is being destroyed,
+            // so that no future is left without a result.
+            if (m_tasks.empty())
+                return;
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+} // end namespace celestia::util
@@ -0,0 +1,102 @@
+// threadpool.h
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// Fixed size pool of worker threads.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace celestia::util
+{
+
+/**
+ * Runs tasks on a fixed number of worker threads. Tasks are started in the
+ * order they were submitted; a task's result (or completion) is obtained
+ * through the future returned by submit(). Destroying the pool waits for
+ * all submitted tasks to finish.
+ */
+class ThreadPool
+{
+ public:
+    // A thread count of zero uses one thread per hardware thread.
+    explicit ThreadPool(unsigned int nThreads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned int size() const { return static_cast<unsigned int>(m_threads.size()); }
+
+    template<typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& task)
+    {
+        using R = std::invoke_result_t<F>;
+        auto packagedTask = std::make_shared<std::packaged_task<R()>>(std::forward<F>(task));
+        std::future<R> result = packagedTask->get_future();
+        enqueue([packagedTask] { (*packagedTask)(); });
+        return result;
+    }
+
+    // Call task(begin, end) on consecutive ranges of at most grain items
+    // covering [0, count), on the workers and on the calling thread, and
+    // wait until all ranges are done. Ranges may be processed concurrently.
+    template<typename F>
+    void parallelFor(std::size_t count, std::size_t grain, F&& task)
+    {
+        grain = std::max(grain, std::size_t(1));
+        std::size_t nRanges = (count + grain - 1) / grain;
+        std::atomic<std::size_t> nextRange{ 0 };
+        auto work = [&]
+        {
+            for (;;)
+            {
+                std::size_t range = nextRange.fetch_add(1, std::memory_order_relaxed);
+                if (range >= nRanges)
+                    return;
+                std::size_t begin = range * grain;
+                task(begin, std::min(begin + grain, count));
+            }
+        };
+
+        std::vector<std::future<void>> helpers;
+        std::size_t nHelpers = std::min(static_cast<std::size_t>(size()), nRanges > 0 ? nRanges - 1 : 0);
+        helpers.reserve(nHelpers);
+        for (std::size_t i = 0; i < nHelpers; ++i)
+            helpers.push_back(submit(work));
+
+        work();
+        for (auto& helper : helpers)
+            helper.wait();
+    }
+
+ private:
+    void enqueue(std::function<void()>&&);
+    void run();
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping{ false };
+};
+
+} // end namespace celestia::util
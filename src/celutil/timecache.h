@@ -0,0 +1,92 @@
+// timecache.h
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// Per thread cache of time dependent values.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace celestia::util
+{
+
+/**
+ * Direct-mapped cache of the values computed by objects for a given time,
+ * e.g. the positions and velocities of orbits. Every thread has its own
+ * cache, so that objects can be evaluated concurrently without locking,
+ * and several objects and times are cached at once. Each instantiation
+ * has its own cache; T holds the values of an entry, and N is the number
+ * of entries, a power of two.
+ *
+ * Objects are identified by a key obtained from newKey() when they are
+ * constructed. Unlike an address, a key is never reused, so the entries of
+ * a destroyed object are never matched by a new one.
+ */
+template<typename T, std::size_t N>
+class TimeCache
+{
+    static_assert(N > 0 && (N & (N - 1)) == 0, "cache size must be a power of two");
+
+ public:
+    struct Entry
+    {
+        std::uint64_t key{ 0 };
+        double time{ 0.0 };
+        // Bit mask of the values which are valid
+        unsigned int valid{ 0 };
+        T values{};
+
+        bool has(std::uint64_t _key, double _time, unsigned int value) const
+        {
+            return key == _key && time == _time && (valid & value) != 0;
+        }
+
+        // Make the entry hold the values of another object or time
+        void claim(std::uint64_t _key, double _time)
+        {
+            if (key != _key || time != _time)
+            {
+                key = _key;
+                time = _time;
+                valid = 0;
+            }
+        }
+    };
+
+    static std::uint64_t newKey()
+    {
+        static std::atomic<std::uint64_t> nextKey{ 1 };
+        return nextKey.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Return the entry where the values of an object at a time are cached.
+    // The entry may hold another object or time, and may be reused by the
+    // computation of other values, so it must be claimed after computing
+    // the values to store.
+    static Entry& entry(std::uint64_t key, double time)
+    {
+        std::uint64_t timeBits;
+        std::memcpy(&timeBits, &time, sizeof(timeBits));
+
+        std::uint64_t h = key * UINT64_C(0x9e3779b97f4a7c15) ^ timeBits;
+        h ^= h >> 33;
+        h *= UINT64_C(0xff51afd7ed558ccd);
+        h ^= h >> 33;
+        return entries[h & (N - 1)];
+    }
+
+ private:
+    inline static thread_local std::array<Entry, N> entries;
+};
+
+} // end namespace celestia::util
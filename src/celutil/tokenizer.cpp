@@ -97,6 +97,26 @@ Tokenizer::Tokenizer(std::istream* _in) :
 }
 
 
+void Tokenizer::readAll()
+{
+    for (;;)
+    {
+        TokenType type = nextToken();
+        recordedTokens.push_back({ type, tokenValue, recordedText.size(), textToken.size(), lineNumber });
+        recordedText.append(textToken);
+        if (type == TokenEnd || type == TokenError)
+            break;
+    }
+
+    in = nullptr;
+    isReplaying = true;
+    replayPosition = 0;
+    tokenType = TokenBegin;
+    textToken.clear();
+    lineNumber = 1;
+}
+
+
 Tokenizer::TokenType Tokenizer::nextToken()
 {
     if (isPushedBack)
@@ -105,6 +125,9 @@ Tokenizer::TokenType Tokenizer::nextToken()
         return tokenType;
     }
 
+    if (isReplaying)
+        return replayToken();
+
     if (isStart)
     {
         isStart = false;
@@ -589,6 +612,22 @@ int Tokenizer::getLineNumber() const
 }
 
 
+Tokenizer::TokenType Tokenizer::replayToken()
+{
+    // The last recorded token is the end of the stream or an error, and
+    // keeps being returned once it's reached.
+    const RecordedToken& token = recordedTokens[replayPosition];
+    if (replayPosition + 1 < recordedTokens.size())
+        ++replayPosition;
+
+    tokenType = token.type;
+    tokenValue = token.value;
+    textToken.assign(recordedText, token.textOffset, token.textLength);
+    lineNumber = token.lineNumber;
+    return tokenType;
+}
+
+
 bool Tokenizer::skipUtf8Bom()
 {
     for (int i = 0; i < 3; ++i)
@@ -15,6 +15,7 @@
 #include <iosfwd>
 #include <string>
 #include <string_view>
+#include <vector>
 
 class Tokenizer
 {
@@ -40,6 +41,11 @@ public:
 
     Tokenizer(std::istream*);
 
+    // Tokenize the rest of the input stream at once. Afterwards the tokens
+    // are returned from memory and the stream is no longer used, so a file
+    // can be tokenized on a worker thread and parsed later on another.
+    void readAll();
+
     TokenType nextToken();
     TokenType getTokenType() const;
     void pushBack();
@@ -62,5 +68,20 @@ private:
     bool reprocess{ false };
     bool hasUtf8Errors{ false };
 
+    struct RecordedToken
+    {
+        TokenType type;
+        double value;
+        std::string::size_type textOffset;
+        std::string::size_type textLength;
+        int lineNumber;
+    };
+
+    std::vector<RecordedToken> recordedTokens{};
+    std::string recordedText{};
+    std::size_t replayPosition{ 0 };
+    bool isReplaying{ false };
+
     bool skipUtf8Bom();
+    TokenType replayToken();
 };
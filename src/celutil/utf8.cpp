@@ -544,6 +544,34 @@ int UTF8StringCompare(std::string_view s0, std::string_view s1, size_t n, bool i
         return 0;
 }
 
+//! Normalize the characters of a UTF-8 string and convert them to lower case
+//! in the same way as UTF8StringCompare does when ignoring case. Two strings
+//! match for n characters in such a comparison exactly when the first n
+//! characters of their folded forms are byte-wise equal. Anything following
+//! an invalid UTF-8 sequence is copied unchanged.
+std::string UTF8FoldCase(std::string_view str)
+{
+    std::string folded;
+    folded.reserve(str.length());
+
+    int len = str.length();
+    int pos = 0;
+    while (pos < len)
+    {
+        wchar_t ch = 0;
+        if (!UTF8Decode(str, pos, ch))
+        {
+            folded.append(str.substr(pos));
+            break;
+        }
+
+        pos += UTF8EncodedSize(ch);
+        UTF8Encode(static_cast<std::uint32_t>(std::tolower(UTF8Normalize(ch))), folded);
+    }
+
+    return folded;
+}
+
 UTF8Status
 UTF8Validator::check(unsigned char c)
 {
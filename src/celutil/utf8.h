@@ -22,6 +22,7 @@ bool UTF8Decode(std::string_view str, int pos, wchar_t &ch);
 void UTF8Encode(std::uint32_t ch, std::string &dest);
 int  UTF8StringCompare(std::string_view s0, std::string_view s1);
 int  UTF8StringCompare(std::string_view s0, std::string_view s1, size_t n, bool ignoreCase = false);
+std::string UTF8FoldCase(std::string_view str);
 
 class UTF8StringOrderingPredicate
 {
@@ -14,7 +14,11 @@
 #include <cstdlib>
 #include <cmath>
 #include <algorithm>
+#include <cstring>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 #include <Eigen/Core>
 #include <Eigen/Geometry>
@@ -25,6 +29,7 @@
 #include <celmath/ray.h>
 #include <celmath/sphere.h>
 #include <celmath/intersect.h>
+#include <celutil/threadpool.h>
 #include <zlib.h>
 #include <png.h>
 
@@ -58,6 +63,68 @@ enum LUTUsageType
 static LUTUsageType LUTUsage = NoLUT;
 static bool UseFisheyeCameras = false;
 static double CameraExposure = 0.0;
+static unsigned int ThreadCount = 0;
+static bool VerifyDeterminism = false;
+
+// Worker threads used in addition to the main thread; null when running
+// serially.
+static unique_ptr<celestia::util::ThreadPool> threadPool;
+
+
+// Report the completion of work items shared between threads, printing
+// the percentage done in steps of ten percent.
+class ProgressReporter
+{
+public:
+    explicit ProgressReporter(size_t _total) : total(max(_total, size_t(1))) {}
+
+    void advance(size_t n = 1)
+    {
+        lock_guard<mutex> lock(progressMutex);
+        done += n;
+        auto percent = (unsigned int) (done * 100 / total);
+        while (reported + 10 <= percent)
+        {
+            reported += 10;
+            cout << ' ' << reported << '%' << flush;
+        }
+    }
+
+    void finish()
+    {
+        cout << endl;
+    }
+
+private:
+    size_t total;
+    size_t done{ 0 };
+    unsigned int reported{ 0 };
+    mutex progressMutex;
+};
+
+
+// Call fn(i) for each i in [0, count) using the thread pool if there is
+// one. Every item must be independent of the others so that the result
+// doesn't depend on the number of threads.
+template<typename F>
+void parallelFor(size_t count, ProgressReporter& progress, F&& fn)
+{
+    auto task = [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+            fn(i);
+        progress.advance(end - begin);
+    };
+
+    if (threadPool == nullptr)
+    {
+        for (size_t i = 0; i < count; i++)
+            task(i, i + 1);
+    }
+    else
+        threadPool->parallelFor(count, 1, task);
+    progress.finish();
+}
 
 
 typedef map<string, double> ParameterSet;
@@ -251,6 +318,9 @@ class LUT2
 {
 public:
     LUT2(unsigned int _width, unsigned int _height);
+    ~LUT2() { delete[] values; }
+    LUT2(const LUT2&) = delete;
+    LUT2& operator=(const LUT2&) = delete;
 
     Vector3d getValue(unsigned int x, unsigned int y) const;
     void setValue(unsigned int x, unsigned int y, const Vector3d&);
@@ -258,6 +328,12 @@ public:
     unsigned int getWidth() const { return width; }
     unsigned int getHeight() const { return height; }
 
+    bool operator==(const LUT2& other) const
+    {
+        return width == other.width && height == other.height &&
+               memcmp(values, other.values, width * height * 3 * sizeof(float)) == 0;
+    }
+
 private:
     unsigned int width;
     unsigned int height;
@@ -269,6 +345,9 @@ class LUT3
 {
 public:
     LUT3(unsigned int _width, unsigned int _height, unsigned int _depth);
+    ~LUT3() { delete[] values; }
+    LUT3(const LUT3&) = delete;
+    LUT3& operator=(const LUT3&) = delete;
 
     Vector4d getValue(unsigned int x, unsigned int y, unsigned int z) const;
     void setValue(unsigned int x, unsigned int y, unsigned int z, const Vector4d&);
@@ -277,6 +356,12 @@ public:
     unsigned int getHeight() const { return height; }
     unsigned int getDepth() const { return depth; }
 
+    bool operator==(const LUT3& other) const
+    {
+        return width == other.width && height == other.height && depth == other.depth &&
+               memcmp(values, other.values, width * height * depth * 4 * sizeof(float)) == 0;
+    }
+
 private:
     unsigned int width;
     unsigned int height;
@@ -384,6 +469,10 @@ void usage()
     cerr << "           set the number of integration steps for depth\n";
     cerr << "   --scattersteps <value> (or -s)\n";
     cerr << "           set the number of integration steps for scattering\n";
+    cerr << "   --threads <value> (or -t)  : set the number of threads\n";
+    cerr << "           (default is one per processor, 1 disables threading)\n";
+    cerr << "   --verify (or -v)           : check that the lookup tables and image\n";
+    cerr << "           are identical to those built with a single thread\n";
 }
 
 
@@ -1037,8 +1126,10 @@ buildExtinctionLUT(const Scene& scene)
     //Sphered planet = Sphered(scene.planet.radius);
     Sphered shell = Sphered(scene.planet.radius + scene.atmosphereShellHeight);
 
-    for (unsigned int i = 0; i < ExtinctionLUTHeightSteps; i++)
+    ProgressReporter progress(ExtinctionLUTHeightSteps);
+    parallelFor(ExtinctionLUTHeightSteps, progress, [&](size_t row)
     {
+        auto i = (unsigned int) row;
         double h = (double) i / (double) (ExtinctionLUTHeightSteps - 1) *
             scene.atmosphereShellHeight * 0.9999;
         Vector3d atmStart = Vector3d::Zero() +
@@ -1064,7 +1155,7 @@ buildExtinctionLUT(const Scene& scene)
 
             lut->setValue(i, j, ext.cwiseMax(1.0e-18));
         }
-    }
+    });
 
     return lut;
 }
@@ -1097,8 +1188,10 @@ buildOpticalDepthLUT(const Scene& scene)
     //Sphered planet = Sphered(scene.planet.radius);
     Sphered shell = Sphered(scene.planet.radius + scene.atmosphereShellHeight);
 
-    for (unsigned int i = 0; i < ExtinctionLUTHeightSteps; i++)
+    ProgressReporter progress(ExtinctionLUTHeightSteps);
+    parallelFor(ExtinctionLUTHeightSteps, progress, [&](size_t row)
     {
+        auto i = (unsigned int) row;
         double h = (double) i / (double) (ExtinctionLUTHeightSteps - 1) *
             scene.atmosphereShellHeight;
         Vector3d atmStart = Vector3d::Zero() +
@@ -1123,7 +1216,7 @@ buildOpticalDepthLUT(const Scene& scene)
 
             lut->setValue(i, j, Vector3d(depth.rayleigh, depth.mie, depth.absorption));
         }
-    }
+    });
 
     return lut;
 }
@@ -1314,48 +1407,49 @@ buildScatteringLUT(const Scene& scene)
 
     Sphered shell = Sphered(scene.planet.radius + scene.atmosphereShellHeight);
 
-    for (unsigned int i = 0; i < ScatteringLUTHeightSteps; i++)
+    // Each task fills the light angle slice for one height and view angle
+    ProgressReporter progress(ScatteringLUTHeightSteps * ScatteringLUTViewAngleSteps);
+    parallelFor(ScatteringLUTHeightSteps * ScatteringLUTViewAngleSteps, progress, [&](size_t slice)
     {
+        auto i = (unsigned int) (slice / ScatteringLUTViewAngleSteps);
+        auto j = (unsigned int) (slice % ScatteringLUTViewAngleSteps);
         double h = (double) i / (double) (ScatteringLUTHeightSteps - 1) *
             scene.atmosphereShellHeight * 0.9999;
         Vector3d atmStart = Vector3d::Zero() +
             Vector3d::UnitX() * (h + scene.planet.radius);
 
-        for (unsigned int j = 0; j < ScatteringLUTViewAngleSteps; j++)
-        {
-            double cosAngle = unpackSNorm((double) j / (ScatteringLUTViewAngleSteps - 1));
-            double sinAngle = sqrt(1.0 - min(1.0, cosAngle * cosAngle));
-            Vector3d viewDir(cosAngle, sinAngle, 0.0);
+        double cosAngle = unpackSNorm((double) j / (ScatteringLUTViewAngleSteps - 1));
+        double sinAngle = sqrt(1.0 - min(1.0, cosAngle * cosAngle));
+        Vector3d viewDir(cosAngle, sinAngle, 0.0);
 
-            Eigen::ParametrizedLine<double, 3> viewRay(atmStart, viewDir);
-            double dist = 0.0;
-            if (!testIntersection(viewRay, shell, dist))
-                dist = 0.0;
+        Eigen::ParametrizedLine<double, 3> viewRay(atmStart, viewDir);
+        double dist = 0.0;
+        if (!testIntersection(viewRay, shell, dist))
+            dist = 0.0;
 
-            Vector3d atmEnd = viewRay.pointAt(dist);
+        Vector3d atmEnd = viewRay.pointAt(dist);
 
-            for (unsigned int k = 0; k < ScatteringLUTLightAngleSteps; k++)
-            {
-                double cosLightAngle = unpackSNorm((double) k / (ScatteringLUTLightAngleSteps - 1));
-                double sinLightAngle = sqrt(1.0 - min(1.0, cosLightAngle * cosLightAngle));
-                Vector3d lightDir(cosLightAngle, sinLightAngle, 0.0);
+        for (unsigned int k = 0; k < ScatteringLUTLightAngleSteps; k++)
+        {
+            double cosLightAngle = unpackSNorm((double) k / (ScatteringLUTLightAngleSteps - 1));
+            double sinLightAngle = sqrt(1.0 - min(1.0, cosLightAngle * cosLightAngle));
+            Vector3d lightDir(cosLightAngle, sinLightAngle, 0.0);
 
 #if 0
-                Vector4d inscatter = integrateInscatteringFactors_LUT(scene,
-                                                                   atmStart,
-                                                                   atmEnd,
-                                                                   lightDir,
-                                                                   true);
-#else
-                Vector4d inscatter = integrateInscatteringFactors(scene,
+            Vector4d inscatter = integrateInscatteringFactors_LUT(scene,
                                                                atmStart,
                                                                atmEnd,
-                                                               lightDir);
+                                                               lightDir,
+                                                               true);
+#else
+            Vector4d inscatter = integrateInscatteringFactors(scene,
+                                                           atmStart,
+                                                           atmEnd,
+                                                           lightDir);
 #endif
-                lut->setValue(i, j, k, inscatter);
-            }
+            lut->setValue(i, j, k, inscatter);
         }
-    }
+    });
 
     return lut;
 }
@@ -1607,14 +1701,10 @@ void render(const Scene& scene,
     unsigned int bottom = min(image.height, viewport.y + viewport.height);
 
     cout << "Rendering " << viewport.width << "x" << viewport.height << " view" << endl;
-    for (unsigned int i = viewport.y; i < bottom; i++)
+    ProgressReporter progress(bottom - viewport.y);
+    parallelFor(bottom - viewport.y, progress, [&](size_t row)
     {
-        unsigned int row = i - viewport.y;
-        if (row % 50 == 49)
-            cout << row + 1 << endl;
-        else if (row % 10 == 0)
-            cout << ".";
-
+        auto i = viewport.y + (unsigned int) row;
         for (unsigned int j = viewport.x; j < right; j++)
         {
             double viewportX = ((double) (j - viewport.x) / (double) (viewport.width - 1) - 0.5) * aspectRatio;
@@ -1633,8 +1723,8 @@ void render(const Scene& scene,
 
             image.setPixel(j, i, color);
         }
-    }
-    cout << endl << "Complete" << endl;
+    });
+    cout << "Complete" << endl;
 }
 
 
@@ -1881,6 +1971,19 @@ bool parseCommandLine(int argc, char* argv[])
                     return false;
                 i++;
             }
+            else if (!strcmp(argv[i], "-t") || !strcmp(argv[i], "--threads"))
+            {
+                if (i == argc - 1)
+                    return false;
+
+                if (sscanf(argv[i + 1], " %u", &ThreadCount) != 1)
+                    return false;
+                i++;
+            }
+            else if (!strcmp(argv[i], "-v") || !strcmp(argv[i], "--verify"))
+            {
+                VerifyDeterminism = true;
+            }
             else if (!strcmp(argv[i], "-i") || !strcmp(argv[i], "--image"))
             {
                 if (i == argc - 1)
@@ -1925,6 +2028,12 @@ int main(int argc, char* argv[])
         exit(1);
     }
 
+    if (ThreadCount == 0)
+        ThreadCount = max(1u, thread::hardware_concurrency());
+    // The main thread does its share of the work, so it isn't in the pool
+    if (ThreadCount > 1)
+        threadPool = make_unique<celestia::util::ThreadPool>(ThreadCount - 1);
+
     ParameterSet sceneParams;
     setSceneDefaults(sceneParams);
     if (!LoadParameterSet(sceneParams, configFilename))
@@ -2038,22 +2147,65 @@ int main(int argc, char* argv[])
     Viewport tophalf (0, 0, image.width, image.height / 2);
     Viewport bothalf (0, image.height / 2, image.width, image.height / 2);
 
-    image.clear({0.1f, 0.1f, 1.0f});
-
-    if (UseFisheyeCameras)
+    auto renderViews = [&](RGBImage& target)
     {
-        render(scene, cameraFisheyeMidday, tophalf, image);
-        render(scene, cameraFisheyeSunset, bothalf, image);
-    }
-    else
-    {
-        render(scene, cameraLowPhase, topleft, image);
-        render(scene, cameraHighPhase, topright, image);
-        render(scene, cameraClose, botleft, image);
-        render(scene, cameraSurface, botright, image);
-    }
+        target.clear({0.1f, 0.1f, 1.0f});
 
+        if (UseFisheyeCameras)
+        {
+            render(scene, cameraFisheyeMidday, tophalf, target);
+            render(scene, cameraFisheyeSunset, bothalf, target);
+        }
+        else
+        {
+            render(scene, cameraLowPhase, topleft, target);
+            render(scene, cameraHighPhase, topright, target);
+            render(scene, cameraClose, botleft, target);
+            render(scene, cameraSurface, botright, target);
+        }
+    };
+
+    renderViews(image);
     WritePNG(outputImageName, image);
 
+    if (VerifyDeterminism && threadPool != nullptr)
+    {
+        cout << "Verifying against a single threaded build...\n";
+        threadPool.reset();
+        bool identical = true;
+
+        if (LUTUsage != NoLUT)
+        {
+            unique_ptr<LUT2> serialLUT(buildExtinctionLUT(scene));
+            if (!(*serialLUT == *scene.extinctionLUT))
+            {
+                cerr << "Extinction LUT differs from the single threaded build\n";
+                identical = false;
+            }
+        }
+
+        if (LUTUsage == UseScatteringLUT)
+        {
+            unique_ptr<LUT3> serialLUT(buildScatteringLUT(scene));
+            if (!(*serialLUT == *scene.scatteringLUT))
+            {
+                cerr << "Scattering LUT differs from the single threaded build\n";
+                identical = false;
+            }
+        }
+
+        RGBImage serialImage(OutputImageWidth, OutputImageHeight);
+        renderViews(serialImage);
+        if (memcmp(serialImage.pixels, image.pixels, image.width * image.height * 3) != 0)
+        {
+            cerr << "Image differs from the single threaded render\n";
+            identical = false;
+        }
+
+        if (!identical)
+            exit(1);
+        cout << "Output is identical to the single threaded build\n";
+    }
+
     exit(0);
 }
@@ -0,0 +1,123 @@
+// imagebench.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Measure the speed of DXTc decompression and normal map generation, in
+// millions of pixels per second.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <celengine/image.h>
+#include <celimage/dds_decompress.h>
+#include <celutil/threadpool.h>
+
+using celestia::PixelFormat;
+
+namespace
+{
+
+constexpr int Runs = 3;
+
+// Best time of a few runs, in seconds
+double
+timeRuns(const std::function<void()>& f)
+{
+    double best = 0.0;
+    for (int i = 0; i < Runs; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        if (i == 0 || elapsed.count() < best)
+            best = elapsed.count();
+    }
+    return best;
+}
+
+void
+report(const char* name, const char* threads, std::uint32_t size, double seconds)
+{
+    double mpixels = static_cast<double>(size) * static_cast<double>(size) * 1.0e-6;
+    std::cout << std::left << std::setw(12) << name
+              << std::setw(10) << threads
+              << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << mpixels / seconds << " MPixel/s\n";
+}
+
+void
+benchDXT(const char* name, DXTFormat format, std::uint32_t size, std::mt19937& rng)
+{
+    std::size_t nBlocks = static_cast<std::size_t>(size / 4) * (size / 4);
+    std::vector<std::uint8_t> blocks(nBlocks * DXTBlockSize(format));
+    std::uniform_int_distribution<int> byteDist(0, 255);
+    std::generate(blocks.begin(), blocks.end(), [&] { return static_cast<std::uint8_t>(byteDist(rng)); });
+
+    Image img(format == DXTFormat::DXT1 ? PixelFormat::RGB : PixelFormat::RGBA, size, size);
+
+    double serial = timeRuns([&]
+    {
+        DecompressDXTc(format, blocks.data(), size, size, img.getPixels(), img.getPitch(), nullptr);
+    });
+    report(name, "1", size, serial);
+
+    double parallel = timeRuns([&]
+    {
+        DecompressDXTc(format, blocks.data(), size, size, img.getPixels(), img.getPitch(), &GetImageThreadPool());
+    });
+    report(name, "pool", size, parallel);
+}
+
+void
+benchNormalMap(std::uint32_t size, std::mt19937& rng)
+{
+    Image heightMap(PixelFormat::LUMINANCE, size, size);
+    std::uniform_int_distribution<int> byteDist(0, 255);
+    std::uint8_t* pixels = heightMap.getPixels();
+    std::generate(pixels, pixels + heightMap.getSize(), [&] { return static_cast<std::uint8_t>(byteDist(rng)); });
+
+    double seconds = timeRuns([&]
+    {
+        std::unique_ptr<Image> normalMap(heightMap.computeNormalMap(2.5f, true));
+    });
+    report("normalmap", "pool", size, seconds);
+}
+
+} // end unnamed namespace
+
+int
+main(int argc, char* argv[])
+{
+    std::uint32_t size = 4096;
+    if (argc > 1)
+        size = static_cast<std::uint32_t>(std::max(4, std::atoi(argv[1]))) & ~3u;
+    if (argc > 2)
+    {
+        std::cerr << "Usage: imagebench [image size]\n";
+        return 1;
+    }
+
+    std::cout << size << 'x' << size << " pixels, "
+              << GetImageThreadPool().size() << " pool threads\n";
+
+    std::mt19937 rng(1);
+    benchDXT("dxt1", DXTFormat::DXT1, size, rng);
+    benchDXT("dxt3", DXTFormat::DXT3, size, rng);
+    benchDXT("dxt5", DXTFormat::DXT5, size, rng);
+    benchNormalMap(size, rng);
+
+    return 0;
+}
@@ -0,0 +1,177 @@
+// pickbench.cpp
+//
+// Copyright (C) 2023-present, Celestia Development Team.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// Compare exhaustive and BVH accelerated picking of a large mesh, in picks
+// per second, and check that both return the same intersections.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include <celmath/mathlib.h>
+#include <celmodel/mesh.h>
+
+using namespace cmod;
+
+namespace
+{
+
+constexpr int ExhaustiveRays = 20;
+constexpr int BVHRays = 20000;
+
+struct Ray
+{
+    Eigen::Vector3d origin;
+    Eigen::Vector3d direction;
+};
+
+// Build a bumpy sphere as a single triangle list with about
+// 2 * slices * slices triangles.
+Mesh
+buildAsteroid(unsigned int slices)
+{
+    unsigned int stacks = slices;
+    unsigned int nVertices = (slices + 1) * (stacks + 1);
+
+    std::vector<VWord> vertexData(nVertices * 3);
+    for (unsigned int i = 0; i <= stacks; i++)
+    {
+        double theta = celestia::numbers::pi * i / stacks;
+        for (unsigned int j = 0; j <= slices; j++)
+        {
+            double phi = 2.0 * celestia::numbers::pi * j / slices;
+            double r = 1.0 + 0.1 * std::sin(7.0 * theta) * std::cos(5.0 * phi)
+                           + 0.03 * std::sin(31.0 * theta + 17.0 * phi);
+            float v[3] =
+            {
+                static_cast<float>(r * std::sin(theta) * std::cos(phi)),
+                static_cast<float>(r * std::cos(theta)),
+                static_cast<float>(r * std::sin(theta) * std::sin(phi)),
+            };
+            std::memcpy(vertexData.data() + (i * (slices + 1) + j) * 3, v, sizeof(v));
+        }
+    }
+
+    std::vector<Index32> indices;
+    indices.reserve(slices * stacks * 6);
+    for (unsigned int i = 0; i < stacks; i++)
+    {
+        for (unsigned int j = 0; j < slices; j++)
+        {
+            Index32 i0 = i * (slices + 1) + j;
+            Index32 i1 = i0 + slices + 1;
+            indices.insert(indices.end(), { i0, i1, i0 + 1, i0 + 1, i1, i1 + 1 });
+        }
+    }
+
+    Mesh mesh;
+    mesh.setVertexDescription(VertexDescription({ VertexAttribute(VertexAttributeSemantic::Position,
+                                                                  VertexAttributeFormat::Float3, 0) }));
+    mesh.setVertices(nVertices, std::move(vertexData));
+    mesh.addGroup(PrimitiveGroupType::TriList, 0, std::move(indices));
+    return mesh;
+}
+
+// Rays from random points around the mesh aimed near its center, so that
+// most of them hit.
+std::vector<Ray>
+buildRays(int count, std::mt19937& rng)
+{
+    std::normal_distribution<double> normal;
+    std::uniform_real_distribution<double> offset(-0.8, 0.8);
+
+    std::vector<Ray> rays;
+    rays.reserve(count);
+    for (int i = 0; i < count; i++)
+    {
+        Eigen::Vector3d origin = Eigen::Vector3d(normal(rng), normal(rng), normal(rng)).normalized() * 3.0;
+        Eigen::Vector3d target(offset(rng), offset(rng), offset(rng));
+        rays.push_back({ origin, (target - origin).normalized() });
+    }
+
+    return rays;
+}
+
+double
+seconds(const std::chrono::steady_clock::time_point& start)
+{
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+void
+report(const char* name, int picks, double elapsed)
+{
+    std::cout << std::left << std::setw(12) << name
+              << std::right << std::fixed << std::setprecision(1)
+              << std::setw(12) << picks / elapsed << " picks/s\n";
+}
+
+} // end unnamed namespace
+
+int
+main(int argc, char* argv[])
+{
+    unsigned int slices = 708;
+    if (argc > 1)
+        slices = static_cast<unsigned int>(std::max(4, std::atoi(argv[1])));
+    if (argc > 2)
+    {
+        std::cerr << "Usage: pickbench [sphere slices]\n";
+        return 1;
+    }
+
+    Mesh mesh = buildAsteroid(slices);
+    std::cout << mesh.getPrimitiveCount() << " triangles\n";
+
+    std::mt19937 rng(1);
+    std::vector<Ray> rays = buildRays(BVHRays, rng);
+
+    // The first pick builds the hierarchy
+    auto start = std::chrono::steady_clock::now();
+    mesh.pick(rays[0].origin, rays[0].direction, static_cast<Mesh::PickResult*>(nullptr));
+    std::cout << "BVH build   " << std::fixed << std::setprecision(1)
+              << std::setw(12) << seconds(start) * 1000.0 << " ms\n";
+
+    std::vector<Mesh::PickResult> exhaustive(ExhaustiveRays);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ExhaustiveRays; i++)
+        mesh.pickExhaustive(rays[i].origin, rays[i].direction, &exhaustive[i]);
+    report("exhaustive", ExhaustiveRays, seconds(start));
+
+    std::vector<Mesh::PickResult> accelerated(BVHRays);
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < BVHRays; i++)
+        mesh.pick(rays[i].origin, rays[i].direction, &accelerated[i]);
+    report("bvh", BVHRays, seconds(start));
+
+    int mismatches = 0;
+    for (int i = 0; i < ExhaustiveRays; i++)
+    {
+        if (exhaustive[i].distance != accelerated[i].distance)
+            mismatches++;
+    }
+
+    if (mismatches != 0)
+    {
+        std::cerr << mismatches << " of " << ExhaustiveRays << " picks differ\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -20,6 +20,7 @@
 
 #include <celmath/mathlib.h>
 #include <celmodel/mesh.h>
+#include <celmodel/meshreorder.h>
 #include <celmodel/model.h>
 #include <celmodel/modelfile.h>
 
@@ -36,6 +37,7 @@ bool genTangents = false;
 bool weldVertices = false;
 bool mergeMeshes = false;
 bool stripify = false;
+bool reorder = false;
 unsigned int vertexCacheSize = 16;
 float smoothAngle = 60.0f;
 
@@ -51,6 +53,7 @@ void usage()
     std::cerr << "   --smooth (or -s) <angle> : smoothing angle for normal generation\n";
     std::cerr << "   --weld (or -w)        : join identical vertices before normal generation\n";
     std::cerr << "   --merge (or -m)       : merge submeshes to improve rendering performance\n";
+    std::cerr << "   --reorder (or -r)     : reorder triangles and vertices for vertex cache efficiency\n";
 #ifdef TRISTRIP
     std::cerr << "   --optimize (or -o)    : optimize by converting triangle lists to strips\n";
 #endif
@@ -94,6 +97,10 @@ bool parseCommandLine(int argc, char* argv[])
             {
                 mergeMeshes = true;
             }
+            else if (!std::strcmp(argv[i], "-r") || !std::strcmp(argv[i], "--reorder"))
+            {
+                reorder = true;
+            }
             else if (!std::strcmp(argv[i], "-o") || !std::strcmp(argv[i], "--optimize"))
             {
                 stripify = true;
@@ -144,6 +151,15 @@ bool parseCommandLine(int argc, char* argv[])
 }
 
 
+cmod::VertexCacheStatistics analyzeVertexCache(const cmod::Model& model)
+{
+    cmod::VertexCacheStatistics stats;
+    for (std::uint32_t i = 0; model.getMesh(i) != nullptr; i++)
+        stats += cmod::AnalyzeVertexCache(*model.getMesh(i), vertexCacheSize);
+    return stats;
+}
+
+
 int main(int argc, char* argv[])
 {
     if (!parseCommandLine(argc, argv))
@@ -235,6 +251,22 @@ int main(int argc, char* argv[])
         }
     }
 
+    if (reorder)
+    {
+        cmod::VertexCacheStatistics before = analyzeVertexCache(*model);
+        for (std::uint32_t i = 0; model->getMesh(i) != nullptr; i++)
+        {
+            cmod::Mesh* mesh = model->getMesh(i);
+            cmod::ReorderMesh(*mesh, vertexCacheSize);
+        }
+        cmod::VertexCacheStatistics after = analyzeVertexCache(*model);
+
+        std::cerr << "Vertex cache (" << vertexCacheSize << " entries, "
+                  << after.triangleCount << " triangles): ACMR "
+                  << before.acmr() << " -> " << after.acmr() << ", ATVR "
+                  << before.atvr() << " -> " << after.atvr() << "\n";
+    }
+
 #ifdef TRISTRIP
     if (stripify)
     {
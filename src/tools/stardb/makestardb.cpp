@@ -17,6 +17,7 @@
 #include <celutil/bytes.h>
 #include <celengine/astro.h>
 #include <celengine/star.h>
+#include <celengine/stardb.h>
 
 using namespace std;
 
@@ -24,6 +25,7 @@ using namespace std;
 static string inputFilename;
 static string outputFilename;
 static bool useSphericalCoords = false;
+static bool writeOctree = false;
 
 
 void Usage()
@@ -31,6 +33,8 @@ void Usage()
     cerr << "Usage: makestardb [options] <input file> <output star database>\n";
     cerr << "  Options:\n";
     cerr << "    --spherical (or -s) : input file has spherical coords (RA/dec/distance\n";
+    cerr << "    --octree (or -t) : write a version 2 database with the stars presorted into\n";
+    cerr << "                       an octree (requires Celestia 1.7 or later)\n";
 }
 
 
@@ -47,6 +51,10 @@ bool parseCommandLine(int argc, char* argv[])
             {
                 useSphericalCoords = true;
             }
+            else if (!strcmp(argv[i], "--octree") || !strcmp(argv[i], "-t"))
+            {
+                writeOctree = true;
+            }
             else
             {
                 cerr << "Unknown command line switch: " << argv[i] << '\n';
@@ -106,7 +114,7 @@ static void writeShort(ostream& out, int16_t n)
 }
 
 
-bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
+bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords, bool octree)
 {
     unsigned int nStarsInFile = 0;
 
@@ -117,13 +125,23 @@ bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
         return 1;
     }
 
-    // Write the header
-    out.write("CELSTARS", 8);
+    // Version 2 databases are written all at once after the stars have
+    // been sorted into the octree.
+    vector<StarDatabase::BinaryRecord> records;
+    if (octree)
+    {
+        records.reserve(nStarsInFile);
+    }
+    else
+    {
+        // Write the header
+        out.write("CELSTARS", 8);
 
-    // Write the version
-    writeShort(out, 0x0100);
+        // Write the version
+        writeShort(out, 0x0100);
 
-    writeUint(out, nStarsInFile);
+        writeUint(out, nStarsInFile);
+    }
 
     for (unsigned int record = 0; record < nStarsInFile; record++)
     {
@@ -133,7 +151,7 @@ bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
 
         in >> catalogNumber;
         if (in.eof())
-            return true;
+            break;
 
         if (!in.good())
         {
@@ -201,6 +219,12 @@ bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
         cout << scString << ' ' << details->getSpectralType() << '\n';
 #endif
 
+        if (octree)
+        {
+            records.push_back({ catalogNumber, Eigen::Vector3f(x, y, z), absMag, sc });
+            continue;
+        }
+
         writeUint(out, catalogNumber);
         writeFloat(out, x);
         writeFloat(out, y);
@@ -209,6 +233,9 @@ bool WriteStarDatabase(istream& in, ostream& out, bool sphericalCoords)
         writeUshort(out, sc.packV1());
     }
 
+    if (octree)
+        return StarDatabase::writeBinary(out, records);
+
     return true;
 }
 
@@ -235,7 +262,7 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    bool success = WriteStarDatabase(inputFile, stardbFile, useSphericalCoords);
+    bool success = WriteStarDatabase(inputFile, stardbFile, useSphericalCoords, writeOctree);
 
     return success ? 0 : 1;
 }
@@ -217,8 +217,10 @@ bool DumpStarDatabase(istream& in, ostream& out, bool spherical)
         return false;
     }
 
+    // Version 2 files only differ in the spectral type packing and in the
+    // octree section after the star records, which isn't needed here.
     uint16_t version = readUshort(in);
-    if (version != 0x0100)
+    if (version != 0x0100 && version != 0x0200)
     {
         cerr << "Unsupported file version " << (version >> 8) << '.' <<
             (version & 0xff) << '\n';
@@ -249,6 +251,12 @@ bool DumpStarDatabase(istream& in, ostream& out, bool spherical)
         int16_t  absMag       = readShort(in);
         uint16_t stellarClass = readUshort(in);
 
+        if (version == 0x0200)
+        {
+            StellarClass sc;
+            stellarClass = sc.unpackV2(stellarClass) ? sc.packV1() : 0xffff;
+        }
+
         out << catalogNum << ' ';
         out << setprecision(7);
 
@@ -0,0 +1,75 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <celengine/completionindex.h>
+#include <celutil/utf8.h>
+
+namespace
+{
+
+std::vector<std::string> complete(const CompletionIndex& index,
+                                  const std::string& prefix,
+                                  std::size_t maxCount = 100)
+{
+    std::vector<std::string> completion;
+    index.find(UTF8FoldCase(prefix), maxCount, completion);
+    std::sort(completion.begin(), completion.end());
+    return completion;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("CompletionIndex", "[CompletionIndex]")
+{
+    const std::vector<std::string> names
+    {
+        "Sirius", "Sol", "Solitaire", "Spica", "Sirrah", "Polaris",
+        "\316\261 Cen", "\316\261 CMa", "\316\262 Cen", "ALPHA", "Alphard", "S",
+    };
+    std::vector<const std::string*> pointers;
+    for (const auto& name : names)
+        pointers.push_back(&name);
+
+    CompletionIndex index;
+    index.build(pointers);
+
+    SECTION("Prefix matches are case insensitive")
+    {
+        REQUIRE(complete(index, "si") == std::vector<std::string>{ "Sirius", "Sirrah" });
+        REQUIRE(complete(index, "SOL") == std::vector<std::string>{ "Sol", "Solitaire" });
+        REQUIRE(complete(index, "alph") == std::vector<std::string>{ "ALPHA", "Alphard" });
+        REQUIRE(complete(index, "\316\221") == std::vector<std::string>{ "\316\261 CMa", "\316\261 Cen" });
+    }
+
+    SECTION("Complete names and prefixes inside edges")
+    {
+        REQUIRE(complete(index, "s").size() == 6);
+        REQUIRE(complete(index, "Solitaire") == std::vector<std::string>{ "Solitaire" });
+        REQUIRE(complete(index, "Solit") == std::vector<std::string>{ "Solitaire" });
+        REQUIRE(complete(index, "\316\261 C").size() == 2);
+        REQUIRE(complete(index, "").size() == names.size());
+    }
+
+    SECTION("Non-matching prefixes")
+    {
+        REQUIRE(complete(index, "Solx").empty());
+        REQUIRE(complete(index, "Solitaires").empty());
+        REQUIRE(complete(index, "x").empty());
+    }
+
+    SECTION("Completion count is limited")
+    {
+        REQUIRE(complete(index, "s", 2).size() == 2);
+        REQUIRE(complete(index, "s", 0).empty());
+    }
+
+    SECTION("Cleared index")
+    {
+        index.clear();
+        REQUIRE(index.empty());
+        REQUIRE(complete(index, "s").empty());
+    }
+}
@@ -0,0 +1,153 @@
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celcompat/numbers.h>
+#include <celengine/body.h>
+#include <celengine/frame.h>
+#include <celengine/selection.h>
+#include <celengine/solarsys.h>
+#include <celengine/stardb.h>
+#include <celengine/starname.h>
+#include <celengine/timeline.h>
+#include <celengine/timelinephase.h>
+#include <celengine/universe.h>
+#include <celephem/orbit.h>
+#include <celephem/rotation.h>
+#include <celestia/eclipsefinder.h>
+
+namespace
+{
+
+// Circular orbit recording the threads it is evaluated on
+class RecordingOrbit : public Orbit
+{
+ public:
+    Eigen::Vector3d positionAtTime(double jd) const override
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            threads.insert(std::this_thread::get_id());
+        }
+        return Eigen::Vector3d(std::cos(jd), 0.0, std::sin(jd)) * 400000.0;
+    }
+
+    double getPeriod() const override { return 2.0 * celestia::numbers::pi; }
+    double getBoundingRadius() const override { return 400000.0; }
+
+    mutable std::mutex mutex;
+    mutable std::set<std::thread::id> threads;
+};
+
+// Fixed orbit standing for a scripted one
+class UnsafeOrbit : public FixedOrbit
+{
+ public:
+    UnsafeOrbit(const Eigen::Vector3d& pos, bool _threadSafe) :
+        FixedOrbit(pos), threadSafe(_threadSafe)
+    {
+    }
+
+    bool isThreadSafe() const override { return threadSafe; }
+
+ private:
+    bool threadSafe;
+};
+
+Body* addBody(Universe& universe,
+              PlanetarySystem* system,
+              const char* name,
+              int classification,
+              float radius,
+              const ReferenceFrame::SharedConstPtr& orbitFrame,
+              Orbit& orbit,
+              const ReferenceFrame::SharedConstPtr& bodyFrame)
+{
+    auto* body = new Body(system, name);
+    body->setClassification(classification);
+    body->setSemiAxes(Eigen::Vector3f::Constant(radius));
+
+    static ConstantOrientation rotation(Eigen::Quaterniond::Identity());
+    auto phase = TimelinePhase::CreateTimelinePhase(universe, body,
+                                                    -std::numeric_limits<double>::infinity(),
+                                                    std::numeric_limits<double>::infinity(),
+                                                    orbitFrame, orbit,
+                                                    bodyFrame, rotation);
+    auto* timeline = new Timeline();
+    timeline->appendPhase(phase);
+    body->setTimeline(timeline);
+    return body;
+}
+
+// Search eclipses of a planet whose moon has a body frame referencing a
+// spacecraft, and return the threads the orbit of the moon was evaluated on.
+std::set<std::thread::id> searchThreads(bool spacecraftThreadSafe)
+{
+    // The universe doesn't own its contents, which are leaked as in the
+    // application.
+    auto* stars = new StarDatabase();
+    stars->setNameDatabase(new StarNameDatabase());
+    std::istringstream stc("Add 1 { RA 0 Dec 0 Distance 10 SpectralType \"G2V\" AbsMag 4.8 }");
+    stars->load(stc);
+    stars->finish();
+
+    auto* universe = new Universe();
+    universe->setStarCatalog(stars);
+    universe->setSolarSystemCatalog(new SolarSystemCatalog());
+    Star* sun = stars->getStar(0);
+    PlanetarySystem* planets = universe->createSolarSystem(sun)->getPlanets();
+
+    static FixedOrbit planetOrbit(Eigen::Vector3d(1.5e8, 0.0, 0.0));
+    auto sunFrame = std::make_shared<J2000EclipticFrame>(Selection(sun));
+    Body* planet = addBody(*universe, planets, "Planet", Body::Planet, 6000.0f,
+                           sunFrame, planetOrbit, sunFrame);
+
+    auto* satellites = new PlanetarySystem(planet);
+    planet->setSatellites(satellites);
+    auto planetFrame = std::make_shared<J2000EclipticFrame>(Selection(planet));
+
+    auto* spacecraftOrbit = new UnsafeOrbit(Eigen::Vector3d(0.0, 50000.0, 0.0), spacecraftThreadSafe);
+    Body* spacecraft = addBody(*universe, satellites, "Spacecraft", Body::Spacecraft, 0.01f,
+                               planetFrame, *spacecraftOrbit, planetFrame);
+
+    auto moonBodyFrame = std::make_shared<BodyMeanEquatorFrame>(Selection(planet),
+                                                                Selection(spacecraft));
+    auto* moonOrbit = new RecordingOrbit();
+    addBody(*universe, satellites, "Moon", Body::Moon, 1700.0f,
+            planetFrame, *moonOrbit, moonBodyFrame);
+
+    std::vector<Eclipse> eclipses;
+    EclipseFinder finder(planet);
+    finder.findEclipses(2451545.0, 2451545.0 + 365.0, Eclipse::Solar | Eclipse::Lunar, eclipses);
+
+    std::lock_guard<std::mutex> lock(moonOrbit->mutex);
+    return moonOrbit->threads;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("EclipseFinder thread safety", "[EclipseFinder]")
+{
+    SECTION("Thread-safe bodies are searched on worker threads")
+    {
+        auto threads = searchThreads(true);
+        REQUIRE(!threads.empty());
+        REQUIRE(threads.count(std::this_thread::get_id()) == 0);
+    }
+
+    SECTION("A non thread-safe body referenced by a body frame forces a serial search")
+    {
+        auto threads = searchThreads(false);
+        REQUIRE(threads == std::set<std::thread::id>{ std::this_thread::get_id() });
+    }
+}
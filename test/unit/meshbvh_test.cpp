@@ -0,0 +1,173 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <Eigen/Core>
+
+#include <celmodel/mesh.h>
+
+using namespace cmod;
+
+namespace
+{
+
+constexpr unsigned int GridSize = 12;
+constexpr unsigned int FanSize = 16;
+// Index past the end of the vertex array
+constexpr Index32 BadIndex = 10000;
+
+Index32 gridIndex(unsigned int x, unsigned int y)
+{
+    return y * GridSize + x;
+}
+
+// A jittered height field, covered by a triangle list on its lower half
+// and by one triangle strip per row on its upper half, and a triangle fan
+// floating above it. Some triangles have out of range indices.
+Mesh makeMesh(std::vector<Eigen::Vector3f>& positions)
+{
+    std::mt19937 rng(3);
+    std::uniform_real_distribution<float> jitter(-0.2f, 0.2f);
+
+    for (unsigned int y = 0; y < GridSize; y++)
+    {
+        for (unsigned int x = 0; x < GridSize; x++)
+        {
+            positions.emplace_back(static_cast<float>(x) + jitter(rng),
+                                   static_cast<float>(y) + jitter(rng),
+                                   jitter(rng));
+        }
+    }
+
+    // Fan center and ring, above the middle of the grid
+    Index32 fanCenter = static_cast<Index32>(positions.size());
+    Eigen::Vector3f center(5.5f, 5.5f, 2.0f);
+    positions.push_back(center);
+    for (unsigned int i = 0; i <= FanSize; i++)
+    {
+        float angle = static_cast<float>(i) * 2.0f * static_cast<float>(EIGEN_PI) / FanSize;
+        positions.push_back(center + Eigen::Vector3f(std::cos(angle), std::sin(angle), 0.1f * jitter(rng)) * 3.0f);
+    }
+
+    std::vector<VWord> vertexData;
+    for (const auto& p : positions)
+    {
+        const auto* words = reinterpret_cast<const VWord*>(p.data());
+        vertexData.insert(vertexData.end(), words, words + 3);
+    }
+
+    Mesh mesh;
+    mesh.setVertexDescription(VertexDescription({ VertexAttribute(VertexAttributeSemantic::Position,
+                                                                   VertexAttributeFormat::Float3,
+                                                                   0) }));
+    mesh.setVertices(static_cast<unsigned int>(positions.size()), std::move(vertexData));
+
+    std::vector<Index32> list;
+    for (unsigned int y = 0; y < GridSize / 2; y++)
+    {
+        for (unsigned int x = 0; x + 1 < GridSize; x++)
+        {
+            list.insert(list.end(), { gridIndex(x, y), gridIndex(x + 1, y), gridIndex(x, y + 1) });
+            if (x == 3)
+                list.insert(list.end(), { gridIndex(x + 1, y), BadIndex, gridIndex(x + 1, y + 1) });
+            else
+                list.insert(list.end(), { gridIndex(x + 1, y), gridIndex(x + 1, y + 1), gridIndex(x, y + 1) });
+        }
+    }
+    mesh.addGroup(PrimitiveGroupType::TriList, 0, std::move(list));
+
+    for (unsigned int y = GridSize / 2; y + 1 < GridSize; y++)
+    {
+        std::vector<Index32> strip;
+        for (unsigned int x = 0; x < GridSize; x++)
+        {
+            strip.push_back(gridIndex(x, y));
+            strip.push_back(x == 7 && y == 8 ? BadIndex : gridIndex(x, y + 1));
+        }
+        mesh.addGroup(PrimitiveGroupType::TriStrip, 0, std::move(strip));
+    }
+
+    std::vector<Index32> fan;
+    fan.push_back(fanCenter);
+    for (unsigned int i = 0; i <= FanSize; i++)
+        fan.push_back(i == 12 ? BadIndex : fanCenter + 1 + i);
+    mesh.addGroup(PrimitiveGroupType::TriFan, 0, std::move(fan));
+
+    return mesh;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Mesh picking", "[Mesh]")
+{
+    std::vector<Eigen::Vector3f> positions;
+    Mesh mesh = makeMesh(positions);
+    REQUIRE(mesh.getPrimitiveCount() >= 64);
+
+    const PrimitiveGroup* fan = mesh.getGroup(mesh.getGroupCount() - 1);
+    REQUIRE(fan->prim == PrimitiveGroupType::TriFan);
+
+    SECTION("The hierarchy finds the same triangles as the exhaustive test")
+    {
+        std::mt19937 rng(7);
+        std::uniform_real_distribution<double> coord(-1.0, 12.0);
+        std::uniform_real_distribution<double> tilt(-0.5, 0.5);
+
+        unsigned int hits = 0;
+        for (int i = 0; i < 2000; i++)
+        {
+            // Alternately look down from above and up from below
+            double z = (i % 2 == 0) ? 10.0 : -10.0;
+            Eigen::Vector3d origin(coord(rng), coord(rng), z);
+            Eigen::Vector3d direction(tilt(rng), tilt(rng), -z / 10.0);
+
+            Mesh::PickResult bvhResult;
+            Mesh::PickResult exhaustiveResult;
+            bool bvhHit = mesh.pick(origin, direction, &bvhResult);
+            bool exhaustiveHit = mesh.pickExhaustive(origin, direction, &exhaustiveResult);
+
+            REQUIRE(bvhHit == exhaustiveHit);
+            if (!bvhHit)
+                continue;
+
+            hits++;
+            REQUIRE(bvhResult.group == exhaustiveResult.group);
+            REQUIRE(bvhResult.primitiveIndex == exhaustiveResult.primitiveIndex);
+            REQUIRE(bvhResult.distance == Approx(exhaustiveResult.distance));
+        }
+
+        REQUIRE(hits > 1000);
+    }
+
+    SECTION("Fan triangles share the first vertex")
+    {
+        // Triangle i of the fan is made of the center and ring vertices i
+        // and i + 1; ring vertex 12 is replaced by an out of range index.
+        Index32 center = fan->indices[0];
+        for (unsigned int i = 0; i < FanSize; i++)
+        {
+            Eigen::Vector3f centroid = (positions[center] +
+                                        positions[center + 1 + i] +
+                                        positions[center + 2 + i]) / 3.0f;
+            Eigen::Vector3d origin(centroid.x(), centroid.y(), 10.0);
+
+            Mesh::PickResult result;
+            REQUIRE(mesh.pick(origin, -Eigen::Vector3d::UnitZ(), &result));
+            if (i == 11 || i == 12)
+            {
+                REQUIRE(result.group != fan);
+                continue;
+            }
+
+            REQUIRE(result.group == fan);
+            REQUIRE(result.primitiveIndex == i);
+            REQUIRE(result.distance == Approx(10.0 - centroid.z()));
+
+            double distance;
+            REQUIRE(mesh.pick(origin, -Eigen::Vector3d::UnitZ(), distance));
+            REQUIRE(distance == Approx(10.0 - centroid.z()));
+        }
+    }
+}
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <Eigen/Core>
+
+#include <celmodel/mesh.h>
+#include <celmodel/meshreorder.h>
+
+using namespace cmod;
+
+namespace
+{
+
+constexpr unsigned int GridSize = 24;
+
+using Triangle = std::array<std::array<float, 3>, 3>;
+
+// A jittered height field covered by a triangle list whose triangles and
+// vertices are in random order.
+Mesh makeMesh()
+{
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<float> jitter(-0.2f, 0.2f);
+
+    std::vector<unsigned int> vertexOrder(GridSize * GridSize);
+    for (unsigned int i = 0; i < vertexOrder.size(); i++)
+        vertexOrder[i] = i;
+    std::shuffle(vertexOrder.begin(), vertexOrder.end(), rng);
+
+    std::vector<VWord> vertexData(vertexOrder.size() * 3);
+    for (unsigned int y = 0; y < GridSize; y++)
+    {
+        for (unsigned int x = 0; x < GridSize; x++)
+        {
+            Eigen::Vector3f p(static_cast<float>(x) + jitter(rng),
+                              static_cast<float>(y) + jitter(rng),
+                              jitter(rng));
+            std::memcpy(vertexData.data() + vertexOrder[y * GridSize + x] * 3, p.data(), sizeof(float) * 3);
+        }
+    }
+
+    std::vector<std::array<Index32, 3>> triangles;
+    for (unsigned int y = 0; y + 1 < GridSize; y++)
+    {
+        for (unsigned int x = 0; x + 1 < GridSize; x++)
+        {
+            Index32 i00 = vertexOrder[y * GridSize + x];
+            Index32 i10 = vertexOrder[y * GridSize + x + 1];
+            Index32 i01 = vertexOrder[(y + 1) * GridSize + x];
+            Index32 i11 = vertexOrder[(y + 1) * GridSize + x + 1];
+            triangles.push_back({ i00, i10, i01 });
+            triangles.push_back({ i10, i11, i01 });
+        }
+    }
+    std::shuffle(triangles.begin(), triangles.end(), rng);
+
+    std::vector<Index32> indices;
+    for (const auto& t : triangles)
+        indices.insert(indices.end(), t.begin(), t.end());
+
+    Mesh mesh;
+    mesh.setVertexDescription(VertexDescription({ VertexAttribute(VertexAttributeSemantic::Position,
+                                                                   VertexAttributeFormat::Float3,
+                                                                   0) }));
+    mesh.setVertices(static_cast<unsigned int>(vertexOrder.size()), std::move(vertexData));
+    mesh.addGroup(PrimitiveGroupType::TriList, 0, std::move(indices));
+    return mesh;
+}
+
+// The triangles of the mesh as vertex positions, each one rotated to start
+// with its smallest vertex so that the winding is kept but the first vertex
+// doesn't matter.
+std::vector<Triangle> triangleSet(const Mesh& mesh)
+{
+    std::vector<Triangle> triangles;
+    const VWord* vertexData = mesh.getVertexData();
+    unsigned int stride = mesh.getVertexStrideWords();
+    for (unsigned int g = 0; g < mesh.getGroupCount(); g++)
+    {
+        const auto& indices = mesh.getGroup(g)->indices;
+        for (std::size_t i = 0; i + 2 < indices.size(); i += 3)
+        {
+            Triangle t;
+            for (unsigned int j = 0; j < 3; j++)
+                std::memcpy(t[j].data(), vertexData + indices[i + j] * stride, sizeof(float) * 3);
+            std::rotate(t.begin(), std::min_element(t.begin(), t.end()), t.end());
+            triangles.push_back(t);
+        }
+    }
+
+    std::sort(triangles.begin(), triangles.end());
+    return triangles;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("Mesh reordering", "[Mesh]")
+{
+    Mesh mesh = makeMesh();
+    auto trianglesBefore = triangleSet(mesh);
+    VertexCacheStatistics before = AnalyzeVertexCache(mesh, 16);
+    REQUIRE(before.triangleCount == trianglesBefore.size());
+
+    REQUIRE(ReorderMesh(mesh, 16));
+
+    SECTION("Triangles and their winding are preserved")
+    {
+        REQUIRE(mesh.getVertexCount() == GridSize * GridSize);
+        REQUIRE(triangleSet(mesh) == trianglesBefore);
+    }
+
+    SECTION("Vertex cache efficiency doesn't get worse")
+    {
+        VertexCacheStatistics after = AnalyzeVertexCache(mesh, 16);
+        REQUIRE(after.triangleCount == before.triangleCount);
+        REQUIRE(after.vertexCount == before.vertexCount);
+        REQUIRE(after.acmr() <= before.acmr());
+    }
+
+    SECTION("Reordering an optimized mesh doesn't make it worse")
+    {
+        VertexCacheStatistics first = AnalyzeVertexCache(mesh, 16);
+        REQUIRE(ReorderMesh(mesh, 16, 1.0f));
+        REQUIRE(triangleSet(mesh) == trianglesBefore);
+        REQUIRE(AnalyzeVertexCache(mesh, 16).acmr() <= first.acmr());
+    }
+}
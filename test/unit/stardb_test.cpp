@@ -0,0 +1,402 @@
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <catch.hpp>
+
+#include <Eigen/Core>
+#include <Eigen/Geometry>
+
+#include <celcompat/filesystem.h>
+#include <celengine/catalogquery.h>
+#include <celengine/star.h>
+#include <celengine/stardb.h>
+#include <celengine/starname.h>
+#include <celengine/staroctree.h>
+#include <celengine/stellarclass.h>
+#include <celutil/binarywrite.h>
+
+namespace
+{
+
+std::vector<StarDatabase::BinaryRecord> randomStars(std::uint32_t nStars)
+{
+    const char* spectralTypes[] = { "O5V", "B2III", "A0V", "F5V", "G2V", "K1III", "M3V", "DA" };
+
+    // Catalog numbers in random order, so that the records don't come in
+    // catalog number order.
+    std::vector<AstroCatalog::IndexNumber> catalogNumbers(nStars);
+    for (std::uint32_t i = 0; i < nStars; i++)
+        catalogNumbers[i] = i * 7 + 1;
+
+    std::mt19937 rng(1);
+    std::shuffle(catalogNumbers.begin(), catalogNumbers.end(), rng);
+
+    std::uniform_real_distribution<float> position(-2000.0f, 2000.0f);
+    std::uniform_real_distribution<float> absMag(-5.0f, 15.0f);
+    std::vector<StarDatabase::BinaryRecord> records;
+    for (std::uint32_t i = 0; i < nStars; i++)
+    {
+        float x = position(rng);
+        float y = position(rng);
+        float z = position(rng);
+        records.push_back({ catalogNumbers[i],
+                            Eigen::Vector3f(x, y, z),
+                            absMag(rng),
+                            StellarClass::parse(spectralTypes[i % 8]) });
+    }
+
+    return records;
+}
+
+// Write the records as a version 0x0100 file, which has no octree section
+std::string writeVersion1(const std::vector<StarDatabase::BinaryRecord>& records)
+{
+    std::ostringstream out;
+    out.write("CELSTARS", 8);
+    celestia::util::writeLE<std::uint16_t>(out, 0x0100);
+    celestia::util::writeLE<std::uint32_t>(out, static_cast<std::uint32_t>(records.size()));
+    for (const auto& record : records)
+    {
+        celestia::util::writeLE<std::uint32_t>(out, record.catalogNumber);
+        celestia::util::writeLE<float>(out, record.position.x());
+        celestia::util::writeLE<float>(out, record.position.y());
+        celestia::util::writeLE<float>(out, record.position.z());
+        celestia::util::writeLE<std::int16_t>(out, static_cast<std::int16_t>(record.absMag * 256.0f));
+        celestia::util::writeLE<std::uint16_t>(out, record.stellarClass.packV1());
+    }
+
+    return out.str();
+}
+
+StarDatabase* loadFile(const fs::path& path, const std::string& data)
+{
+    std::ofstream(path, std::ios::out | std::ios::binary).write(data.data(), data.size());
+
+    auto* db = new StarDatabase();
+    db->setNameDatabase(new StarNameDatabase());
+    REQUIRE(db->loadBinary(path));
+    db->finish();
+    return db;
+}
+
+std::vector<StarRange> visibleRanges(const StarDatabase& db)
+{
+    // Look in all six directions from a few points
+    const Eigen::Quaternionf orientations[] =
+    {
+        Eigen::Quaternionf::Identity(),
+        Eigen::Quaternionf(Eigen::AngleAxisf(static_cast<float>(EIGEN_PI), Eigen::Vector3f::UnitY())),
+        Eigen::Quaternionf(Eigen::AngleAxisf(static_cast<float>(EIGEN_PI / 2), Eigen::Vector3f::UnitY())),
+        Eigen::Quaternionf(Eigen::AngleAxisf(static_cast<float>(-EIGEN_PI / 2), Eigen::Vector3f::UnitY())),
+        Eigen::Quaternionf(Eigen::AngleAxisf(static_cast<float>(EIGEN_PI / 2), Eigen::Vector3f::UnitX())),
+        Eigen::Quaternionf(Eigen::AngleAxisf(static_cast<float>(-EIGEN_PI / 2), Eigen::Vector3f::UnitX())),
+    };
+    const Eigen::Vector3f positions[] =
+    {
+        Eigen::Vector3f::Zero(),
+        Eigen::Vector3f(500.0f, -200.0f, 1200.0f),
+        Eigen::Vector3f(-1500.0f, 1500.0f, -300.0f),
+    };
+
+    std::vector<StarRange> ranges;
+    for (const auto& position : positions)
+    {
+        for (const auto& orientation : orientations)
+            db.findVisibleStarRanges(ranges, position, orientation, 1.0f, 1.0f, 6.0f);
+    }
+
+    return ranges;
+}
+
+void requireSameStars(const StarDatabase& v2,
+                      const StarDatabase& v1,
+                      const std::vector<StarDatabase::BinaryRecord>& records)
+{
+    REQUIRE(v2.size() == records.size());
+    REQUIRE(v1.size() == records.size());
+    for (const auto& record : records)
+    {
+        const Star* star2 = v2.find(record.catalogNumber);
+        const Star* star1 = v1.find(record.catalogNumber);
+        REQUIRE(star2 != nullptr);
+        REQUIRE(star1 != nullptr);
+        REQUIRE(star2->getPosition() == record.position);
+        REQUIRE(star1->getPosition() == record.position);
+        REQUIRE(star2->getAbsoluteMagnitude() == star1->getAbsoluteMagnitude());
+    }
+}
+
+float starDistance(const Star& star, const Eigen::Vector3f& observer)
+{
+    return (star.getPosition() - observer).norm();
+}
+
+bool matchesQuery(const Star& star, const CatalogQuery& query)
+{
+    Eigen::Vector3f offset = star.getPosition() - query.observer.cast<float>();
+    float distance = offset.norm();
+    float absMag = star.getAbsoluteMagnitude();
+    float appMag = star.getApparentMagnitude(distance);
+    return absMag >= query.minAbsMag && absMag <= query.maxAbsMag &&
+           distance >= query.minDistance && distance <= query.maxDistance &&
+           query.inCone(offset.cast<double>(), distance) &&
+           appMag >= query.minAppMag && appMag <= query.maxAppMag &&
+           (CatalogQuery::spectralClassBit(star.getSpectralType()[0]) & query.spectralClassMask) != 0;
+}
+
+float queryKey(const Star& star, const CatalogQuery& query)
+{
+    const Eigen::Vector3f observer = query.observer.cast<float>();
+    switch (query.sortKey)
+    {
+    case CatalogQuery::SortKey::ApparentMagnitude:
+        return star.getApparentMagnitude(starDistance(star, observer));
+    case CatalogQuery::SortKey::AbsoluteMagnitude:
+        return star.getAbsoluteMagnitude();
+    case CatalogQuery::SortKey::Distance:
+        return starDistance(star, observer);
+    default:
+        return 0.0f;
+    }
+}
+
+// The stars of the database sorted by key, keeping the first nStars
+template<typename StarKey>
+std::vector<float> bestKeys(const StarDatabase& db, std::size_t nStars, StarKey starKey)
+{
+    std::vector<float> keys;
+    for (std::uint32_t i = 0; i < db.size(); i++)
+        keys.push_back(starKey(*db.getStar(i)));
+
+    std::sort(keys.begin(), keys.end());
+    keys.resize(std::min(keys.size(), nStars));
+    return keys;
+}
+
+template<typename StarKey>
+std::vector<float> resultKeys(const std::vector<const Star*>& result, StarKey starKey)
+{
+    std::vector<float> keys;
+    for (const Star* star : result)
+        keys.push_back(starKey(*star));
+    return keys;
+}
+
+void requireUnique(std::vector<const Star*> result)
+{
+    std::sort(result.begin(), result.end());
+    REQUIRE(std::adjacent_find(result.begin(), result.end()) == result.end());
+}
+
+CatalogQuery randomQuery(std::mt19937& rng)
+{
+    std::uniform_real_distribution<double> position(-2500.0, 2500.0);
+    std::uniform_real_distribution<float> magnitude(-5.0f, 15.0f);
+    std::uniform_real_distribution<float> distance(0.0f, 3000.0f);
+    std::uniform_real_distribution<double> angle(0.05, 2.0);
+    std::uniform_int_distribution<int> choice(0, 3);
+
+    CatalogQuery query;
+    query.observer = Eigen::Vector3d(position(rng), position(rng), position(rng));
+    if (choice(rng) != 0)
+    {
+        query.coneAxis = Eigen::Vector3d(position(rng), position(rng), position(rng)).normalized();
+        query.coneAngle = angle(rng);
+    }
+    if (choice(rng) == 0)
+        query.minDistance = distance(rng);
+    if (choice(rng) == 0)
+        query.maxDistance = query.minDistance + distance(rng);
+    if (choice(rng) == 0)
+        query.maxAppMag = magnitude(rng);
+    if (choice(rng) == 0)
+        query.minAppMag = std::min(query.maxAppMag, 15.0f) - 10.0f;
+    if (choice(rng) == 0)
+        query.maxAbsMag = magnitude(rng);
+    if (choice(rng) == 0)
+        query.minAbsMag = std::min(query.maxAbsMag, 15.0f) - 8.0f;
+    if (choice(rng) == 0)
+    {
+        query.spectralClassMask = CatalogQuery::spectralClassBit('G') |
+                                  CatalogQuery::spectralClassBit('K') |
+                                  CatalogQuery::spectralClassBit('D');
+    }
+
+    query.sortKey = static_cast<CatalogQuery::SortKey>(choice(rng));
+    const std::uint32_t maxResults[] = { 1, 10, 200, query.maxResults };
+    query.maxResults = maxResults[choice(rng)];
+    return query;
+}
+
+StarDatabase* loadQueryDatabase(const fs::path& path)
+{
+    const auto records = randomStars(20000);
+    std::ostringstream out;
+    REQUIRE(StarDatabase::writeBinary(out, records));
+
+    StarDatabase* db = loadFile(path, out.str());
+    REQUIRE(db->getOctreeNodeCount() > 8);
+    return db;
+}
+
+} // end unnamed namespace
+
+TEST_CASE("StarDatabase version 0x0200 files", "[StarDatabase]")
+{
+    const auto records = randomStars(5000);
+    std::ostringstream out;
+    REQUIRE(StarDatabase::writeBinary(out, records));
+    std::string data = out.str();
+
+    // The octree depends on the order the stars are inserted into it; the
+    // version 0x0100 file keeps the order of the records, which is also the
+    // order used by writeBinary().
+    const fs::path path("stardb_test.dat");
+    StarDatabase* v1 = loadFile(path, writeVersion1(records));
+
+    SECTION("Presorted load matches the version 0x0100 one")
+    {
+        StarDatabase* v2 = loadFile(path, data);
+
+        requireSameStars(*v2, *v1, records);
+
+        REQUIRE(v2->getOctreeNodeCount() > 1);
+        REQUIRE(v2->getOctreeNodeCount() == v1->getOctreeNodeCount());
+
+        auto ranges2 = visibleRanges(*v2);
+        auto ranges1 = visibleRanges(*v1);
+        REQUIRE(!ranges2.empty());
+        REQUIRE(ranges2.size() == ranges1.size());
+        for (std::size_t i = 0; i < ranges2.size(); i++)
+        {
+            REQUIRE(ranges2[i].first == ranges1[i].first);
+            REQUIRE(ranges2[i].count == ranges1[i].count);
+        }
+
+        delete v2;
+    }
+
+    SECTION("Unsorted catalog number index is rejected")
+    {
+        // Swap the first two entries of the index at the end of the file
+        auto index = data.end() - static_cast<std::ptrdiff_t>(records.size() * sizeof(std::uint32_t));
+        std::swap_ranges(index, index + sizeof(std::uint32_t), index + sizeof(std::uint32_t));
+
+        StarDatabase* v2 = loadFile(path, data);
+
+        requireSameStars(*v2, *v1, records);
+
+        delete v2;
+    }
+
+    delete v1;
+    fs::remove(path);
+}
+
+TEST_CASE("StarDatabase best star searches", "[StarDatabase]")
+{
+    const fs::path path("stardb_best_test.dat");
+    StarDatabase* db = loadQueryDatabase(path);
+
+    const Eigen::Vector3f observers[] =
+    {
+        Eigen::Vector3f::Zero(),
+        Eigen::Vector3f(1800.0f, -700.0f, 300.0f),
+        Eigen::Vector3f(-4000.0f, 2500.0f, 6000.0f),
+    };
+    const std::uint32_t counts[] = { 1, 7, 100, 1000, db->size() + 5 };
+
+    for (std::uint32_t nStars : counts)
+    {
+        auto luminosity = [](const Star& star) { return star.getAbsoluteMagnitude(); };
+        std::vector<const Star*> result;
+        db->findMostLuminousStars(result, nStars);
+        requireUnique(result);
+        REQUIRE(resultKeys(result, luminosity) == bestKeys(*db, nStars, luminosity));
+
+        for (const auto& observer : observers)
+        {
+            auto distance = [&](const Star& star) { return (observer - star.getPosition()).squaredNorm(); };
+            result.clear();
+            db->findNearestStars(result, observer, nStars);
+            requireUnique(result);
+            REQUIRE(resultKeys(result, distance) == bestKeys(*db, nStars, distance));
+
+            auto brightness = [&](const Star& star)
+            {
+                return star.getApparentMagnitude(starDistance(star, observer));
+            };
+            result.clear();
+            db->findBrightestStars(result, observer, nStars);
+            requireUnique(result);
+            REQUIRE(resultKeys(result, brightness) == bestKeys(*db, nStars, brightness));
+        }
+    }
+
+    delete db;
+    fs::remove(path);
+}
+
+TEST_CASE("StarDatabase queries", "[StarDatabase]")
+{
+    const fs::path path("stardb_query_test.dat");
+    StarDatabase* db = loadQueryDatabase(path);
+
+    std::mt19937 rng(11);
+    std::size_t totalFound = 0;
+    for (int i = 0; i < 100; i++)
+    {
+        CatalogQuery query = randomQuery(rng);
+        auto key = [&](const Star& star) { return queryKey(star, query); };
+
+        std::vector<std::pair<float, const Star*>> matches;
+        for (std::uint32_t j = 0; j < db->size(); j++)
+        {
+            const Star* star = db->getStar(j);
+            if (matchesQuery(*star, query))
+                matches.emplace_back(key(*star), star);
+        }
+        std::stable_sort(matches.begin(), matches.end(),
+                         [](const auto& a, const auto& b) { return a.first < b.first; });
+        bool truncated = matches.size() > query.maxResults;
+        if (truncated)
+            matches.resize(query.maxResults);
+
+        std::vector<const Star*> expected;
+        for (const auto& match : matches)
+            expected.push_back(match.second);
+
+        std::vector<const Star*> result;
+        db->findStars(result, query);
+        totalFound += result.size();
+
+        REQUIRE(result.size() == expected.size());
+        requireUnique(result);
+        REQUIRE(std::all_of(result.begin(), result.end(),
+                            [&](const Star* star) { return matchesQuery(*star, query); }));
+
+        // Stars with equal keys may come in any order, and when the
+        // results are truncated without a sort key, any matching stars
+        // may be returned.
+        if (query.sortKey != CatalogQuery::SortKey::None)
+            REQUIRE(resultKeys(result, key) == resultKeys(expected, key));
+        if (!truncated)
+        {
+            std::sort(result.begin(), result.end());
+            std::sort(expected.begin(), expected.end());
+            REQUIRE(result == expected);
+        }
+    }
+
+    REQUIRE(totalFound > 1000);
+
+    delete db;
+    fs::remove(path);
+}
@@ -342,3 +342,38 @@ TEST_CASE("Tokenizer skips comments", "[Tokenizer]")
 
     REQUIRE(tok.nextToken() == Tokenizer::TokenEnd);
 }
+
+TEST_CASE("Tokenizer replays tokens read in advance", "[Tokenizer]")
+{
+    std::istringstream input("Name 1.5 \"string\"\n"
+                             "{ Key [ 2 ] }");
+    Tokenizer tok(&input);
+    tok.readAll();
+
+    REQUIRE(tok.nextToken() == Tokenizer::TokenName);
+    REQUIRE(tok.getStringValue() == "Name");
+    REQUIRE(tok.getLineNumber() == 1);
+
+    REQUIRE(tok.nextToken() == Tokenizer::TokenNumber);
+    REQUIRE(tok.getNumberValue() == 1.5);
+
+    REQUIRE(tok.nextToken() == Tokenizer::TokenString);
+    REQUIRE(tok.getStringValue() == "string");
+
+    REQUIRE(tok.nextToken() == Tokenizer::TokenBeginGroup);
+    REQUIRE(tok.getLineNumber() == 2);
+
+    REQUIRE(tok.nextToken() == Tokenizer::TokenName);
+    REQUIRE(tok.getStringValue() == "Key");
+    tok.pushBack();
+    REQUIRE(tok.nextToken() == Tokenizer::TokenName);
+    REQUIRE(tok.getStringValue() == "Key");
+
+    REQUIRE(tok.nextToken() == Tokenizer::TokenBeginArray);
+    REQUIRE(tok.nextToken() == Tokenizer::TokenNumber);
+    REQUIRE(tok.getNumberValue() == 2.0);
+    REQUIRE(tok.nextToken() == Tokenizer::TokenEndArray);
+    REQUIRE(tok.nextToken() == Tokenizer::TokenEndGroup);
+    REQUIRE(tok.nextToken() == Tokenizer::TokenEnd);
+    REQUIRE(tok.nextToken() == Tokenizer::TokenEnd);
+}